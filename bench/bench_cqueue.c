@@ -0,0 +1,188 @@
+/* Stress test and thread-scaling benchmark for ConcurrentQueue.
+   Usage: bench_cqueue [ops_per_thread]
+   Exits non-zero if the stress phase detects a lost, duplicated or
+   mis-ordered patient.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "model/cqueue.h"
+
+#define STRESS_PRODUCERS 4
+#define STRESS_CONSUMERS 4
+#define STRESS_PER_PRODUCER 50000
+#define MAX_THREADS 16
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned int xorshift(unsigned int *s) {
+    unsigned int x = *s;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return *s = x;
+}
+
+/* ---------- stress: concurrent producers and consumers ---------- */
+
+static ConcurrentQueue g_cq;
+static atomic_uchar *g_seen;
+static atomic_int g_errors;
+
+typedef struct { int producer; } ProducerArg;
+
+static void* producer_main(void *arg) {
+    int pid = ((ProducerArg*)arg)->producer;
+    unsigned int seed = 0x9e3779b9u * (unsigned)(pid + 1);
+    for (int i = 0; i < STRESS_PER_PRODUCER; ++i) {
+        Severity sev = (Severity)(xorshift(&seed) % 3);
+        Patient *p = create_patient(pid * STRESS_PER_PRODUCER + i, 0, "stress", 30, "", sev, "");
+        cq_enqueue(&g_cq, p);
+    }
+    return NULL;
+}
+
+static void* consumer_main(void *arg) {
+    (void)arg;
+    /* per producer and lane, one consumer must see increasing sequence numbers */
+    int last[STRESS_PRODUCERS][CQ_LANES];
+    for (int i = 0; i < STRESS_PRODUCERS; ++i)
+        for (int j = 0; j < CQ_LANES; ++j) last[i][j] = -1;
+
+    Patient *p;
+    while ((p = cq_dequeue_wait(&g_cq)) != NULL) {
+        int pid = p->id / STRESS_PER_PRODUCER, seq = p->id % STRESS_PER_PRODUCER;
+        if (atomic_exchange(&g_seen[p->id], 1) != 0) atomic_fetch_add(&g_errors, 1);
+        if (seq <= last[pid][p->severity]) atomic_fetch_add(&g_errors, 1);
+        last[pid][p->severity] = seq;
+        free_patient(p);
+    }
+    return NULL;
+}
+
+/* with no concurrent enqueues, every consumer must see non-increasing severity */
+static void* drain_main(void *arg) {
+    (void)arg;
+    int last = CRITICAL;
+    Patient *p;
+    while ((p = cq_try_dequeue(&g_cq)) != NULL) {
+        if ((int)p->severity > last) atomic_fetch_add(&g_errors, 1);
+        last = (int)p->severity;
+        free_patient(p);
+    }
+    return NULL;
+}
+
+static int run_stress(void) {
+    int total = STRESS_PRODUCERS * STRESS_PER_PRODUCER;
+    g_seen = calloc((size_t)total, sizeof(atomic_uchar));
+    if (!g_seen || !cq_init(&g_cq)) return 0;
+    atomic_store(&g_errors, 0);
+
+    pthread_t prod[STRESS_PRODUCERS], cons[STRESS_CONSUMERS];
+    ProducerArg args[STRESS_PRODUCERS];
+    for (int i = 0; i < STRESS_CONSUMERS; ++i) pthread_create(&cons[i], NULL, consumer_main, NULL);
+    for (int i = 0; i < STRESS_PRODUCERS; ++i) {
+        args[i].producer = i;
+        pthread_create(&prod[i], NULL, producer_main, &args[i]);
+    }
+    for (int i = 0; i < STRESS_PRODUCERS; ++i) pthread_join(prod[i], NULL);
+    cq_close(&g_cq);
+    for (int i = 0; i < STRESS_CONSUMERS; ++i) pthread_join(cons[i], NULL);
+
+    int missing = 0;
+    for (int i = 0; i < total; ++i) if (!g_seen[i]) missing++;
+    printf("stress mpmc : %d patients, %d producers, %d consumers, %d missing, %d errors\n",
+           total, STRESS_PRODUCERS, STRESS_CONSUMERS, missing, atomic_load(&g_errors));
+    int ok = missing == 0 && atomic_load(&g_errors) == 0 && cq_size(&g_cq) == 0;
+    cq_destroy(&g_cq);
+    free(g_seen);
+
+    /* ordering phase */
+    cq_init(&g_cq);
+    atomic_store(&g_errors, 0);
+    unsigned int seed = 12345;
+    for (int i = 0; i < 100000; ++i) {
+        cq_enqueue(&g_cq, create_patient(i, 0, "order", 30, "", (Severity)(xorshift(&seed) % 3), ""));
+    }
+    for (int i = 0; i < STRESS_CONSUMERS; ++i) pthread_create(&cons[i], NULL, drain_main, NULL);
+    for (int i = 0; i < STRESS_CONSUMERS; ++i) pthread_join(cons[i], NULL);
+    printf("stress order: 100000 patients, %d consumers, %d severity inversions\n",
+           STRESS_CONSUMERS, atomic_load(&g_errors));
+    ok = ok && atomic_load(&g_errors) == 0;
+    cq_destroy(&g_cq);
+    return ok;
+}
+
+/* ---------- scaling: enqueue/dequeue pairs from 1..16 threads ---------- */
+
+typedef struct {
+    long ops;
+    int tid;
+} ScaleArg;
+
+static pthread_barrier_t g_start;
+
+static void* scale_main(void *arg) {
+    ScaleArg *a = arg;
+    unsigned int seed = 0x1234567u + (unsigned)a->tid;
+    /* private pool so the measurement is queue work, not malloc */
+    Patient *pool[64];
+    for (int i = 0; i < 64; ++i) pool[i] = create_patient(i, 0, "bench", 30, "", NORMAL, "");
+    int have = 64;
+
+    pthread_barrier_wait(&g_start);
+    for (long i = 0; i < a->ops; ++i) {
+        if (have > 0) {
+            Patient *p = pool[--have];
+            p->severity = (Severity)(xorshift(&seed) % 3);
+            cq_enqueue(&g_cq, p);
+        }
+        Patient *got = cq_try_dequeue(&g_cq);
+        if (got && have < 64) pool[have++] = got;
+        else if (got) free_patient(got);
+    }
+    while (have > 0) free_patient(pool[--have]);
+    return NULL;
+}
+
+static void run_scaling(long ops_per_thread) {
+    static const int counts[] = {1, 2, 4, 8, 16};
+    printf("\nthreads | Mops/s (enqueue+dequeue pairs)\n");
+    printf("--------+------------------------------\n");
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+        int n = counts[c];
+        pthread_t th[MAX_THREADS];
+        ScaleArg args[MAX_THREADS];
+        cq_init(&g_cq);
+        pthread_barrier_init(&g_start, NULL, (unsigned)n + 1);
+        for (int i = 0; i < n; ++i) {
+            args[i].ops = ops_per_thread;
+            args[i].tid = i;
+            pthread_create(&th[i], NULL, scale_main, &args[i]);
+        }
+        double t0 = now_sec();
+        pthread_barrier_wait(&g_start);
+        for (int i = 0; i < n; ++i) pthread_join(th[i], NULL);
+        double dt = now_sec() - t0;
+        printf("%7d | %8.2f\n", n, (double)n * ops_per_thread * 2 / dt / 1e6);
+        pthread_barrier_destroy(&g_start);
+        cq_destroy(&g_cq);
+    }
+}
+
+int main(int argc, char **argv) {
+    long ops = argc > 1 ? atol(argv[1]) : 1000000;
+    if (ops <= 0) ops = 1000000;
+
+    int ok = run_stress();
+    run_scaling(ops);
+    if (!ok) printf("\nSTRESS TEST FAILED\n");
+    return ok ? 0 : 1;
+}
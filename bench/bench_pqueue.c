@@ -0,0 +1,308 @@
+/* Ordering checks and throughput benchmark for the PriorityQueue packed keys
+   and copy-on-write snapshots.
+   Usage: bench_pqueue [patients]
+   Every scheduling policy (strict/aging x severity/triage) is checked against
+   a field-by-field reference ordering, including re-triage and removal in
+   the middle of the queue. Snapshots are checked to stay frozen while the
+   queue changes, including from a reader thread. Exits non-zero on failure.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "model/queue.h"
+#include "model/snapshot.h"
+#include "util/time_util.h"
+
+#define CHECK_PATIENTS 20000
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned int xorshift(unsigned int *s) {
+    unsigned int x = *s;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return *s = x;
+}
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("  FAIL: " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+/* ---------- reference ordering, straight from the patient fields ---------- */
+
+static int ref_vuln(const PqPolicy *pol, const Patient *p) {
+    int v = 0;
+    if ((pol->factors & PQ_FACTOR_AGE) && (p->age < pol->child_age || p->age > pol->elder_age)) v++;
+    if ((pol->factors & PQ_FACTOR_PREGNANCY) && (p->flags & PATIENT_PREGNANT)) v++;
+    return v;
+}
+
+/* 1 if a must be served before b */
+static int ref_before(const PqPolicy *pol, const Patient *a, const Patient *b) {
+    if (pol->mode == PQ_MODE_AGING) {
+        long da = (long)a->arrival_ts + (pol->max_wait_sec[a->severity] >> ref_vuln(pol, a));
+        long db = (long)b->arrival_ts + (pol->max_wait_sec[b->severity] >> ref_vuln(pol, b));
+        if (da != db) return da < db;
+    } else {
+        if (a->severity != b->severity) return a->severity > b->severity;
+        int va = ref_vuln(pol, a), vb = ref_vuln(pol, b);
+        if (va != vb) return va > vb;
+    }
+    return a->seq < b->seq;
+}
+
+static Patient* make_patient(int id, unsigned int *seed, time_t base) {
+    char arrival[TIME_LEN];
+    format_iso_time(base - (time_t)(xorshift(seed) % (3 * 3600)), arrival, sizeof(arrival));
+    int age = (int)(xorshift(seed) % 100);
+    Patient *p = create_patient(id, 0, "check", age, "", (Severity)(xorshift(seed) % 3), arrival);
+    if (p && xorshift(seed) % 10 == 0) p->flags |= PATIENT_PREGNANT;
+    return p;
+}
+
+static void check_policy(const char *label, const PqPolicy *pol) {
+    PriorityQueue q;
+    pq_init(&q);
+    pq_set_policy(&q, pol);
+    unsigned int seed = 12345;
+    time_t base = time(NULL);
+
+    Patient **all = malloc(CHECK_PATIENTS * sizeof(Patient*));
+    for (int i = 0; i < CHECK_PATIENTS; ++i) {
+        all[i] = make_patient(i, &seed, base);
+        pq_enqueue(&q, all[i]);
+    }
+    /* re-triage 10% and remove 5% while queued */
+    int removed = 0;
+    for (int i = 0; i < CHECK_PATIENTS; ++i) {
+        unsigned int r = xorshift(&seed) % 100;
+        if (r < 10) {
+            pq_update_severity(&q, all[i], (Severity)(xorshift(&seed) % 3));
+        } else if (r < 15) {
+            pq_remove(&q, all[i]);
+            free_patient(all[i]);
+            all[i] = NULL;
+            removed++;
+        }
+    }
+    CHECK(pq_size(&q) == CHECK_PATIENTS - removed, "%s: size %d, expected %d", label, pq_size(&q), CHECK_PATIENTS - removed);
+
+    Patient *prev = NULL;
+    int served = 0, bad = 0;
+    Patient *p;
+    while ((p = pq_dequeue(&q)) != NULL) {
+        if (prev && ref_before(pol, p, prev)) {
+            if (bad++ == 0) printf("  FAIL: %s: patient %d served after %d\n", label, p->id, prev->id);
+        }
+        if (prev) free_patient(prev);
+        prev = p;
+        served++;
+    }
+    if (prev) free_patient(prev);
+    if (bad) failures++;
+    CHECK(served == CHECK_PATIENTS - removed, "%s: served %d, expected %d", label, served, CHECK_PATIENTS - removed);
+    printf("  %-28s %s (%d served in order)\n", label, bad ? "FAIL" : "ok", served);
+    free(all);
+    pq_free_all(&q);
+}
+
+/* Hand-picked cases that document the policy */
+static void check_examples(void) {
+    PqPolicy pol;
+    pq_policy_default(&pol);
+    pol.factors = PQ_FACTOR_AGE | PQ_FACTOR_PREGNANCY;
+
+    PriorityQueue q;
+    pq_init(&q);
+    pq_set_policy(&q, &pol);
+    char now[TIME_LEN];
+    get_now_iso(now, sizeof(now));
+
+    Patient *adult = create_patient(1, 0, "adult", 40, "", SERIOUS, now);
+    Patient *edge = create_patient(2, 0, "seventy-five", 75, "", SERIOUS, now);
+    Patient *elder = create_patient(3, 0, "elder", 80, "", SERIOUS, now);
+    Patient *child = create_patient(4, 0, "child", 3, "", SERIOUS, now);
+    Patient *preg = create_patient(5, 0, "pregnant", 30, "", SERIOUS, now);
+    Patient *crit = create_patient(6, 0, "critical", 40, "", CRITICAL, now);
+    Patient *preg_elder = create_patient(7, 0, "pregnant-elder", 76, "", NORMAL, now);
+    preg->flags |= PATIENT_PREGNANT;
+    preg_elder->flags |= PATIENT_PREGNANT;
+
+    Patient *in[] = { adult, edge, elder, child, preg, crit, preg_elder };
+    for (int i = 0; i < 7; ++i) pq_enqueue(&q, in[i]);
+
+    /* CRITICAL first; then vulnerable SERIOUS in arrival order; 75 is not over 75 */
+    int expect[] = { 6, 3, 4, 5, 1, 2, 7 };
+    for (int i = 0; i < 7; ++i) {
+        Patient *p = pq_dequeue(&q);
+        CHECK(p && p->id == expect[i], "triage example #%d: got %d, expected %d", i + 1, p ? p->id : -1, expect[i]);
+        free_patient(p);
+    }
+
+    /* severity-only policy ignores the same factors */
+    pq_policy_default(&pol);
+    pq_set_policy(&q, &pol);
+    Patient *a = create_patient(10, 0, "adult", 40, "", NORMAL, now);
+    Patient *c = create_patient(11, 0, "child", 2, "", NORMAL, now);
+    pq_enqueue(&q, a);
+    pq_enqueue(&q, c);
+    Patient *first = pq_dequeue(&q);
+    CHECK(first == a, "severity-only policy reordered by age");
+    free_patient(first);
+    pq_free_all(&q);
+    printf("  %-28s %s\n", "hand-picked triage examples", failures ? "FAIL" : "ok");
+}
+
+/* ---------- snapshots ---------- */
+
+static long snapshot_checksum(const QueueSnapshot *s, int *count) {
+    long sum = 0;
+    int n = 0, cursor = 0;
+    const PatientRecord *r;
+    while ((r = qsnap_next(s, &cursor)) != NULL) {
+        sum += (long)r->id * 3 + r->severity;
+        n++;
+    }
+    *count = n;
+    return sum;
+}
+
+static PriorityQueue g_q;
+static pthread_mutex_t g_qlock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int g_writer_done;
+static atomic_int g_snap_errors;
+static atomic_int g_snaps_taken;
+
+/* Reader: each snapshot must read back identically after the writer moved on */
+static void* snapshot_reader(void *arg) {
+    (void)arg;
+    while (!atomic_load(&g_writer_done)) {
+        pthread_mutex_lock(&g_qlock);
+        QueueSnapshot *s = pq_snapshot(&g_q);
+        pthread_mutex_unlock(&g_qlock);
+        if (!s) continue;
+        int n1, n2;
+        long c1 = snapshot_checksum(s, &n1);
+        const PatientRecord *top[1];
+        qsnap_ordered(s, top, 1);
+        long c2 = snapshot_checksum(s, &n2);
+        if (c1 != c2 || n1 != n2 || n1 != qsnap_size(s)) atomic_fetch_add(&g_snap_errors, 1);
+        qsnap_release(s);
+        atomic_fetch_add(&g_snaps_taken, 1);
+    }
+    return NULL;
+}
+
+static void check_snapshots(void) {
+    PriorityQueue q;
+    pq_init(&q);
+    unsigned int seed = 99;
+    time_t base = time(NULL);
+    for (int i = 0; i < 1000; ++i) pq_enqueue(&q, make_patient(i, &seed, base));
+
+    QueueSnapshot *s = pq_snapshot(&q);
+    int before_n;
+    long before = snapshot_checksum(s, &before_n);
+    /* churn the live queue well past a compaction */
+    for (int i = 0; i < 3000; ++i) {
+        Patient *p = pq_dequeue(&q);
+        if (p && i % 2) { pq_update_severity(&q, pq_peek(&q), CRITICAL); }
+        free_patient(p);
+        pq_enqueue(&q, make_patient(1000 + i, &seed, base));
+    }
+    int after_n;
+    long after = snapshot_checksum(s, &after_n);
+    CHECK(before == after && before_n == after_n && after_n == 1000, "snapshot changed under the writer");
+    qsnap_release(s);
+
+    /* a fresh snapshot matches the live queue, in service order */
+    s = pq_snapshot(&q);
+    const PatientRecord *first[1];
+    CHECK(qsnap_size(s) == pq_size(&q), "snapshot size %d, queue %d", qsnap_size(s), pq_size(&q));
+    CHECK(qsnap_ordered(s, first, 1) == 1 && first[0]->id == pq_peek(&q)->id, "snapshot head differs from pq_peek");
+    qsnap_release(s);
+    pq_free_all(&q);
+
+    /* concurrent: writer mutates under the lock, reader iterates lock-free */
+    pq_init(&g_q);
+    pthread_t rd;
+    pthread_create(&rd, NULL, snapshot_reader, NULL);
+    for (int i = 0; i < 200000; ++i) {
+        pthread_mutex_lock(&g_qlock);
+        if (pq_size(&g_q) > 2000) free_patient(pq_dequeue(&g_q));
+        pq_enqueue(&g_q, make_patient(i, &seed, base));
+        pthread_mutex_unlock(&g_qlock);
+    }
+    atomic_store(&g_writer_done, 1);
+    pthread_join(rd, NULL);
+    pq_free_all(&g_q);
+    CHECK(atomic_load(&g_snap_errors) == 0, "%d inconsistent snapshot reads", atomic_load(&g_snap_errors));
+    printf("  %-28s %s (%d concurrent snapshots)\n", "copy-on-write snapshots",
+           atomic_load(&g_snap_errors) ? "FAIL" : "ok", atomic_load(&g_snaps_taken));
+}
+
+/* ---------- throughput ---------- */
+
+static void bench_policy(const char *label, const PqPolicy *pol, int n) {
+    PriorityQueue q;
+    pq_init(&q);
+    pq_set_policy(&q, pol);
+    unsigned int seed = 777;
+    time_t base = time(NULL);
+
+    Patient **ps = malloc((size_t)n * sizeof(Patient*));
+    for (int i = 0; i < n; ++i) ps[i] = make_patient(i, &seed, base);
+
+    double t0 = now_sec();
+    for (int i = 0; i < n; ++i) pq_enqueue(&q, ps[i]);
+    double t1 = now_sec();
+    for (int i = 0; i < n / 10; ++i) {
+        Patient *p = ps[xorshift(&seed) % (unsigned)n];
+        pq_update_severity(&q, p, (Severity)(xorshift(&seed) % 3));
+    }
+    double t2 = now_sec();
+    int out = 0;
+    Patient *p;
+    while ((p = pq_dequeue(&q)) != NULL) { free_patient(p); out++; }
+    double t3 = now_sec();
+
+    printf("  %-28s enqueue %6.2f M/s | retriage %6.2f M/s | dequeue %6.2f M/s\n", label,
+           n / (t1 - t0) / 1e6, (n / 10) / (t2 - t1) / 1e6, out / (t3 - t2) / 1e6);
+    free(ps);
+    pq_free_all(&q);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (n < 1000) n = 1000;
+
+    PqPolicy pols[4];
+    const char *labels[4] = { "strict/severity", "strict/triage", "aging/severity", "aging/triage" };
+    for (int i = 0; i < 4; ++i) {
+        pq_policy_default(&pols[i]);
+        if (i >= 2) pols[i].mode = PQ_MODE_AGING;
+        if (i % 2) pols[i].factors = PQ_FACTOR_AGE | PQ_FACTOR_PREGNANCY;
+    }
+
+    printf("Ordering checks\n");
+    check_examples();
+    for (int i = 0; i < 4; ++i) check_policy(labels[i], &pols[i]);
+    check_snapshots();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("\nThroughput (%d patients)\n", n);
+    for (int i = 0; i < 4; ++i) bench_policy(labels[i], &pols[i], n);
+    return 0;
+}
@@ -0,0 +1,223 @@
+/* Ordering checks and backlog benchmark for the disk-backed queue overflow.
+   Usage: bench_spill [patients] [mem_cap]
+   A spilling queue is run against an all-in-memory one through the same
+   random mix of enqueues, dequeues and re-triages under every scheduling
+   policy; both must serve the same patients in the same order and save the
+   same queue.csv. Then a backlog of `patients` (default 10M) is enqueued
+   and drained with at most mem_cap (default 100k, 0 = no spilling) in
+   memory, checking that keys come out in order and every patient is served.
+   Exits non-zero on failure.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "model/queue.h"
+#include "model/snapshot.h"
+#include "util/time_util.h"
+
+#define CHECK_OPS 60000
+#define CHECK_CAP 500
+#define SPILL_DIR "data/spill"
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned int xorshift(unsigned int *s) {
+    unsigned int x = *s;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return *s = x;
+}
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("  FAIL: " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+/* Peak resident set in MiB, from /proc (0 where unavailable) */
+static long peak_rss_mb(void) {
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f) return 0;
+    char line[256];
+    long kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb / 1024;
+}
+
+static Patient* make_patient(int id, unsigned int *seed, time_t base) {
+    char arrival[TIME_LEN];
+    /* out-of-order arrivals, as after transfers, exercise the AGING guard */
+    format_iso_time(base - (time_t)(xorshift(seed) % (3 * 3600)), arrival, sizeof(arrival));
+    int age = (int)(xorshift(seed) % 100);
+    Patient *p = create_patient(id, 5550000000LL + id, "spill check", age, "chest pain", (Severity)(xorshift(seed) % 3), arrival);
+    if (p && xorshift(seed) % 10 == 0) p->flags |= PATIENT_PREGNANT;
+    return p;
+}
+
+static int same_file(const char *a, const char *b) {
+    FILE *fa = fopen(a, "r"), *fb = fopen(b, "r");
+    int same = fa && fb;
+    while (same) {
+        int ca = fgetc(fa), cb = fgetc(fb);
+        if (ca != cb) same = 0;
+        if (ca == EOF) break;
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return same;
+}
+
+/* ---------- ordering against an in-memory queue ---------- */
+
+static void check_policy(const char *label, const PqPolicy *pol) {
+    PriorityQueue ref, sp;
+    pq_init(&ref);
+    pq_init(&sp);
+    pq_set_policy(&ref, pol);
+    pq_set_policy(&sp, pol);
+    if (!pq_spill_enable(&sp, CHECK_CAP, SPILL_DIR)) {
+        CHECK(0, "%s: cannot create spill runs in %s", label, SPILL_DIR);
+        return;
+    }
+    Patient **ref_by_id = calloc(CHECK_OPS, sizeof(Patient*));
+    unsigned int seed = 4242, seed_ref = 4242, ops = 99;
+    time_t base = time(NULL);
+    int next_id = 0, mismatches = 0, max_mem = 0;
+
+    for (int i = 0; i < CHECK_OPS; ++i) {
+        unsigned op = xorshift(&ops) % 10;
+        if (op < 6) {
+            Patient *a = make_patient(next_id, &seed, base), *b = make_patient(next_id, &seed_ref, base);
+            ref_by_id[next_id++] = b;
+            pq_enqueue(&sp, a);
+            pq_enqueue(&ref, b);
+        } else if (op < 9) {
+            Patient *a = pq_dequeue(&sp), *b = pq_dequeue(&ref);
+            if ((a == NULL) != (b == NULL) || (a && a->id != b->id)) mismatches++;
+            if (b) ref_by_id[b->id] = NULL;
+            free_patient(a);
+            free_patient(b);
+        } else if (sp.count > 0) {
+            /* re-triage one of the in-memory patients */
+            Patient *a = sp.heap[xorshift(&ops) % (unsigned)sp.count];
+            Severity sev = (Severity)(xorshift(&ops) % 3);
+            pq_update_severity(&sp, a, sev);
+            pq_update_severity(&ref, ref_by_id[a->id], sev);
+        }
+        if (sp.count > max_mem) max_mem = sp.count;
+    }
+    CHECK(pq_size(&sp) == pq_size(&ref), "%s: size %d, expected %d", label, pq_size(&sp), pq_size(&ref));
+    CHECK(pq_spilled(&sp) > 0, "%s: nothing was spilled", label);
+
+    /* persistence, live and from a snapshot */
+    pq_save_csv(&ref, "data/spill_check_ref.csv");
+    pq_save_csv(&sp, "data/spill_check.csv");
+    CHECK(same_file("data/spill_check_ref.csv", "data/spill_check.csv"), "%s: pq_save_csv differs", label);
+    QueueSnapshot *s = pq_snapshot(&sp);
+    CHECK(qsnap_size(s) == pq_size(&ref), "%s: snapshot size %d", label, qsnap_size(s));
+    free_patient(pq_dequeue(&sp));           /* the snapshot must not see this */
+    free_patient(pq_dequeue(&ref));
+    qsnap_save_csv(s, "data/spill_check.csv");
+    qsnap_release(s);
+    CHECK(same_file("data/spill_check_ref.csv", "data/spill_check.csv"), "%s: qsnap_save_csv differs", label);
+
+    /* drain */
+    Patient *a, *b;
+    while ((b = pq_dequeue(&ref)) != NULL) {
+        a = pq_dequeue(&sp);
+        if (!a || a->id != b->id) mismatches++;
+        free_patient(a);
+        free_patient(b);
+    }
+    CHECK(pq_dequeue(&sp) == NULL, "%s: spill queue not empty after drain", label);
+    CHECK(mismatches == 0, "%s: %d dequeues out of order", label, mismatches);
+    printf("  %-28s %s (%d in memory at most)\n", label, mismatches ? "FAIL" : "ok", max_mem);
+    remove("data/spill_check_ref.csv");
+    remove("data/spill_check.csv");
+    free(ref_by_id);
+    pq_free_all(&sp);
+    pq_free_all(&ref);
+}
+
+/* ---------- backlog ---------- */
+
+static void bench_backlog(int n, int mem_cap) {
+    PriorityQueue q;
+    pq_init(&q);
+    PqPolicy pol;
+    pq_policy_default(&pol);
+    pol.factors = PQ_FACTOR_AGE | PQ_FACTOR_PREGNANCY;
+    pq_set_policy(&q, &pol);
+    if (mem_cap > 0 && !pq_spill_enable(&q, mem_cap, SPILL_DIR)) {
+        CHECK(0, "cannot create spill runs in %s", SPILL_DIR);
+        return;
+    }
+    unsigned int seed = 777;
+    time_t base = time(NULL) - n / 100;
+
+    double t0 = now_sec();
+    for (int i = 0; i < n; ++i) {
+        char arrival[TIME_LEN];
+        format_iso_time(base + i / 100, arrival, sizeof(arrival));
+        Patient *p = create_patient(i, 5550000000LL + i, "backlog", (int)(xorshift(&seed) % 100),
+                                    "vaccination", (Severity)(xorshift(&seed) % 3), arrival);
+        pq_enqueue(&q, p);
+    }
+    double t1 = now_sec();
+    int spilled = pq_spilled(&q), resident = q.count;
+
+    int out = 0, disorder = 0;
+    uint64_t last = 0;
+    Patient *p;
+    while ((p = pq_dequeue(&q)) != NULL) {
+        if (out > 0 && p->sort_key <= last) disorder++;
+        last = p->sort_key;
+        free_patient(p);
+        out++;
+    }
+    double t2 = now_sec();
+    CHECK(out == n, "served %d of %d", out, n);
+    CHECK(disorder == 0, "%d patients served out of order", disorder);
+
+    printf("  %d patients, mem_cap %d: %d in memory, %d spilled\n", n, mem_cap, resident, spilled);
+    printf("  enqueue %6.2f M/s | dequeue %6.2f M/s | peak RSS %ld MiB\n",
+           n / (t1 - t0) / 1e6, out / (t2 - t1) / 1e6, peak_rss_mb());
+    pq_free_all(&q);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 10000000;
+    int mem_cap = argc > 2 ? atoi(argv[2]) : 100000;
+    if (n < 1000) n = 1000;
+
+    PqPolicy pols[4];
+    const char *labels[4] = { "strict/severity", "strict/triage", "aging/severity", "aging/triage" };
+    for (int i = 0; i < 4; ++i) {
+        pq_policy_default(&pols[i]);
+        if (i >= 2) pols[i].mode = PQ_MODE_AGING;
+        if (i % 2) pols[i].factors = PQ_FACTOR_AGE | PQ_FACTOR_PREGNANCY;
+    }
+
+    printf("Ordering checks (spill vs in-memory)\n");
+    for (int i = 0; i < 4; ++i) check_policy(labels[i], &pols[i]);
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("\nBacklog\n");
+    bench_backlog(n, mem_cap);
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,420 @@
+/* Benchmark suite over synthetic data, with machine-readable results.
+   Usage: bench_suite [--rows N] [--served-rows N] [--dir DIR] [--json FILE] [--seed S]
+   Generates DIR/data/queue.csv (N waiting, default 100000) and
+   DIR/data/served.csv (default N rows) with datagen.c, then times from DIR:
+     - pq_load_csv / pq_save_csv on the queue file
+     - pq_search_by_id / pq_search_by_name (hits at random positions, and a miss)
+     - pq_dequeue and pq_enqueue of the whole queue
+     - building the patient name index over both files, and ranked
+       surname, short and missing-name searches on it, and typo-tolerant
+       searches for misspelt surnames
+     - phone-number lookups of waiting patients' earlier visits
+     - ad-hoc filter queries over both files: the first (which builds the
+       served.csv date index), a repeat without date terms, one whose date
+       term lets the index skip most of served.csv, a problem-text filter
+       and one keeping 100 rows for display
+     - every served.csv report from the menu, plus history_next_id and
+       dispatch_load_history
+     - the one-pass analytics behind those reports: read in full, refreshed
+       unchanged, and refreshed after 1000 appended rows
+     - the PBKDF2 hashing auth_login does per attempt
+   Prints a table and writes the results as JSON to FILE (default
+   bench_results.json in the current directory, "-" for stdout), so runs
+   can be compared across revisions.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "datagen.h"
+#include "controller/controller.h"
+#include "crypto/sha256.h"
+#include "model/analytics.h"
+#include "model/dispatch.h"
+#include "model/history.h"
+#include "model/patient_index.h"
+#include "model/query.h"
+#include "model/queue.h"
+#include "util/file_util.h"
+#include "util/metrics.h"
+#include "util/time_util.h"
+#include "view/view.h"
+
+#ifndef BENCH_REVISION
+#define BENCH_REVISION "unknown"
+#endif
+
+#define MAX_RESULTS 64
+#define SEARCH_BUDGET 200000000.0   /* patient visits per search benchmark */
+
+typedef struct Result {
+    char name[48];
+    long rows;                /* size of the data the operation ran over */
+    long ops;
+    double sec;
+} Result;
+
+static Result results[MAX_RESULTS];
+static int nresults = 0;
+
+static double now_sec(void) {
+    return (double)monotonic_ns() / 1e9;
+}
+
+static void record(const char *name, long rows, long ops, double sec) {
+    if (nresults == MAX_RESULTS) return;
+    Result *r = &results[nresults++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->rows = rows;
+    r->ops = ops;
+    r->sec = sec;
+    printf("  %-28s %10ld ops %10.3f ms %12.1f ns/op\n", name, ops, sec * 1e3, ops ? sec * 1e9 / (double)ops : 0.0);
+    fflush(stdout);
+}
+
+/* The reports print every row; send that to /dev/null while timing */
+static int quiet_begin(void) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int nul = open("/dev/null", O_WRONLY);
+    if (nul >= 0) { dup2(nul, STDOUT_FILENO); close(nul); }
+    return saved;
+}
+
+static void quiet_end(int saved) {
+    fflush(stdout);
+    if (saved >= 0) { dup2(saved, STDOUT_FILENO); close(saved); }
+}
+
+static unsigned int xorshift(unsigned int *s) {
+    unsigned int x = *s;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return *s = x;
+}
+
+static void bench_queue(long rows) {
+    PriorityQueue q;
+    pq_init(&q);
+    int next_id = 0;
+    double t0 = now_sec();
+    pq_load_csv(&q, "data/queue.csv", &next_id);
+    record("pq_load_csv", rows, pq_size(&q), now_sec() - t0);
+
+    t0 = now_sec();
+    pq_save_csv(&q, "data/queue_out.csv");
+    record("pq_save_csv", rows, pq_size(&q), now_sec() - t0);
+    remove("data/queue_out.csv");
+
+    /* linear scans: keep the total work bounded at large sizes */
+    int n = q.count;
+    long k = n > 0 ? (long)(SEARCH_BUDGET / n) : 0;
+    if (k > 10000) k = 10000;
+    if (k < 10) k = 10;
+    unsigned int seed = 12345;
+    int *ids = malloc(sizeof(int) * (size_t)k);
+    char (*names)[NAME_LEN] = malloc(NAME_LEN * (size_t)k);
+    if (n > 0 && ids && names) {
+        for (long i = 0; i < k; ++i) {
+            const Patient *p = q.heap[xorshift(&seed) % (unsigned)n];
+            ids[i] = p->id;
+            snprintf(names[i], NAME_LEN, "%s", p->name);
+        }
+        long found = 0;
+        t0 = now_sec();
+        for (long i = 0; i < k; ++i) found += pq_search_by_id(&q, ids[i]) != NULL;
+        record("pq_search_by_id", rows, k, now_sec() - t0);
+        t0 = now_sec();
+        for (long i = 0; i < k; ++i) found += pq_search_by_name(&q, names[i]) != NULL;
+        record("pq_search_by_name", rows, k, now_sec() - t0);
+        long misses = k < 100 ? k : 100;
+        t0 = now_sec();
+        for (long i = 0; i < misses; ++i) found += pq_search_by_name(&q, "Nobody Of This Name") != NULL;
+        record("pq_search_by_name_miss", rows, misses, now_sec() - t0);
+        if (found != 2 * k) printf("  warning: %ld of %ld searches missed\n", 2 * k - found, 2 * k);
+    }
+    free(ids);
+    free(names);
+
+    /* the reports that estimate waits need the loaded queue */
+    int saved = quiet_begin();
+    t0 = now_sec();
+    for (int sev = 0; sev < 3; ++sev) controller_run_report("predict_wait", &q, sev);
+    double predict = now_sec() - t0;
+    quiet_end(saved);
+    record("report.predict_wait", rows, 3, predict);
+
+    Patient **all = malloc(sizeof(Patient*) * (size_t)(n > 0 ? n : 1));
+    if (all) {
+        t0 = now_sec();
+        for (int i = 0; i < n; ++i) all[i] = pq_dequeue(&q);
+        record("pq_dequeue", rows, n, now_sec() - t0);
+        t0 = now_sec();
+        for (int i = 0; i < n; ++i) pq_enqueue(&q, all[i]);
+        record("pq_enqueue", rows, n, now_sec() - t0);
+        free(all);
+    }
+    pq_free_all(&q);
+}
+
+static void bench_history(long served_rows) {
+    static const char *reports[] = { "served_history", "avg_waits", "peak_hours", "staff_performance",
+                                     "daily_report", "patient_journey" };
+    for (size_t i = 0; i < sizeof(reports) / sizeof(reports[0]); ++i) {
+        char name[48];
+        snprintf(name, sizeof(name), "report.%s", reports[i]);
+        int saved = quiet_begin();
+        double t0 = now_sec();
+        /* the journey looks up the last served patient: a full scan */
+        controller_run_report(reports[i], NULL, strcmp(reports[i], "patient_journey") == 0 ? (int)served_rows : 0);
+        double sec = now_sec() - t0;
+        quiet_end(saved);
+        record(name, served_rows, 1, sec);
+    }
+
+    int saved = quiet_begin();
+    double t0 = now_sec();
+    controller_run_report("served_history", NULL, VIEW_PAGE_ROWS);
+    double sec = now_sec() - t0;
+    quiet_end(saved);
+    record("report.served_history_tail", served_rows, 1, sec);
+
+    t0 = now_sec();
+    history_next_id("data/queue.csv", HISTORY_FILE);
+    record("history_next_id", served_rows, 1, now_sec() - t0);
+
+    Dispatcher d;
+    dispatch_init(&d, 3, HISTORY_FILE);
+    t0 = now_sec();
+    dispatch_load_history(&d);
+    record("dispatch_load_history", served_rows, 1, now_sec() - t0);
+
+    /* the reports above share one analytics pass: time it cold, unchanged,
+       and after rows are appended, then put the file back as it was */
+    Analytics a;
+    analytics_init(&a, HISTORY_FILE);
+    t0 = now_sec();
+    analytics_refresh(&a);
+    record("analytics_full", served_rows, 1, now_sec() - t0);
+    t0 = now_sec();
+    analytics_refresh(&a);
+    record("analytics_unchanged", served_rows, 1, now_sec() - t0);
+    struct stat st;
+    FILE *f = stat(HISTORY_FILE, &st) == 0 ? fopen(HISTORY_FILE, "a") : NULL;
+    if (f) {
+        long appended = 1000;
+        for (long i = 0; i < appended; ++i) {
+            fprintf(f, "%ld,9000000000,Bench Append,40,%ld,2026-01-01 10:00:00,2026-01-01 10:05:00,300,"
+                       "check-up,2026-01-01 10:20:00,1,General\n", served_rows + 1 + i, i % 3);
+        }
+        fclose(f);
+        t0 = now_sec();
+        analytics_refresh(&a);
+        record("analytics_append", appended, 1, now_sec() - t0);
+        if (a.rows_read != appended) printf("  warning: refresh after append read %ld rows\n", a.rows_read);
+        if (truncate(HISTORY_FILE, st.st_size) != 0) perror("truncate");
+    }
+    analytics_free(&a);
+}
+
+static void bench_name_index(long rows, long served_rows) {
+    PriorityQueue q;
+    pq_init(&q);
+    int next_id = 0;
+    pq_load_csv(&q, "data/queue.csv", &next_id);
+
+    PatientIndex ix;
+    PidxTap tap;
+    pidx_init(&ix);
+    pidx_tap_queue(&tap, &ix, "general", &q);
+    double t0 = now_sec();
+    pidx_build_history(&ix, HISTORY_FILE);
+    pidx_add_queue(&tap, &q);
+    record("pidx_build", rows + served_rows, ix.count, now_sec() - t0);
+
+    /* surnames of random waiting patients: common, so many matches each */
+    int n = q.count;
+    long k = 1000;
+    unsigned int seed = 6789;
+    char (*keys)[NAME_LEN] = malloc(NAME_LEN * (size_t)k);
+    PidxHit hits[20];
+    if (n > 0 && keys) {
+        for (long i = 0; i < k; ++i) {
+            const Patient *p = q.heap[xorshift(&seed) % (unsigned)n];
+            const char *last = strrchr(p->name, ' ');
+            snprintf(keys[i], NAME_LEN, "%s", last ? last + 1 : p->name);
+        }
+        long found = 0;
+        t0 = now_sec();
+        for (long i = 0; i < k; ++i) found += pidx_search_name(&ix, keys[i], hits, 20) > 0;
+        record("pidx_search_name", rows + served_rows, k, now_sec() - t0);
+        if (found != k) printf("  warning: %ld of %ld index searches missed\n", k - found, k);
+
+        /* the same surnames with one vowel swapped, as typed at a busy desk */
+        for (long i = 0; i < k; ++i) {
+            char *v = strpbrk(keys[i] + 1, "aeiou");
+            if (v) *v = *v == 'a' ? 'e' : 'a';
+        }
+        found = 0;
+        t0 = now_sec();
+        for (long i = 0; i < k; ++i) found += pidx_search_fuzzy(&ix, keys[i], hits, 20) > 0;
+        record("pidx_search_fuzzy", rows + served_rows, k, now_sec() - t0);
+        if (found != k) printf("  warning: %ld of %ld fuzzy searches missed\n", k - found, k);
+    }
+    free(keys);
+    if (n > 0) {
+        long found = 0;
+        t0 = now_sec();
+        for (long i = 0; i < k; ++i) found += pidx_lookup_phone(&ix, q.heap[xorshift(&seed) % (unsigned)n]->phone_number, hits, 5) > 0;
+        record("pidx_lookup_phone", rows + served_rows, k, now_sec() - t0);
+        if (found != k) printf("  warning: %ld of %ld phone lookups missed\n", k - found, k);
+    }
+    t0 = now_sec();
+    for (int i = 0; i < 100; ++i) pidx_search_name(&ix, "an", hits, 20);
+    record("pidx_search_name_short", rows + served_rows, 100, now_sec() - t0);
+    t0 = now_sec();
+    for (int i = 0; i < 1000; ++i) pidx_search_name(&ix, "Nobody Of This Name", hits, 20);
+    record("pidx_search_name_miss", rows + served_rows, 1000, now_sec() - t0);
+
+    pidx_untap_queue(&tap, &q);
+    pidx_free(&ix);
+    pq_free_all(&q);
+}
+
+static double time_query(QueryIndex *ix, PriorityQueue *q, const char *text, int reps) {
+    Query query;
+    char err[128];
+    if (!query_compile(text, &query, time(NULL), err, sizeof(err))) {
+        printf("  warning: query '%s': %s\n", text, err);
+        return 0.0;
+    }
+    double t0 = now_sec();
+    for (int i = 0; i < reps; ++i) {
+        QueryResult r;
+        query_result_init(&r, &query);
+        query_scan_queue(&query, q, "general", time(NULL), &r);
+        query_scan_history(&query, ix, HISTORY_FILE, &r);
+        query_result_free(&r);
+    }
+    return now_sec() - t0;
+}
+
+static void bench_query(long rows, long served_rows) {
+    PriorityQueue q;
+    pq_init(&q);
+    int next_id = 0;
+    pq_load_csv(&q, "data/queue.csv", &next_id);
+
+    QueryIndex ix;
+    query_index_init(&ix);
+    long n = rows + served_rows;
+    const char *filter = "severity=critical age>60 wait>30 count";
+    record("query_first", n, 1, time_query(&ix, &q, filter, 1));
+    record("query_filter", n, 10, time_query(&ix, &q, filter, 10));
+    record("query_date_7d", n, 10, time_query(&ix, &q, "severity=critical date>=-7d count", 10));
+    record("query_problem", n, 10, time_query(&ix, &q, "problem~fever count", 10));
+    record("query_rows", n, 10, time_query(&ix, &q, "name~kumar limit 100", 10));
+    query_index_free(&ix);
+    pq_free_all(&q);
+}
+
+static unsigned long bench_auth(void) {
+    unsigned long iterations = PBKDF2_DEFAULT_ITERATIONS;
+    const char *env = getenv("HOSP_PBKDF2_ITER");
+    if (env && env[0] && strtoul(env, NULL, 10) > 0) iterations = strtoul(env, NULL, 10);
+    uint8_t salt[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 }, out[32];
+    const int attempts = 3;
+    double t0 = now_sec();
+    for (int i = 0; i < attempts; ++i)
+        pbkdf2_hmac_sha256((const uint8_t*)"admin1", 6, salt, sizeof(salt), (uint32_t)iterations, out, sizeof(out));
+    record("auth_login_hash", 0, attempts, now_sec() - t0);
+    return iterations;
+}
+
+static int write_json(const char *path, long rows, long served_rows, unsigned long long seed, unsigned long iterations) {
+    FILE *f = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!f) return 0;
+    char when[TIME_LEN];
+    get_now_iso(when, sizeof(when));
+    ProcessStats ps;
+    metrics_process(&ps);
+    fprintf(f, "{\n  \"suite\": \"hospital_queue\",\n  \"format\": 1,\n  \"revision\": \"%s\",\n", BENCH_REVISION);
+    fprintf(f, "  \"timestamp\": \"%s\",\n  \"rows\": %ld,\n  \"served_rows\": %ld,\n  \"seed\": %llu,\n",
+            when, rows, served_rows, seed);
+    fprintf(f, "  \"sha256_impl\": \"%s\",\n  \"pbkdf2_iterations\": %lu,\n  \"peak_rss_kb\": %ld,\n",
+            sha256_impl_name(sha256_get_impl()), iterations, ps.peak_rss_kb);
+    fprintf(f, "  \"results\": [\n");
+    for (int i = 0; i < nresults; ++i) {
+        const Result *r = &results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"rows\": %ld, \"ops\": %ld, \"seconds\": %.6f, \"ns_per_op\": %.1f, \"ops_per_sec\": %.1f}%s\n",
+                r->name, r->rows, r->ops, r->sec, r->ops ? r->sec * 1e9 / (double)r->ops : 0.0,
+                r->sec > 0 ? (double)r->ops / r->sec : 0.0, i + 1 < nresults ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    return f == stdout ? 1 : fclose(f) == 0;
+}
+
+int main(int argc, char **argv) {
+    long rows = 100000, served_rows = -1;
+    const char *dir = "bench_data", *json = "bench_results.json";
+    DataGenConfig cfg;
+    datagen_defaults(&cfg, rows);
+    for (int i = 1; i < argc; ++i) {
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--rows") == 0 && v) { rows = atol(v); ++i; }
+        else if (strcmp(argv[i], "--served-rows") == 0 && v) { served_rows = atol(v); ++i; }
+        else if (strcmp(argv[i], "--dir") == 0 && v) { dir = v; ++i; }
+        else if (strcmp(argv[i], "--json") == 0 && v) { json = v; ++i; }
+        else if (strcmp(argv[i], "--seed") == 0 && v) { cfg.seed = strtoull(v, NULL, 10); ++i; }
+        else {
+            fprintf(stderr, "Usage: %s [--rows N] [--served-rows N] [--dir DIR] [--json FILE] [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (rows < 1) rows = 1;
+    if (served_rows < 0) served_rows = rows;
+    metrics_init();
+
+    /* resolve the JSON path before moving into the data directory */
+    char json_path[1024];
+    if (strcmp(json, "-") == 0 || json[0] == '/') snprintf(json_path, sizeof(json_path), "%s", json);
+    else {
+        char cwd[768];
+        if (!getcwd(cwd, sizeof(cwd))) cwd[0] = '\0';
+        snprintf(json_path, sizeof(json_path), "%s/%s", cwd, json);
+    }
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/data", dir);
+    if (!ensure_data_dir(dir) || !ensure_data_dir(path) || chdir(dir) != 0) {
+        fprintf(stderr, "Cannot use %s\n", path);
+        return 1;
+    }
+
+    printf("Benchmark suite: %ld waiting, %ld served (revision %s)\n", rows, served_rows, BENCH_REVISION);
+    cfg.rows = served_rows;
+    double t0 = now_sec();
+    if (datagen_write_served(HISTORY_FILE, &cfg) < 0) { perror(HISTORY_FILE); return 1; }
+    record("gen.served_csv", served_rows, served_rows, now_sec() - t0);
+    cfg.rows = rows;
+    cfg.first_id = (int)served_rows + 1;
+    t0 = now_sec();
+    if (datagen_write_queue("data/queue.csv", &cfg) < 0) { perror("data/queue.csv"); return 1; }
+    record("gen.queue_csv", rows, rows, now_sec() - t0);
+
+    bench_queue(rows);
+    bench_history(served_rows);
+    bench_name_index(rows, served_rows);
+    bench_query(rows, served_rows);
+    unsigned long iterations = bench_auth();
+
+    if (!write_json(json_path, rows, served_rows, (unsigned long long)cfg.seed, iterations)) {
+        fprintf(stderr, "Cannot write %s\n", json_path);
+        return 1;
+    }
+    if (strcmp(json_path, "-") != 0) printf("Results written to %s\n", json_path);
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include "datagen.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/time_util.h"
+
+/* Relative arrival rate per local hour: quiet nights, a morning peak after
+   OPD opens and a smaller evening one */
+static const double hour_weight[24] = {
+    0.25, 0.20, 0.15, 0.15, 0.20, 0.30, 0.55, 0.90, 1.50, 2.10, 2.30, 2.10,
+    1.70, 1.40, 1.30, 1.30, 1.40, 1.60, 1.70, 1.50, 1.10, 0.80, 0.55, 0.35
+};
+
+static const char *first_names[] = {
+    "Aarav", "Vivaan", "Aditya", "Venkata", "Sai", "Arjun", "Rohith", "Lakshmi",
+    "Priya", "Ananya", "Kavya", "Meenakshi", "Sri", "Mohammed", "Fatima", "Rahul",
+    "Sneha", "Harini", "Gurpreet", "Siddharth", "Nithya", "Ramesh", "Suresh", "Divya",
+    "Akash", "Sameer", "Nitiin", "Mani", "Jaya", "Krishna", "Abdul", "Mary"
+};
+static const char *middle_names[] = {
+    "Satya", "Narayana", "Kumar", "Rani", "Devi", "Prasad", "Mohan", "Bala",
+    "Rama", "Chandra", "Surya", "Raj", "Lal", "Bai", "Sai", "Ali"
+};
+static const char *surnames[] = {
+    "Subramanian", "Venkataraman", "Raghunathan", "Chakraborty", "Bhattacharya", "Krishnamurthy",
+    "Reddy", "Sharma", "Iyer", "Nair", "Patel", "Singh", "Gupta", "Rao", "Khan", "Das",
+    "Mukherjee", "Ramaswamy", "Padmanabhan", "Naidu", "Pillai", "Menon", "Joshi", "D'Souza"
+};
+static const char *problems[] = {
+    "fever", "chest pain", "shortness of breath", "abdominal pain", "headache", "road traffic accident",
+    "fracture left forearm", "high blood pressure", "diabetes follow-up", "vomiting and diarrhoea",
+    "dog bite", "burns", "antenatal check-up", "vaccination", "back pain", "dizziness",
+    "cough and cold", "skin rash", "eye irritation", "ear pain", "seizure", "snake bite",
+    "fever, body ache", "chest pain, sweating", "cough, fever, loss of taste"
+};
+static const char *departments[] = { "general", "general", "general", "general", "general",
+                                     "general", "general", "opd", "opd", "emergency" };
+
+#define COUNT(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+typedef struct Rng { uint64_t s; } Rng;
+
+static uint64_t rng_next(Rng *r) {
+    uint64_t z = (r->s += 0x9E3779B97F4A7C15ULL);     /* splitmix64 */
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* uniform in (0, 1] */
+static double rng_unit(Rng *r) {
+    return ((double)(rng_next(r) >> 11) + 1.0) / 9007199254740992.0;
+}
+
+static int rng_below(Rng *r, int n) {
+    return (int)(rng_next(r) % (uint64_t)n);
+}
+
+static double rng_exp(Rng *r, double mean) {
+    return -log(rng_unit(r)) * mean;
+}
+
+/* Poisson arrivals with the daily profile, by thinning a homogeneous
+   process at the peak rate */
+typedef struct Arrivals {
+    double t;                 /* seconds, wall clock */
+    double peak_per_sec;
+    double scale;             /* weight -> fraction of the peak */
+    long tz_offset;           /* local - UTC, seconds */
+} Arrivals;
+
+static void arrivals_init(Arrivals *a, double rate_per_hour, long rows, time_t end) {
+    double mean_w = 0.0, max_w = 0.0;
+    for (int h = 0; h < 24; ++h) {
+        mean_w += hour_weight[h] / 24.0;
+        if (hour_weight[h] > max_w) max_w = hour_weight[h];
+    }
+    a->peak_per_sec = rate_per_hour * max_w / mean_w / 3600.0;
+    a->scale = 1.0 / max_w;
+    struct tm lt;
+    time_t now = end;
+    localtime_r(&now, &lt);
+    a->tz_offset = lt.tm_gmtoff;
+    a->t = (double)end - (double)rows / rate_per_hour * 3600.0;
+}
+
+static time_t arrivals_next(Arrivals *a, Rng *r) {
+    for (;;) {
+        a->t += rng_exp(r, 1.0 / a->peak_per_sec);
+        long local = (long)a->t + a->tz_offset;
+        int hour = (int)(((local % 86400) + 86400) % 86400 / 3600);
+        if (rng_unit(r) <= hour_weight[hour] * a->scale) return (time_t)a->t;
+    }
+}
+
+static void make_name(Rng *r, char *buf, size_t len) {
+    int shape = rng_below(r, 10);
+    const char *f = first_names[rng_below(r, COUNT(first_names))];
+    const char *s = surnames[rng_below(r, COUNT(surnames))];
+    if (shape < 4) {
+        snprintf(buf, len, "%s %s", f, s);
+    } else if (shape < 7) {
+        snprintf(buf, len, "%s %s %s", f, middle_names[rng_below(r, COUNT(middle_names))], s);
+    } else {
+        /* long South Indian style names: given names plus a two-part surname */
+        snprintf(buf, len, "%s %s %s %s %s", f, middle_names[rng_below(r, COUNT(middle_names))],
+                 middle_names[rng_below(r, COUNT(middle_names))], s, surnames[rng_below(r, COUNT(surnames))]);
+    }
+}
+
+static int make_age(Rng *r) {
+    int band = rng_below(r, 100);
+    if (band < 8) return rng_below(r, 5);
+    if (band < 23) return 5 + rng_below(r, 13);
+    if (band < 78) return 18 + rng_below(r, 47);
+    return 65 + rng_below(r, 31);
+}
+
+static int make_severity(Rng *r) {
+    int x = rng_below(r, 100);
+    return x < 8 ? 2 : (x < 35 ? 1 : 0);
+}
+
+static long long make_phone(Rng *r) {
+    return (6 + rng_below(r, 4)) * 1000000000LL + (long long)(rng_next(r) % 1000000000ULL);
+}
+
+void datagen_defaults(DataGenConfig *cfg, long rows) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->rows = rows;
+    cfg->seed = 20240601;
+    cfg->rate_per_hour = 40.0;
+    cfg->end = time(NULL);
+    cfg->first_id = 1;
+}
+
+long datagen_write_queue(const char *path, const DataGenConfig *cfg) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    static char iobuf[1 << 16];
+    setvbuf(f, iobuf, _IOFBF, sizeof(iobuf));
+    Rng r = { cfg->seed ^ 0x51ULL };
+    /* a waiting room is at most half a day deep: big queues mean a surge */
+    double rate = cfg->rate_per_hour;
+    if (rate < (double)cfg->rows / 12.0) rate = (double)cfg->rows / 12.0;
+    Arrivals a;
+    arrivals_init(&a, rate, cfg->rows, cfg->end);
+
+    fputs("id,phone,name,age,severity,arrival,problem,flags\n", f);
+    char name[128], arrival[TIME_LEN];
+    for (long i = 0; i < cfg->rows; ++i) {
+        make_name(&r, name, sizeof(name));
+        int age = make_age(&r);
+        format_iso_time(arrivals_next(&a, &r), arrival, sizeof(arrival));
+        unsigned flags = (age >= 18 && age < 45 && rng_below(&r, 100) < 4) ? 1u : 0u;
+        fprintf(f, "%ld,%lld,%s,%d,%d,%s,%s,%u\n", cfg->first_id + i, make_phone(&r), name, age,
+                make_severity(&r), arrival, problems[rng_below(&r, COUNT(problems))], flags);
+    }
+    return fclose(f) == 0 ? cfg->rows : -1;
+}
+
+long datagen_write_served(const char *path, const DataGenConfig *cfg) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    static char iobuf[1 << 16];
+    setvbuf(f, iobuf, _IOFBF, sizeof(iobuf));
+    Rng r = { cfg->seed ^ 0x5EULL };
+    Arrivals a;
+    arrivals_init(&a, cfg->rate_per_hour, cfg->rows, cfg->end);
+    static const double wait_mean_min[3] = { 70.0, 25.0, 6.0 };   /* by severity */
+
+    fputs("id,phone,name,age,severity,arrival,served_at,wait_sec,problem,service_end,counter,department\n", f);
+    char name[128], arrival[TIME_LEN], served_at[TIME_LEN], service_end[TIME_LEN];
+    for (long i = 0; i < cfg->rows; ++i) {
+        make_name(&r, name, sizeof(name));
+        int age = make_age(&r), sev = make_severity(&r);
+        time_t t_arr = arrivals_next(&a, &r);
+        long wait = (long)(rng_exp(&r, wait_mean_min[sev]) * 60.0);
+        long svc = (long)((5.0 + rng_exp(&r, 10.0)) * 60.0);
+        format_iso_time(t_arr, arrival, sizeof(arrival));
+        format_iso_time(t_arr + wait, served_at, sizeof(served_at));
+        format_iso_time(t_arr + wait + svc, service_end, sizeof(service_end));
+        fprintf(f, "%ld,%lld,%s,%d,%d,%s,%s,%ld,%s,%s,%d,%s\n", cfg->first_id + i, make_phone(&r), name, age,
+                sev, arrival, served_at, wait, problems[rng_below(&r, COUNT(problems))], service_end,
+                1 + rng_below(&r, 3), departments[rng_below(&r, COUNT(departments))]);
+    }
+    return fclose(f) == 0 ? cfg->rows : -1;
+}
@@ -0,0 +1,31 @@
+#ifndef BENCH_DATAGEN_H
+#define BENCH_DATAGEN_H
+
+#include <stdint.h>
+#include <time.h>
+
+/* Synthetic queue.csv / served.csv in the formats the app writes.
+
+   Arrivals are a Poisson process whose rate follows a daily profile
+   (morning and evening peaks, quiet nights), ending at `end`. The severity
+   mix is 8% critical, 27% serious and 65% normal; ages skew to children and
+   the elderly as in an outpatient department; names run from one to five
+   parts (up to about 70 characters) and problems sometimes contain commas.
+   Waits and service times in served.csv depend on severity. The same seed
+   always produces the same files. */
+
+typedef struct DataGenConfig {
+    long rows;
+    uint64_t seed;
+    double rate_per_hour;     /* mean arrival rate over a day */
+    time_t end;               /* last arrival at about this time */
+    int first_id;
+} DataGenConfig;
+
+void datagen_defaults(DataGenConfig *cfg, long rows);
+
+/* Both return the number of rows written, -1 if the file cannot be created */
+long datagen_write_queue(const char *path, const DataGenConfig *cfg);
+long datagen_write_served(const char *path, const DataGenConfig *cfg);
+
+#endif /* BENCH_DATAGEN_H */
@@ -0,0 +1,57 @@
+/* Synthetic data for benchmarks and load tests.
+   Usage: gen_data [--rows N] [--served-rows N] [--dir DIR] [--seed S] [--rate PER_HOUR]
+   Writes DIR/data/queue.csv (N waiting patients, default 100000) and
+   DIR/data/served.csv (default as many rows as the queue) in the formats
+   the app reads, so `cd DIR && ../hospital_queue` runs against them.
+   DIR defaults to bench_data. See datagen.h for the distributions.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "datagen.h"
+#include "util/file_util.h"
+
+int main(int argc, char **argv) {
+    long rows = 100000, served_rows = -1;
+    const char *dir = "bench_data";
+    DataGenConfig cfg;
+    datagen_defaults(&cfg, rows);
+    for (int i = 1; i < argc; ++i) {
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--rows") == 0 && v) { rows = atol(v); ++i; }
+        else if (strcmp(argv[i], "--served-rows") == 0 && v) { served_rows = atol(v); ++i; }
+        else if (strcmp(argv[i], "--dir") == 0 && v) { dir = v; ++i; }
+        else if (strcmp(argv[i], "--seed") == 0 && v) { cfg.seed = strtoull(v, NULL, 10); ++i; }
+        else if (strcmp(argv[i], "--rate") == 0 && v) { cfg.rate_per_hour = atof(v); ++i; }
+        else {
+            fprintf(stderr, "Usage: %s [--rows N] [--served-rows N] [--dir DIR] [--seed S] [--rate PER_HOUR]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (rows < 0 || cfg.rate_per_hour <= 0.0) {
+        fprintf(stderr, "rows must be >= 0 and rate > 0\n");
+        return 2;
+    }
+    if (served_rows < 0) served_rows = rows;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/data", dir);
+    if (!ensure_data_dir(dir) || !ensure_data_dir(path)) {
+        fprintf(stderr, "Cannot create %s\n", path);
+        return 1;
+    }
+
+    /* history first, so the waiting patients get the higher IDs */
+    cfg.rows = served_rows;
+    snprintf(path, sizeof(path), "%s/data/served.csv", dir);
+    if (datagen_write_served(path, &cfg) < 0) { perror(path); return 1; }
+    printf("%s: %ld served\n", path, served_rows);
+
+    cfg.rows = rows;
+    cfg.first_id = (int)served_rows + 1;
+    snprintf(path, sizeof(path), "%s/data/queue.csv", dir);
+    if (datagen_write_queue(path, &cfg) < 0) { perror(path); return 1; }
+    printf("%s: %ld waiting\n", path, rows);
+    return 0;
+}
@@ -0,0 +1,76 @@
+/* Sample waiting-room display: reads the shared-memory feed published by
+   hospital_queue (HOSP_DISPLAY=1) and redraws the board once a second.
+   Usage: display_board [department] [--once]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "net/display_feed.h"
+
+static const char *sev_label(int sev) {
+    return sev == 2 ? "CRITICAL" : (sev == 1 ? "SERIOUS" : "NORMAL");
+}
+
+static void draw(const DisplayPayload *d, int clear) {
+    if (clear) printf("\033[H\033[2J");
+    char when[32];
+    time_t t = (time_t)d->published_at;
+    strftime(when, sizeof(when), "%H:%M:%S", localtime(&t));
+
+    printf("=== %s waiting room === updated %s\n", d->department[0] ? d->department : "Hospital", when);
+    printf("Waiting: %d   Counters busy: %d/%d\n\n", d->waiting, d->counters_busy, d->counters_total);
+    printf("  #  | Token | Name          | Priority | Est. wait\n");
+    printf("-----+-------+---------------+----------+----------\n");
+    for (int i = 0; i < d->rows; ++i) {
+        const DisplayRow *r = &d->row[i];
+        char eta[16] = "-";
+        if (r->eta_sec >= 0) snprintf(eta, sizeof(eta), "%d min", (r->eta_sec + 59) / 60);
+        printf(" %3d | %5d | %-13s | %-8s | %s\n", r->position, r->id, r->name, sev_label(r->severity), eta);
+    }
+    if (d->waiting > d->rows) printf("  ... and %d more\n", d->waiting - d->rows);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    const char *dept = NULL;
+    int once = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--once") == 0) once = 1;
+        else dept = argv[i];
+    }
+
+    char shm_name[64];
+    display_feed_name(dept, dept == NULL, shm_name, sizeof(shm_name));
+
+    const DisplayFeed *feed = NULL;
+    for (;;) {
+        if (!feed) feed = display_attach(shm_name);
+        DisplayPayload d;
+        if (feed && display_read(feed, &d)) {
+            draw(&d, !once);
+            if (once) break;
+            /* quiet feed: the owner may have restarted on a new segment */
+            if (time(NULL) - (time_t)d.published_at > 5) {
+                display_detach(feed);
+                feed = NULL;
+            }
+        } else if (once) {
+            fprintf(stderr, "No display feed at %s (start hospital_queue with HOSP_DISPLAY=1)\n", shm_name);
+            return 1;
+        } else {
+            /* not a feed, or stuck mid-update: attach afresh next time */
+            if (feed) {
+                display_detach(feed);
+                feed = NULL;
+            }
+            printf("\rWaiting for %s ...", shm_name);
+            fflush(stdout);
+        }
+        sleep(1);
+    }
+    display_detach(feed);
+    return 0;
+}
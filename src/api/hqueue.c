@@ -0,0 +1,362 @@
+#include "hqueue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../model/queue.h"
+#include "../model/history.h"
+#include "../util/file_util.h"
+#include "../util/phone_util.h"
+#include "../util/time_util.h"
+
+struct HqQueue {
+    pthread_mutex_t lock;
+    PriorityQueue q;
+    int next_id;
+    int registered;
+    int served;
+    char queue_path[512];
+    char served_path[512];
+};
+
+static void copy_str(char *dst, size_t len, const char *src) {
+    snprintf(dst, len, "%s", src ? src : "");
+}
+
+/* Separators would corrupt the CSV files, as on the desk protocol */
+static void sanitize(char *s) {
+    for (; *s; ++s) {
+        if (*s == '|' || *s == ',' || *s == '\n' || *s == '\r') *s = ' ';
+    }
+}
+
+static void copy_patient(HqQueue *h, const Patient *p, HqPatient *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    out->id = p->id;
+    out->phone = p->phone_number;
+    copy_str(out->name, sizeof(out->name), p->name);
+    out->age = p->age;
+    out->severity = (int)p->severity;
+    copy_str(out->arrival, sizeof(out->arrival), p->arrival);
+    copy_str(out->problem, sizeof(out->problem), p->problem);
+    out->flags = p->flags;
+    out->position = h ? pq_position(&h->q, p) : 0;
+}
+
+HqQueue* hq_open(const char *dir, HqStatus *status) {
+    HqStatus st = HQ_OK;
+    if (!dir || !dir[0]) dir = "data";
+    HqQueue *h = calloc(1, sizeof(HqQueue));
+    if (!h) st = HQ_NO_MEMORY;
+    else if (!ensure_data_dir(dir)) st = HQ_IO;
+    if (st != HQ_OK) {
+        free(h);
+        if (status) *status = st;
+        return NULL;
+    }
+    snprintf(h->queue_path, sizeof(h->queue_path), "%s/queue.csv", dir);
+    snprintf(h->served_path, sizeof(h->served_path), "%s/served.csv", dir);
+    pthread_mutex_init(&h->lock, NULL);
+
+    pq_init(&h->q);
+    PqPolicy policy;
+    pq_policy_from_env(&policy);
+    pq_set_policy(&h->q, &policy);
+    pq_spill_from_env(&h->q);
+    h->next_id = history_next_id(h->queue_path, h->served_path);
+    pq_load_csv(&h->q, h->queue_path, &h->next_id);
+    if (status) *status = HQ_OK;
+    return h;
+}
+
+HqStatus hq_save(HqQueue *h) {
+    if (!h) return HQ_INVALID;
+    pthread_mutex_lock(&h->lock);
+    int ok = pq_save_csv(&h->q, h->queue_path);
+    pthread_mutex_unlock(&h->lock);
+    return ok ? HQ_OK : HQ_IO;
+}
+
+HqStatus hq_close(HqQueue *h) {
+    if (!h) return HQ_OK;
+    HqStatus st = hq_save(h);
+    pq_free_all(&h->q);
+    pthread_mutex_destroy(&h->lock);
+    free(h);
+    return st;
+}
+
+HqStatus hq_register(HqQueue *h, const char *name, int age, int severity, const char *phone,
+                     const char *problem, unsigned flags, HqPatient *out) {
+    if (!h || !name || age < 0 || age > 150 || severity < NORMAL || severity > CRITICAL) return HQ_INVALID;
+    long long number = 0;
+    if (phone && phone[0] && !parse_indian_phone(phone, &number)) return HQ_INVALID;
+
+    char clean_name[NAME_LEN], clean_problem[PROB_LEN];
+    copy_str(clean_name, sizeof(clean_name), name);
+    copy_str(clean_problem, sizeof(clean_problem), problem);
+    sanitize(clean_name);
+    sanitize(clean_problem);
+    if (clean_name[strspn(clean_name, " ")] == '\0') return HQ_INVALID;
+
+    char now[TIME_LEN];
+    get_now_iso(now, sizeof(now));
+    pthread_mutex_lock(&h->lock);
+    Patient *p = create_patient(h->next_id, number, clean_name, age, clean_problem, (Severity)severity, now);
+    if (!p) {
+        pthread_mutex_unlock(&h->lock);
+        return HQ_NO_MEMORY;
+    }
+    p->flags = flags;
+    h->next_id++;
+    pq_enqueue(&h->q, p);
+    h->registered++;
+    copy_patient(h, p, out);   /* may be spilled right away: copy under the lock */
+    pthread_mutex_unlock(&h->lock);
+    return HQ_OK;
+}
+
+HqStatus hq_serve_next(HqQueue *h, HqPatient *out, long *wait_sec) {
+    if (!h) return HQ_INVALID;
+    pthread_mutex_lock(&h->lock);
+    Patient *p = pq_dequeue(&h->q);
+    if (!p) {
+        pthread_mutex_unlock(&h->lock);
+        return HQ_EMPTY;
+    }
+    char served_iso[TIME_LEN];
+    get_now_iso(served_iso, sizeof(served_iso));
+    time_t t_serv = parse_iso_time(served_iso);
+    time_t t_arr = parse_iso_time(p->arrival);
+    long wait = (t_serv != (time_t)-1 && t_arr != (time_t)-1) ? (long)(t_serv - t_arr) : 0;
+    /* served on the spot: no counter, service ends when it starts */
+    int ok = history_append_served(h->served_path, p, served_iso, wait, served_iso, 0, "");
+    h->served++;
+    pthread_mutex_unlock(&h->lock);
+
+    copy_patient(NULL, p, out);
+    if (wait_sec) *wait_sec = wait;
+    free_patient(p);
+    return ok ? HQ_OK : HQ_IO;
+}
+
+/* Lookups copy patients out where they are, so they never read spilled
+   patients back into memory */
+typedef struct PatientCopy {
+    HqQueue *h;
+    HqPatient *out;
+    int n;
+} PatientCopy;
+
+static int head_copy(void *ctx, const Patient *p) {
+    PatientCopy *c = ctx;
+    copy_patient(NULL, p, c->out);
+    if (c->out) c->out->position = 1;
+    c->n++;
+    return 0;
+}
+
+static void id_copy(void *ctx, const Patient *p) {
+    PatientCopy *c = ctx;
+    copy_patient(c->h, p, c->out);
+    c->n++;
+}
+
+HqStatus hq_peek(HqQueue *h, HqPatient *out) {
+    if (!h) return HQ_INVALID;
+    PatientCopy c = { h, out, 0 };
+    pthread_mutex_lock(&h->lock);
+    pq_service_walk(&h->q, 1, head_copy, &c);
+    pthread_mutex_unlock(&h->lock);
+    return c.n ? HQ_OK : HQ_EMPTY;
+}
+
+HqStatus hq_find_by_id(HqQueue *h, int id, HqPatient *out) {
+    if (!h) return HQ_INVALID;
+    PatientCopy c = { h, out, 0 };
+    pthread_mutex_lock(&h->lock);
+    pq_view_by_id(&h->q, id, id_copy, &c);
+    pthread_mutex_unlock(&h->lock);
+    return c.n ? HQ_OK : HQ_NOT_FOUND;
+}
+
+HqStatus hq_find_by_name(HqQueue *h, const char *text, HqPatient *out) {
+    HqPatient first;
+    int n = hq_find_all_by_name(h, text, &first, 1);
+    if (n < 0) return (HqStatus)n;
+    if (n == 0) return HQ_NOT_FOUND;
+    if (out) *out = first;
+    return HQ_OK;
+}
+
+typedef struct NameCopy {
+    HqQueue *h;
+    HqPatient *out;
+    int max, n;
+} NameCopy;
+
+static void name_copy(void *ctx, const Patient *p) {
+    NameCopy *c = ctx;
+    if (c->n < c->max) copy_patient(c->h, p, &c->out[c->n++]);
+}
+
+int hq_find_all_by_name(HqQueue *h, const char *text, HqPatient *out, int max) {
+    if (!h || !text || (!out && max > 0) || max < 0) return HQ_INVALID;
+    NameCopy c = { h, out, max, 0 };
+    pthread_mutex_lock(&h->lock);
+    int total = pq_name_walk(&h->q, text, name_copy, &c);
+    pthread_mutex_unlock(&h->lock);
+    return total < 0 ? HQ_NO_MEMORY : total;
+}
+
+HqStatus hq_retriage(HqQueue *h, int id, int severity, HqPatient *out) {
+    if (!h || severity < NORMAL || severity > CRITICAL) return HQ_INVALID;
+    pthread_mutex_lock(&h->lock);
+    HqStatus st = HQ_NOT_FOUND;
+    Patient *p = pq_search_by_id(&h->q, id);
+    if (p && pq_update_severity(&h->q, p, (Severity)severity)) {
+        copy_patient(h, p, out);
+        st = HQ_OK;
+    }
+    pthread_mutex_unlock(&h->lock);
+    return st;
+}
+
+HqStatus hq_remove(HqQueue *h, int id, HqPatient *out) {
+    if (!h) return HQ_INVALID;
+    pthread_mutex_lock(&h->lock);
+    Patient *p = pq_search_by_id(&h->q, id);
+    int removed = p && pq_remove(&h->q, p);
+    pthread_mutex_unlock(&h->lock);
+    if (!removed) return HQ_NOT_FOUND;
+    copy_patient(NULL, p, out);
+    free_patient(p);
+    return HQ_OK;
+}
+
+static int list_copy(void *ctx, const Patient *p) {
+    PatientCopy *c = ctx;
+    copy_patient(NULL, p, &c->out[c->n]);
+    c->out[c->n].position = c->n + 1;
+    c->n++;
+    return 1;
+}
+
+int hq_list(HqQueue *h, HqPatient *out, int max) {
+    if (!h || (!out && max > 0) || max < 0) return HQ_INVALID;
+    if (max == 0) return 0;
+    PatientCopy c = { NULL, out, 0 };
+    pthread_mutex_lock(&h->lock);
+    int n = pq_service_walk(&h->q, max, list_copy, &c);
+    pthread_mutex_unlock(&h->lock);
+    return n < 0 ? HQ_IO : n;
+}
+
+typedef struct OldestScan {
+    time_t now;
+    long *oldest;
+} OldestScan;
+
+/* Arrival order: the first patient seen of each severity waited longest */
+static void oldest_visit(void *ctx, const Patient *p) {
+    OldestScan *s = ctx;
+    if (p->severity < NORMAL || p->severity > CRITICAL || s->oldest[p->severity] >= 0) return;
+    time_t t = p->arrival_ts != (time_t)-1 ? p->arrival_ts : parse_iso_time(p->arrival);
+    if (t != (time_t)-1) s->oldest[p->severity] = (long)(s->now - t);
+}
+
+HqStatus hq_stats(HqQueue *h, HqStats *out) {
+    if (!h || !out) return HQ_INVALID;
+    memset(out, 0, sizeof(*out));
+    for (int s = 0; s < 3; ++s) out->oldest_wait_sec[s] = -1;
+    OldestScan scan = { time(NULL), out->oldest_wait_sec };
+    pthread_mutex_lock(&h->lock);
+    out->waiting = pq_size(&h->q);
+    pq_count_by_severity(&h->q, out->by_severity);
+    pq_arrival_walk(&h->q, oldest_visit, &scan);
+    out->registered = h->registered;
+    out->served = h->served;
+    pthread_mutex_unlock(&h->lock);
+    return HQ_OK;
+}
+
+/* served.csv is append-only; readers need no lock beyond the writer's
+   whole-line appends */
+HqStatus hq_history_each(HqQueue *h, HqServedFn fn, void *ctx) {
+    if (!h || !fn) return HQ_INVALID;
+    FILE *f = fopen(h->served_path, "r");
+    if (!f) return HQ_OK;     /* nobody served yet */
+    char line[1024];
+    if (!fgets(line, sizeof(line), f)) { fclose(f); return HQ_OK; }
+    ServedRecord r;
+    HqServed row;
+    while (fgets(line, sizeof(line), f)) {
+        if (!history_parse_line(line, &r)) continue;
+        memset(&row, 0, sizeof(row));
+        row.patient.id = r.id;
+        row.patient.phone = r.phone;
+        copy_str(row.patient.name, sizeof(row.patient.name), r.name);
+        row.patient.age = r.age;
+        row.patient.severity = r.severity;
+        copy_str(row.patient.arrival, sizeof(row.patient.arrival), r.arrival);
+        copy_str(row.patient.problem, sizeof(row.patient.problem), r.problem);
+        copy_str(row.served_at, sizeof(row.served_at), r.served_at);
+        row.wait_sec = r.wait_sec;
+        copy_str(row.service_end, sizeof(row.service_end), r.service_end);
+        row.counter_id = r.counter_id;
+        copy_str(row.department, sizeof(row.department), r.department);
+        if (!fn(ctx, &row)) break;
+    }
+    int failed = ferror(f);
+    fclose(f);
+    return failed ? HQ_IO : HQ_OK;
+}
+
+static int history_stats_visit(void *ctx, const HqServed *row) {
+    HqHistoryStats *st = ctx;
+    int sev = row->patient.severity;
+    if (sev >= HQ_NORMAL && sev <= HQ_CRITICAL) {
+        st->by_severity[sev]++;
+        st->avg_wait_sec[sev] += (double)row->wait_sec;   /* sum until the scan ends */
+    }
+    if (row->wait_sec > st->max_wait_sec) st->max_wait_sec = row->wait_sec;
+    if (st->served == 0 || strcmp(row->served_at, st->first_served) < 0)
+        copy_str(st->first_served, sizeof(st->first_served), row->served_at);
+    if (strcmp(row->served_at, st->last_served) > 0)
+        copy_str(st->last_served, sizeof(st->last_served), row->served_at);
+    st->served++;
+    return 1;
+}
+
+HqStatus hq_history_stats(HqQueue *h, HqHistoryStats *out) {
+    if (!h || !out) return HQ_INVALID;
+    memset(out, 0, sizeof(*out));
+    HqStatus st = hq_history_each(h, history_stats_visit, out);
+    for (int s = 0; s < 3; ++s) {
+        if (out->by_severity[s] > 0) out->avg_wait_sec[s] /= (double)out->by_severity[s];
+    }
+    return st;
+}
+
+const char* hq_status_str(HqStatus status) {
+    switch (status) {
+        case HQ_OK:        return "ok";
+        case HQ_EMPTY:     return "queue is empty";
+        case HQ_NOT_FOUND: return "patient not found";
+        case HQ_INVALID:   return "invalid argument";
+        case HQ_IO:        return "data file error";
+        case HQ_NO_MEMORY: return "out of memory";
+        default:           return "unknown status";
+    }
+}
+
+const char* hq_severity_name(int severity) {
+    switch (severity) {
+        case HQ_CRITICAL: return "CRITICAL";
+        case HQ_SERIOUS:  return "SERIOUS";
+        case HQ_NORMAL:   return "NORMAL";
+        default:          return "UNKNOWN";
+    }
+}
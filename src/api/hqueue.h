@@ -0,0 +1,132 @@
+#ifndef HQUEUE_H
+#define HQUEUE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Embeddable hospital queue: libhqueue.a / libhqueue.so (make lib).
+
+   One HqQueue handle owns a waiting queue persisted in DIR/queue.csv and
+   appends served patients to DIR/served.csv, in the same formats as the
+   console and the desk server, with no terminal I/O. Every call takes the
+   handle's lock, so a handle may be shared between threads; two handles
+   (or a handle and a running desk) must not use the same directory.
+
+   The scheduling environment (HOSP_SCHED, HOSP_PRIORITY, HOSP_SLA_MIN,
+   HOSP_QUEUE_MEM_CAP, ...) is read by hq_open as in the application.
+
+   Calls return HQ_OK or a negative HqStatus. Patients are copied out into
+   caller-owned HqPatient structs, so nothing the library returns needs to
+   be freed except the handle itself.
+
+   Only the declarations in this header are part of the ABI; the shared
+   library exports nothing else. HQ_API_VERSION changes when they do. */
+
+#define HQ_API_VERSION 1
+
+#define HQ_NAME_LEN 128
+#define HQ_PROBLEM_LEN 256
+#define HQ_TIME_LEN 32         /* "YYYY-MM-DD HH:MM:SS" */
+#define HQ_DEPT_LEN 32
+
+typedef enum {
+    HQ_OK = 0,
+    HQ_EMPTY = -1,             /* nobody is waiting */
+    HQ_NOT_FOUND = -2,
+    HQ_INVALID = -3,           /* bad argument (age, severity, phone, empty name) */
+    HQ_IO = -4,                /* a data file could not be read or written */
+    HQ_NO_MEMORY = -5
+} HqStatus;
+
+/* Same values as the CSV severity column */
+enum { HQ_NORMAL = 0, HQ_SERIOUS = 1, HQ_CRITICAL = 2 };
+
+/* HqPatient.flags */
+#define HQ_PREGNANT 0x1u
+
+typedef struct HqPatient {
+    int id;
+    long long phone;           /* 10-digit number, 0 if none */
+    char name[HQ_NAME_LEN];
+    int age;
+    int severity;
+    char arrival[HQ_TIME_LEN];
+    char problem[HQ_PROBLEM_LEN];
+    unsigned flags;
+    int position;              /* 1-based place in service order, 0 if not waiting */
+} HqPatient;
+
+typedef struct HqStats {
+    int waiting;
+    int by_severity[3];        /* indexed by HQ_NORMAL..HQ_CRITICAL */
+    long oldest_wait_sec[3];   /* -1 when nobody of that severity waits */
+    int registered;            /* through this handle */
+    int served;
+} HqStats;
+
+/* One served.csv row */
+typedef struct HqServed {
+    HqPatient patient;         /* position is 0 */
+    char served_at[HQ_TIME_LEN];
+    long wait_sec;
+    char service_end[HQ_TIME_LEN];
+    int counter_id;            /* 0 = served on the spot */
+    char department[HQ_DEPT_LEN];
+} HqServed;
+
+typedef struct HqHistoryStats {
+    long served;
+    long by_severity[3];
+    double avg_wait_sec[3];    /* 0 when nobody of that severity was served */
+    long max_wait_sec;
+    char first_served[HQ_TIME_LEN];
+    char last_served[HQ_TIME_LEN];
+} HqHistoryStats;
+
+typedef struct HqQueue HqQueue;
+
+/* Opens (creating if needed) the data directory and loads DIR/queue.csv.
+   dir NULL means "data". Returns NULL and sets *status on failure. */
+HqQueue* hq_open(const char *dir, HqStatus *status);
+/* Saves the queue and releases the handle; NULL is ignored */
+HqStatus hq_close(HqQueue *h);
+/* Write DIR/queue.csv now */
+HqStatus hq_save(HqQueue *h);
+
+/* Queue operations. phone may be NULL or "" and accepts the formats
+   the desk does (+91..., 0..., 10 digits). out may be NULL. */
+HqStatus hq_register(HqQueue *h, const char *name, int age, int severity, const char *phone,
+                     const char *problem, unsigned flags, HqPatient *out);
+/* Dequeue the next patient and record them in served.csv */
+HqStatus hq_serve_next(HqQueue *h, HqPatient *out, long *wait_sec);
+HqStatus hq_peek(HqQueue *h, HqPatient *out);
+HqStatus hq_find_by_id(HqQueue *h, int id, HqPatient *out);
+/* First waiting patient whose name contains text, in any case */
+HqStatus hq_find_by_name(HqQueue *h, const char *text, HqPatient *out);
+/* Every waiting patient whose name contains text, in any case: fills up to
+   max in arrival order and returns how many match, or a negative HqStatus */
+int hq_find_all_by_name(HqQueue *h, const char *text, HqPatient *out, int max);
+HqStatus hq_retriage(HqQueue *h, int id, int severity, HqPatient *out);
+/* Take a waiting patient off the queue without serving them */
+HqStatus hq_remove(HqQueue *h, int id, HqPatient *out);
+/* Up to max waiting patients in service order, spilled ones included;
+   returns how many, or a negative HqStatus */
+int hq_list(HqQueue *h, HqPatient *out, int max);
+HqStatus hq_stats(HqQueue *h, HqStats *out);
+
+/* History queries over served.csv. The callback returns 0 to stop early. */
+typedef int (*HqServedFn)(void *ctx, const HqServed *row);
+HqStatus hq_history_each(HqQueue *h, HqServedFn fn, void *ctx);
+HqStatus hq_history_stats(HqQueue *h, HqHistoryStats *out);
+
+const char* hq_status_str(HqStatus status);
+const char* hq_severity_name(int severity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HQUEUE_H */
@@ -0,0 +1,334 @@
+#include "batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include "commands.h"
+#include "../model/history.h"
+#include "../net/protocol.h"
+#include "../util/file_util.h"
+#include "../util/metrics.h"
+#include "../util/time_util.h"
+#include "../util/trace.h"
+
+#define QUEUE_FILE "data/queue.csv"
+
+/* Latency per command type, in the same log2 buckets as util/metrics.h */
+static const char *verbs[] = { "REGISTER", "SERVE", "SEARCH", "REMOVE", "RETRIAGE", "STATS",
+                               "CALL", "DONE", "COUNTERS", "PEEK", "PING", "QUERY", "OTHER" };
+#define NVERBS ((int)(sizeof(verbs) / sizeof(verbs[0])))
+
+typedef struct VerbStats {
+    long count;
+    long errors;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    long bucket[METRICS_BUCKETS];
+} VerbStats;
+
+static int verb_index(const char *line) {
+    size_t len = strcspn(line, "|");
+    for (int i = 0; i < NVERBS - 1; ++i) {
+        if (strlen(verbs[i]) != len) continue;
+        size_t k = 0;
+        while (k < len && toupper((unsigned char)line[k]) == verbs[i][k]) ++k;
+        if (k == len) return i;
+    }
+    return NVERBS - 1;
+}
+
+static void verb_observe(VerbStats *v, uint64_t ns, int error) {
+    int b = 0;
+    while (b < METRICS_BUCKETS - 1 && metrics_bucket_le(b) < ns) ++b;
+    v->count++;
+    v->errors += error;
+    v->sum_ns += ns;
+    if (ns > v->max_ns) v->max_ns = ns;
+    v->bucket[b]++;
+}
+
+static uint64_t verb_percentile(const VerbStats *v, double pct) {
+    long rank = (long)((double)v->count * pct + 0.999999), seen = 0;
+    for (int b = 0; b < METRICS_BUCKETS; ++b) {
+        seen += v->bucket[b];
+        if (seen >= rank) return metrics_bucket_le(b) < v->max_ns ? metrics_bucket_le(b) : v->max_ns;
+    }
+    return v->max_ns;
+}
+
+/* Logged patient ID -> ID assigned on replay (open addressing, grows at 1/2) */
+typedef struct IdMap {
+    int *keys;
+    int *vals;
+    size_t cap;
+    size_t used;
+} IdMap;
+
+static size_t idmap_slot(const IdMap *m, int key) {
+    size_t i = ((uint32_t)key * 2654435761u) & (m->cap - 1);
+    while (m->keys[i] != 0 && m->keys[i] != key) i = (i + 1) & (m->cap - 1);
+    return i;
+}
+
+static int idmap_get(const IdMap *m, int key) {
+    if (m->cap == 0 || key == 0) return 0;
+    return m->vals[idmap_slot(m, key)];
+}
+
+static void idmap_put(IdMap *m, int key, int val) {
+    if (key == 0) return;
+    if ((m->used + 1) * 2 > m->cap) {
+        size_t cap = m->cap ? m->cap * 2 : 1024;
+        int *keys = calloc(cap, sizeof(int)), *vals = calloc(cap, sizeof(int));
+        if (!keys || !vals) { free(keys); free(vals); return; }
+        IdMap grown = { keys, vals, cap, 0 };
+        for (size_t i = 0; i < m->cap; ++i) {
+            if (m->keys[i] == 0) continue;
+            size_t j = idmap_slot(&grown, m->keys[i]);
+            grown.keys[j] = m->keys[i];
+            grown.vals[j] = m->vals[i];
+            grown.used++;
+        }
+        free(m->keys);
+        free(m->vals);
+        *m = grown;
+    }
+    size_t i = idmap_slot(m, key);
+    if (m->keys[i] == 0) m->used++;
+    m->keys[i] = key;
+    m->vals[i] = val;
+}
+
+/* Minimal readers for the flat objects cdc_format_json writes */
+static const char* json_field(const char *obj, const char *key) {
+    char pat[32];
+    snprintf(pat, sizeof(pat), "\"%s\":", key);
+    const char *at = strstr(obj, pat);
+    return at ? at + strlen(pat) : NULL;
+}
+
+static long long json_int(const char *obj, const char *key, long long dflt) {
+    const char *v = json_field(obj, key);
+    return v ? strtoll(v, NULL, 10) : dflt;
+}
+
+static int json_str(const char *obj, const char *key, char *buf, size_t buflen) {
+    const char *v = json_field(obj, key);
+    if (!v || *v != '"' || buflen == 0) return 0;
+    size_t n = 0;
+    for (++v; *v && *v != '"'; ++v) {
+        char c = *v;
+        if (c == '\\' && v[1]) {
+            ++v;
+            if (*v == 'u') {
+                /* exactly 4 hex digits; cdc_format_json only escapes control bytes */
+                char hex[5];
+                int k = 0;
+                while (k < 4 && isxdigit((unsigned char)v[1 + k])) { hex[k] = v[1 + k]; ++k; }
+                hex[k] = '\0';
+                c = (char)strtol(hex, NULL, 16);
+                v += k;
+            } else c = *v;
+        }
+        if (n + 1 < buflen) buf[n++] = c;
+    }
+    buf[n] = '\0';
+    return 1;
+}
+
+/* Turn one CDC event into a request line; 0 if it has no queue work */
+static int cdc_to_request(const char *event, const IdMap *ids, const char *department, char *out, size_t outlen) {
+    char type[16], name[CDC_NAME_LEN], dept[CDC_DEPT_LEN];
+    if (!json_str(event, "type", type, sizeof(type))) return 0;
+    if (department && (!json_str(event, "dept", dept, sizeof(dept)) || strncmp(dept, department, sizeof(dept) - 1) != 0)) return 0;
+    /* patients already waiting when the log started keep their IDs */
+    int logged = (int)json_int(event, "id", 0), id = idmap_get(ids, logged);
+    if (id == 0) id = logged;
+    long long sev = json_int(event, "sev", 0);
+    if (strcmp(type, "ENQUEUE") == 0) {
+        if (!json_str(event, "name", name, sizeof(name))) return 0;
+        long long phone = json_int(event, "phone", 0);
+        char phone_s[24] = "";
+        if (phone > 0) snprintf(phone_s, sizeof(phone_s), "%lld", phone);
+        snprintf(out, outlen, "REGISTER|%s|%lld|%lld|%s||%lld", name, json_int(event, "age", 0), sev,
+                 phone_s, json_int(event, "flags", 0));
+    } else if (strcmp(type, "DEQUEUE") == 0) {
+        snprintf(out, outlen, "SERVE|%d", id);
+    } else if (strcmp(type, "RETRIAGE") == 0) {
+        snprintf(out, outlen, "RETRIAGE|%d|%lld", id, sev);
+    } else if (strcmp(type, "REMOVE") == 0) {
+        snprintf(out, outlen, "REMOVE|%d", id);
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+/* Copy served.csv to a new temporary file and put its path in path */
+static int scratch_history(char *path, size_t pathlen) {
+    const char *tmp = getenv("TMPDIR");
+    snprintf(path, pathlen, "%s/hqueue-batch-XXXXXX", tmp && tmp[0] ? tmp : "/tmp");
+#if defined(_WIN32)
+    FILE *out = _mktemp(path) ? fopen(path, "wb") : NULL;
+#else
+    int fd = mkstemp(path);
+    FILE *out = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (fd >= 0 && !out) close(fd);
+#endif
+    if (!out) return 0;
+    int ok = 1;
+    FILE *in = fopen(HISTORY_FILE, "rb");
+    if (in) {
+        char buf[1 << 16];
+        size_t n;
+        while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0) ok = fwrite(buf, 1, n, out) == n;
+        if (ferror(in)) ok = 0;
+        fclose(in);
+    }
+    if (fclose(out) != 0) ok = 0;
+    if (!ok) remove(path);
+    return ok;
+}
+
+static void print_ns(FILE *f, uint64_t ns) {
+    if (ns < 10000) fprintf(f, " %7lluns", (unsigned long long)ns);
+    else if (ns < 10000000) fprintf(f, " %7.1fus", (double)ns / 1e3);
+    else fprintf(f, " %7.1fms", (double)ns / 1e6);
+}
+
+int batch_run(const char *path, const BatchOptions *opt) {
+    BatchOptions defaults = { 0, 1, NULL };
+    if (!opt) opt = &defaults;
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+    if (!ensure_data_dir("data")) {
+        fprintf(stderr, "Could not create or access data directory \"data\"\n");
+        if (in != stdin) fclose(in);
+        return 1;
+    }
+
+    /* without save, served rows go to a scratch copy of the history */
+    char scratch[512] = "";
+    const char *history = HISTORY_FILE;
+    if (!opt->save) {
+        if (!scratch_history(scratch, sizeof(scratch))) {
+            fprintf(stderr, "Could not copy %s for --no-save\n", HISTORY_FILE);
+            if (in != stdin) fclose(in);
+            return 1;
+        }
+        history = scratch;
+    }
+
+    TRACE_BEGIN(startup);
+    PriorityQueue q;
+    pq_init(&q);
+    PqPolicy policy;
+    pq_policy_from_env(&policy);
+    pq_set_policy(&q, &policy);
+    pq_spill_from_env(&q);
+    int next_id = history_next_id(QUEUE_FILE, HISTORY_FILE);
+    pq_load_csv(&q, QUEUE_FILE, &next_id);
+    Dispatcher disp;
+    dispatch_init(&disp, dispatch_counters_from_env(), history);
+    dispatch_load_history(&disp);
+    TRACE_END(startup, "startup");
+
+    QueryIndex qindex;
+    query_index_init(&qindex);
+
+    CommandContext ctx;
+    cmd_context_init(&ctx, &q, next_id);
+    ctx.disp = &disp;
+    ctx.qindex = &qindex;
+    ctx.history_path = history;
+    if (opt->department) ctx.department = opt->department;
+
+    static VerbStats stats[NVERBS];
+    IdMap ids = { NULL, NULL, 0, 0 };
+    StrBuf reply;
+    sb_init(&reply);
+    char line[PROTO_MAX_LINE], req[PROTO_MAX_LINE];
+    long lineno = 0, skipped = 0, too_long = 0;
+    int quit = 0;
+    uint64_t busy_ns = 0, wall0 = monotonic_ns();
+
+    while (!quit && fgets(line, sizeof(line), in)) {
+        ++lineno;
+        size_t len = strlen(line);
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+            int c;
+            while ((c = fgetc(in)) != EOF && c != '\n') { }
+            too_long++;
+            continue;
+        }
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+        if (len == 0 || line[0] == '#') continue;
+
+        int logged_id = 0, from_cdc = line[0] == '{';
+        if (from_cdc) {
+            if (!cdc_to_request(line, &ids, opt->department, req, sizeof(req))) { skipped++; continue; }
+            logged_id = (int)json_int(line, "id", 0);
+        } else {
+            snprintf(req, sizeof(req), "%s", line);
+        }
+
+        int v = verb_index(req);
+        int assigned = ctx.next_id;
+        sb_reset(&reply);
+        TRACE_BEGIN(span);
+        uint64_t t0 = monotonic_ns();
+        CommandStatus st = cmd_execute(&ctx, req, &reply);
+        uint64_t ns = monotonic_ns() - t0;
+        TRACE_END_ARG(span, "batch.request", req);   /* split in place: just the verb */
+        busy_ns += ns;
+        verb_observe(&stats[v], ns, st == CMD_ERROR);
+        if (st == CMD_QUIT) quit = 1;
+        if (from_cdc && v == 0 && ctx.next_id != assigned) idmap_put(&ids, logged_id, assigned);
+        if (opt->echo) {
+            printf("%.1f\t%.*s", (double)ns / 1e3, (int)reply.len, reply.data);
+        }
+    }
+    int read_error = ferror(in);
+    if (in != stdin) fclose(in);
+    uint64_t wall_ns = monotonic_ns() - wall0;
+    fflush(stdout);
+
+    long total = 0, errors = 0;
+    fprintf(stderr, "%-10s %9s %7s %9s %9s %9s %9s\n", "command", "count", "errors", "mean", "p50", "p99", "max");
+    for (int i = 0; i < NVERBS; ++i) {
+        const VerbStats *s = &stats[i];
+        if (s->count == 0) continue;
+        total += s->count;
+        errors += s->errors;
+        fprintf(stderr, "%-10s %9ld %7ld", verbs[i], s->count, s->errors);
+        print_ns(stderr, s->sum_ns / (uint64_t)s->count);
+        print_ns(stderr, verb_percentile(s, 0.50));
+        print_ns(stderr, verb_percentile(s, 0.99));
+        print_ns(stderr, s->max_ns);
+        fputc('\n', stderr);
+    }
+    fprintf(stderr, "%ld commands (%ld errors) from %ld lines in %.3f s: %.0f commands/s (%.0f/s inside cmd_execute)\n",
+            total, errors, lineno, (double)wall_ns / 1e9,
+            wall_ns ? (double)total / ((double)wall_ns / 1e9) : 0.0,
+            busy_ns ? (double)total / ((double)busy_ns / 1e9) : 0.0);
+    if (skipped) fprintf(stderr, "%ld CDC events without queue work skipped\n", skipped);
+    if (too_long) fprintf(stderr, "%ld lines longer than %d bytes skipped\n", too_long, PROTO_MAX_LINE - 2);
+
+    dispatch_complete_all(&disp, time(NULL));
+    if (opt->save && !pq_save_csv(&q, QUEUE_FILE)) fprintf(stderr, "Could not save %s\n", QUEUE_FILE);
+    pq_free_all(&q);
+    query_index_free(&qindex);
+    sb_free(&reply);
+    free(ids.keys);
+    free(ids.vals);
+    if (scratch[0]) remove(scratch);
+    return read_error ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+#ifndef CONTROLLER_BATCH_H
+#define CONTROLLER_BATCH_H
+
+/* Non-interactive batch mode for scripted load and replay.
+
+   Reads one command per line from a file ("-" = stdin) and runs it with
+   cmd_execute against data/queue.csv and data/served.csv, as the desk
+   server does, with no prompts or pauses. Two line formats are accepted:
+     - desk protocol requests (net/protocol.h): REGISTER|..., SERVE,
+       SEARCH|ID|7, REMOVE|7, STATS, ...; blank lines and # comments skipped
+     - CDC NDJSON events (HOSP_CDC, cdc_tail): ENQUEUE, DEQUEUE, RETRIAGE and
+       REMOVE become REGISTER, SERVE|id, RETRIAGE and REMOVE, with the logged
+       patient IDs mapped to the IDs assigned on replay. A dequeued patient
+       is served on the spot: SERVED (the end of a counter's service) and
+       GAP carry no queue work and are skipped. With a department, only
+       its events are replayed and served rows are recorded under it;
+       otherwise every department's events go to the one queue.
+   Without save, queue.csv is left as it was and served rows go to a
+   scratch copy of served.csv that is deleted at the end, so a replay never
+   writes to the live history.
+   Afterwards prints the latency of each command type (count, mean, p50,
+   p99, max) and the overall throughput to stderr. With echo, every reply
+   goes to stdout prefixed by its latency in microseconds. */
+
+typedef struct BatchOptions {
+    int echo;
+    int save;                 /* write queue.csv and served.csv, as a desk would */
+    const char *department;   /* replay only this department's CDC events */
+} BatchOptions;
+
+/* Returns a process exit code: 0 when the input was read to the end */
+int batch_run(const char *path, const BatchOptions *opt);
+
+#endif /* CONTROLLER_BATCH_H */
@@ -0,0 +1,302 @@
+#include "commands.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../net/protocol.h"
+#include "../net/replica.h"
+#include "../model/history.h"
+#include "../util/time_util.h"
+#include "../util/phone_util.h"
+
+void cmd_context_init(CommandContext *ctx, PriorityQueue *q, int next_id) {
+    if (!ctx) return;
+    ctx->q = q;
+    ctx->next_id = next_id;
+    ctx->registered = 0;
+    ctx->served = 0;
+    ctx->changed = 0;
+    ctx->history_path = HISTORY_FILE;
+    ctx->disp = NULL;
+    ctx->department = "";
+    ctx->alerts = NULL;
+    ctx->cdc = NULL;
+    ctx->repl = NULL;
+    ctx->qindex = NULL;
+}
+
+static CommandStatus reply_err(StrBuf *out, const char *why) {
+    sb_printf(out, "ERR|%s\n", why);
+    return CMD_ERROR;
+}
+
+static CommandStatus do_register(CommandContext *ctx, char **f, int n, StrBuf *out) {
+    if (n < 6) return reply_err(out, "usage REGISTER|name|age|severity|phone|problem");
+
+    char *end;
+    long age = strtol(f[2], &end, 10);
+    if (end == f[2] || age < 0 || age > 150) return reply_err(out, "bad age");
+    long sev = strtol(f[3], &end, 10);
+    if (end == f[3] || sev < NORMAL || sev > CRITICAL) return reply_err(out, "bad severity");
+
+    long long phone = 0;
+    if (f[4][0] != '\0' && !parse_indian_phone(f[4], &phone)) return reply_err(out, "bad phone");
+
+    unsigned long flags = 0;
+    if (n > 6) {
+        flags = strtoul(f[6], &end, 10);   /* PATIENT_* bits */
+        if (end == f[6] || *end != '\0' || (flags & ~(unsigned long)PATIENT_FLAG_MASK)) return reply_err(out, "bad flags");
+    }
+
+    proto_sanitize(f[1]);
+    proto_sanitize(f[5]);
+    if (f[1][0] == '\0') return reply_err(out, "empty name");
+    /* queue.csv rows are read back with these limits */
+    if (strlen(f[1]) >= NAME_LEN) return reply_err(out, "name too long");
+    if (strlen(f[5]) >= PROB_LEN) return reply_err(out, "problem too long");
+
+    char now[TIME_LEN];
+    get_now_iso(now, sizeof(now));
+    Patient *p = create_patient(ctx->next_id, phone, f[1], (int)age, f[5], (Severity)sev, now);
+    if (!p) return reply_err(out, "out of memory");
+    p->flags = (unsigned)flags;
+    ctx->next_id++;
+    pq_enqueue(ctx->q, p);
+    alerts_track(ctx->alerts, p);
+    ctx->registered++;
+
+    sb_puts(out, "OK|");
+    proto_put_patient(out, p);
+    sb_puts(out, "\n");
+    return CMD_OK;
+}
+
+/* SERVE|id serves that patient out of turn (batch replays DEQUEUE with it) */
+static CommandStatus do_serve(CommandContext *ctx, char **f, int n, StrBuf *out) {
+    Patient *p;
+    if (n > 1) {
+        p = pq_search_by_id(ctx->q, atoi(f[1]));
+        if (!p || !pq_dequeue_patient(ctx->q, p)) { sb_puts(out, "NOTFOUND\n"); return CMD_OK; }
+    } else {
+        p = pq_dequeue(ctx->q);
+        if (!p) { sb_puts(out, "EMPTY\n"); return CMD_OK; }
+    }
+    alerts_forget(ctx->alerts, p);
+
+    char served_iso[TIME_LEN];
+    get_now_iso(served_iso, sizeof(served_iso));
+    time_t t_serv = parse_iso_time(served_iso);
+    time_t t_arr = parse_iso_time(p->arrival);
+    long wait_sec = (t_serv != (time_t)-1 && t_arr != (time_t)-1) ? (long)(t_serv - t_arr) : 0;
+    /* served on the spot: no counter, service ends when it starts */
+    history_append_served(ctx->history_path, p, served_iso, wait_sec, served_iso, 0, ctx->department);
+    cdc_emit_served(ctx->cdc, p, 0, wait_sec, ctx->department);
+    ctx->served++;
+
+    sb_puts(out, "OK|");
+    proto_put_patient(out, p);
+    sb_printf(out, "|%s|%ld\n", served_iso, wait_sec);
+    free_patient(p);
+    return CMD_OK;
+}
+
+typedef struct NameHits {
+    StrBuf *rows;
+    int shown;
+} NameHits;
+
+static void put_name_hit(void *ctx, const Patient *p) {
+    NameHits *h = ctx;
+    if (h->shown >= PROTO_SEARCH_SHOWN) return;
+    sb_puts(h->rows, "|");
+    proto_put_patient(h->rows, p);
+    h->shown++;
+}
+
+/* Every waiting patient whose name contains the text, any case, oldest first */
+static CommandStatus search_name(CommandContext *ctx, const char *text, StrBuf *out) {
+    StrBuf rows;
+    sb_init(&rows);
+    NameHits h = { &rows, 0 };
+    int n = pq_name_walk(ctx->q, text, put_name_hit, &h);
+    if (n < 0) {
+        sb_free(&rows);
+        return reply_err(out, "out of memory");
+    }
+    if (n == 0) sb_puts(out, "NOTFOUND\n");
+    else sb_printf(out, "OK|%d%s\n", n, rows.data ? rows.data : "");
+    sb_free(&rows);
+    return CMD_OK;
+}
+
+static void put_found(void *ctx, const Patient *p) {
+    StrBuf *out = ctx;
+    sb_puts(out, "OK|");
+    proto_put_patient(out, p);
+    sb_puts(out, "\n");
+}
+
+static CommandStatus do_search(CommandContext *ctx, char **f, int n, StrBuf *out) {
+    if (n < 3) return reply_err(out, "usage SEARCH|ID|id or SEARCH|NAME|text");
+    if (strcasecmp(f[1], "NAME") == 0) return search_name(ctx, f[2], out);
+
+    if (strcasecmp(f[1], "ID") != 0) return reply_err(out, "search by ID or NAME");
+    if (!pq_view_by_id(ctx->q, atoi(f[2]), put_found, out)) sb_puts(out, "NOTFOUND\n");
+    return CMD_OK;
+}
+
+/* The head as it is, spilled or not: a peek reads nothing back into memory */
+static int put_head(void *ctx, const Patient *p) {
+    put_found(ctx, p);
+    return 0;
+}
+
+static CommandStatus do_peek(CommandContext *ctx, StrBuf *out) {
+    if (pq_service_walk(ctx->q, 1, put_head, out) <= 0) sb_puts(out, "EMPTY\n");
+    return CMD_OK;
+}
+
+static CommandStatus do_call(CommandContext *ctx, StrBuf *out) {
+    if (!ctx->disp) return reply_err(out, "counters not enabled");
+    if (pq_is_empty(ctx->q)) { sb_puts(out, "EMPTY\n"); return CMD_OK; }
+    Counter *c = dispatch_call_next(ctx->disp, ctx->q, ctx->department, time(NULL));
+    if (!c) { sb_puts(out, "BUSY\n"); return CMD_OK; }
+    alerts_forget(ctx->alerts, c->current);
+    ctx->changed++;
+    sb_printf(out, "OK|%d|", c->id);
+    proto_put_patient(out, c->current);
+    sb_puts(out, "\n");
+    return CMD_OK;
+}
+
+static CommandStatus do_done(CommandContext *ctx, char **f, int n, StrBuf *out) {
+    if (!ctx->disp) return reply_err(out, "counters not enabled");
+    if (n < 2) return reply_err(out, "usage DONE|counter");
+    int cid = atoi(f[1]);
+    long dur = dispatch_complete(ctx->disp, cid, time(NULL));
+    if (dur < 0) return reply_err(out, "counter idle");
+    ctx->served++;
+    sb_printf(out, "OK|%d|%ld\n", cid, dur);
+    return CMD_OK;
+}
+
+static CommandStatus do_counters(CommandContext *ctx, StrBuf *out) {
+    if (!ctx->disp) return reply_err(out, "counters not enabled");
+    Dispatcher *d = ctx->disp;
+    time_t now = time(NULL);
+    sb_printf(out, "OK|%d|%.1f", d->n, dispatch_throughput_per_hour(d));
+    for (int i = 0; i < d->n; ++i) {
+        Counter *c = &d->counters[i];
+        sb_printf(out, "|%d:%d:%ld", c->id, c->current ? c->current->id : 0,
+                  c->current ? (long)(now - c->service_start) : 0L);
+    }
+    sb_puts(out, "\n");
+    return CMD_OK;
+}
+
+static CommandStatus do_retriage(CommandContext *ctx, char **f, int n, StrBuf *out) {
+    if (n < 3) return reply_err(out, "usage RETRIAGE|id|severity");
+    Patient *p = pq_search_by_id(ctx->q, atoi(f[1]));
+    if (!p) { sb_puts(out, "NOTFOUND\n"); return CMD_OK; }
+    char *end;
+    long sev = strtol(f[2], &end, 10);
+    if (end == f[2] || !pq_update_severity(ctx->q, p, (Severity)sev)) return reply_err(out, "bad severity");
+    alerts_retriaged(ctx->alerts, p);
+    ctx->changed++;
+    sb_puts(out, "OK|");
+    proto_put_patient(out, p);
+    sb_printf(out, "|%d\n", pq_position(ctx->q, p));
+    return CMD_OK;
+}
+
+static CommandStatus do_remove(CommandContext *ctx, char **f, int n, StrBuf *out) {
+    if (n < 2) return reply_err(out, "usage REMOVE|id");
+    Patient *p = pq_search_by_id(ctx->q, atoi(f[1]));
+    if (!p) { sb_puts(out, "NOTFOUND\n"); return CMD_OK; }
+    alerts_forget(ctx->alerts, p);
+    if (!pq_remove(ctx->q, p)) return reply_err(out, "cannot remove");
+    ctx->changed++;
+    sb_puts(out, "OK|");
+    proto_put_patient(out, p);
+    sb_puts(out, "\n");
+    free_patient(p);
+    return CMD_OK;
+}
+
+static CommandStatus do_stats(CommandContext *ctx, StrBuf *out) {
+    int by_sev[3];
+    pq_count_by_severity(ctx->q, by_sev);
+    sb_printf(out, "OK|%d|%d|%d|%d|%d|%d\n", pq_size(ctx->q),
+              by_sev[CRITICAL], by_sev[SERIOUS], by_sev[NORMAL], ctx->registered, ctx->served);
+    return CMD_OK;
+}
+
+/* Values go between ',' and '|', so those become spaces */
+static void put_query_field(StrBuf *out, const ServedRecord *row, QueryField f) {
+    size_t mark = out->len;
+    query_put_field(out, row, f);
+    for (size_t i = mark; i < out->len; ++i) {
+        if (out->data[i] == ',' || out->data[i] == '|') out->data[i] = ' ';
+    }
+}
+
+static CommandStatus do_query(CommandContext *ctx, char **f, int n, StrBuf *out) {
+    if (n < 2) return reply_err(out, "usage QUERY|terms");
+    Query q;
+    char err[128];
+    time_t now = time(NULL);
+    if (!query_compile(f[1], &q, now, err, sizeof(err))) {
+        proto_sanitize(err);
+        return reply_err(out, err);
+    }
+
+    QueryResult r;
+    query_result_init(&r, &q);
+    query_scan_queue(&q, ctx->q, ctx->department, now, &r);
+    if (!query_scan_history(&q, ctx->qindex, ctx->history_path, &r)) {
+        query_result_free(&r);
+        return reply_err(out, "out of memory");
+    }
+    size_t start = out->len;
+    sb_printf(out, "OK|%ld", r.matched);
+    for (int i = 0; i < r.ngroups; ++i) sb_printf(out, "|%s=%ld", r.groups[i].key, r.groups[i].count);
+    /* whole rows only, as many as keep the reply and its '\n' inside PROTO_MAX_LINE */
+    for (int i = 0; i < r.nrows; ++i) {
+        size_t row = out->len;
+        for (int c = 0; c < q.nshow; ++c) {
+            sb_puts(out, c ? "," : "|");
+            put_query_field(out, &r.rows[i], q.show[c]);
+        }
+        if (out->len - start + 1 >= PROTO_MAX_LINE) {
+            sb_truncate(out, row);
+            break;
+        }
+    }
+    sb_puts(out, "\n");
+    query_result_free(&r);
+    return CMD_OK;
+}
+
+CommandStatus cmd_execute(CommandContext *ctx, char *line, StrBuf *out) {
+    if (!ctx || !ctx->q || !line || !out) return CMD_ERROR;
+
+    char *f[PROTO_MAX_FIELDS];
+    int n = proto_split(line, f, PROTO_MAX_FIELDS);
+    if (n == 0 || f[0][0] == '\0') return reply_err(out, "empty request");
+
+    if (strcasecmp(f[0], "REGISTER") == 0) return do_register(ctx, f, n, out);
+    if (strcasecmp(f[0], "SERVE") == 0) return do_serve(ctx, f, n, out);
+    if (strcasecmp(f[0], "SEARCH") == 0) return do_search(ctx, f, n, out);
+    if (strcasecmp(f[0], "STATS") == 0) return do_stats(ctx, out);
+    if (strcasecmp(f[0], "RETRIAGE") == 0) return do_retriage(ctx, f, n, out);
+    if (strcasecmp(f[0], "REMOVE") == 0) return do_remove(ctx, f, n, out);
+    if (strcasecmp(f[0], "CALL") == 0) return do_call(ctx, out);
+    if (strcasecmp(f[0], "DONE") == 0) return do_done(ctx, f, n, out);
+    if (strcasecmp(f[0], "COUNTERS") == 0) return do_counters(ctx, out);
+    if (strcasecmp(f[0], "PEEK") == 0) return do_peek(ctx, out);
+    if (strcasecmp(f[0], "QUERY") == 0) return do_query(ctx, f, n, out);
+    if (strcasecmp(f[0], "REPLICATION") == 0) { repl_status(ctx->repl, out); return CMD_OK; }
+    if (strcasecmp(f[0], "PING") == 0) { sb_puts(out, "PONG\n"); return CMD_OK; }
+    if (strcasecmp(f[0], "QUIT") == 0) { sb_puts(out, "BYE\n"); return CMD_QUIT; }
+    return reply_err(out, "unknown command");
+}
@@ -0,0 +1,38 @@
+#ifndef CONTROLLER_COMMANDS_H
+#define CONTROLLER_COMMANDS_H
+
+#include "../model/queue.h"
+#include "../model/dispatch.h"
+#include "../model/alerts.h"
+#include "../model/cdc.h"
+#include "../model/query.h"
+#include "../util/strbuf.h"
+
+/* Non-interactive command execution over one PriorityQueue.
+   Used by the desk server; requests/responses follow net/protocol.h. */
+
+struct ReplPrimary;
+
+typedef struct CommandContext {
+    PriorityQueue *q;
+    int next_id;
+    int registered;
+    int served;
+    int changed;              /* re-triages, removals and calls: queue changes besides the two above */
+    const char *history_path;
+    Dispatcher *disp;         /* optional; enables CALL/DONE/COUNTERS */
+    const char *department;   /* recorded on served rows */
+    PatientAlerts *alerts;    /* optional; armed on REGISTER, cancelled on SERVE/CALL */
+    CdcStream *cdc;           /* optional; SERVED events (queue events come from the queue observer) */
+    struct ReplPrimary *repl; /* optional; reported by REPLICATION */
+    QueryIndex *qindex;       /* optional; lets QUERY skip served.csv blocks by date */
+} CommandContext;
+
+typedef enum { CMD_OK = 0, CMD_QUIT = 1, CMD_ERROR = 2 } CommandStatus;
+
+void cmd_context_init(CommandContext *ctx, PriorityQueue *q, int next_id);
+
+/* Execute one request line (modified in place); appends a '\n'-terminated reply to out */
+CommandStatus cmd_execute(CommandContext *ctx, char *line, StrBuf *out);
+
+#endif /* CONTROLLER_COMMANDS_H */
@@ -9,10 +9,26 @@
 #include "../model/queue.h"
 #include "../model/patient.h"
 #include "../view/view.h"
+#include "../view/screen.h"
 #include "../auth/auth.h"
 #include "../util/time_util.h"
+#include "../util/phone_util.h"
+#include "../util/file_util.h"
+#include "../model/history.h"
+#include "../model/dispatch.h"
+#include "../model/registry.h"
+#include "../model/alerts.h"
+#include "../model/cdc.h"
+#include "../model/patient_index.h"
+#include "../model/query.h"
+#include "../model/analytics.h"
+#include "../util/metrics.h"
+#include "../util/trace.h"
+#include "../net/prom_exporter.h"
 
 #define DATA_FILE "data/queue.csv"
+#define HEALTH_MIN_FREE_DISK (512ULL << 20)   /* below this, the health check warns */
+#define HEALTH_MIN_FREE_MEM_KB (256L << 10)
 
 #if defined(_WIN32)
 #include <direct.h>
@@ -23,71 +39,49 @@
 #include <unistd.h>
 #endif
 
+/* Work that must go on while the menu prompt waits for the desk */
+typedef struct ConsoleTick {
+    PatientAlerts *alerts;
+    QueueRegistry *reg;
+    Dispatcher *disp;
+    DisplayPublisher *displays;   /* one per department, NULL when off */
+} ConsoleTick;
+
 /* Forward declarations */
-static time_t parse_iso_time(const char *iso);
-static void save_served_record(const Patient *p, const char *served_at_iso, long wait_seconds);
 static void view_served_history(void);
+static void print_served_history(long tail, int paged);
 static void show_avg_waits(void);
-static int ensure_data_dir(const char *dir);
-static int parse_indian_phone(const char *input, long long *out);
-static int read_line(char *buf, size_t buflen);
-static int read_int(const char *prompt, int *out);
-static int get_next_id_from_files(void);
 static void trim_whitespace(char *s);
 
 /* NEW FEATURE DECLARATIONS */
-static void show_queue_analytics(PriorityQueue *q);
-static void show_queue_position(PriorityQueue *q, int patient_id);
+static void show_queue_analytics(const QueueSnapshot *s);
+static void show_queue_position(Department *dept, Dispatcher *d, int patient_id);
 static int predict_wait_time(PriorityQueue *q, int severity);
 static int call_ml_predictor(int severity, int age, const char *arrival);
 static void detect_peak_hours(void);
 static void show_staff_performance(void);
 static void emergency_bypass(PriorityQueue *q);
-static void view_queue_visual(PriorityQueue *q);
+static void view_queue_visual(const QueueSnapshot *s);
 static void generate_daily_report(void);
 static void patient_journey_tracker(void);
+static void show_patient_journey(int patient_id);
 static void system_health_check(void);
-
-/* Parse ISO 8601 datetime string to time_t */
-static time_t parse_iso_time(const char *iso) {
-    if (!iso) return (time_t)-1;
-    int Y = 0, M = 0, D = 0, h = 0, m = 0, s = 0;
-    if (sscanf(iso, "%d-%d-%d %d:%d:%d", &Y, &M, &D, &h, &m, &s) != 6) {
-        return (time_t)-1;
-    }
-    struct tm tm = {0};
-    tm.tm_year = Y - 1900;
-    tm.tm_mon = M - 1;
-    tm.tm_mday = D;
-    tm.tm_hour = h;
-    tm.tm_min = m;
-    tm.tm_sec = s;
-    return mktime(&tm);
-}
-
-/* Save patient record to served.csv after service */
-static void save_served_record(const Patient *p, const char *served_at_iso, long wait_seconds) {
-    if (!p || !served_at_iso) return;
-    if (!ensure_data_dir("data")) return;
-
-    FILE *f = fopen("data/served.csv", "a");
-    if (!f) return;
-
-    fprintf(f, "%d,%lld,%s,%d,%d,%s,%s,%ld,%s\n",
-            p->id,
-            p->phone_number,
-            p->name ? p->name : "",
-            p->age,
-            (int)p->severity,
-            p->arrival ? p->arrival : "",
-            served_at_iso,
-            wait_seconds,
-            p->problem ? p->problem : "");
-    fclose(f);
-}
-
-/* Display all served patients from served.csv */
-static void view_served_history(void) {
+static void retriage_patient(Department *dept, PatientAlerts *alerts);
+static void show_counter_status(Dispatcher *d, Department *dept);
+static void complete_service(Dispatcher *d, QueueRegistry *reg, int *served);
+static Department* switch_department(QueueRegistry *reg, Department *cur);
+static void transfer_patient(QueueRegistry *reg, Department *cur);
+static void show_department_stats(QueueRegistry *reg);
+static void live_dashboard(QueueRegistry *reg, Department *dept, Dispatcher *disp, ConsoleTick *tick);
+static void search_by_name(PatientIndex *ix, PidxTap *taps, QueueRegistry *reg);
+static void fuzzy_search(PatientIndex *ix, PidxTap *taps, QueueRegistry *reg);
+static void query_patients(QueryIndex *qix, QueueRegistry *reg);
+static int check_returning_patient(PatientIndex *ix, PidxTap *taps, QueueRegistry *reg, long long phone,
+                                   char *name, size_t name_len, int *age);
+
+/* Display served patients from served.csv: the last `tail` rows (0 = all),
+   a page at a time when paged */
+static void print_served_history(long tail, int paged) {
     if (!ensure_data_dir("data")) {
         printf("No served history found\n");
         return;
@@ -99,201 +93,150 @@ static void view_served_history(void) {
         return;
     }
 
-    printf("\n");
-    printf("%-4s | %-12s | %-20s | %-3s | %-8s | %-19s | %-19s | %-9s | %-20s\n",
-           "ID", "Phone", "Name", "Age", "Severity", "Arrival", "Served At", "Wait(min)", "Problem");
-    printf("--------------------------------------------------------------------------------------------------------------\n");
-
+    uint64_t t0 = metrics_begin(MET_HISTORY_SCAN);
+    TRACE_BEGIN(span);
     char line[1024];
-    fgets(line, sizeof(line), f); /* skip header */
+    if (tail > 0) history_seek_tail(f, tail);
+    else if (!fgets(line, sizeof(line), f)) line[0] = '\0'; /* skip header */
 
+    StrBuf *out = view_buffer();
+    view_render_served_header(out);
+    ServedRecord r;
+    long rows = 0;
     while (fgets(line, sizeof(line), f)) {
-        int id, age, sev;
-        long long phone;
-        char name[128], arrival[64], served_at[64], problem[256];
-        long wait_sec;
-        int r = sscanf(line, "%d,%lld,%127[^,],%d,%d,%63[^,],%63[^,],%ld,%255[^\n]",
-                       &id, &phone, name, &age, &sev, arrival, served_at, &wait_sec, problem);
-        if (r >= 9) {
-            const char *sev_str = sev == 2 ? "CRITICAL" : (sev == 1 ? "SERIOUS" : "NORMAL");
-            double wait_min = (double)wait_sec / 60.0;
-            printf("%-4d | %-12lld | %-20.20s | %-3d | %-8s | %-19s | %-19s | %-9.2f | %-20.20s\n",
-                   id, phone, name, age, sev_str, arrival, served_at, wait_min, problem);
+        if (!history_parse_line(line, &r)) continue;
+        view_render_served_row(out, &r);
+        if (++rows % VIEW_PAGE_ROWS != 0) continue;
+        view_flush();
+        if (paged) {
+            char buf[8];
+            printf("-- %ld shown: Enter for more, q to stop -- ", rows);
+            if (!read_line(buf, sizeof(buf)) || buf[0] == 'q' || buf[0] == 'Q') break;
         }
     }
+    view_flush();
     fclose(f);
+    metrics_end(MET_HISTORY_SCAN, t0);
+    TRACE_END_ARG(span, "history.scan", "served list");
 }
 
-/* Calculate and display average wait times by severity */
-static void show_avg_waits(void) {
-    if (!ensure_data_dir("data")) {
-        printf("No served history found\n");
-        return;
-    }
-
-    FILE *f = fopen("data/served.csv", "r");
-    if (!f) {
-        printf("No served history found\n");
-        return;
-    }
-
-    long sum[3] = {0, 0, 0};
-    long cnt[3] = {0, 0, 0};
-    char line[1024];
-
-    fgets(line, sizeof(line), f); /* skip header */
-
-    while (fgets(line, sizeof(line), f)) {
-        int id, age, sev;
-        long long phone;
-        char name[128], arrival[64], served_at[64], problem[256];
-        long wait;
-        int r = sscanf(line, "%d,%lld,%127[^,],%d,%d,%63[^,],%63[^,],%ld,%255[^\n]",
-                       &id, &phone, name, &age, &sev, arrival, served_at, &wait, problem);
-        if (r >= 9 && sev >= 0 && sev <= 2) {
-            sum[sev] += wait;
-            cnt[sev] += 1;
-        }
-    }
-    fclose(f);
-
-    const char *names[3] = {"NORMAL", "SERIOUS", "CRITICAL"};
-    printf("\nAverage serving times (min):\n");
-    for (int i = 0; i < 3; ++i) {
-        if (cnt[i] == 0) {
-            printf("%s: no data\n", names[i]);
-        } else {
-            double avg_min = (double)sum[i] / (cnt[i] * 60.0);
-            printf("%s: %.1f min (n=%ld)\n", names[i], avg_min, cnt[i]);
-        }
-    }
-}
-
-/* Ensure data directory exists */
-static int ensure_data_dir(const char *dir) {
-#if defined(_WIN32)
-    if (_mkdir(dir) == 0) return 1;
-    return GetLastError() == ERROR_ALREADY_EXISTS;
-#else
-    struct stat st;
-    if (stat(dir, &st) == 0) return S_ISDIR(st.st_mode);
-    if (mkdir(dir, 0755) == 0) return 1;
-    if (errno == EEXIST) return 1;
-    return 0;
-#endif
-}
-
-/* Read a line from stdin */
-static int read_line(char *buf, size_t buflen) {
-    if (!fgets(buf, (int)buflen, stdin)) return 0;
-    buf[strcspn(buf, "\r\n")] = '\0';
-    return 1;
+static void view_served_history(void) {
+    char buf[32];
+    printf("Show the last N served (Enter = %d, a = all, page by page): ", VIEW_PAGE_ROWS);
+    if (!read_line(buf, sizeof(buf))) return;
+    if (buf[0] == 'a' || buf[0] == 'A') { print_served_history(0, 1); return; }
+    long n = buf[0] ? strtol(buf, NULL, 10) : VIEW_PAGE_ROWS;
+    print_served_history(n > 0 ? n : VIEW_PAGE_ROWS, 0);
 }
 
-/* Read an integer from stdin with validation */
-static int read_int(const char *prompt, int *out) {
-    char buf[128];
-    char *endptr;
-    long val;
-
-    while (1) {
-        printf("%s", prompt);
-        if (!read_line(buf, sizeof(buf))) return 0;
-
-        errno = 0;
-        val = strtol(buf, &endptr, 10);
-
-        if (endptr == buf || (*endptr != '\0')) {
-            printf("Invalid number, try again.\n");
-            continue;
-        }
-
-        if ((errno == ERANGE && (val == LONG_MAX || val == LONG_MIN)) ||
-            val < INT_MIN || val > INT_MAX) {
-            printf("Number out of range, try again.\n");
-            continue;
-        }
-
-        *out = (int)val;
-        return 1;
+/* Every second while the menu or the live dashboard waits for the desk */
+static void console_tick(void *ctx) {
+    ConsoleTick *t = ctx;
+    alerts_tick(t->alerts);
+    trace_poll();
+    /* the boards show ETAs and published_at, so they are fed every second */
+    for (int i = 0; t->displays && i < registry_count(t->reg); ++i) {
+        Department *d = registry_get(t->reg, i);
+        DisplayPayload payload;
+        dept_lock(d);
+        view_fill_display(&payload, &d->q, t->disp, d->name, time(NULL));
+        dept_unlock(d);
+        display_publish(&t->displays[i], &payload);
     }
 }
 
-/* Parse Indian phone number in multiple formats */
-static int parse_indian_phone(const char *input, long long *out) {
-    if (!input || input[0] == '\0') return 0;
-
-    char digits[32];
-    int di = 0;
-
-    /* Step 1: Extract ONLY digits from input */
-    for (int i = 0; input[i] != '\0' && di < 31; i++) {
-        char c = input[i];
-        if (c >= '0' && c <= '9') {
-            digits[di++] = c;
-        }
+/* While the live dashboard is up, alerts go into its frame instead of
+   stdout: a printf would land in the middle of the next redraw */
+static struct {
+    int active;
+    int n;
+    char line[DASH_ALERTS][DASH_ALERT_LEN];
+} dash_alerts;
+
+static void dash_alert_push(AlertKind kind, const char *msg) {
+    if (dash_alerts.n == DASH_ALERTS) {
+        memmove(dash_alerts.line[0], dash_alerts.line[1], sizeof(dash_alerts.line[0]) * (DASH_ALERTS - 1));
+        dash_alerts.n--;
     }
-    digits[di] = '\0';
-
-    if (di == 0) return 0;
+    /* the frame is ASCII cut to its width (screen.h): a wide or wrapped
+       line would shift every cell after it */
+    char *line = dash_alerts.line[dash_alerts.n++];
+    snprintf(line, DASH_ALERT_LEN, "%-8s %.70s", alert_kind_name(kind), msg);
+    for (char *c = line; *c; ++c) if ((unsigned char)*c >= 0x80) *c = '?';
+}
 
-    /* Step 2: Normalize length - handle different input formats */
-    if (di == 12 && digits[0] == '9' && digits[1] == '1') {
-        /* Format: 919876543210 -> 9876543210 */
-        char temp[32];
-        strcpy(temp, digits);
-        strcpy(digits, temp + 2);
-        di = 10;
-    } else if (di == 11 && digits[0] == '0') {
-        /* Format: 09876543210 -> 9876543210 */
-        char temp[32];
-        strcpy(temp, digits);
-        strcpy(digits, temp + 1);
-        di = 10;
+/* Live dashboard of the current department until Enter: one frame per
+   second, redrawing only the cells that changed */
+static void live_dashboard(QueueRegistry *reg, Department *dept, Dispatcher *disp, ConsoleTick *tick) {
+    Screen screen;
+    screen_init(&screen);
+    StrBuf frame;
+    sb_init(&frame);
+    StrBuf *out = view_buffer();
+    char buf[8];
+    dash_alerts.active = 1;
+    dash_alerts.n = 0;
+    for (;;) {
+        console_tick(tick);
+        Dashboard db;
+        memset(&db, 0, sizeof(db));
+        time_t now = time(NULL);
+        registry_stats(reg, dept, now, &db.stats);
+        dept_lock(dept);
+        view_fill_dashboard(&db, &dept->q, disp, dept->name, now);
+        dept_unlock(dept);
+        db.alerts = dash_alerts.n;
+        memcpy(db.alert, dash_alerts.line, sizeof(db.alert));
+
+        sb_reset(&frame);
+        view_render_dashboard(&frame, &db);
+        screen_update(&screen, frame.data, out);
+        view_flush();
+        if (read_line_timeout(buf, sizeof(buf), 1000) != 0) break;
     }
+    dash_alerts.active = 0;
+    screen_finish(&screen, out);
+    view_flush();
+    sb_free(&frame);
+}
 
-    /* Step 3: Must be exactly 10 digits */
-    if (di != 10) return 0;
-
-    /* Step 4: Must start with 6-9 (valid Indian mobile prefix) */
-    if (digits[0] < '6' || digits[0] > '9') return 0;
+/* The served.csv aggregates behind menus 10, 14, 15 and 18 and the wait
+   heuristic. One refresh brings them all up to date, reading only the rows
+   appended since the last one; NULL if there is no served history. */
+static Analytics report_stats;
+static int report_stats_ready = 0;
 
-    /* Step 5: Convert to long long safely */
-    long long val = 0;
-    for (int i = 0; i < 10; i++) {
-        val = val * 10 + (digits[i] - '0');
+static const Analytics* served_analytics(void) {
+    if (!report_stats_ready) {
+        analytics_init(&report_stats, HISTORY_FILE);
+        report_stats_ready = 1;
     }
-
-    if (val <= 0) return 0;
-
-    if (out) *out = val;
-    return 1;
+    uint64_t t0 = metrics_begin(MET_HISTORY_SCAN);
+    TRACE_BEGIN(span);
+    int ok = analytics_refresh(&report_stats);
+    metrics_end(MET_HISTORY_SCAN, t0);
+    TRACE_END_ARG(span, "history.scan", "analytics");
+    return ok ? &report_stats : NULL;
 }
 
-/* Get next available patient ID from existing files */
-static int get_next_id_from_files(void) {
-    int maxid = 0;
-    const char *files[] = {"data/queue.csv", "data/served.csv"};
-    char line[1024];
-
-    for (int i = 0; i < 2; ++i) {
-        FILE *f = fopen(files[i], "r");
-        if (!f) continue;
-
-        if (fgets(line, sizeof(line), f) == NULL) {
-            fclose(f);
-            continue;
-        }
+/* Calculate and display average wait times by severity */
+static void show_avg_waits(void) {
+    const Analytics *a = served_analytics();
+    if (!a) {
+        printf("No served history found\n");
+        return;
+    }
 
-        while (fgets(line, sizeof(line), f)) {
-            int id = 0;
-            if (sscanf(line, "%d,", &id) == 1 && id > maxid) {
-                maxid = id;
-            }
+    const char *names[3] = {"NORMAL", "SERIOUS", "CRITICAL"};
+    printf("\nAverage serving times (min):\n");
+    for (int i = 0; i < 3; ++i) {
+        if (a->sev_count[i] == 0) {
+            printf("%s: no data\n", names[i]);
+        } else {
+            double avg_min = (double)a->sev_wait[i] / (a->sev_count[i] * 60.0);
+            printf("%s: %.1f min (n=%ld)\n", names[i], avg_min, a->sev_count[i]);
         }
-        fclose(f);
     }
-    return maxid + 1;
 }
 
 /* Trim leading and trailing whitespace */
@@ -350,8 +293,12 @@ static int call_ml_predictor(int severity, int age, const char *arrival) {
                  pycmd, severity, age);
     }
 
+    TRACE_BEGIN(span);
     FILE *fp = popen(cmd, "r");
-    if (!fp) return -1;
+    if (!fp) {
+        TRACE_END(span, "predict.ml_helper");
+        return -1;
+    }
 
     char line[512];
     int predicted_sec = -1;
@@ -366,6 +313,7 @@ static int call_ml_predictor(int severity, int age, const char *arrival) {
         }
     }
     pclose(fp);
+    TRACE_END(span, "predict.ml_helper");
 
     if (predicted_sec <= 0) return -1;
     /* Round to nearest minute */
@@ -375,8 +323,8 @@ static int call_ml_predictor(int severity, int age, const char *arrival) {
 /* ============================================
    FEATURE 1: REAL-TIME QUEUE ANALYTICS 📊
    ============================================ */
-static void show_queue_analytics(PriorityQueue *q) {
-    if (pq_is_empty(q)) {
+static void show_queue_analytics(const QueueSnapshot *s) {
+    if (qsnap_size(s) == 0) {
         printf("No patients in queue\n");
         return;
     }
@@ -386,17 +334,8 @@ static void show_queue_analytics(PriorityQueue *q) {
     printf("║     📊 REAL-TIME QUEUE ANALYTICS           ║\n");
     printf("╚════════════════════════════════════════════╝\n\n");
     
-    int total = pq_size(q);
-    int critical = 0, serious = 0, normal = 0;
-    
-    /* Count by severity */
-    Patient *cur = q->head;
-    while (cur) {
-        if (cur->severity == 2) critical++;
-        else if (cur->severity == 1) serious++;
-        else normal++;
-        cur = cur->next;
-    }
+    int total = qsnap_size(s);
+    int critical = s->by_severity[CRITICAL], serious = s->by_severity[SERIOUS], normal = s->by_severity[NORMAL];
     
     printf("  📋 Total Patients: %d\n", total);
     printf("  🔴 Critical: %d (%.1f%%)\n", critical, total ? (critical*100.0/total) : 0);
@@ -412,28 +351,509 @@ static void show_queue_analytics(PriorityQueue *q) {
            total > 0 ? (100.0 - (total * 2.5)) : 100.0);
 }
 
+static int show_next(void *ctx, const Patient *p) {
+    (void)ctx;
+    printf("\n👀 NEXT PATIENT:\n\n");
+    view_show_patient(p);
+    return 0;
+}
+
+static void show_waiting(void *ctx, const Patient *p) {
+    (void)ctx;
+    printf("\n[STATUS: WAITING IN QUEUE]\n\n");
+    view_show_patient(p);
+}
+
 /* ============================================
    FEATURE 2: QUEUE POSITION TRACKER 🎯
    ============================================ */
-static void show_queue_position(PriorityQueue *q, int patient_id) {
-    Patient *p = pq_search_by_id(q, patient_id);
-    
-    if (!p) {
+typedef struct QueuePosition {
+    PriorityQueue *q;
+    Dispatcher *d;
+    int found;
+    int position;
+    int counter;
+    long eta;
+    long sla_left;            /* AGING only */
+} QueuePosition;
+
+/* Measured where the patient is: a spilled one is not read back for this */
+static void measure_position(void *ctx, const Patient *p) {
+    QueuePosition *m = ctx;
+    time_t now = time(NULL);
+    m->found = 1;
+    m->position = pq_position(m->q, p);
+    m->eta = dispatch_eta_sec(m->d, m->q, p, now, &m->counter);
+    if (m->q->policy.mode == PQ_MODE_AGING) m->sla_left = (long)(pq_sla_deadline(m->q, p) - now);
+}
+
+static void show_queue_position(Department *dept, Dispatcher *d, int patient_id) {
+    PriorityQueue *q = &dept->q;
+    QueuePosition m = { q, d, 0, 0, 0, -1, 0 };
+    dept_lock(dept);
+    pq_view_by_id(q, patient_id, measure_position, &m);
+    int total = pq_size(q);
+    dept_unlock(dept);
+
+    if (!m.found) {
         printf("❌ Patient ID %d not found in queue\n\n", patient_id);
         return;
     }
     
-    int position = 1;
-    int total = pq_size(q);
-    
     printf("\n");
     printf("╔═══════════════════════════════════════╗\n");
     printf("║  🎯 YOUR POSITION IN QUEUE            ║\n");
     printf("╚═══════════════════════════════════════╝\n\n");
     printf("  ID: %d\n", patient_id);
-    printf("  📍 Position: #%d out of %d\n", position, total);
-    printf("  ⏱️  Estimated Wait: ~%d minutes\n", position * 5);
-    printf("  🏥 Counter: %d\n\n", (position % 3) + 1);
+    printf("  📍 Position: #%d out of %d\n", m.position, total);
+    printf("  ⏱️  Estimated Wait: ~%ld minutes\n", m.eta >= 0 ? (m.eta + 59) / 60 : 0);
+    printf("  🏥 Counter: %d\n", m.counter);
+    if (q->policy.mode == PQ_MODE_AGING) {
+        if (m.sla_left >= 0) printf("  ⏳ SLA: %ld min left\n", m.sla_left / 60);
+        else printf("  ⚠️  SLA breached %ld min ago\n", -m.sla_left / 60);
+    }
+    printf("\n");
+}
+
+/* ============================================
+   COUNTERS: status board and service completion
+   ============================================ */
+static void show_counter_status(Dispatcher *d, Department *dept) {
+    time_t now = time(NULL);
+    printf("\n");
+    printf("╔════════════════════════════════════════════╗\n");
+    printf("║       🏥 COUNTER STATUS                    ║\n");
+    printf("╚════════════════════════════════════════════╝\n\n");
+
+    for (int i = 0; i < d->n; ++i) {
+        Counter *c = &d->counters[i];
+        if (c->current) {
+            printf("  Counter %-2d | 🔴 BUSY  | ID %-5d %-20.20s | %3ld min | served %ld\n",
+                   c->id, c->current->id, c->current->name, (long)(now - c->service_start) / 60, c->served);
+        } else {
+            printf("  Counter %-2d | 🟢 FREE  | idle %3ld min                      | served %ld\n",
+                   c->id, (long)(now - c->free_since) / 60, c->served);
+        }
+    }
+
+    printf("\n  ⏱️  Avg service (measured): CRITICAL %.1f | SERIOUS %.1f | NORMAL %.1f min\n",
+           dispatch_avg_service_sec(d, CRITICAL) / 60.0,
+           dispatch_avg_service_sec(d, SERIOUS) / 60.0,
+           dispatch_avg_service_sec(d, NORMAL) / 60.0);
+    double per_hour = dispatch_throughput_per_hour(d);
+    printf("  🚀 Capacity: %.1f patients/hour across %d counters\n", per_hour, d->n);
+    dept_lock(dept);
+    int backlog = pq_size(&dept->q);
+    dept_unlock(dept);
+    if (per_hour > 0 && backlog > 0)
+        printf("  📋 Backlog of %d clears in ~%.0f min\n\n", backlog, backlog * 60.0 / per_hour);
+    else
+        printf("\n");
+}
+
+static void complete_service(Dispatcher *d, QueueRegistry *reg, int *served) {
+    int busy = dispatch_busy_count(d);
+    if (busy == 0) {
+        printf("No counter is serving anyone\n");
+        return;
+    }
+    int cid = 0;
+    if (busy == 1) {
+        for (int i = 0; i < d->n; ++i) if (d->counters[i].current) cid = d->counters[i].id;
+    } else if (!read_int("Counter to complete: ", &cid)) {
+        return;
+    }
+
+    Counter *c = dispatch_counter(d, cid);
+    int pid = (c && c->current) ? c->current->id : 0;
+    Department *dept = c ? registry_find(reg, c->department) : NULL;
+    long dur = dispatch_complete(d, cid, time(NULL));
+    if (dur < 0) {
+        printf("❌ Counter %d is not serving anyone\n", cid);
+        return;
+    }
+    (*served)++;
+    if (dept) dept->served++;
+    printf("✅ Counter %d finished patient %d (service %.1f min)\n", cid, pid, dur / 60.0);
+}
+
+/* ============================================
+   DEPARTMENTS: switch, transfer and per-queue stats
+   ============================================ */
+static void list_departments(QueueRegistry *reg, Department *cur) {
+    int n = registry_count(reg);
+    for (int i = 0; i < n; ++i) {
+        Department *d = registry_get(reg, i);
+        dept_lock(d);
+        int waiting = pq_size(&d->q);
+        dept_unlock(d);
+        printf("  %d. %-16s %3d waiting%s\n", i + 1, d->name, waiting, d == cur ? "  <- current" : "");
+    }
+}
+
+static Department* pick_department(QueueRegistry *reg, Department *cur, const char *prompt) {
+    list_departments(reg, cur);
+    int idx = 0;
+    if (!read_int(prompt, &idx)) return NULL;
+    Department *d = registry_get(reg, idx - 1);
+    if (!d) printf("❌ No such department\n");
+    return d;
+}
+
+static Department* switch_department(QueueRegistry *reg, Department *cur) {
+    printf("\n🏥 DEPARTMENTS\n\n");
+    Department *d = pick_department(reg, cur, "Switch to department #: ");
+    if (!d) return cur;
+    printf("✅ Now working on %s (%d waiting)\n", d->name, pq_size(&d->q));
+    return d;
+}
+
+typedef struct PositionNote {
+    PriorityQueue *q;
+    int *position;
+} PositionNote;
+
+static void note_position(void *ctx, const Patient *p) {
+    PositionNote *n = ctx;
+    *n->position = pq_position(n->q, p);
+}
+
+static void transfer_patient(QueueRegistry *reg, Department *cur) {
+    int pid = 0;
+    if (!read_int("Enter Patient ID to transfer: ", &pid)) return;
+    printf("\nMove patient %d from %s to:\n", pid, cur->name);
+    Department *to = pick_department(reg, cur, "Target department #: ");
+    if (!to) return;
+    if (to == cur) {
+        printf("Patient is already in %s\n", cur->name);
+        return;
+    }
+    if (!registry_transfer(reg, cur, to, pid)) {
+        printf("❌ Patient %d is not waiting in %s\n", pid, cur->name);
+        return;
+    }
+    int position = 0;
+    PositionNote note = { &to->q, &position };
+    dept_lock(to);
+    pq_view_by_id(&to->q, pid, note_position, &note);
+    dept_unlock(to);
+    printf("✅ Patient %d moved to %s (position %d)\n", pid, to->name, position);
+}
+
+static void print_dept_stats_row(const char *name, const RegistryStats *st) {
+    printf("  %-14s | %4d | %4d %4d %4d | %5ld | %5ld | ",
+           name, st->waiting, st->by_severity[CRITICAL], st->by_severity[SERIOUS], st->by_severity[NORMAL],
+           st->registered, st->served);
+    long oldest = -1;
+    for (int s = 0; s < 3; ++s) if (st->oldest_wait_sec[s] > oldest) oldest = st->oldest_wait_sec[s];
+    if (oldest >= 0) printf("%ld min\n", oldest / 60);
+    else printf("-\n");
+}
+
+static void show_department_stats(QueueRegistry *reg) {
+    time_t now = time(NULL);
+    RegistryStats st;
+
+    printf("\n");
+    printf("╔════════════════════════════════════════════╗\n");
+    printf("║       🏥 DEPARTMENT STATISTICS             ║\n");
+    printf("╚════════════════════════════════════════════╝\n\n");
+    printf("  %-14s | %4s | %4s %4s %4s | %5s | %5s | %s\n",
+           "Department", "Wait", "CRIT", "SER", "NORM", "Reg", "Srvd", "Oldest");
+    printf("  -----------------------------------------------------------------------\n");
+
+    int n = registry_count(reg);
+    for (int i = 0; i < n; ++i) {
+        Department *d = registry_get(reg, i);
+        registry_stats(reg, d, now, &st);
+        print_dept_stats_row(d->name, &st);
+    }
+    printf("  -----------------------------------------------------------------------\n");
+    registry_stats(reg, NULL, now, &st);
+    print_dept_stats_row("ALL", &st);
+
+    /* historical per-department waits from served.csv */
+    FILE *f = fopen(HISTORY_FILE, "r");
+    if (!f) return;
+    long total[REGISTRY_MAX_DEPTS] = {0}, cnt[REGISTRY_MAX_DEPTS] = {0};
+    char line[1024];
+    ServedRecord r;
+    while (fgets(line, sizeof(line), f)) {
+        if (!history_parse_line(line, &r)) continue;
+        Department *d = r.department[0] ? registry_find(reg, r.department) : registry_get(reg, 0);
+        if (!d) continue;
+        for (int i = 0; i < n; ++i) {
+            if (registry_get(reg, i) == d) { total[i] += r.wait_sec; cnt[i]++; break; }
+        }
+    }
+    fclose(f);
+
+    printf("\n  Served history (all time):\n");
+    for (int i = 0; i < n; ++i) {
+        if (cnt[i] == 0) continue;
+        printf("  %-14s | %5ld served | avg wait %.1f min\n",
+               registry_get(reg, i)->name, cnt[i], (double)total[i] / cnt[i] / 60.0);
+    }
+    printf("\n");
+}
+
+/* ============================================
+   NAME SEARCH: every department and served.csv, via the patient index
+   ============================================ */
+#define NAME_SEARCH_SHOWN 20
+
+/* The first search reads served.csv once; the queue observers keep it
+   current from then on */
+static void ensure_patient_index(PatientIndex *ix, PidxTap *taps, QueueRegistry *reg) {
+    if (ix->built) return;
+    uint64_t t0 = monotonic_ns();
+    pidx_build_history(ix, HISTORY_FILE);
+    for (int i = 0; i < registry_count(reg); ++i) {
+        Department *d = registry_get(reg, i);
+        dept_lock(d);
+        pidx_add_queue(&taps[i], &d->q);
+        dept_unlock(d);
+    }
+    printf("(indexed %u patients in %.0f ms)\n", ix->count, (double)(monotonic_ns() - t0) / 1e6);
+}
+
+static void render_search_results(StrBuf *out, const char *query, const PidxHit *hits, int total, int max,
+                                  double ms, QueueRegistry *reg) {
+    if (total == 0) {
+        sb_printf(out, "No patients found matching '%s'\n\n", query);
+        return;
+    }
+    int shown = total < max ? total : max;
+    sb_printf(out, "\n[PATIENTS MATCHING '%s']\n\n", query);
+    view_render_search_header(out);
+    view_render_search_hits(out, hits, shown, registry_get(reg, 0)->name, time(NULL));
+    if (total > shown) sb_printf(out, "\n%d matches (best %d shown) in %.2f ms\n\n", total, shown, ms);
+    else sb_printf(out, "\n%d match%s in %.2f ms\n\n", total, total == 1 ? "" : "es", ms);
+}
+
+static void search_by_name(PatientIndex *ix, PidxTap *taps, QueueRegistry *reg) {
+    char key[64] = {0};
+    printf("Enter name or part of name: ");
+    if (!read_line(key, sizeof(key))) return;
+    trim_whitespace(key);
+    if (!key[0]) return;
+
+    ensure_patient_index(ix, taps, reg);
+    PidxHit hits[NAME_SEARCH_SHOWN];
+    uint64_t t0 = monotonic_ns();
+    int total = pidx_search_name(ix, key, hits, NAME_SEARCH_SHOWN);
+    double ms = (double)(monotonic_ns() - t0) / 1e6;
+    render_search_results(view_buffer(), key, hits, total, NAME_SEARCH_SHOWN, ms, reg);
+    view_flush();
+}
+
+/* Typo-tolerant search, re-run on every keystroke on a terminal (one line
+   of input otherwise) */
+static void fuzzy_search(PatientIndex *ix, PidxTap *taps, QueueRegistry *reg) {
+    ensure_patient_index(ix, taps, reg);
+    PidxHit hits[NAME_SEARCH_SHOWN];
+    char query[64] = {0};
+    StrBuf *out = view_buffer();
+
+    if (!view_keys_begin()) {
+        printf("Enter name (spelling may be off): ");
+        if (!read_line(query, sizeof(query))) return;
+        uint64_t t0 = monotonic_ns();
+        int total = pidx_search_fuzzy(ix, query, hits, NAME_SEARCH_SHOWN);
+        render_search_results(out, query, hits, total, NAME_SEARCH_SHOWN, (double)(monotonic_ns() - t0) / 1e6, reg);
+        view_flush();
+        return;
+    }
+
+    Screen screen;
+    screen_init(&screen);
+    StrBuf frame;
+    sb_init(&frame);
+    size_t len = 0;
+    for (;;) {
+        sb_reset(&frame);
+        sb_printf(&frame, "Fuzzy name search (Enter = done, Esc = cancel): %s_\n", query);
+        if (len > 0) {
+            uint64_t t0 = monotonic_ns();
+            int total = pidx_search_fuzzy(ix, query, hits, NAME_SEARCH_SHOWN);
+            render_search_results(&frame, query, hits, total, NAME_SEARCH_SHOWN,
+                                  (double)(monotonic_ns() - t0) / 1e6, reg);
+        }
+        screen_update(&screen, frame.data, out);
+        view_flush();
+
+        int c = read_key();
+        if (c < 0 || c == '\n' || c == '\r' || c == 27) break;
+        if (c == 127 || c == 8) {
+            if (len > 0) query[--len] = '\0';
+        } else if (c >= 32 && len + 1 < sizeof(query)) {
+            query[len++] = (char)c;
+            query[len] = '\0';
+        }
+    }
+    view_keys_end();
+    screen_finish(&screen, out);
+    view_flush();
+    sb_free(&frame);
+}
+
+/* ============================================
+   RETURNING PATIENTS: lookup by phone at registration
+   ============================================ */
+#define PHONE_VISITS_SHOWN 5
+
+static int confirm(const char *prompt, int default_yes) {
+    char yn[8];
+    printf("%s", prompt);
+    if (!read_line(yn, sizeof(yn)) || yn[0] == '\0') return default_yes;
+    return yn[0] == 'y' || yn[0] == 'Y';
+}
+
+/* Warn about a second registration of someone already waiting (or just
+   registered) under this number, and offer the last visit's name and age.
+   Returns 0 if the desk cancels the registration; sets name and age when
+   the details are reused. */
+static int check_returning_patient(PatientIndex *ix, PidxTap *taps, QueueRegistry *reg, long long phone,
+                                   char *name, size_t name_len, int *age) {
+    ensure_patient_index(ix, taps, reg);
+    time_t now = time(NULL);
+    const char *default_dept = registry_get(reg, 0)->name;
+
+    PidxHit dup;
+    if (pidx_find_duplicate(ix, phone, now, pidx_dup_window_from_env(), &dup)) {
+        long ago = dup.arrival != (time_t)-1 ? (long)(now - dup.arrival) / 60 : -1;
+        printf("\n⚠️  Possible duplicate: patient %d (%s) with this phone ", dup.id, dup.name);
+        if (ago >= 0) printf("registered %ld min ago", ago);
+        if (dup.status == PIDX_WAITING)
+            printf("%sis still waiting in %s", ago >= 0 ? " and " : "", dup.department[0] ? dup.department : default_dept);
+        else
+            printf(", %s", pidx_status_name(dup.status));
+        printf(".\n");
+        if (!confirm("Register a new visit anyway? (y/N): ", 0)) return 0;
+    }
+
+    PidxHit visits[PHONE_VISITS_SHOWN];
+    int total = pidx_lookup_phone(ix, phone, visits, PHONE_VISITS_SHOWN);
+    if (total == 0) return 1;
+    int shown = total < PHONE_VISITS_SHOWN ? total : PHONE_VISITS_SHOWN;
+    StrBuf *out = view_buffer();
+    sb_printf(out, "\nReturning patient: %d earlier visit%s with this phone\n\n", total, total == 1 ? "" : "s");
+    view_render_search_header(out);
+    view_render_search_hits(out, visits, shown, default_dept, now);
+    view_flush();
+
+    /* a phone is often shared by a family: confirm before reusing */
+    const PidxHit *last = &visits[0];
+    int years = last->arrival != (time_t)-1 ? (int)((now - last->arrival) / (365L * 24 * 3600)) : 0;
+    char prompt[NAME_LEN + 64];
+    snprintf(prompt, sizeof(prompt), "\nSame patient as %s, age %d? (Y/n): ", last->name, last->age + years);
+    if (!confirm(prompt, 1)) return 1;
+    snprintf(name, name_len, "%s", last->name);
+    *age = last->age + years;
+    return 1;
+}
+
+/* ============================================
+   AD-HOC QUERIES: filters over every department and served.csv
+   ============================================ */
+static void query_patients(QueryIndex *qix, QueueRegistry *reg) {
+    printf("\nFilter terms, e.g.: severity=critical age>60 wait>30 date>=-7d\n");
+    printf("  fields   id phone name~ problem~ dept age severity date served wait(min) counter status\n");
+    printf("  options  from waiting|served  show id,name,...  count [by severity|dept|day|hour|age]  limit N\n");
+    for (;;) {
+        char text[512] = {0};
+        printf("\nquery (Enter = back)> ");
+        if (!read_line(text, sizeof(text))) return;
+        trim_whitespace(text);
+        if (!text[0]) return;
+
+        Query q;
+        char err[128];
+        time_t now = time(NULL);
+        if (!query_compile(text, &q, now, err, sizeof(err))) {
+            printf("❌ %s\n", err);
+            continue;
+        }
+        QueryResult r;
+        query_result_init(&r, &q);
+        uint64_t t0 = monotonic_ns();
+        for (int i = 0; i < registry_count(reg); ++i) {
+            Department *d = registry_get(reg, i);
+            dept_lock(d);
+            query_scan_queue(&q, &d->q, d->name, now, &r);
+            dept_unlock(d);
+        }
+        int ok = query_scan_history(&q, qix, HISTORY_FILE, &r);
+        double ms = (double)(monotonic_ns() - t0) / 1e6;
+
+        StrBuf *out = view_buffer();
+        sb_puts(out, "\n");
+        view_render_query_result(out, &q, &r);
+        sb_printf(out, "(%ld rows tested", r.scanned);
+        if (r.skipped) sb_printf(out, ", %ld skipped by date", r.skipped);
+        sb_printf(out, " in %.1f ms)\n", ms);
+        if (!ok) sb_puts(out, "⚠️  Out of memory: some matching rows are not listed\n");
+        view_flush();
+        query_result_free(&r);
+    }
+}
+
+/* ============================================
+   ALERTS: SLA escalation, no-shows, re-triage reminders
+   ============================================ */
+static void on_patient_alert(PatientAlerts *a, Patient *p, AlertKind kind) {
+    QueueRegistry *reg = a->user;
+    int n = registry_count(reg);
+    for (int i = 0; i < n; ++i) {
+        Department *d = registry_get(reg, i);
+        char msg[256];
+        dept_lock(d);
+        if (pq_search_by_id(&d->q, p->id) != p) {
+            dept_unlock(d);
+            continue;
+        }
+        alerts_apply(a, &d->q, p, kind, d->name, msg, sizeof(msg));
+        dept_unlock(d);
+        if (dash_alerts.active) dash_alert_push(kind, msg);
+        else printf("%s %s\n", kind == ALERT_ESCALATE ? "🚨" : (kind == ALERT_NO_SHOW ? "🚶" : "🔔"), msg);
+        return;
+    }
+    /* not waiting anywhere any more: nothing to do */
+    alerts_forget(a, p);
+}
+
+/* ============================================
+   RE-TRIAGE: change severity of a waiting patient
+   ============================================ */
+static void retriage_patient(Department *dept, PatientAlerts *alerts) {
+    PriorityQueue *q = &dept->q;
+    int pid = 0, sev = 0;
+    if (!read_int("Enter Patient ID: ", &pid)) return;
+    dept_lock(dept);
+    Patient *p = pq_search_by_id(q, pid);
+    int before = p ? pq_position(q, p) : 0;
+    dept_unlock(dept);
+    if (!p) {
+        printf("❌ Patient ID %d not found in queue\n", pid);
+        return;
+    }
+    if (!read_int("New severity (0=Normal,1=Serious,2=Critical): ", &sev)) return;
+    /* looked up again: an alert may have moved the patient during the prompt */
+    dept_lock(dept);
+    p = pq_search_by_id(q, pid);
+    int ok = p && pq_update_severity(q, p, (Severity)sev);
+    if (ok) alerts_retriaged(alerts, p);
+    int after = ok ? pq_position(q, p) : 0;
+    dept_unlock(dept);
+    if (!p) {
+        printf("❌ Patient ID %d is no longer waiting\n", pid);
+        return;
+    }
+    if (!ok) {
+        printf("❌ Invalid severity\n");
+        return;
+    }
+    printf("✅ Patient %d re-triaged: position #%d -> #%d\n", pid, before, after);
 }
 
 /* ============================================
@@ -441,37 +861,17 @@ static void show_queue_position(PriorityQueue *q, int patient_id) {
    (ML-powered with fallback heuristic)
    ============================================ */
 static int predict_wait_time(PriorityQueue *q, int severity) {
-    FILE *f = fopen("data/served.csv", "r");
-    
-    int total_queue = pq_size(q);
-    long historical_wait[3] = {0, 0, 0};
-    int count[3] = {0, 0, 0};
-    char line[1024];
-    
-    if (f) {
-        fgets(line, sizeof(line), f);
-        
-        while (fgets(line, sizeof(line), f)) {
-            int sev;
-            long wait;
-            if (sscanf(line, "%*d,%*lld,%*[^,],%*d,%d,%*[^,],%*[^,],%ld", &sev, &wait) == 2) {
-                if (sev >= 0 && sev <= 2) {
-                    historical_wait[sev] += wait;
-                    count[sev]++;
-                }
-            }
-        }
-        fclose(f);
+    const Analytics *a = served_analytics();
+    long long historical_wait[3] = {0, 0, 0};
+    long count[3] = {0, 0, 0};
+    if (a) {
+        memcpy(historical_wait, a->sev_wait, sizeof(historical_wait));
+        memcpy(count, a->sev_count, sizeof(count));
     }
     
-    int critical_in_queue = 0, serious_in_queue = 0, normal_in_queue = 0;
-    Patient *cur = q->head;
-    while (cur) {
-        if (cur->severity == 2) critical_in_queue++;
-        else if (cur->severity == 1) serious_in_queue++;
-        else normal_in_queue++;
-        cur = cur->next;
-    }
+    int by_sev[3];
+    pq_count_by_severity(q, by_sev);
+    int critical_in_queue = by_sev[CRITICAL], serious_in_queue = by_sev[SERIOUS], normal_in_queue = by_sev[NORMAL];
     
     int predicted_wait = 0;
     
@@ -507,33 +907,20 @@ static int predict_wait_time(PriorityQueue *q, int severity) {
    FEATURE 4: PEAK HOURS DETECTION 📈
    ============================================ */
 static void detect_peak_hours(void) {
-    FILE *f = fopen("data/served.csv", "r");
-    if (!f) {
+    const Analytics *a = served_analytics();
+    if (!a) {
         printf("No historical data available\n");
         return;
     }
-    
-    int hourly_count[24] = {0};
-    char line[1024];
-    fgets(line, sizeof(line), f);
-    
-    while (fgets(line, sizeof(line), f)) {
-        char arrival[64];
-        int hour = 0;
-        if (sscanf(line, "%*d,%*lld,%*[^,],%*d,%*d,%63[^,]", arrival) == 1) {
-            if (sscanf(arrival, "%*d-%*d-%*d %d:", &hour) == 1 && hour >= 0 && hour < 24) {
-                hourly_count[hour]++;
-            }
-        }
-    }
-    fclose(f);
+    const long *hourly_count = a->hour_count;
     
     printf("\n");
     printf("╔════════════════════════════════════════════╗\n");
     printf("║     📈 PEAK HOURS ANALYSIS                 ║\n");
     printf("╚════════════════════════════════════════════╝\n\n");
     
-    int max_hour = 0, max_patients = 0;
+    int max_hour = 0;
+    long max_patients = 0;
     for (int i = 0; i < 24; i++) {
         if (hourly_count[i] > max_patients) {
             max_patients = hourly_count[i];
@@ -541,14 +928,14 @@ static void detect_peak_hours(void) {
         }
     }
     
-    printf("  🔴 Peak Hour: %02d:00 (%d patients)\n", max_hour, max_patients);
+    printf("  🔴 Peak Hour: %02d:00 (%ld patients)\n", max_hour, max_patients);
     printf("  ⚠️  Staffing Alert: Consider adding staff!\n");
     printf("  📊 Hours Summary:\n");
     
     for (int i = 0; i < 24; i += 3) {
         printf("    ");
         for (int j = i; j < i + 3 && j < 24; j++) {
-            printf("%02d:00(%d) ", j, hourly_count[j]);
+            printf("%02d:00(%ld) ", j, hourly_count[j]);
         }
         printf("\n");
     }
@@ -559,8 +946,8 @@ static void detect_peak_hours(void) {
    FEATURE 5: STAFF PERFORMANCE METRICS 👨‍⚕️
    ============================================ */
 static void show_staff_performance(void) {
-    FILE *f = fopen("data/served.csv", "r");
-    if (!f) {
+    const Analytics *a = served_analytics();
+    if (!a) {
         printf("No performance data available\n");
         return;
     }
@@ -570,41 +957,44 @@ static void show_staff_performance(void) {
     printf("║      👨‍⚕️  STAFF PERFORMANCE METRICS                    ║\n");
     printf("╚═══════════════════════════════════════════════════════╝\n\n");
     
-    int total_served = 0;
-    long total_wait = 0;
-    char line[1024];
-    
-    fgets(line, sizeof(line), f);
-    while (fgets(line, sizeof(line), f)) {
-        long wait;
-        if (sscanf(line, "%*d,%*lld,%*[^,],%*d,%*d,%*[^,],%*[^,],%ld", &wait) == 1) {
-            total_served++;
-            total_wait += wait;
-        }
-    }
-    fclose(f);
-    
+    long long total_wait = 0;
+    long total_served = analytics_total(a, &total_wait);
     if (total_served == 0) {
         printf("  No performance data yet\n\n");
         return;
     }
     
-    double avg_wait = (double)total_wait / total_served / 60.0;
-    
-    printf("  👤 Dr. Smith         | Served: 42  | Avg Wait: 8.5 min  | ⭐⭐⭐⭐⭐\n");
-    printf("  👤 Dr. Johnson       | Served: 38  | Avg Wait: 10.2 min | ⭐⭐⭐⭐\n");
-    printf("  👤 Nurse Patel       | Served: 45  | Avg Wait: 7.8 min  | ⭐⭐⭐⭐⭐\n");
-    printf("  👤 Dr. Sharma        | Served: 35  | Avg Wait: 9.1 min  | ⭐⭐⭐⭐\n\n");
+    /* one row per doctor counter; counter 0 rows were served on the spot */
+    long service_n = 0;
+    long long service_sum = 0;
+    for (int c = 0; c < ANALYTICS_MAX_STAFF; ++c) {
+        const AnalyticsStaff *st = &a->staff[c];
+        if (st->served == 0) continue;
+        service_n += st->service_n;
+        service_sum += st->service_sum;
+        if (c == 0) printf("  👤 On the spot       ");
+        else printf("  👤 Counter %-9d", c);
+        printf(" | Served: %-6ld | Avg Wait: %6.1f min", st->served, (double)st->wait_sum / st->served / 60.0);
+        if (st->service_n) printf(" | Avg Service: %5.1f min\n", (double)st->service_sum / st->service_n / 60.0);
+        else printf(" | Avg Service: -\n");
+    }
     
-    printf("  📊 Overall Statistics:\n");
-    printf("     Total Patients Served: %d\n", total_served);
-    printf("     Average Wait Time: %.2f min\n", avg_wait);
-    printf("     System Efficiency: %.1f%%\n\n", 95.5);
+    printf("\n  📊 Overall Statistics:\n");
+    printf("     Total Patients Served: %ld\n", total_served);
+    printf("     Average Wait Time: %.2f min\n", (double)total_wait / total_served / 60.0);
+    if (service_n) printf("     Average Service Time: %.2f min\n", (double)service_sum / service_n / 60.0);
+    printf("\n");
 }
 
 /* ============================================
    FEATURE 6: EMERGENCY BYPASS 🚨
    ============================================ */
+static void list_critical(void *ctx, const Patient *p) {
+    if (p->severity != CRITICAL) return;
+    printf("  ⚡ CRITICAL Patient ID %d: %s\n", p->id, p->name);
+    (*(int*)ctx)++;
+}
+
 static void emergency_bypass(PriorityQueue *q) {
     if (pq_is_empty(q)) {
         printf("No patients in queue\n");
@@ -618,15 +1008,8 @@ static void emergency_bypass(PriorityQueue *q) {
     
     int count = 0;
     int total = pq_size(q);
-    Patient *cur = q->head;
-    
-    while (cur) {
-        if (cur->severity == 2) {
-            printf("  ⚡ CRITICAL Patient ID %d: %s\n", cur->id, cur->name);
-            count++;
-        }
-        cur = cur->next;
-    }
+    /* spilled critical patients are listed too, read in place */
+    pq_arrival_walk(q, list_critical, &count);
     
     if (count == 0) {
         printf("  ℹ️  No critical patients in queue\n\n");
@@ -638,8 +1021,8 @@ static void emergency_bypass(PriorityQueue *q) {
 /* ============================================
    FEATURE 7: VISUAL QUEUE DISPLAY 📋
    ============================================ */
-static void view_queue_visual(PriorityQueue *q) {
-    if (pq_is_empty(q)) {
+static void view_queue_visual(const QueueSnapshot *s) {
+    if (qsnap_size(s) == 0) {
         printf("Queue is empty\n");
         return;
     }
@@ -651,17 +1034,16 @@ static void view_queue_visual(PriorityQueue *q) {
     
     printf("  QUEUE ORDER:\n\n");
     
-    int total = pq_size(q);
-    int i = 0;
-    Patient *cur = q->head;
+    int total = qsnap_size(s);
+    const PatientRecord *top[10];
+    int shown = qsnap_ordered(s, top, 10);
     
-    while (cur && i < 10) {
+    for (int i = 0; i < shown; i++) {
+        const PatientRecord *cur = top[i];
         const char *sev_icon = cur->severity == 2 ? "🔴" : 
                                cur->severity == 1 ? "🟠" : "🟢";
         printf("  %s [#%d] %s (ID: %d, Age: %d)\n", 
                sev_icon, i + 1, cur->name, cur->id, cur->age);
-        cur = cur->next;
-        i++;
     }
     
     if (total > 10) {
@@ -674,8 +1056,8 @@ static void view_queue_visual(PriorityQueue *q) {
    FEATURE 8: DAILY REPORT GENERATOR 📑
    ============================================ */
 static void generate_daily_report(void) {
-    FILE *f = fopen("data/served.csv", "r");
-    if (!f) {
+    const Analytics *a = served_analytics();
+    if (!a) {
         printf("No data available\n");
         return;
     }
@@ -685,34 +1067,31 @@ static void generate_daily_report(void) {
     printf("║       📑 DAILY PERFORMANCE REPORT          ║\n");
     printf("╚════════════════════════════════════════════╝\n\n");
     
-    int total = 0, critical = 0, serious = 0, normal = 0;
-    long total_wait = 0;
-    char line[1024];
-    
-    fgets(line, sizeof(line), f);
-    while (fgets(line, sizeof(line), f)) {
-        int sev;
-        long wait;
-        if (sscanf(line, "%*d,%*lld,%*[^,],%*d,%d,%*[^,],%*[^,],%ld", &sev, &wait) == 2) {
-            total++;
-            total_wait += wait;
-            if (sev == 2) critical++;
-            else if (sev == 1) serious++;
-            else normal++;
-        }
-    }
-    fclose(f);
+    long long total_wait = 0;
+    long total = analytics_total(a, &total_wait);
+    long critical = a->sev_count[CRITICAL], serious = a->sev_count[SERIOUS], normal = a->sev_count[NORMAL];
     
-    printf("  📊 Total Patients: %d\n", total);
-    printf("  🔴 Critical: %d (%.1f%%)\n", critical, total ? (critical*100.0/total) : 0);
-    printf("  🟠 Serious: %d (%.1f%%)\n", serious, total ? (serious*100.0/total) : 0);
-    printf("  🟢 Normal: %d (%.1f%%)\n\n", normal, total ? (normal*100.0/total) : 0);
+    printf("  📊 Total Patients: %ld\n", total);
+    printf("  🔴 Critical: %ld (%.1f%%)\n", critical, total ? (critical*100.0/total) : 0);
+    printf("  🟠 Serious: %ld (%.1f%%)\n", serious, total ? (serious*100.0/total) : 0);
+    printf("  🟢 Normal: %ld (%.1f%%)\n\n", normal, total ? (normal*100.0/total) : 0);
     
     if (total > 0) {
         printf("  ⏱️  Average Wait Time: %.2f minutes\n", (double)total_wait / total / 60.0);
         printf("  ✅ System Efficiency: 92.5%%\n");
         printf("  🎯 Patient Satisfaction: 4.7/5.0 ⭐\n\n");
     }
+    
+    if (a->ndays > 0) {
+        printf("  📅 Last %d day(s):\n", a->ndays < 7 ? a->ndays : 7);
+        for (int i = a->ndays > 7 ? a->ndays - 7 : 0; i < a->ndays; ++i) {
+            const AnalyticsDay *d = &a->days[i];
+            printf("     %s  %6ld patients (🔴 %ld 🟠 %ld 🟢 %ld)  avg wait %.1f min\n", d->date, d->count,
+                   d->by_sev[CRITICAL], d->by_sev[SERIOUS], d->by_sev[NORMAL],
+                   d->count ? (double)d->wait_sum / d->count / 60.0 : 0.0);
+        }
+        printf("\n");
+    }
 }
 
 /* ============================================
@@ -721,7 +1100,10 @@ static void generate_daily_report(void) {
 static void patient_journey_tracker(void) {
     int patient_id = 0;
     if (!read_int("Enter Patient ID: ", &patient_id)) return;
-    
+    show_patient_journey(patient_id);
+}
+
+static void show_patient_journey(int patient_id) {
     printf("\n");
     printf("╔════════════════════════════════════════════╗\n");
     printf("║      🛤️  PATIENT JOURNEY TRACKER           ║\n");
@@ -764,6 +1146,17 @@ static void patient_journey_tracker(void) {
 /* ============================================
    FEATURE 10: SYSTEM HEALTH CHECK ✅
    ============================================ */
+static void print_bytes(const char *label, uint64_t bytes) {
+    if (bytes >= (1ULL << 30)) printf("%s%.1f GB", label, (double)bytes / (1ULL << 30));
+    else printf("%s%.0f MB", label, (double)bytes / (1ULL << 20));
+}
+
+static void print_latency(uint64_t ns) {
+    if (ns >= 1000000000ULL) printf(" %8.2fs ", (double)ns / 1e9);
+    else if (ns >= 1000000ULL) printf(" %7.2fms ", (double)ns / 1e6);
+    else printf(" %7.2fus ", (double)ns / 1e3);
+}
+
 static void system_health_check(void) {
     printf("\n");
     printf("╔════════════════════════════════════════════╗\n");
@@ -773,16 +1166,75 @@ static void system_health_check(void) {
     int queue_ok = access("data/queue.csv", F_OK) == 0 ? 1 : 0;
     int served_ok = access("data/served.csv", F_OK) == 0 ? 1 : 0;
     int users_ok = access("data/users.csv", F_OK) == 0 ? 1 : 0;
+    int healthy = users_ok;
     
     printf("  📁 Queue Database: %s\n", queue_ok ? "✅ OK" : "❌ Error");
     printf("  📁 Served Records: %s\n", served_ok ? "✅ OK" : "❌ Error");
     printf("  🔐 Users Database: %s\n", users_ok ? "✅ OK" : "❌ Error");
-    printf("  💾 Storage: ✅ OK (1.2 GB available)\n");
-    printf("  🌐 Network: ✅ OK (Connected)\n");
-    printf("  ⚙️  API Status: ✅ Running\n");
-    printf("  📊 CPU Usage: 15%% (Normal)\n");
-    printf("  🧠 Memory Usage: 28%% (Normal)\n\n");
-    printf("  ✅ OVERALL SYSTEM STATUS: HEALTHY\n\n");
+
+    DiskStats disk;
+    metrics_disk("data", &disk);
+    if (disk.ok) {
+        int low = disk.free_bytes < HEALTH_MIN_FREE_DISK;
+        print_bytes(low ? "  💾 Storage: ⚠️  LOW (" : "  💾 Storage: ✅ OK (", disk.free_bytes);
+        print_bytes(" free of ", disk.total_bytes);
+        printf(")\n");
+        if (low) healthy = 0;
+    } else {
+        printf("  💾 Storage: unknown\n");
+    }
+
+    /* CPU share since the previous check (or since start) */
+    static double last_cpu = 0.0, last_wall = 0.0;
+    ProcessStats ps;
+    metrics_process(&ps);
+    double cpu = ps.cpu_user_sec + ps.cpu_sys_sec;
+    double wall = ps.uptime_sec - last_wall;
+    if (wall >= 1.0)
+        printf("  📊 CPU: %.1f%% over the last %.0f s", (cpu - last_cpu) * 100.0 / wall, wall);
+    else
+        printf("  📊 CPU:");
+    printf(" (%.2f s user, %.2f s system in total, %d threads)\n", ps.cpu_user_sec, ps.cpu_sys_sec, ps.threads);
+    last_cpu = cpu;
+    last_wall = ps.uptime_sec;
+    if (ps.ok) {
+        double share = ps.rss_kb * 100.0 / (double)ps.mem_total_kb;
+        printf("  🧠 Memory: %.1f MB resident (peak %.1f MB), %.2f%% of RAM, %.0f MB available\n",
+               ps.rss_kb / 1024.0, ps.peak_rss_kb / 1024.0, share, ps.mem_available_kb / 1024.0);
+        if (ps.mem_available_kb >= 0 && ps.mem_available_kb < HEALTH_MIN_FREE_MEM_KB) healthy = 0;
+    } else {
+        printf("  🧠 Memory: unknown\n");
+    }
+    printf("  ⏳ Uptime: %.0f min\n\n", ps.uptime_sec / 60.0);
+
+    printf("  %-13s %10s %10s %10s %10s %10s\n", "Operation", "Calls", "Mean", "p50", "p99", "Max");
+    for (int id = 0; id < MET_COUNT; ++id) {
+        MetricSummary m;
+        metrics_read((MetricId)id, &m);
+        printf("  %-13s %10llu", metrics_name((MetricId)id), (unsigned long long)m.count);
+        if (m.timed == 0) { printf("          -          -          -          -\n"); continue; }
+        print_latency(m.mean_ns);
+        print_latency(m.p50_ns);
+        print_latency(m.p99_ns);
+        print_latency(m.max_ns);
+        printf("\n");
+    }
+    printf("  (enqueue/dequeue latency sampled 1 in %d calls)\n\n", METRICS_HOT_SAMPLE);
+
+    printf("  %s OVERALL SYSTEM STATUS: %s\n\n", healthy ? "✅" : "⚠️ ", healthy ? "HEALTHY" : "NEEDS ATTENTION");
+}
+
+int controller_run_report(const char *name, PriorityQueue *q, int arg) {
+    if (!name) return 0;
+    if (strcmp(name, "served_history") == 0) print_served_history(arg > 0 ? arg : 0, 0);
+    else if (strcmp(name, "avg_waits") == 0) show_avg_waits();
+    else if (strcmp(name, "predict_wait") == 0 && q) printf("%d\n", predict_wait_time(q, arg));
+    else if (strcmp(name, "peak_hours") == 0) detect_peak_hours();
+    else if (strcmp(name, "staff_performance") == 0) show_staff_performance();
+    else if (strcmp(name, "daily_report") == 0) generate_daily_report();
+    else if (strcmp(name, "patient_journey") == 0) show_patient_journey(arg);
+    else return 0;
+    return 1;
 }
 
 /* Main application loop */
@@ -791,6 +1243,8 @@ int main_loop() {
     #if defined(_WIN32)
     system("chcp 65001 >nul 2>&1");
     #endif
+    /* the menu prompt polls stdin, which must not hide lines in a buffer */
+    setvbuf(stdin, NULL, _IONBF, 0);
 
     if (!ensure_data_dir("data")) {
         fprintf(stderr, "Could not create or access data directory \"data\"\n");
@@ -806,72 +1260,108 @@ int main_loop() {
         return 1;
     }
 
-    PriorityQueue q;
-    pq_init(&q);
+    /* everything between login and the first menu */
+    TRACE_BEGIN(startup);
+    PqPolicy policy;
+    pq_policy_from_env(&policy);
+
+    QueueRegistry reg;
+    registry_init(&reg);
+    registry_add_from_env(&reg, &policy);
+
+    Dispatcher disp;
+    dispatch_init(&disp, dispatch_counters_from_env(), HISTORY_FILE);
+    dispatch_load_history(&disp);
+
+    int nextId = history_next_id(DATA_FILE, HISTORY_FILE);
+    registry_load_all(&reg, &nextId);
+    Department *dept = registry_get(&reg, 0);
+    PriorityQueue *q = &dept->q;
+
+    /* one waiting-room feed per department, refreshed every second */
+    DisplayPublisher displays[REGISTRY_MAX_DEPTS];
+    int display_on = display_enabled_from_env();
+    for (int i = 0; i < registry_count(&reg); ++i) {
+        Department *d = registry_get(&reg, i);
+        char shm_name[64];
+        displays[i].feed = NULL;
+        display_feed_name(d->name, d->is_default, shm_name, sizeof(shm_name));
+        if (display_on) display_publisher_open(&displays[i], shm_name);
+    }
 
-    int nextId = get_next_id_from_files();
-    pq_load_csv(&q, DATA_FILE, &nextId);
+    /* change-data capture: tapped after loading, so only new changes stream */
+    CdcStream *cdc = cdc_open_from_env();
+    CdcTap cdc_taps[REGISTRY_MAX_DEPTS];
+    for (int i = 0; i < registry_count(&reg); ++i) {
+        Department *d = registry_get(&reg, i);
+        cdc_tap_queue(&cdc_taps[i], cdc, d->name, &d->q);
+    }
+    disp.cdc = cdc;
+    if (cdc) printf("Streaming change events to %s\n", getenv("HOSP_CDC"));
+
+    /* name search index: built on the first search, then kept current */
+    PatientIndex pidx;
+    pidx_init(&pidx);
+    PidxTap pidx_taps[REGISTRY_MAX_DEPTS];
+    for (int i = 0; i < registry_count(&reg); ++i) {
+        Department *d = registry_get(&reg, i);
+        pidx_tap_queue(&pidx_taps[i], &pidx, d->name, &d->q);
+    }
+
+    /* date index of served.csv for ad-hoc queries, grown as they read it */
+    QueryIndex qindex;
+    query_index_init(&qindex);
+
+    /* Prometheus endpoint: reads counters the queues keep, never their locks */
+    PromExporter *prom = prom_open_from_env();
+    PromQueue *prom_q[REGISTRY_MAX_DEPTS] = { NULL };
+    for (int i = 0; prom && i < registry_count(&reg); ++i) {
+        Department *d = registry_get(&reg, i);
+        dept_lock(d);
+        prom_q[i] = prom_track_queue(prom, d->name, &d->q);
+        dept_unlock(d);
+    }
+    if (prom) printf("Serving Prometheus metrics on %s (GET /metrics)\n", getenv("HOSP_METRICS_LISTEN"));
+
+    char policy_desc[96];
+    printf("Priority policy: %s\n", pq_policy_describe(&policy, policy_desc, sizeof(policy_desc)));
+
+    PatientAlerts alerts;
+    AlertConfig acfg;
+    alerts_config_from_env(&acfg, &policy);
+    alerts_init(&alerts, &acfg, on_patient_alert, &reg);
+    for (int i = 0; i < registry_count(&reg); ++i) alerts_track_queue(&alerts, &registry_get(&reg, i)->q);
 
     int totalAdded = 0, served = 0;
+    TRACE_END(startup, "startup");
+
+    ConsoleTick tick = { &alerts, &reg, &disp, display_on ? displays : NULL };
 
     for (;;) {
-        printf("\n╔════════════════════════════════════════════╗\n");
-        printf("║          MAIN MENU                         ║\n");
-        printf("╚════════════════════════════════════════════╝\n\n");
-        printf("  1.  ➕ Register Patient\n");
-        printf("  2.  📋 View Waiting List\n");
-        printf("  3.  📞 Call Next Patient\n");
-        printf("  4.  👀 Peek Next Patient\n");
-        printf("  5.  🔍 Search Patient\n");
-        printf("  6.  💾 Save Queue\n");
-        printf("  7.  📊 View Statistics\n");
-        printf("  8.  🗑️  Clear Queue\n");
-        printf("  9.  📜 View Served History\n");
-        printf("  10. ⏱️  Average Serving Times\n");
-        printf("  11. 📊 Queue Analytics (NEW)\n");
-        printf("  12. 🎯 Check Queue Position (NEW)\n");
-        printf("  13. 🤖 Predict Wait Time (NEW - ML)\n");
-        printf("  14. 📈 Peak Hours Analysis (NEW)\n");
-        printf("  15. 👨‍⚕️ Staff Performance (NEW)\n");
-        printf("  16. 🚨 Emergency Bypass (NEW)\n");
-        printf("  17. 📋 Visual Queue (NEW)\n");
-        printf("  18. 📑 Daily Report (NEW)\n");
-        printf("  19. 🛤️  Patient Journey (NEW)\n");
-        printf("  20. ✅ System Health Check (NEW)\n");
-        printf("  21. 🚪 Exit\n\n");
-        
+        console_tick(&tick);
+        for (int i = 0; prom && i < registry_count(&reg); ++i) {
+            Department *d = registry_get(&reg, i);
+            dept_lock(d);
+            prom_refresh(prom_q[i], &d->q);
+            dept_unlock(d);
+        }
+        view_render_main_menu(view_buffer(), dept->name);
+        view_flush();
+
         int ch;
-        if (!read_int("Enter choice: ", &ch)) break;
+        /* alerts keep firing while the desk sits at the prompt */
+        if (!read_int_ticking("Enter choice: ", &ch, console_tick, &tick)) break;
 
         if (ch == 1) {
             char name[NAME_LEN] = {0}, problem[PROB_LEN] = {0};
-            int age = 0, sev = 0;
+            int age = -1, sev = 0;
             long long phone_number = 0;
             char phone_buf[64];
             int phone_attempts = 0;
 
-            printf("Enter name: ");
-            if (!read_line(name, sizeof(name))) break;
-
-            if (!read_int("Enter age: ", &age)) break;
-
-            printf("Enter problem/notes: ");
-            if (!read_line(problem, sizeof(problem))) break;
-
+            /* phone first: a returning patient's details come from their last visit */
             while (1) {
-                if (!read_int("Severity (0=Normal,1=Serious,2=Critical): ", &sev)) {
-                    sev = 0;
-                    break;
-                }
-                if (sev < 0 || sev > 2) {
-                    printf("Invalid severity, try again.\n");
-                    continue;
-                }
-                break;
-            }
-
-            while (1) {
-                printf("Enter patient's phone number (accepts +91 / 0 / plain): ");
+                printf("Enter patient's phone number (accepts +91 / 0 / plain, Enter = none): ");
                 if (!read_line(phone_buf, sizeof(phone_buf))) {
                     phone_number = 0;
                     break;
@@ -890,6 +1380,41 @@ int main_loop() {
                     break;
                 }
             }
+            if (phone_number && !check_returning_patient(&pidx, pidx_taps, &reg, phone_number, name, sizeof(name), &age)) {
+                printf("Registration cancelled\n");
+                continue;
+            }
+
+            if (name[0]) {
+                printf("Name: %s, age %d\n", name, age);
+            } else {
+                printf("Enter name: ");
+                if (!read_line(name, sizeof(name))) break;
+
+                if (!read_int("Enter age: ", &age)) break;
+            }
+
+            printf("Enter problem/notes: ");
+            if (!read_line(problem, sizeof(problem))) break;
+
+            while (1) {
+                if (!read_int("Severity (0=Normal,1=Serious,2=Critical): ", &sev)) {
+                    sev = 0;
+                    break;
+                }
+                if (sev < 0 || sev > 2) {
+                    printf("Invalid severity, try again.\n");
+                    continue;
+                }
+                break;
+            }
+
+            unsigned flags = 0;
+            if (q->policy.factors & PQ_FACTOR_PREGNANCY) {
+                char yn[8];
+                printf("Pregnant? (y/N): ");
+                if (read_line(yn, sizeof(yn)) && (yn[0] == 'y' || yn[0] == 'Y')) flags |= PATIENT_PREGNANT;
+            }
 
             char now[TIME_LEN] = {0};
             get_now_iso(now, sizeof(now));
@@ -898,7 +1423,12 @@ int main_loop() {
             if (!p) {
                 printf("Failed to create patient\n");
             } else {
-                pq_enqueue(&q, p);
+                p->flags = flags;
+                dept_lock(dept);
+                pq_enqueue(q, p);
+                alerts_track(&alerts, p);
+                dept->registered++;
+                dept_unlock(dept);
                 totalAdded++;
                 printf("\n✅ Patient registered with ID %d\n\n", p->id);
                 view_show_patient(p);
@@ -908,75 +1438,68 @@ int main_loop() {
             }
 
         } else if (ch == 2) {
-            view_show_list(&q);
+            dept_lock(dept);
+            QueueSnapshot *snap = pq_snapshot(q);
+            dept_unlock(dept);
+            view_show_snapshot(snap);
+            qsnap_release(snap);
 
         } else if (ch == 3) {
-            Patient *p = pq_dequeue(&q);
-            if (p) {
-                printf("\n📞 CALLING NEXT PATIENT:\n\n");
-                view_show_patient(p);
-
-                char served_iso[TIME_LEN];
-                get_now_iso(served_iso, sizeof(served_iso));
-                time_t t_serv = parse_iso_time(served_iso);
-                time_t t_arr = parse_iso_time(p->arrival);
-                long wait_sec = (t_serv != (time_t)-1 && t_arr != (time_t)-1)
-                                ? (long)(t_serv - t_arr)
-                                : 0;
-                save_served_record(p, served_iso, wait_sec);
-
-                free_patient(p);
-                served++;
-                printf("\n✅ Patient serviced successfully\n");
-            } else {
+            dept_lock(dept);
+            int empty = pq_is_empty(q);
+            Counter *c = empty ? NULL : dispatch_call_next(&disp, q, dept->name, time(NULL));
+            dept_unlock(dept);
+            if (empty) {
                 printf("❌ No patients to serve\n");
+            } else {
+                if (c) {
+                    alerts_forget(&alerts, c->current);
+                    printf("\n📞 CALLING NEXT PATIENT TO COUNTER %d:\n\n", c->id);
+                    view_show_patient(c->current);
+                    printf("✅ Service started; complete it with option 23\n");
+                } else {
+                    printf("❌ All %d counters are busy; complete a service first (option 23)\n", disp.n);
+                }
             }
 
         } else if (ch == 4) {
-            Patient *p = pq_peek(&q);
-            if (p) {
-                printf("\n👀 NEXT PATIENT:\n\n");
-                view_show_patient(p);
-            } else {
-                printf("Queue is empty\n");
-            }
+            /* the head may be spilled: shown in place, not read back */
+            dept_lock(dept);
+            int shown = pq_service_walk(q, 1, show_next, NULL);
+            dept_unlock(dept);
+            if (shown <= 0) printf("Queue is empty\n");
 
         } else if (ch == 5) {
             int s = 0;
-            if (!read_int("Search by (1) ID or (2) name? ", &s)) continue;
+            if (!read_int("Search by (1) ID, (2) name or (3) name, typo-tolerant? ", &s)) continue;
 
             if (s == 1) {
                 int id = 0;
                 if (!read_int("Enter ID: ", &id)) continue;
 
-                Patient *p = pq_search_by_id(&q, id);
-                if (p) {
-                    printf("\n[STATUS: WAITING IN QUEUE]\n\n");
-                    view_show_patient(p);
-                    continue;
-                }
+                dept_lock(dept);
+                int waiting = pq_view_by_id(q, id, show_waiting, NULL);
+                dept_unlock(dept);
+                if (waiting) continue;
 
                 FILE *f = fopen("data/served.csv", "r");
                 if (f) {
                     char line[1024];
                     fgets(line, sizeof(line), f);
 
-                    int rid, age, sev;
-                    long long phone;
-                    char name[128], arrival[64], served_at[64], problem[256];
-                    long wait;
+                    ServedRecord r;
                     int found = 0;
 
                     while (fgets(line, sizeof(line), f)) {
-                        int r = sscanf(line, "%d,%lld,%127[^,],%d,%d,%63[^,],%63[^,],%ld,%255[^\n]",
-                                       &rid, &phone, name, &age, &sev, arrival, served_at, &wait, problem);
-                        if (r >= 9 && rid == id) {
+                        if (history_parse_line(line, &r) && r.id == id) {
                             found = 1;
-                            const char *sev_str = sev == 2 ? "CRITICAL" : (sev == 1 ? "SERIOUS" : "NORMAL");
+                            const char *sev_str = r.severity == 2 ? "CRITICAL" : (r.severity == 1 ? "SERIOUS" : "NORMAL");
                             printf("\n[STATUS: ALREADY SERVED]\n\n");
-                            printf("ID: %d\nPhone: %lld\nName: %s\nAge: %d\n", rid, phone, name, age);
-                            printf("Severity: %s\nArrival: %s\nServed At: %s\n", sev_str, arrival, served_at);
-                            printf("Wait Time: %.2f min\nProblem: %s\n\n", (double)wait / 60.0, problem);
+                            printf("ID: %d\nPhone: %lld\nName: %s\nAge: %d\n", r.id, r.phone, r.name, r.age);
+                            printf("Severity: %s\nArrival: %s\nServed At: %s\n", sev_str, r.arrival, r.served_at);
+                            if (r.counter_id > 0)
+                                printf("Service End: %s\nCounter: %d\n", r.service_end, r.counter_id);
+                            printf("Wait Time: %.2f min\nProblem: %s\n\n", (double)r.wait_sec / 60.0, r.problem);
                             break;
                         }
                     }
@@ -986,63 +1509,44 @@ int main_loop() {
                 printf("Patient ID %d not found\n\n", id);
 
             } else if (s == 2) {
-                char key[64] = {0};
-                printf("Enter name or part of name: ");
-                if (!read_line(key, sizeof(key))) continue;
-
-                Patient *p = pq_search_by_name(&q, key);
-                if (p) {
-                    printf("\n[STATUS: WAITING IN QUEUE]\n\n");
-                    view_show_patient(p);
-                    continue;
-                }
-
-                FILE *f = fopen("data/served.csv", "r");
-                if (f) {
-                    char line[1024];
-                    fgets(line, sizeof(line), f);
-
-                    int rid, age, sev;
-                    long long phone;
-                    char name[128], arrival[64], served_at[64], problem[256];
-                    long wait;
-                    int found = 0;
-
-                    printf("\n[SERVED PATIENTS - MATCHING '%s']\n\n", key);
-                    printf("%-4s | %-20s | %-8s | %-9s | %-12s\n",
-                           "ID", "Name", "Severity", "Wait(min)", "Phone");
-                    printf("----------------------------------------------------------------------\n");
-
-                    while (fgets(line, sizeof(line), f)) {
-                        int r = sscanf(line, "%d,%lld,%127[^,],%d,%d,%63[^,],%63[^,],%ld,%255[^\n]",
-                                       &rid, &phone, name, &age, &sev, arrival, served_at, &wait, problem);
-                        if (r >= 9 && strstr(name, key)) {
-                            found = 1;
-                            const char *sev_str = sev == 2 ? "CRITICAL" : (sev == 1 ? "SERIOUS" : "NORMAL");
-                            printf("%-4d | %-20s | %-8s | %-9.2f | %lld\n",
-                                   rid, name, sev_str, (double)wait / 60.0, phone);
-                        }
-                    }
-                    fclose(f);
-                    if (found) {
-                        printf("\n");
-                        continue;
-                    }
-                }
-                printf("No patients found matching '%s'\n\n", key);
+                search_by_name(&pidx, pidx_taps, &reg);
+            } else if (s == 3) {
+                fuzzy_search(&pidx, pidx_taps, &reg);
             }
 
         } else if (ch == 6) {
-            if (pq_save_csv(&q, DATA_FILE))
-                printf("✅ Saved to %s\n", DATA_FILE);
+            char path[256];
+            PromQueue *pq = NULL;
+            for (int i = 0; i < registry_count(&reg); ++i) if (registry_get(&reg, i) == dept) pq = prom_q[i];
+            registry_queue_path(dept, path, sizeof(path));
+            prom_save_begin(pq);
+            dept_lock(dept);
+            int ok = pq_save_csv(q, path);
+            dept_unlock(dept);
+            prom_save_end(pq, ok);
+            if (ok)
+                printf("✅ Saved to %s\n", path);
             else
                 printf("❌ Save failed\n");
 
         } else if (ch == 7) {
-            view_show_stats(totalAdded, served, &q);
+            dept_lock(dept);
+            view_show_stats(totalAdded, served, q);
+            dept_unlock(dept);
 
         } else if (ch == 8) {
-            clear_queue_with_confirmation(&q);
+            if (confirm("Are you sure? (y/n): ", 0)) {
+                /* one at a time so a queue observer sees every removal */
+                dept_lock(dept);
+                alerts_forget_queue(&alerts, q);
+                Patient *p;
+                while ((p = pq_peek(q)) != NULL) {
+                    pq_remove(q, p);
+                    free_patient(p);
+                }
+                dept_unlock(dept);
+                printf("Queue cleared\n");
+            }
 
         } else if (ch == 9) {
             view_served_history();
@@ -1051,7 +1555,11 @@ int main_loop() {
             show_avg_waits();
 
         } else if (ch == 11) {
-            show_queue_analytics(&q);
+            dept_lock(dept);
+            QueueSnapshot *snap = pq_snapshot(q);
+            dept_unlock(dept);
+            show_queue_analytics(snap);
+            qsnap_release(snap);
             printf("Press Enter to continue...");
             char __tmpbuf[8];
             read_line(__tmpbuf, sizeof(__tmpbuf));
@@ -1059,7 +1567,7 @@ int main_loop() {
         } else if (ch == 12) {
             int pid = 0;
             if (read_int("Enter Patient ID: ", &pid))
-                show_queue_position(&q, pid);
+                show_queue_position(dept, &disp, pid);
             char __tmpbuf[8];
             read_line(__tmpbuf, sizeof(__tmpbuf));
 
@@ -1079,18 +1587,28 @@ int main_loop() {
             const char *sev_name = sev == 2 ? "CRITICAL" : (sev == 1 ? "SERIOUS" : "NORMAL");
             printf("  Severity Level: %s\n", sev_name);
             printf("  Age: %d\n", age);
-            printf("  📊 Patients Ahead: %d\n\n", pq_size(&q));
+            dept_lock(dept);
+            int ahead = pq_size(q);
+            dept_unlock(dept);
+            printf("  📊 Patients Ahead: %d\n\n", ahead);
             
             char arrival_now[TIME_LEN];
             get_now_iso(arrival_now, sizeof(arrival_now));
+            uint64_t t_predict = metrics_begin(MET_PREDICT);
             int ml_wait = call_ml_predictor(sev, age, arrival_now);
+            int heur_wait = 0;
+            if (ml_wait <= 0) {
+                dept_lock(dept);
+                heur_wait = predict_wait_time(q, sev);
+                dept_unlock(dept);
+            }
+            metrics_end(MET_PREDICT, t_predict);
             
             if (ml_wait > 0) {
                 printf("  🧠 ML MODEL PREDICTION:\n");
                 printf("  ⏱️  PREDICTED WAIT TIME: ~%d minutes\n\n", ml_wait);
                 printf("  ✅ Model trained on historical records\n\n");
             } else {
-                int heur_wait = predict_wait_time(&q, sev);
                 printf("  ⚠️  ML model unavailable, using heuristic:\n");
                 printf("  ⏱️  ESTIMATED WAIT TIME: ~%d minutes\n\n", heur_wait);
                 printf("  💡 Tip: Train model with: python src/tools/wait_predictor.py train\n\n");
@@ -1112,13 +1630,19 @@ int main_loop() {
             read_line(__tmpbuf, sizeof(__tmpbuf));
 
         } else if (ch == 16) {
-            emergency_bypass(&q);
+            dept_lock(dept);
+            emergency_bypass(q);
+            dept_unlock(dept);
             printf("Press Enter to continue...");
             char __tmpbuf[8];
             read_line(__tmpbuf, sizeof(__tmpbuf));
 
         } else if (ch == 17) {
-            view_queue_visual(&q);
+            dept_lock(dept);
+            QueueSnapshot *snap = pq_snapshot(q);
+            dept_unlock(dept);
+            view_queue_visual(snap);
+            qsnap_release(snap);
             printf("Press Enter to continue...");
             char __tmpbuf[8];
             read_line(__tmpbuf, sizeof(__tmpbuf));
@@ -1142,15 +1666,51 @@ int main_loop() {
             read_line(__tmpbuf, sizeof(__tmpbuf));
 
         } else if (ch == 21) {
-            printf("\n🚪 Exiting... saving queue to %s\n", DATA_FILE);
-            pq_save_csv(&q, DATA_FILE);
-            pq_free_all(&q);
+            printf("\n🚪 Exiting... saving %d department queue(s)\n", registry_count(&reg));
+            dispatch_complete_all(&disp, time(NULL));
+            registry_save_all(&reg);
             break;
 
+        } else if (ch == 22) {
+            retriage_patient(dept, &alerts);
+
+        } else if (ch == 23) {
+            complete_service(&disp, &reg, &served);
+
+        } else if (ch == 24) {
+            show_counter_status(&disp, dept);
+
+        } else if (ch == 25) {
+            dept = switch_department(&reg, dept);
+            q = &dept->q;
+
+        } else if (ch == 26) {
+            transfer_patient(&reg, dept);
+
+        } else if (ch == 27) {
+            show_department_stats(&reg);
+
+        } else if (ch == 28) {
+            live_dashboard(&reg, dept, &disp, &tick);
+
+        } else if (ch == 29) {
+            query_patients(&qindex, &reg);
+
         } else {
             printf("❌ Invalid option\n");
         }
     }
 
+    for (int i = 0; display_on && i < registry_count(&reg); ++i) display_publisher_close(&displays[i], 1);
+    for (int i = 0; i < registry_count(&reg); ++i) cdc_untap_queue(&cdc_taps[i], &registry_get(&reg, i)->q);
+    cdc_close(cdc);
+    for (int i = 0; i < registry_count(&reg); ++i) pidx_untap_queue(&pidx_taps[i], &registry_get(&reg, i)->q);
+    pidx_free(&pidx);
+    query_index_free(&qindex);
+    if (report_stats_ready) analytics_free(&report_stats);
+    for (int i = 0; i < registry_count(&reg); ++i) prom_untrack_queue(prom_q[i], &registry_get(&reg, i)->q);
+    prom_close(prom);
+    alerts_destroy(&alerts);
+    registry_destroy(&reg);
     return 0;
 }
\ No newline at end of file
@@ -4,4 +4,13 @@
 // prototype for the main loop implemented in controller.c
 int main_loop(void);
 
+struct PriorityQueue;
+/* Run one served.csv report from the menu without prompting, e.g. for
+   bench/bench_suite.c. Reads data/served.csv under the working directory
+   and prints to stdout. name is served_history (arg = last N rows, 0 =
+   all), avg_waits, predict_wait (arg = severity), peak_hours,
+   staff_performance, daily_report or patient_journey (arg = patient ID).
+   Returns 0 for an unknown name. */
+int controller_run_report(const char *name, struct PriorityQueue *q, int arg);
+
 #endif // CONTROLLER_CONTROLLER_H
\ No newline at end of file
@@ -0,0 +1,397 @@
+/* SHA-256, HMAC-SHA256 and PBKDF2 shared by auth and gen_hash.
+   Input is compressed a whole 64-byte block at a time straight from the
+   caller's buffer; only a trailing partial block is copied into ctx->data.
+   The compression function is picked at runtime: x86 SHA-NI, ARMv8 SHA2
+   or the portable scalar code.
+*/
+#include "sha256.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__GNUC__) || defined(__clang__)
+#define SHA256_HAVE_SHANI 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+#endif
+
+/* The ARMv8 path needs the compiler to target the crypto extension,
+   e.g. CFLAGS += -march=armv8-a+crypto */
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#define SHA256_HAVE_ARMV8 1
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+typedef void (*sha256_blocks_fn)(uint32_t state[8], const uint8_t *data, size_t nblocks);
+
+static const uint32_t K[64] = {
+  0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+  0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+  0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+  0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+  0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+  0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+  0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+  0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
+};
+
+static const uint32_t H0[8] = {
+  0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19
+};
+
+/* ---------- scalar backend ---------- */
+
+static inline uint32_t rotr(uint32_t x, uint32_t n){ return (x >> n) | (x << (32-n)); }
+static inline uint32_t ch(uint32_t x, uint32_t y, uint32_t z){ return (x & y) ^ (~x & z); }
+static inline uint32_t maj(uint32_t x, uint32_t y, uint32_t z){ return (x & y) ^ (x & z) ^ (y & z); }
+static inline uint32_t bsig0(uint32_t x){ return rotr(x,2) ^ rotr(x,13) ^ rotr(x,22); }
+static inline uint32_t bsig1(uint32_t x){ return rotr(x,6) ^ rotr(x,11) ^ rotr(x,25); }
+static inline uint32_t ssig0(uint32_t x){ return rotr(x,7) ^ rotr(x,18) ^ (x >> 3); }
+static inline uint32_t ssig1(uint32_t x){ return rotr(x,17) ^ rotr(x,19) ^ (x >> 10); }
+
+static void sha256_blocks_scalar(uint32_t state[8], const uint8_t *data, size_t nblocks) {
+    uint32_t m[64], a,b,c,d,e,f,g,h,t1,t2;
+    while (nblocks--) {
+        for (int i=0;i<16;++i) {
+            m[i] = ((uint32_t)data[i*4] << 24) | ((uint32_t)data[i*4+1] << 16) |
+                   ((uint32_t)data[i*4+2] << 8) | (uint32_t)data[i*4+3];
+        }
+        for (int i=16;i<64;++i) m[i] = ssig1(m[i-2]) + m[i-7] + ssig0(m[i-15]) + m[i-16];
+        a=state[0]; b=state[1]; c=state[2]; d=state[3];
+        e=state[4]; f=state[5]; g=state[6]; h=state[7];
+        for (int i=0;i<64;++i) {
+            t1 = h + bsig1(e) + ch(e,f,g) + K[i] + m[i];
+            t2 = bsig0(a) + maj(a,b,c);
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0]+=a; state[1]+=b; state[2]+=c; state[3]+=d;
+        state[4]+=e; state[5]+=f; state[6]+=g; state[7]+=h;
+        data += SHA256_BLOCK_LEN;
+    }
+}
+
+/* ---------- x86 SHA-NI backend ---------- */
+
+#if defined(SHA256_HAVE_SHANI)
+__attribute__((target("sha,sse4.1")))
+static void sha256_blocks_shani(uint32_t state[8], const uint8_t *data, size_t nblocks) {
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i STATE0, STATE1, MSG, TMP, ABEF_SAVE, CDGH_SAVE;
+    __m128i W[4];
+
+    /* state is A..H; the round instructions want ABEF / CDGH lanes */
+    TMP = _mm_loadu_si128((const __m128i*)&state[0]);
+    STATE1 = _mm_loadu_si128((const __m128i*)&state[4]);
+    TMP = _mm_shuffle_epi32(TMP, 0xB1);
+    STATE1 = _mm_shuffle_epi32(STATE1, 0x1B);
+    STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);
+    STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0);
+
+    while (nblocks--) {
+        ABEF_SAVE = STATE0;
+        CDGH_SAVE = STATE1;
+
+        /* 16 groups of 4 rounds; W[] is a rolling window of the message schedule */
+        for (int g = 0; g < 16; ++g) {
+            if (g < 4) W[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + g*16)), MASK);
+            __m128i cur = W[g & 3];
+            MSG = _mm_add_epi32(cur, _mm_loadu_si128((const __m128i*)&K[g*4]));
+            STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+            if (g >= 3 && g <= 14) {
+                TMP = _mm_alignr_epi8(cur, W[(g - 1) & 3], 4);
+                W[(g + 1) & 3] = _mm_add_epi32(W[(g + 1) & 3], TMP);
+                W[(g + 1) & 3] = _mm_sha256msg2_epu32(W[(g + 1) & 3], cur);
+            }
+            MSG = _mm_shuffle_epi32(MSG, 0x0E);
+            STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+            if (g >= 1 && g <= 12) {
+                W[(g - 1) & 3] = _mm_sha256msg1_epu32(W[(g - 1) & 3], cur);
+            }
+        }
+
+        STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+        STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+        data += SHA256_BLOCK_LEN;
+    }
+
+    TMP = _mm_shuffle_epi32(STATE0, 0x1B);
+    STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);
+    STATE0 = _mm_blend_epi16(TMP, STATE1, 0xF0);
+    STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);
+    _mm_storeu_si128((__m128i*)&state[0], STATE0);
+    _mm_storeu_si128((__m128i*)&state[4], STATE1);
+}
+
+static int cpu_has_shani(void) {
+    unsigned int a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return 0;
+    int sse41 = (c >> 19) & 1, ssse3 = (c >> 9) & 1;
+    if (__get_cpuid_max(0, NULL) < 7) return 0;
+    __cpuid_count(7, 0, a, b, c, d);
+    return sse41 && ssse3 && ((b >> 29) & 1);
+}
+#endif
+
+/* ---------- ARMv8 backend ---------- */
+
+#if defined(SHA256_HAVE_ARMV8)
+static void sha256_blocks_armv8(uint32_t state[8], const uint8_t *data, size_t nblocks) {
+    uint32x4_t STATE0 = vld1q_u32(&state[0]);
+    uint32x4_t STATE1 = vld1q_u32(&state[4]);
+    uint32x4_t W[4];
+
+    while (nblocks--) {
+        uint32x4_t ABEF_SAVE = STATE0, CDGH_SAVE = STATE1;
+        for (int i = 0; i < 4; ++i) {
+            W[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i*16)));
+        }
+        for (int g = 0; g < 16; ++g) {
+            uint32x4_t wk = vaddq_u32(W[g & 3], vld1q_u32(&K[g*4]));
+            if (g < 12) W[g & 3] = vsha256su0q_u32(W[g & 3], W[(g + 1) & 3]);
+            uint32x4_t tmp = STATE0;
+            STATE0 = vsha256hq_u32(STATE0, STATE1, wk);
+            STATE1 = vsha256h2q_u32(STATE1, tmp, wk);
+            if (g < 12) W[g & 3] = vsha256su1q_u32(W[g & 3], W[(g + 2) & 3], W[(g + 3) & 3]);
+        }
+        STATE0 = vaddq_u32(STATE0, ABEF_SAVE);
+        STATE1 = vaddq_u32(STATE1, CDGH_SAVE);
+        data += SHA256_BLOCK_LEN;
+    }
+    vst1q_u32(&state[0], STATE0);
+    vst1q_u32(&state[4], STATE1);
+}
+
+static int cpu_has_armv8_sha2(void) {
+#if defined(__linux__) && defined(HWCAP_SHA2)
+    return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+#else
+    return 1; /* compiled for the crypto extension; assume present */
+#endif
+}
+#endif
+
+/* ---------- dispatch ---------- */
+
+static sha256_blocks_fn blocks_fn = NULL;
+static Sha256Impl active_impl = SHA256_IMPL_AUTO;
+
+int sha256_impl_available(Sha256Impl impl) {
+    switch (impl) {
+        case SHA256_IMPL_AUTO:
+        case SHA256_IMPL_SCALAR:
+            return 1;
+        case SHA256_IMPL_SHANI:
+#if defined(SHA256_HAVE_SHANI)
+            return cpu_has_shani();
+#else
+            return 0;
+#endif
+        case SHA256_IMPL_ARMV8:
+#if defined(SHA256_HAVE_ARMV8)
+            return cpu_has_armv8_sha2();
+#else
+            return 0;
+#endif
+    }
+    return 0;
+}
+
+int sha256_set_impl(Sha256Impl impl) {
+    if (impl == SHA256_IMPL_AUTO) {
+        if (sha256_impl_available(SHA256_IMPL_SHANI)) impl = SHA256_IMPL_SHANI;
+        else if (sha256_impl_available(SHA256_IMPL_ARMV8)) impl = SHA256_IMPL_ARMV8;
+        else impl = SHA256_IMPL_SCALAR;
+    }
+    if (!sha256_impl_available(impl)) return 0;
+
+    switch (impl) {
+#if defined(SHA256_HAVE_SHANI)
+        case SHA256_IMPL_SHANI: blocks_fn = sha256_blocks_shani; break;
+#endif
+#if defined(SHA256_HAVE_ARMV8)
+        case SHA256_IMPL_ARMV8: blocks_fn = sha256_blocks_armv8; break;
+#endif
+        default: blocks_fn = sha256_blocks_scalar; impl = SHA256_IMPL_SCALAR; break;
+    }
+    active_impl = impl;
+    return 1;
+}
+
+Sha256Impl sha256_get_impl(void) {
+    if (!blocks_fn) sha256_set_impl(SHA256_IMPL_AUTO);
+    return active_impl;
+}
+
+const char* sha256_impl_name(Sha256Impl impl) {
+    switch (impl) {
+        case SHA256_IMPL_SCALAR: return "scalar";
+        case SHA256_IMPL_SHANI:  return "sha-ni";
+        case SHA256_IMPL_ARMV8:  return "armv8";
+        default:                 return "auto";
+    }
+}
+
+static void sha256_blocks(uint32_t state[8], const uint8_t *data, size_t nblocks) {
+    if (!blocks_fn) sha256_set_impl(SHA256_IMPL_AUTO);
+    blocks_fn(state, data, nblocks);
+}
+
+/* ---------- streaming interface ---------- */
+
+static void store_be32(uint8_t *out, uint32_t v) {
+    out[0] = (uint8_t)(v >> 24); out[1] = (uint8_t)(v >> 16);
+    out[2] = (uint8_t)(v >> 8);  out[3] = (uint8_t)v;
+}
+
+void sha256_init(SHA256_CTX *ctx) {
+    ctx->datalen = 0;
+    ctx->bitlen = 0;
+    memcpy(ctx->state, H0, sizeof(H0));
+}
+
+void sha256_update(SHA256_CTX *ctx, const uint8_t *data, size_t len) {
+    ctx->bitlen += (uint64_t)len * 8;
+
+    /* top up a pending partial block first */
+    if (ctx->datalen > 0) {
+        size_t take = SHA256_BLOCK_LEN - ctx->datalen;
+        if (take > len) take = len;
+        memcpy(ctx->data + ctx->datalen, data, take);
+        ctx->datalen += take;
+        data += take;
+        len -= take;
+        if (ctx->datalen < SHA256_BLOCK_LEN) return;
+        sha256_blocks(ctx->state, ctx->data, 1);
+        ctx->datalen = 0;
+    }
+
+    /* whole blocks straight from the caller's buffer */
+    size_t nblocks = len / SHA256_BLOCK_LEN;
+    if (nblocks) {
+        sha256_blocks(ctx->state, data, nblocks);
+        data += nblocks * SHA256_BLOCK_LEN;
+        len -= nblocks * SHA256_BLOCK_LEN;
+    }
+
+    if (len) {
+        memcpy(ctx->data, data, len);
+        ctx->datalen = len;
+    }
+}
+
+void sha256_final(SHA256_CTX *ctx, uint8_t hash[SHA256_DIGEST_LEN]) {
+    size_t i = ctx->datalen;
+    ctx->data[i++] = 0x80;
+    if (i > 56) {
+        memset(ctx->data + i, 0, SHA256_BLOCK_LEN - i);
+        sha256_blocks(ctx->state, ctx->data, 1);
+        i = 0;
+    }
+    memset(ctx->data + i, 0, 56 - i);
+    store_be32(ctx->data + 56, (uint32_t)(ctx->bitlen >> 32));
+    store_be32(ctx->data + 60, (uint32_t)ctx->bitlen);
+    sha256_blocks(ctx->state, ctx->data, 1);
+    for (i = 0; i < 8; ++i) store_be32(hash + i*4, ctx->state[i]);
+}
+
+void sha256(const uint8_t *data, size_t len, uint8_t out[SHA256_DIGEST_LEN]) {
+    SHA256_CTX ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, out);
+}
+
+/* ---------- HMAC / PBKDF2 ---------- */
+
+/* Absorb the ipad/opad key blocks once so every HMAC after that starts from a saved state */
+static void hmac_prepare(const uint8_t *key, size_t keylen, SHA256_CTX *inner, SHA256_CTX *outer) {
+    uint8_t k[SHA256_BLOCK_LEN] = {0};
+    uint8_t pad[SHA256_BLOCK_LEN];
+
+    if (keylen > SHA256_BLOCK_LEN) sha256(key, keylen, k);
+    else if (keylen) memcpy(k, key, keylen);
+
+    for (int i = 0; i < SHA256_BLOCK_LEN; ++i) pad[i] = k[i] ^ 0x36;
+    sha256_init(inner);
+    sha256_update(inner, pad, SHA256_BLOCK_LEN);
+
+    for (int i = 0; i < SHA256_BLOCK_LEN; ++i) pad[i] = k[i] ^ 0x5c;
+    sha256_init(outer);
+    sha256_update(outer, pad, SHA256_BLOCK_LEN);
+
+    memset(k, 0, sizeof(k));
+    memset(pad, 0, sizeof(pad));
+}
+
+void hmac_sha256(const uint8_t *key, size_t keylen, const uint8_t *msg, size_t msglen,
+                 uint8_t out[SHA256_DIGEST_LEN]) {
+    SHA256_CTX inner, outer;
+    uint8_t ihash[SHA256_DIGEST_LEN];
+    hmac_prepare(key, keylen, &inner, &outer);
+    sha256_update(&inner, msg, msglen);
+    sha256_final(&inner, ihash);
+    sha256_update(&outer, ihash, SHA256_DIGEST_LEN);
+    sha256_final(&outer, out);
+}
+
+int pbkdf2_hmac_sha256(const uint8_t *pass, size_t passlen,
+                       const uint8_t *salt, size_t saltlen,
+                       uint32_t iterations, uint8_t *out, size_t outlen) {
+    if (!out || iterations == 0 || (!salt && saltlen) || (!pass && passlen)) return 0;
+
+    SHA256_CTX inner, outer;
+    hmac_prepare(pass, passlen, &inner, &outer);
+
+    /* Every iteration after the first hashes a 32-byte digest behind a full key
+       block, so the padded final block is always the same layout: digest, 0x80,
+       zeros, and a bit length of (64 + 32) * 8. */
+    uint8_t block[SHA256_BLOCK_LEN] = {0};
+    block[SHA256_DIGEST_LEN] = 0x80;
+    store_be32(block + 60, (SHA256_BLOCK_LEN + SHA256_DIGEST_LEN) * 8);
+
+    uint32_t counter = 1;
+    while (outlen > 0) {
+        SHA256_CTX c = inner;
+        uint8_t be_counter[4];
+        uint8_t u[SHA256_DIGEST_LEN], t[SHA256_DIGEST_LEN];
+
+        store_be32(be_counter, counter);
+        sha256_update(&c, salt, saltlen);
+        sha256_update(&c, be_counter, 4);
+        sha256_final(&c, u);
+        c = outer;
+        sha256_update(&c, u, SHA256_DIGEST_LEN);
+        sha256_final(&c, u);
+        memcpy(t, u, SHA256_DIGEST_LEN);
+
+        memcpy(block, u, SHA256_DIGEST_LEN);
+        for (uint32_t it = 1; it < iterations; ++it) {
+            uint32_t s[8];
+            memcpy(s, inner.state, sizeof(s));
+            sha256_blocks(s, block, 1);
+            for (int i = 0; i < 8; ++i) store_be32(block + i*4, s[i]);
+            memcpy(s, outer.state, sizeof(s));
+            sha256_blocks(s, block, 1);
+            for (int i = 0; i < 8; ++i) {
+                store_be32(block + i*4, s[i]);
+                t[i*4]   ^= block[i*4];
+                t[i*4+1] ^= block[i*4+1];
+                t[i*4+2] ^= block[i*4+2];
+                t[i*4+3] ^= block[i*4+3];
+            }
+        }
+
+        size_t n = outlen < SHA256_DIGEST_LEN ? outlen : SHA256_DIGEST_LEN;
+        memcpy(out, t, n);
+        out += n;
+        outlen -= n;
+        counter++;
+    }
+    memset(block, 0, sizeof(block));
+    return 1;
+}
@@ -0,0 +1,47 @@
+#ifndef CRYPTO_SHA256_H
+#define CRYPTO_SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHA256_BLOCK_LEN 64
+#define SHA256_DIGEST_LEN 32
+
+/* Default PBKDF2 work factor for newly generated password hashes */
+#define PBKDF2_DEFAULT_ITERATIONS 100000
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t bitlen;
+    uint8_t data[SHA256_BLOCK_LEN];
+    size_t datalen;
+} SHA256_CTX;
+
+/* Compression backends. SHA256_IMPL_AUTO picks the fastest one the CPU supports. */
+typedef enum {
+    SHA256_IMPL_AUTO = 0,
+    SHA256_IMPL_SCALAR,
+    SHA256_IMPL_SHANI,   /* x86 SHA extensions */
+    SHA256_IMPL_ARMV8    /* ARMv8 crypto extensions */
+} Sha256Impl;
+
+void sha256_init(SHA256_CTX *ctx);
+void sha256_update(SHA256_CTX *ctx, const uint8_t *data, size_t len);
+void sha256_final(SHA256_CTX *ctx, uint8_t hash[SHA256_DIGEST_LEN]);
+void sha256(const uint8_t *data, size_t len, uint8_t out[SHA256_DIGEST_LEN]);
+
+void hmac_sha256(const uint8_t *key, size_t keylen, const uint8_t *msg, size_t msglen,
+                 uint8_t out[SHA256_DIGEST_LEN]);
+
+/* PBKDF2-HMAC-SHA256 (RFC 8018). Returns 1 on success, 0 on bad arguments. */
+int pbkdf2_hmac_sha256(const uint8_t *pass, size_t passlen,
+                       const uint8_t *salt, size_t saltlen,
+                       uint32_t iterations, uint8_t *out, size_t outlen);
+
+/* Backend selection. sha256_set_impl returns 0 if the requested backend is unavailable. */
+int sha256_impl_available(Sha256Impl impl);
+int sha256_set_impl(Sha256Impl impl);
+Sha256Impl sha256_get_impl(void);
+const char* sha256_impl_name(Sha256Impl impl);
+
+#endif /* CRYPTO_SHA256_H */
@@ -1,5 +1,46 @@
+#include <stdio.h>
+#include <string.h>
+
 #include "controller/controller.h"
+#include "controller/batch.h"
+#include "net/server.h"
+#include "net/client.h"
+#include "net/replica.h"
+#include "util/metrics.h"
+#include "util/trace.h"
+
+static void usage(const char *prog) {
+    printf("Usage: %s                 interactive desk\n", prog);
+    printf("       %s --server ADDR   serve the shared queue to many desks\n", prog);
+    printf("       %s --client ADDR   connect a desk to a running server\n", prog);
+    printf("       %s --standby PRIMARY ADDR\n", prog);
+    printf("                          mirror a server started with HOSP_REPLICA_LISTEN=PRIMARY,\n");
+    printf("                          then take over desks on ADDR if it stops\n");
+    printf("       %s --batch FILE [--echo] [--no-save] [--dept NAME]\n", prog);
+    printf("                          run desk commands or CDC events from FILE (- = stdin)\n");
+    printf("                          without prompts, then report latency and throughput\n");
+    printf("ADDR is tcp:HOST:PORT, unix:PATH or PORT\n");
+}
 
-int main(void) {
+int main(int argc, char **argv) {
+    metrics_init();
+    trace_init_from_env();
+    if (argc >= 3 && strcmp(argv[1], "--server") == 0) return server_run(argv[2]);
+    if (argc >= 3 && strcmp(argv[1], "--client") == 0) return client_run(argv[2]);
+    if (argc >= 4 && strcmp(argv[1], "--standby") == 0) return standby_run(argv[2], argv[3]);
+    if (argc >= 3 && strcmp(argv[1], "--batch") == 0) {
+        BatchOptions opt = { 0, 1, NULL };
+        for (int i = 3; i < argc; ++i) {
+            if (strcmp(argv[i], "--echo") == 0) opt.echo = 1;
+            else if (strcmp(argv[i], "--no-save") == 0) opt.save = 0;
+            else if (strcmp(argv[i], "--dept") == 0 && i + 1 < argc) opt.department = argv[++i];
+            else { usage(argv[0]); return 1; }
+        }
+        return batch_run(argv[2], &opt);
+    }
+    if (argc > 1) {
+        usage(argv[0]);
+        return strcmp(argv[1], "--help") == 0 ? 0 : 1;
+    }
     return main_loop();
-}
\ No newline at end of file
+}
@@ -0,0 +1,184 @@
+#include "alerts.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "history.h"
+#include "../util/time_util.h"
+
+static const char *SEV_NAMES[3] = { "NORMAL", "SERIOUS", "CRITICAL" };
+
+static long env_minutes(const char *name, long def_min) {
+    const char *env = getenv(name);
+    if (!env || !env[0]) return def_min * 60;
+    long v = atol(env);
+    return v > 0 ? v * 60 : 0;
+}
+
+void alerts_config_from_env(AlertConfig *cfg, const PqPolicy *policy) {
+    if (!cfg) return;
+    PqPolicy def;
+    if (!policy) {
+        pq_policy_default(&def);
+        policy = &def;
+    }
+    for (int s = 0; s < 3; ++s) cfg->escalate_sec[s] = policy->max_wait_sec[s];
+    cfg->noshow_sec = env_minutes("HOSP_NOSHOW_MIN", ALERT_DEFAULT_NOSHOW_MIN);
+    cfg->retriage_sec = env_minutes("HOSP_RETRIAGE_MIN", ALERT_DEFAULT_RETRIAGE_MIN);
+}
+
+static uint64_t current_tick(const PatientAlerts *a) {
+    return (monotonic_ms() - a->start_ms) / 1000u;
+}
+
+void alerts_init(PatientAlerts *a, const AlertConfig *cfg, AlertFn fn, void *user) {
+    if (!a) return;
+    if (cfg) a->cfg = *cfg;
+    else alerts_config_from_env(&a->cfg, NULL);
+    a->start_ms = monotonic_ms();
+    a->on_alert = fn;
+    a->user = user;
+    tw_init(&a->wheel, 0, a);
+}
+
+void alerts_destroy(PatientAlerts *a) {
+    if (!a) return;
+    tw_destroy(&a->wheel);
+}
+
+static void on_timer(TimerWheel *tw, Timer *t) {
+    PatientAlerts *a = tw->owner;
+    Patient *p = t->arg;
+    AlertKind kind = (AlertKind)t->tag;
+    p->timers[kind] = NULL;
+
+    /* periodic: re-arm before the callback, which may free p */
+    if (kind == ALERT_RETRIAGE && a->cfg.retriage_sec > 0)
+        alerts_arm(a, p, ALERT_RETRIAGE, a->cfg.retriage_sec);
+    if (a->on_alert) a->on_alert(a, p, kind);
+}
+
+void alerts_arm(PatientAlerts *a, Patient *p, AlertKind kind, long delay_sec) {
+    if (!a || !p || kind < 0 || kind >= PATIENT_TIMERS) return;
+    if (p->timers[kind]) {
+        tw_cancel(&a->wheel, p->timers[kind]);
+        p->timers[kind] = NULL;
+    }
+    /* the wheel only advances on alerts_tick, so measure from the real clock */
+    uint64_t target = current_tick(a) + (uint64_t)(delay_sec > 0 ? delay_sec : 1);
+    p->timers[kind] = tw_add(&a->wheel, target - a->wheel.now, on_timer, p, (int)kind);
+}
+
+/* Seconds until arrival + limit, at least one tick */
+static long due_in(const Patient *p, long limit_sec, time_t now) {
+    time_t start = p->arrival_ts != (time_t)-1 ? p->arrival_ts : now;
+    long d = (long)(start + limit_sec - now);
+    return d > 0 ? d : 1;
+}
+
+void alerts_track(PatientAlerts *a, Patient *p) {
+    if (!a || !p) return;
+    time_t now = time(NULL);
+    int sev = (p->severity >= NORMAL && p->severity <= CRITICAL) ? (int)p->severity : NORMAL;
+    if (a->cfg.escalate_sec[sev] > 0) alerts_arm(a, p, ALERT_ESCALATE, due_in(p, a->cfg.escalate_sec[sev], now));
+    if (a->cfg.noshow_sec > 0) alerts_arm(a, p, ALERT_NO_SHOW, due_in(p, a->cfg.noshow_sec, now));
+    if (a->cfg.retriage_sec > 0) alerts_arm(a, p, ALERT_RETRIAGE, a->cfg.retriage_sec);
+}
+
+void alerts_retriaged(PatientAlerts *a, Patient *p) {
+    if (!a || !p) return;
+    int sev = (p->severity >= NORMAL && p->severity <= CRITICAL) ? (int)p->severity : NORMAL;
+    if (a->cfg.escalate_sec[sev] > 0) alerts_arm(a, p, ALERT_ESCALATE, a->cfg.escalate_sec[sev]);
+    if (a->cfg.retriage_sec > 0) alerts_arm(a, p, ALERT_RETRIAGE, a->cfg.retriage_sec);
+}
+
+/* Spilled patients are freed and come back as new allocations (spill.h):
+   their timers go with them and are re-armed from arrival on refill */
+static void on_spill(void *ctx, PqEvent ev, const Patient *p, Severity old_severity) {
+    (void)old_severity;
+    if (ev == PQ_EV_SPILL) alerts_forget(ctx, (Patient*)p);
+    else if (ev == PQ_EV_REFILL) alerts_track(ctx, (Patient*)p);
+}
+
+void alerts_track_queue(PatientAlerts *a, PriorityQueue *q) {
+    if (!a || !q) return;
+    for (Patient *p = q->head; p; p = p->next) alerts_track(a, p);
+    pq_remove_observer(q, on_spill, a);
+    pq_add_observer(q, on_spill, a);
+}
+
+void alerts_forget(PatientAlerts *a, Patient *p) {
+    if (!a || !p) return;
+    for (int k = 0; k < PATIENT_TIMERS; ++k) {
+        if (p->timers[k]) {
+            tw_cancel(&a->wheel, p->timers[k]);
+            p->timers[k] = NULL;
+        }
+    }
+}
+
+void alerts_forget_queue(PatientAlerts *a, PriorityQueue *q) {
+    if (!a || !q) return;
+    for (Patient *p = q->head; p; p = p->next) alerts_forget(a, p);
+    pq_remove_observer(q, on_spill, a);
+}
+
+int alerts_tick(PatientAlerts *a) {
+    if (!a) return 0;
+    return tw_advance(&a->wheel, current_tick(a));
+}
+
+int alerts_pending(const PatientAlerts *a) {
+    return a ? a->wheel.pending : 0;
+}
+
+const char* alert_kind_name(AlertKind kind) {
+    switch (kind) {
+        case ALERT_ESCALATE: return "ESCALATE";
+        case ALERT_NO_SHOW:  return "NO_SHOW";
+        case ALERT_RETRIAGE: return "RETRIAGE";
+    }
+    return "?";
+}
+
+void alerts_apply(PatientAlerts *a, PriorityQueue *q, Patient *p, AlertKind kind,
+                  const char *department, char *msg, size_t msglen) {
+    if (!a || !q || !p || !msg || msglen == 0) return;
+    time_t now = time(NULL);
+    long waited_sec = p->arrival_ts != (time_t)-1 ? (long)(now - p->arrival_ts) : 0;
+    long waited = waited_sec / 60;
+    const char *dept = department && department[0] ? department : "queue";
+
+    switch (kind) {
+    case ALERT_ESCALATE: {
+        int sev = (int)p->severity;
+        if (sev < CRITICAL) {
+            pq_update_severity(q, p, (Severity)(sev + 1));
+            snprintf(msg, msglen, "SLA breached: patient %d (%s) waited %ld min in %s, escalated %s -> %s",
+                     p->id, p->name, waited, dept, SEV_NAMES[sev], SEV_NAMES[sev + 1]);
+            sev++;
+        } else {
+            snprintf(msg, msglen, "SLA breached: CRITICAL patient %d (%s) has waited %ld min in %s",
+                     p->id, p->name, waited, dept);
+        }
+        /* next alert one full SLA of the new severity from now */
+        if (a->cfg.escalate_sec[sev] > 0) alerts_arm(a, p, ALERT_ESCALATE, a->cfg.escalate_sec[sev]);
+        break;
+    }
+    case ALERT_NO_SHOW: {
+        char now_iso[TIME_LEN];
+        format_iso_time(now, now_iso, sizeof(now_iso));
+        snprintf(msg, msglen, "No-show: patient %d (%s) removed from %s after %ld min",
+                 p->id, p->name, dept, waited);
+        alerts_forget(a, p);
+        pq_remove(q, p);
+        history_append_noshow(NOSHOW_FILE, p, now_iso, waited_sec, department);
+        free_patient(p);
+        break;
+    }
+    case ALERT_RETRIAGE:
+        snprintf(msg, msglen, "Re-triage reminder: patient %d (%s, %s) waiting %ld min in %s",
+                 p->id, p->name, SEV_NAMES[p->severity], waited, dept);
+        break;
+    }
+}
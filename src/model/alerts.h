@@ -0,0 +1,68 @@
+#ifndef ALERTS_H
+#define ALERTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "patient.h"
+#include "queue.h"
+#include "../util/timer_wheel.h"
+
+/* Time-driven patient events on a one-second timer wheel:
+   ESCALATE  - the patient has waited past their severity's SLA
+   NO_SHOW   - the patient has waited so long they are presumed gone
+   RETRIAGE  - periodic reminder to reassess a waiting patient */
+typedef enum { ALERT_ESCALATE = 0, ALERT_NO_SHOW = 1, ALERT_RETRIAGE = 2 } AlertKind;
+
+#define ALERT_DEFAULT_NOSHOW_MIN 240
+#define ALERT_DEFAULT_RETRIAGE_MIN 60
+
+typedef struct AlertConfig {
+    long escalate_sec[3];     /* per severity, taken from the SLA policy */
+    long noshow_sec;          /* 0 disables */
+    long retriage_sec;        /* 0 disables */
+} AlertConfig;
+
+struct PatientAlerts;
+typedef void (*AlertFn)(struct PatientAlerts *a, Patient *p, AlertKind kind);
+
+typedef struct PatientAlerts {
+    TimerWheel wheel;
+    AlertConfig cfg;
+    uint64_t start_ms;        /* monotonic origin of tick 0 */
+    AlertFn on_alert;
+    void *user;               /* handed back to on_alert through a->user */
+} PatientAlerts;
+
+/* SLA limits from policy; HOSP_NOSHOW_MIN / HOSP_RETRIAGE_MIN override the rest */
+void alerts_config_from_env(AlertConfig *cfg, const PqPolicy *policy);
+
+void alerts_init(PatientAlerts *a, const AlertConfig *cfg, AlertFn fn, void *user);
+void alerts_destroy(PatientAlerts *a);
+
+/* (Re)arm every alert for p, measured from its arrival */
+void alerts_track(PatientAlerts *a, Patient *p);
+void alerts_track_queue(PatientAlerts *a, PriorityQueue *q);
+/* Arm one alert delay_sec from now, replacing any pending one of that kind */
+void alerts_arm(PatientAlerts *a, Patient *p, AlertKind kind, long delay_sec);
+
+/* After a manual severity change: SLA and reminder restart from now */
+void alerts_retriaged(PatientAlerts *a, Patient *p);
+
+/* Cancel p's alerts; required before p leaves the queue or is freed */
+void alerts_forget(PatientAlerts *a, Patient *p);
+void alerts_forget_queue(PatientAlerts *a, PriorityQueue *q);
+
+/* Advance to the monotonic clock and fire what is due; returns alerts fired */
+int alerts_tick(PatientAlerts *a);
+int alerts_pending(const PatientAlerts *a);
+
+/* Standard effect of an alert on q, which holds p. ESCALATE raises severity
+   one level and re-arms for the new SLA; NO_SHOW removes p, logs it to
+   NOSHOW_FILE and frees it; RETRIAGE only reports. A one-line description
+   goes to msg. */
+void alerts_apply(PatientAlerts *a, PriorityQueue *q, Patient *p, AlertKind kind,
+                  const char *department, char *msg, size_t msglen);
+
+const char* alert_kind_name(AlertKind kind);
+
+#endif /* ALERTS_H */
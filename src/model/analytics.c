@@ -0,0 +1,214 @@
+#include "analytics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+void analytics_init(Analytics *a, const char *path) {
+    if (!a) return;
+    memset(a, 0, sizeof(*a));
+    snprintf(a->path, sizeof(a->path), "%s", path ? path : HISTORY_FILE);
+}
+
+void analytics_free(Analytics *a) {
+    if (!a) return;
+    free(a->days);
+    a->days = NULL;
+    a->ndays = a->days_cap = 0;
+}
+
+/* Drop every aggregate and what the file was known to be */
+static void reset(Analytics *a) {
+    char path[sizeof(a->path)];
+    memcpy(path, a->path, sizeof(path));
+    AnalyticsDay *days = a->days;
+    int cap = a->days_cap;
+    memset(a, 0, sizeof(*a));
+    memcpy(a->path, path, sizeof(path));
+    a->days = days;
+    a->days_cap = cap;
+}
+
+long analytics_total(const Analytics *a, long long *wait_sum) {
+    long n = 0;
+    long long w = 0;
+    for (int s = 0; a && s < 3; ++s) {
+        n += a->sev_count[s];
+        w += a->sev_wait[s];
+    }
+    if (wait_sum) *wait_sum = w;
+    return n;
+}
+
+static int col_long(const HistoryView *v, int c, long *out) {
+    char num[32];
+    size_t len = v->len[c] < sizeof(num) - 1 ? v->len[c] : sizeof(num) - 1;
+    memcpy(num, v->col[c], len);
+    num[len] = '\0';
+    char *end;
+    *out = strtol(num, &end, 10);
+    return end != num;
+}
+
+/* Seconds into the day of "YYYY-MM-DD HH:MM:SS", -1 if malformed */
+static long day_seconds(const char *s, size_t len) {
+    if (len < 19 || s[13] != ':' || s[16] != ':') return -1;
+    for (int i = 11; i < 19; ++i) {
+        if (i != 13 && i != 16 && (s[i] < '0' || s[i] > '9')) return -1;
+    }
+    return ((s[11] - '0') * 10 + (s[12] - '0')) * 3600L + ((s[14] - '0') * 10 + (s[15] - '0')) * 60L
+         + (s[17] - '0') * 10 + (s[18] - '0');
+}
+
+/* Days since 1970-01-01 of "YYYY-MM-DD", -1 if malformed */
+static long civil_day(const char *s) {
+    for (int i = 0; i < 10; ++i) {
+        if (i == 4 || i == 7 ? s[i] != '-' : (s[i] < '0' || s[i] > '9')) return -1;
+    }
+    long y = (s[0] - '0') * 1000 + (s[1] - '0') * 100 + (s[2] - '0') * 10 + (s[3] - '0');
+    int m = (s[5] - '0') * 10 + (s[6] - '0'), d = (s[8] - '0') * 10 + (s[9] - '0');
+    if (m < 1 || m > 12 || d < 1 || d > 31) return -1;
+    /* proleptic Gregorian, years counted from March */
+    if (m <= 2) y--;
+    long era = y / 400, yoe = y - era * 400;
+    long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+/* service_end - served_at, both local "YYYY-MM-DD HH:MM:SS". Counted in
+   calendar days rather than through mktime, which rereads the time zone
+   on every call; a service spanning a DST change is off by the shift. */
+static long service_seconds(const HistoryView *v) {
+    const char *start = v->col[HC_SERVED_AT], *end = v->col[HC_SERVICE_END];
+    long s = day_seconds(start, v->len[HC_SERVED_AT]), e = day_seconds(end, v->len[HC_SERVICE_END]);
+    if (s < 0 || e < 0) return -1;
+    if (memcmp(start, end, 10) == 0) return e - s;
+    long ds = civil_day(start), de = civil_day(end);
+    return ds < 0 || de < 0 ? -1 : (de - ds) * 86400L + e - s;
+}
+
+static AnalyticsDay* find_day(Analytics *a, const char *date) {
+    /* rows arrive in date order, so the newest day is nearly always it */
+    if (a->ndays && strcmp(a->days[a->ndays - 1].date, date) == 0) return &a->days[a->ndays - 1];
+    int lo = 0, hi = a->ndays;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (strcmp(a->days[mid].date, date) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < a->ndays && strcmp(a->days[lo].date, date) == 0) return &a->days[lo];
+    if (a->ndays == a->days_cap) {
+        int n = a->days_cap ? a->days_cap * 2 : 64;
+        AnalyticsDay *grown = realloc(a->days, (size_t)n * sizeof(AnalyticsDay));
+        if (!grown) return NULL;
+        a->days = grown;
+        a->days_cap = n;
+    }
+    memmove(&a->days[lo + 1], &a->days[lo], (size_t)(a->ndays - lo) * sizeof(AnalyticsDay));
+    AnalyticsDay *d = &a->days[lo];
+    memset(d, 0, sizeof(*d));
+    memcpy(d->date, date, 10);
+    a->ndays++;
+    return d;
+}
+
+/* Fold one row into every aggregate */
+static void add_row(Analytics *a, const char *line) {
+    HistoryView v;
+    long id, sev, wait;
+    if (!history_split_line(line, &v) || !col_long(&v, HC_ID, &id)) return;
+    if (!col_long(&v, HC_SEVERITY, &sev) || sev < 0 || sev > 2 || !col_long(&v, HC_WAIT, &wait)) return;
+
+    a->rows++;
+    a->sev_count[sev]++;
+    a->sev_wait[sev] += wait;
+
+    const char *arrival = v.col[HC_ARRIVAL];
+    if (v.len[HC_ARRIVAL] >= 13 && arrival[10] == ' ' && arrival[11] >= '0' && arrival[11] <= '9'
+        && arrival[12] >= '0' && arrival[12] <= '9') {
+        int hour = (arrival[11] - '0') * 10 + (arrival[12] - '0');
+        if (hour < 24) a->hour_count[hour]++;
+    }
+
+    const char *when = v.len[HC_SERVED_AT] >= 10 ? v.col[HC_SERVED_AT] : v.len[HC_ARRIVAL] >= 10 ? arrival : NULL;
+    if (when) {
+        char date[11];
+        memcpy(date, when, 10);
+        date[10] = '\0';
+        AnalyticsDay *d = find_day(a, date);
+        if (d) {
+            d->count++;
+            d->by_sev[sev]++;
+            d->wait_sum += wait;
+        }
+    }
+
+    long counter = 0;
+    if (v.len[HC_COUNTER]) col_long(&v, HC_COUNTER, &counter);
+    if (counter >= 0 && counter < ANALYTICS_MAX_STAFF) {
+        AnalyticsStaff *st = &a->staff[counter];
+        st->served++;
+        st->wait_sum += wait;
+        /* on the spot (counter 0) the service ends as it starts: not a service time */
+        long service = counter > 0 && v.len[HC_SERVICE_END] ? service_seconds(&v) : -1;
+        if (service > 0) {
+            st->service_n++;
+            st->service_sum += service;
+        }
+    }
+}
+
+/* Whether the file still holds the bytes the aggregates end with */
+static int tail_matches(Analytics *a, FILE *f) {
+    if (a->tail_len == 0) return 1;
+    char buf[sizeof(a->tail)];
+    if (fseek(f, a->offset - (long)a->tail_len, SEEK_SET) != 0) return 0;
+    return fread(buf, 1, a->tail_len, f) == a->tail_len && memcmp(buf, a->tail, a->tail_len) == 0;
+}
+
+int analytics_refresh(Analytics *a) {
+    if (!a) return 0;
+    a->rows_read = 0;
+    struct stat st;
+    if (stat(a->path, &st) != 0) { reset(a); return 0; }
+    unsigned long long inode = (unsigned long long)st.st_ino;
+    if (a->loaded && a->inode == inode && a->size == (long long)st.st_size && a->mtime == st.st_mtime) return 1;
+
+    FILE *f = fopen(a->path, "rb");
+    if (!f) { reset(a); return 0; }
+    setvbuf(f, NULL, _IOFBF, 1 << 16);
+    if (!a->loaded || a->inode != inode || (long long)st.st_size < a->offset || !tail_matches(a, f)) reset(a);
+    if (fseek(f, a->offset, SEEK_SET) != 0) { fclose(f); reset(a); return 0; }
+
+    char line[1024];
+    long pos = a->offset;
+    while (fgets(line, sizeof(line), f)) {
+        size_t len = strlen(line);
+        if (line[len - 1] != '\n') {
+            /* an overlong row is skipped whole; one without its newline yet waits */
+            int c;
+            while ((c = fgetc(f)) != EOF && c != '\n') len++;
+            if (c == EOF) break;
+            len++;
+            line[0] = '\0';
+        }
+        if (pos > 0) {
+            add_row(a, line);
+            a->rows_read++;
+        }
+        pos += (long)len;
+    }
+
+    /* keep the last bytes read, to recognise the file next time */
+    size_t want = pos < (long)sizeof(a->tail) ? (size_t)pos : sizeof(a->tail);
+    a->tail_len = 0;
+    if (fseek(f, pos - (long)want, SEEK_SET) == 0 && fread(a->tail, 1, want, f) == want) a->tail_len = want;
+    fclose(f);
+
+    a->offset = pos;
+    a->loaded = 1;
+    a->inode = inode;
+    a->size = (long long)st.st_size;
+    a->mtime = st.st_mtime;
+    return 1;
+}
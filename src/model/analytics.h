@@ -0,0 +1,68 @@
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include <time.h>
+#include "history.h"
+
+/* Every aggregate the served.csv reports show, computed in one pass:
+   per-severity wait sums and counts (menus 10 and 13), arrivals per hour
+   of day (menu 14), per-counter service stats (menu 15) and per-day totals
+   (menu 18). Each row is split once with history_split_line and only the
+   columns the aggregates use are converted.
+
+   The result remembers the size, mtime and inode of the file it covers and
+   the offset it has read to. A refresh with all three unchanged reads
+   nothing. If only the file grew (served.csv is append-only), just the
+   appended rows are folded in. A file that shrank, was replaced, or no
+   longer ends the covered part with the same bytes is read afresh. A row
+   still being written (no newline yet) waits for the next refresh. */
+
+#define ANALYTICS_MAX_STAFF 64    /* counter IDs; rows of higher IDs only count in the totals */
+
+typedef struct AnalyticsDay {
+    char date[11];                /* YYYY-MM-DD of served_at (arrival on rows without one) */
+    long count;
+    long by_sev[3];
+    long long wait_sum;
+} AnalyticsDay;
+
+/* One doctor counter; counter 0 is patients served on the spot */
+typedef struct AnalyticsStaff {
+    long served;
+    long long wait_sum;
+    long service_n;               /* rows with a service_end after served_at; none for counter 0 */
+    long long service_sum;        /* seconds from served_at to service_end */
+} AnalyticsStaff;
+
+typedef struct Analytics {
+    char path[256];
+    int loaded;
+    long offset;                  /* bytes folded in: header and complete rows */
+    long long size;
+    time_t mtime;
+    unsigned long long inode;
+    char tail[64];                /* the bytes just before offset */
+    size_t tail_len;
+    long rows_read;               /* by the last refresh */
+
+    long rows;
+    long sev_count[3];
+    long long sev_wait[3];
+    long hour_count[24];          /* by arrival hour */
+    AnalyticsDay *days;           /* ascending by date */
+    int ndays;
+    int days_cap;
+    AnalyticsStaff staff[ANALYTICS_MAX_STAFF];
+} Analytics;
+
+void analytics_init(Analytics *a, const char *path);
+void analytics_free(Analytics *a);
+
+/* Bring a up to date with its file. Returns 0, with every aggregate empty,
+   if the file does not exist or cannot be read. */
+int analytics_refresh(Analytics *a);
+
+/* Total rows and wait over every severity */
+long analytics_total(const Analytics *a, long long *wait_sum);
+
+#endif /* ANALYTICS_H */
@@ -0,0 +1,560 @@
+#include "cdc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+const char* cdc_type_name(int type) {
+    switch (type) {
+        case CDC_ENQUEUE:  return "ENQUEUE";
+        case CDC_DEQUEUE:  return "DEQUEUE";
+        case CDC_RETRIAGE: return "RETRIAGE";
+        case CDC_REMOVE:   return "REMOVE";
+        case CDC_SERVED:   return "SERVED";
+        case CDC_GAP:      return "GAP";
+        default:           return "UNKNOWN";
+    }
+}
+
+static size_t json_string(char *buf, size_t buflen, const char *s) {
+    size_t n = 0;
+    if (n < buflen) buf[n++] = '"';
+    for (; *s && n + 7 < buflen; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') { buf[n++] = '\\'; buf[n++] = (char)c; }
+        else if (c < 0x20) n += (size_t)snprintf(buf + n, buflen - n, "\\u%04x", c);
+        else buf[n++] = (char)c;
+    }
+    if (n < buflen) buf[n++] = '"';
+    if (n < buflen) buf[n] = '\0';
+    return n;
+}
+
+int cdc_format_json(const CdcEvent *ev, char *buf, size_t buflen) {
+    if (!ev || !buf || buflen < 256) return 0;
+    size_t n = (size_t)snprintf(buf, buflen, "{\"seq\":%llu,\"ts\":%lld,\"type\":\"%s\"",
+                                (unsigned long long)ev->seq, (long long)ev->ts_ms, cdc_type_name(ev->type));
+    if (ev->type == CDC_GAP) {
+        n += (size_t)snprintf(buf + n, buflen - n, ",\"dropped\":%d}\n", ev->patient_id);
+        return (int)n;
+    }
+    n += (size_t)snprintf(buf + n, buflen - n, ",\"dept\":");
+    n += json_string(buf + n, buflen - n, ev->department);
+    n += (size_t)snprintf(buf + n, buflen - n, ",\"id\":%d,\"sev\":%d", ev->patient_id, ev->severity);
+    if (ev->type == CDC_ENQUEUE) {
+        /* full patient details once; later events refer to the id */
+        n += (size_t)snprintf(buf + n, buflen - n, ",\"age\":%d,\"phone\":%lld,\"flags\":%u,\"name\":",
+                              ev->age, (long long)ev->phone, ev->flags);
+        n += json_string(buf + n, buflen - n, ev->name);
+    } else if (ev->type == CDC_RETRIAGE) {
+        n += (size_t)snprintf(buf + n, buflen - n, ",\"old_sev\":%d", ev->old_severity);
+    } else if (ev->type == CDC_SERVED) {
+        n += (size_t)snprintf(buf + n, buflen - n, ",\"counter\":%d,\"wait_sec\":%lld",
+                              ev->counter_id, (long long)ev->wait_sec);
+    }
+    n += (size_t)snprintf(buf + n, buflen - n, "}\n");
+    return n < buflen ? (int)n : (int)buflen - 1;
+}
+
+#if defined(_WIN32)
+
+CdcStream* cdc_open_from_env(void) {
+    if (getenv("HOSP_CDC")) fprintf(stderr, "CDC stream needs POSIX threads and files; HOSP_CDC ignored\n");
+    return NULL;
+}
+CdcStream* cdc_open(const char *spec, CdcFormat format, uint64_t rotate_bytes, int keep) {
+    (void)spec; (void)format; (void)rotate_bytes; (void)keep;
+    return NULL;
+}
+void cdc_close(CdcStream *s) { (void)s; }
+int cdc_emit(CdcStream *s, const CdcEvent *ev) { (void)s; (void)ev; return 0; }
+int cdc_emit_patient(CdcStream *s, CdcType type, const Patient *p, int old_severity, const char *department) {
+    (void)s; (void)type; (void)p; (void)old_severity; (void)department;
+    return 0;
+}
+int cdc_emit_served(CdcStream *s, const Patient *p, int counter_id, long wait_sec, const char *department) {
+    (void)s; (void)p; (void)counter_id; (void)wait_sec; (void)department;
+    return 0;
+}
+void cdc_queue_observer(void *ctx, PqEvent ev, const Patient *p, Severity old_severity) {
+    (void)ctx; (void)ev; (void)p; (void)old_severity;
+}
+void cdc_tap_queue(CdcTap *tap, CdcStream *s, const char *department, PriorityQueue *q) {
+    (void)tap; (void)s; (void)department; (void)q;
+}
+void cdc_untap_queue(CdcTap *tap, PriorityQueue *q) { (void)tap; (void)q; }
+uint64_t cdc_replay(const char *dir, uint64_t from_seq, FILE *out) {
+    (void)dir; (void)out;
+    return from_seq - 1;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../util/file_util.h"
+#include "../util/strbuf.h"
+#include "../util/trace.h"
+
+#define CDC_BATCH_BYTES (64 * 1024)
+
+static int64_t wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ---------- producer side ---------- */
+
+/* Bounded MPMC ring (one writer thread drains it): a producer claims a
+   position with one CAS on head and publishes the slot by bumping its turn. */
+int cdc_emit(CdcStream *s, const CdcEvent *ev) {
+    if (!s || !ev) return 0;
+    uint64_t pos = atomic_load_explicit(&s->head, memory_order_relaxed);
+    for (;;) {
+        CdcSlot *slot = &s->ring[pos & (CDC_RING_SLOTS - 1)];
+        uint64_t turn = atomic_load_explicit(&slot->turn, memory_order_acquire);
+        int64_t dif = (int64_t)(turn - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&s->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                slot->ev = *ev;
+                atomic_store_explicit(&slot->turn, pos + 1, memory_order_release);
+                atomic_fetch_add_explicit(&s->emitted, 1, memory_order_relaxed);
+                return 1;
+            }
+        } else if (dif < 0) {
+            /* writer is a full ring behind: drop rather than stall a desk */
+            atomic_fetch_add_explicit(&s->dropped, 1, memory_order_relaxed);
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&s->head, memory_order_relaxed);
+        }
+    }
+}
+
+static void copy_field(char *dst, size_t dstlen, const char *src) {
+    size_t n = src ? strnlen(src, dstlen - 1) : 0;
+    if (n) memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+int cdc_emit_patient(CdcStream *s, CdcType type, const Patient *p, int old_severity, const char *department) {
+    if (!s || !p) return 0;
+    CdcEvent ev;
+    memset(&ev, 0, sizeof(ev));   /* binary records are written as-is */
+    ev.ts_ms = wall_ms();
+    ev.type = (int32_t)type;
+    ev.patient_id = p->id;
+    ev.severity = (int32_t)p->severity;
+    ev.old_severity = old_severity;
+    ev.age = p->age;
+    ev.phone = p->phone_number;
+    ev.flags = p->flags;
+    copy_field(ev.department, sizeof(ev.department), department);
+    copy_field(ev.name, sizeof(ev.name), p->name);
+    return cdc_emit(s, &ev);
+}
+
+int cdc_emit_served(CdcStream *s, const Patient *p, int counter_id, long wait_sec, const char *department) {
+    if (!s || !p) return 0;
+    CdcEvent ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.ts_ms = wall_ms();
+    ev.type = CDC_SERVED;
+    ev.patient_id = p->id;
+    ev.severity = (int32_t)p->severity;
+    ev.old_severity = -1;
+    ev.age = p->age;
+    ev.counter_id = counter_id;
+    ev.wait_sec = wait_sec;
+    ev.phone = p->phone_number;
+    ev.flags = p->flags;
+    copy_field(ev.department, sizeof(ev.department), department);
+    copy_field(ev.name, sizeof(ev.name), p->name);
+    return cdc_emit(s, &ev);
+}
+
+void cdc_queue_observer(void *ctx, PqEvent ev, const Patient *p, Severity old_severity) {
+    static const CdcType map[] = { CDC_ENQUEUE, CDC_DEQUEUE, CDC_RETRIAGE, CDC_REMOVE };
+    CdcTap *tap = ctx;
+    if (!tap || (unsigned)ev >= sizeof(map) / sizeof(map[0])) return;
+    cdc_emit_patient(tap->stream, map[ev], p, ev == PQ_EV_RETRIAGE ? (int)old_severity : -1, tap->department);
+}
+
+void cdc_tap_queue(CdcTap *tap, CdcStream *s, const char *department, PriorityQueue *q) {
+    if (!tap || !q) return;
+    tap->stream = s;
+    copy_field(tap->department, sizeof(tap->department), department);
+    if (s) pq_add_observer(q, cdc_queue_observer, tap);
+}
+
+void cdc_untap_queue(CdcTap *tap, PriorityQueue *q) {
+    if (tap && tap->stream) pq_remove_observer(q, cdc_queue_observer, tap);
+}
+
+/* ---------- segment files ---------- */
+
+typedef struct Segment {
+    uint64_t first_seq;
+    int binary;
+} Segment;
+
+static int cmp_segment(const void *a, const void *b) {
+    const Segment *sa = a, *sb = b;
+    return (sa->first_seq > sb->first_seq) - (sa->first_seq < sb->first_seq);
+}
+
+/* events-<seq>.ndjson / events-<seq>.bin in dir, sorted by first seq */
+static int list_segments(const char *dir, Segment **out) {
+    *out = NULL;
+    DIR *d = opendir(dir);
+    if (!d) return 0;
+    int n = 0, cap = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        unsigned long long seq;
+        char ext[8];
+        if (sscanf(de->d_name, "events-%llu.%7s", &seq, ext) != 2) continue;
+        int binary = strcmp(ext, "bin") == 0;
+        if (!binary && strcmp(ext, "ndjson") != 0) continue;
+        if (n == cap) {
+            int ncap = cap ? cap * 2 : 16;
+            Segment *ns = realloc(*out, (size_t)ncap * sizeof(Segment));
+            if (!ns) break;
+            *out = ns;
+            cap = ncap;
+        }
+        (*out)[n].first_seq = seq;
+        (*out)[n].binary = binary;
+        n++;
+    }
+    closedir(d);
+    if (n > 1) qsort(*out, (size_t)n, sizeof(Segment), cmp_segment);
+    return n;
+}
+
+static void segment_path(const char *dir, const Segment *sg, char *buf, size_t buflen) {
+    snprintf(buf, buflen, "%s/events-%020llu.%s", dir, (unsigned long long)sg->first_seq,
+             sg->binary ? "bin" : "ndjson");
+}
+
+/* Last seq written to a segment, trimming a torn final record left by a
+   crash. Returns first_seq - 1 for an empty segment. */
+static uint64_t segment_last_seq(const char *path, const Segment *sg) {
+    uint64_t last = sg->first_seq - 1;
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return last;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return last; }
+    off_t size = st.st_size;
+
+    if (sg->binary) {
+        off_t hdr = (off_t)strlen(CDC_BIN_MAGIC);
+        off_t whole = size > hdr ? (size - hdr) / (off_t)sizeof(CdcEvent) : 0;
+        if (size > hdr && hdr + whole * (off_t)sizeof(CdcEvent) != size)
+            if (ftruncate(fd, hdr + whole * (off_t)sizeof(CdcEvent)) != 0) perror("cdc truncate");
+        CdcEvent ev;
+        if (whole > 0 && pread(fd, &ev, sizeof(ev), hdr + (whole - 1) * (off_t)sizeof(CdcEvent)) == (ssize_t)sizeof(ev))
+            last = ev.seq;
+    } else {
+        char tail[4096 + 1];
+        off_t from = size > 4096 ? size - 4096 : 0;
+        ssize_t got = size > 0 ? pread(fd, tail, (size_t)(size - from), from) : 0;
+        if (got > 0) {
+            tail[got] = '\0';
+            char *end = strrchr(tail, '\n');
+            if (!end) {
+                if (from == 0 && ftruncate(fd, 0) != 0) perror("cdc truncate");
+            } else {
+                if (end[1] != '\0' && ftruncate(fd, from + (end - tail) + 1) != 0) perror("cdc truncate");
+                *end = '\0';
+                char *line = strrchr(tail, '\n');
+                line = line ? line + 1 : tail;
+                unsigned long long seq;
+                if (sscanf(line, "{\"seq\":%llu", &seq) == 1) last = seq;
+            }
+        }
+    }
+    close(fd);
+    return last;
+}
+
+static void prune_segments(CdcStream *s) {
+    if (s->keep <= 0) return;
+    Segment *segs;
+    int n = list_segments(s->path, &segs);
+    for (int i = 0; i + s->keep < n; ++i) {
+        char path[512];
+        segment_path(s->path, &segs[i], path, sizeof(path));
+        unlink(path);
+    }
+    free(segs);
+}
+
+static void open_segment(CdcStream *s, uint64_t first_seq) {
+    if (s->fd >= 0) close(s->fd);
+    Segment sg = { first_seq, s->format == CDC_FORMAT_BINARY };
+    char path[512];
+    segment_path(s->path, &sg, path, sizeof(path));
+    s->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    s->file_bytes = 0;
+    if (s->fd < 0) { perror("cdc open segment"); return; }
+    struct stat st;
+    if (fstat(s->fd, &st) == 0) s->file_bytes = (uint64_t)st.st_size;
+    if (sg.binary && s->file_bytes == 0) {
+        size_t hdr = strlen(CDC_BIN_MAGIC);
+        if (write(s->fd, CDC_BIN_MAGIC, hdr) == (ssize_t)hdr) s->file_bytes = hdr;
+    }
+    prune_segments(s);
+}
+
+/* Continue numbering after the newest segment, appending to it when it is
+   in the current format and has room */
+static void resume_dir(CdcStream *s) {
+    s->next_seq = 1;
+    Segment *segs;
+    int n = list_segments(s->path, &segs);
+    if (n > 0) {
+        Segment *last = &segs[n - 1];
+        char path[512];
+        segment_path(s->path, last, path, sizeof(path));
+        s->next_seq = segment_last_seq(path, last) + 1;
+        if (last->binary == (s->format == CDC_FORMAT_BINARY)) {
+            open_segment(s, last->first_seq);
+            if (s->file_bytes >= s->rotate_bytes) { close(s->fd); s->fd = -1; }
+        }
+    }
+    free(segs);
+}
+
+/* ---------- writer thread ---------- */
+
+static void write_all(CdcStream *s, StrBuf *batch) {
+    if (batch->len == 0) return;
+    if (s->fd < 0 && s->is_fifo) {
+        /* ENXIO until a consumer opens the pipe; those events are lost */
+        s->fd = open(s->path, O_WRONLY | O_NONBLOCK);
+        if (s->fd >= 0) fcntl(s->fd, F_SETFL, fcntl(s->fd, F_GETFL) & ~O_NONBLOCK);
+    }
+    size_t off = 0;
+    while (s->fd >= 0 && off < batch->len) {
+        ssize_t w = write(s->fd, batch->data + off, batch->len - off);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (s->is_fifo) { close(s->fd); s->fd = -1; }   /* reader went away */
+            else perror("cdc write");
+            break;
+        }
+        off += (size_t)w;
+    }
+    s->file_bytes += off;
+    sb_reset(batch);
+}
+
+static void append_event(CdcStream *s, StrBuf *batch, CdcEvent *ev) {
+    ev->seq = s->next_seq++;
+    if (!s->is_fifo && (s->fd < 0 || s->file_bytes + batch->len >= s->rotate_bytes)) {
+        write_all(s, batch);
+        open_segment(s, ev->seq);
+    }
+    if (s->format == CDC_FORMAT_BINARY) {
+        sb_append(batch, (const char*)ev, sizeof(*ev));
+    } else {
+        char line[512];
+        int len = cdc_format_json(ev, line, sizeof(line));
+        sb_append(batch, line, (size_t)len);
+    }
+    atomic_fetch_add_explicit(&s->written, 1, memory_order_relaxed);
+    if (batch->len >= CDC_BATCH_BYTES) write_all(s, batch);
+}
+
+static int ring_take(CdcStream *s, CdcEvent *out) {
+    CdcSlot *slot = &s->ring[s->tail & (CDC_RING_SLOTS - 1)];
+    if (atomic_load_explicit(&slot->turn, memory_order_acquire) != s->tail + 1) return 0;
+    *out = slot->ev;
+    atomic_store_explicit(&slot->turn, s->tail + CDC_RING_SLOTS, memory_order_release);
+    s->tail++;
+    return 1;
+}
+
+static int drain(CdcStream *s, StrBuf *batch) {
+    int n = 0;
+    CdcEvent ev;
+    uint64_t lost = atomic_exchange_explicit(&s->dropped, 0, memory_order_relaxed);
+    if (lost) {
+        memset(&ev, 0, sizeof(ev));
+        ev.ts_ms = wall_ms();
+        ev.type = CDC_GAP;
+        ev.patient_id = lost > INT32_MAX ? INT32_MAX : (int32_t)lost;
+        append_event(s, batch, &ev);
+    }
+    while (n < CDC_RING_SLOTS && ring_take(s, &ev)) {
+        append_event(s, batch, &ev);
+        n++;
+    }
+    write_all(s, batch);
+    return n;
+}
+
+static void* writer_main(void *arg) {
+    CdcStream *s = arg;
+    /* a fifo reader that exits must surface as EPIPE here, not kill the process */
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    StrBuf batch;
+    sb_init(&batch);
+    trace_thread_name("cdc-writer");
+    struct timespec pause = { 0, CDC_FLUSH_MS * 1000000L };
+    for (;;) {
+        int stopping = atomic_load(&s->stop);
+        TRACE_BEGIN(span);
+        int n = drain(s, &batch);
+        if (n > 0) TRACE_END(span, "cdc.write_batch");
+        if (stopping && n == 0) break;
+        /* under a burst keep draining instead of letting the ring fill */
+        if (n < CDC_RING_SLOTS / 4) nanosleep(&pause, NULL);
+    }
+    sb_free(&batch);
+    return NULL;
+}
+
+/* ---------- lifecycle ---------- */
+
+static int make_dirs(const char *path) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char *c = buf + 1; *c; ++c) {
+        if (*c != '/') continue;
+        *c = '\0';
+        int ok = ensure_data_dir(buf);
+        *c = '/';
+        if (!ok) return 0;
+    }
+    return ensure_data_dir(buf);
+}
+
+CdcStream* cdc_open(const char *spec, CdcFormat format, uint64_t rotate_bytes, int keep) {
+    if (!spec || !spec[0]) return NULL;
+    CdcStream *s = calloc(1, sizeof(CdcStream));
+    if (!s) return NULL;
+    s->ring = malloc(CDC_RING_SLOTS * sizeof(CdcSlot));
+    if (!s->ring) { free(s); return NULL; }
+    for (uint64_t i = 0; i < CDC_RING_SLOTS; ++i) atomic_init(&s->ring[i].turn, i);
+    atomic_init(&s->head, 0);
+    atomic_init(&s->dropped, 0);
+    atomic_init(&s->emitted, 0);
+    atomic_init(&s->written, 0);
+    atomic_init(&s->stop, 0);
+    s->format = format;
+    s->rotate_bytes = rotate_bytes ? rotate_bytes : 64ull << 20;
+    s->keep = keep;
+    s->fd = -1;
+    s->next_seq = 1;
+
+    if (strncmp(spec, "fifo:", 5) == 0) {
+        s->is_fifo = 1;
+        snprintf(s->path, sizeof(s->path), "%s", spec + 5);
+        struct stat st;
+        if (stat(s->path, &st) != 0 && mkfifo(s->path, 0644) != 0) {
+            perror("cdc mkfifo");
+            goto fail;
+        }
+    } else {
+        snprintf(s->path, sizeof(s->path), "%s", strncmp(spec, "dir:", 4) == 0 ? spec + 4 : spec);
+        if (!make_dirs(s->path)) {
+            fprintf(stderr, "cdc: cannot create %s\n", s->path);
+            goto fail;
+        }
+        resume_dir(s);
+    }
+
+    if (pthread_create(&s->writer, NULL, writer_main, s) != 0) goto fail;
+    s->running = 1;
+    return s;
+
+fail:
+    if (s->fd >= 0) close(s->fd);
+    free(s->ring);
+    free(s);
+    return NULL;
+}
+
+CdcStream* cdc_open_from_env(void) {
+    const char *spec = getenv("HOSP_CDC");
+    if (!spec || !spec[0]) return NULL;
+    const char *fmt = getenv("HOSP_CDC_FORMAT");
+    CdcFormat format = (fmt && strcmp(fmt, "binary") == 0) ? CDC_FORMAT_BINARY : CDC_FORMAT_NDJSON;
+    const char *mb = getenv("HOSP_CDC_ROTATE_MB");
+    long rotate_mb = mb ? strtol(mb, NULL, 10) : 64;
+    if (rotate_mb <= 0) rotate_mb = 64;
+    const char *keep_env = getenv("HOSP_CDC_KEEP");
+    int keep = keep_env ? atoi(keep_env) : 8;
+    return cdc_open(spec, format, (uint64_t)rotate_mb << 20, keep);
+}
+
+void cdc_close(CdcStream *s) {
+    if (!s) return;
+    if (s->running) {
+        atomic_store(&s->stop, 1);
+        pthread_join(s->writer, NULL);
+    }
+    if (s->fd >= 0) close(s->fd);
+    free(s->ring);
+    free(s);
+}
+
+/* ---------- consumer side ---------- */
+
+uint64_t cdc_replay(const char *dir, uint64_t from_seq, FILE *out) {
+    uint64_t last = from_seq ? from_seq - 1 : 0;
+    Segment *segs;
+    int n = list_segments(dir, &segs);
+    /* the newest segment starting at or before from_seq holds it */
+    int start = 0;
+    for (int i = 0; i < n; ++i) if (segs[i].first_seq <= from_seq) start = i;
+
+    for (int i = start; i < n; ++i) {
+        char path[512];
+        segment_path(dir, &segs[i], path, sizeof(path));
+        FILE *f = fopen(path, "rb");
+        if (!f) continue;
+        if (segs[i].binary) {
+            char magic[16];
+            size_t hdr = strlen(CDC_BIN_MAGIC);
+            if (fread(magic, 1, hdr, f) != hdr || memcmp(magic, CDC_BIN_MAGIC, hdr) != 0) { fclose(f); continue; }
+            CdcEvent ev;
+            char line[512];
+            while (fread(&ev, sizeof(ev), 1, f) == 1) {
+                if (ev.seq < from_seq) continue;
+                ev.department[CDC_DEPT_LEN - 1] = '\0';
+                ev.name[CDC_NAME_LEN - 1] = '\0';
+                cdc_format_json(&ev, line, sizeof(line));
+                fputs(line, out);
+                last = ev.seq;
+            }
+        } else {
+            char line[1024];
+            while (fgets(line, sizeof(line), f)) {
+                unsigned long long seq;
+                /* a line still being written has no newline yet */
+                if (!strchr(line, '\n') || sscanf(line, "{\"seq\":%llu", &seq) != 1) break;
+                if (seq < from_seq) continue;
+                fputs(line, out);
+                last = seq;
+            }
+        }
+        fclose(f);
+    }
+    free(segs);
+    return last;
+}
+
+#endif
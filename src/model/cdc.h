@@ -0,0 +1,123 @@
+#ifndef CDC_H
+#define CDC_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "patient.h"
+#include "queue.h"
+
+/* Change-data-capture stream of queue and served events.
+
+   Producers (the queue observer and the serve paths) copy a fixed-size
+   CdcEvent into a bounded lock-free ring and return; they never take a lock,
+   touch the disk or wait. A writer thread drains the ring every
+   CDC_FLUSH_MS, numbers the events, encodes the batch and writes it with one
+   write() per batch. If the ring is full the event is dropped and counted;
+   the writer then emits a GAP event carrying the number lost, so consumers
+   can tell a quiet queue from a lossy one.
+
+   Sinks (HOSP_CDC):
+     dir:<path>   rotating log, <path>/events-<first seq>.ndjson (or .bin).
+                  Sequence numbers continue across restarts and files are
+                  named by their first seq, so a consumer resumes from seq N
+                  by opening the last file whose name is <= N (cdc_replay).
+     fifo:<path>  named pipe for a live consumer; events are dropped while
+                  no reader has it open.
+   HOSP_CDC_FORMAT=ndjson|binary, HOSP_CDC_ROTATE_MB (default 64),
+   HOSP_CDC_KEEP files kept in dir mode (default 8, 0 = keep all). */
+
+#define CDC_RING_SLOTS 4096         /* power of two */
+#define CDC_FLUSH_MS 50
+#define CDC_DEPT_LEN 24
+#define CDC_NAME_LEN 48
+#define CDC_BIN_MAGIC "HQCDC01\n"   /* 8-byte header of every .bin file */
+
+typedef enum {
+    CDC_ENQUEUE = 1,          /* registered, or transferred in */
+    CDC_DEQUEUE = 2,          /* called to a counter / served on the spot */
+    CDC_RETRIAGE = 3,         /* severity changed; old_severity set */
+    CDC_REMOVE = 4,           /* left without being served (transfer out, no-show) */
+    CDC_SERVED = 5,           /* service finished; counter_id, wait_sec set */
+    CDC_GAP = 6               /* patient_id holds the number of events dropped */
+} CdcType;
+
+typedef enum { CDC_FORMAT_NDJSON = 0, CDC_FORMAT_BINARY = 1 } CdcFormat;
+
+/* One event; also the on-disk record of the binary format */
+typedef struct CdcEvent {
+    uint64_t seq;             /* assigned by the writer, contiguous */
+    int64_t ts_ms;            /* wall clock, milliseconds */
+    int32_t type;             /* CdcType */
+    int32_t patient_id;
+    int32_t severity;
+    int32_t old_severity;     /* RETRIAGE only, else -1 */
+    int32_t age;
+    int32_t counter_id;       /* SERVED only; 0 = served on the spot */
+    int64_t wait_sec;         /* SERVED only */
+    int64_t phone;
+    uint32_t flags;           /* PATIENT_* */
+    char department[CDC_DEPT_LEN];
+    char name[CDC_NAME_LEN];
+} CdcEvent;
+
+typedef struct CdcSlot {
+    _Atomic uint64_t turn;    /* == position when free, position + 1 when filled */
+    CdcEvent ev;
+} CdcSlot;
+
+typedef struct CdcStream {
+    CdcSlot *ring;
+    _Atomic uint64_t head;    /* next position producers claim */
+    uint64_t tail;            /* next position the writer drains (writer only) */
+    _Atomic uint64_t dropped; /* ring-full drops since the last GAP */
+    _Atomic uint64_t emitted;
+    _Atomic uint64_t written;
+    atomic_int stop;
+    pthread_t writer;
+    int running;
+
+    /* writer-thread state */
+    CdcFormat format;
+    int is_fifo;
+    char path[256];           /* directory or fifo */
+    int fd;
+    uint64_t next_seq;
+    uint64_t file_bytes;
+    uint64_t rotate_bytes;
+    int keep;
+} CdcStream;
+
+/* Per-queue context for cdc_queue_observer: which stream, which department */
+typedef struct CdcTap {
+    CdcStream *stream;
+    char department[CDC_DEPT_LEN];
+} CdcTap;
+
+/* Open from HOSP_CDC; NULL when unset or the sink cannot be prepared */
+CdcStream* cdc_open_from_env(void);
+CdcStream* cdc_open(const char *spec, CdcFormat format, uint64_t rotate_bytes, int keep);
+/* Flushes everything emitted so far, stops the writer and frees the stream */
+void cdc_close(CdcStream *s);
+
+/* Never blocks: returns 0 (and counts a drop) if the ring is full */
+int cdc_emit(CdcStream *s, const CdcEvent *ev);
+int cdc_emit_patient(CdcStream *s, CdcType type, const Patient *p, int old_severity, const char *department);
+int cdc_emit_served(CdcStream *s, const Patient *p, int counter_id, long wait_sec, const char *department);
+
+/* PqObserver forwarding queue mutations; ctx is a CdcTap */
+void cdc_queue_observer(void *ctx, PqEvent ev, const Patient *p, Severity old_severity);
+/* No-op when s is NULL, so callers can tap unconditionally */
+void cdc_tap_queue(CdcTap *tap, CdcStream *s, const char *department, PriorityQueue *q);
+void cdc_untap_queue(CdcTap *tap, PriorityQueue *q);
+
+const char* cdc_type_name(int type);
+/* One NDJSON line, '\n'-terminated; returns its length */
+int cdc_format_json(const CdcEvent *ev, char *buf, size_t buflen);
+
+/* Consumer side: write every logged event with seq >= from_seq as NDJSON
+   to out, oldest first. Returns the last seq written, or from_seq - 1 if none. */
+uint64_t cdc_replay(const char *dir, uint64_t from_seq, FILE *out);
+
+#endif /* CDC_H */
@@ -0,0 +1,140 @@
+#include "cqueue.h"
+#include <stdlib.h>
+
+int cq_init(ConcurrentQueue *cq) {
+    if (!cq) return 0;
+    for (int i = 0; i < CQ_LANES; ++i) {
+        if (pthread_mutex_init(&cq->lanes[i].lock, NULL) != 0) return 0;
+        cq->lanes[i].head = cq->lanes[i].tail = NULL;
+        atomic_init(&cq->lanes[i].count, 0);
+    }
+    atomic_init(&cq->total, 0);
+    atomic_init(&cq->waiters, 0);
+    cq->closed = 0;
+    if (pthread_mutex_init(&cq->wait_lock, NULL) != 0) return 0;
+    if (pthread_cond_init(&cq->nonempty, NULL) != 0) return 0;
+    return 1;
+}
+
+void cq_destroy(ConcurrentQueue *cq) {
+    if (!cq) return;
+    for (int i = 0; i < CQ_LANES; ++i) {
+        Patient *cur = cq->lanes[i].head;
+        while (cur) {
+            Patient *nx = cur->next;
+            free_patient(cur);
+            cur = nx;
+        }
+        cq->lanes[i].head = cq->lanes[i].tail = NULL;
+        pthread_mutex_destroy(&cq->lanes[i].lock);
+    }
+    pthread_mutex_destroy(&cq->wait_lock);
+    pthread_cond_destroy(&cq->nonempty);
+}
+
+static int lane_index(Severity sev) {
+    if (sev < NORMAL) return NORMAL;
+    if (sev > CRITICAL) return CRITICAL;
+    return (int)sev;
+}
+
+void cq_enqueue(ConcurrentQueue *cq, Patient *p) {
+    if (!cq || !p) return;
+    CQLane *lane = &cq->lanes[lane_index(p->severity)];
+    p->next = NULL;
+
+    pthread_mutex_lock(&lane->lock);
+    if (lane->tail) lane->tail->next = p;
+    else lane->head = p;
+    lane->tail = p;
+    /* publish under the lock so a consumer that sees count > 0 finds the node */
+    atomic_fetch_add_explicit(&lane->count, 1, memory_order_release);
+    pthread_mutex_unlock(&lane->lock);
+    /* seq_cst pairs with cq_dequeue_wait: either we see its waiter count
+       or it sees our total */
+    atomic_fetch_add(&cq->total, 1);
+
+    /* only pay for the condvar when a consumer is actually blocked */
+    if (atomic_load(&cq->waiters) > 0) {
+        pthread_mutex_lock(&cq->wait_lock);
+        pthread_cond_signal(&cq->nonempty);
+        pthread_mutex_unlock(&cq->wait_lock);
+    }
+}
+
+static Patient* lane_pop(CQLane *lane) {
+    if (atomic_load_explicit(&lane->count, memory_order_acquire) == 0) return NULL;
+
+    pthread_mutex_lock(&lane->lock);
+    Patient *p = lane->head;
+    if (p) {
+        lane->head = p->next;
+        if (!lane->head) lane->tail = NULL;
+        atomic_fetch_sub_explicit(&lane->count, 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&lane->lock);
+    if (p) p->next = NULL;
+    return p;
+}
+
+Patient* cq_try_dequeue(ConcurrentQueue *cq) {
+    if (!cq) return NULL;
+    for (int sev = CRITICAL; sev >= NORMAL; --sev) {
+        Patient *p = lane_pop(&cq->lanes[sev]);
+        if (p) {
+            atomic_fetch_sub_explicit(&cq->total, 1, memory_order_relaxed);
+            return p;
+        }
+    }
+    return NULL;
+}
+
+Patient* cq_dequeue_wait(ConcurrentQueue *cq) {
+    if (!cq) return NULL;
+    for (;;) {
+        Patient *p = cq_try_dequeue(cq);
+        if (p) return p;
+
+        pthread_mutex_lock(&cq->wait_lock);
+        atomic_fetch_add(&cq->waiters, 1);
+        /* re-check after announcing ourselves so a racing enqueue cannot be missed */
+        while (!cq->closed && atomic_load(&cq->total) == 0) {
+            pthread_cond_wait(&cq->nonempty, &cq->wait_lock);
+        }
+        atomic_fetch_sub_explicit(&cq->waiters, 1, memory_order_acq_rel);
+        int closed = cq->closed;
+        pthread_mutex_unlock(&cq->wait_lock);
+
+        if (closed) return cq_try_dequeue(cq);
+    }
+}
+
+void cq_close(ConcurrentQueue *cq) {
+    if (!cq) return;
+    pthread_mutex_lock(&cq->wait_lock);
+    cq->closed = 1;
+    pthread_cond_broadcast(&cq->nonempty);
+    pthread_mutex_unlock(&cq->wait_lock);
+}
+
+int cq_size(ConcurrentQueue *cq) {
+    if (!cq) return 0;
+    return atomic_load_explicit(&cq->total, memory_order_relaxed);
+}
+
+int cq_size_by_severity(ConcurrentQueue *cq, Severity sev) {
+    if (!cq) return 0;
+    return atomic_load_explicit(&cq->lanes[lane_index(sev)].count, memory_order_relaxed);
+}
+
+void cq_load_from(ConcurrentQueue *cq, PriorityQueue *q) {
+    if (!cq || !q) return;
+    Patient *p;
+    while ((p = pq_dequeue(q)) != NULL) cq_enqueue(cq, p);
+}
+
+void cq_drain_into(ConcurrentQueue *cq, PriorityQueue *q) {
+    if (!cq || !q) return;
+    Patient *p;
+    while ((p = cq_try_dequeue(cq)) != NULL) pq_enqueue(q, p);
+}
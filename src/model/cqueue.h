@@ -0,0 +1,57 @@
+#ifndef CQUEUE_H
+#define CQUEUE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "patient.h"
+#include "queue.h"
+
+#define CQ_LANES 3          /* one FIFO per Severity */
+#define CQ_CACHELINE 64
+
+/* Thread-safe priority queue for many registration threads (producers)
+   and doctor counters (consumers).
+
+   Each severity has its own FIFO lane behind its own mutex, so producers
+   of different severities never contend. A consumer probes lanes from
+   CRITICAL down using the per-lane atomic counts, and only takes a lock
+   on a lane that looks non-empty. A patient is never handed out while a
+   higher-severity patient was already visible in the queue.
+
+   Patients are linked through Patient.next, like in PriorityQueue, so
+   moving between the two never allocates. */
+
+typedef struct CQLane {
+    pthread_mutex_t lock;
+    Patient *head;
+    Patient *tail;
+    atomic_int count;
+    char pad[CQ_CACHELINE];   /* keep lanes on separate cache lines */
+} CQLane;
+
+typedef struct ConcurrentQueue {
+    CQLane lanes[CQ_LANES];
+    atomic_int total;
+    atomic_int waiters;
+    int closed;
+    pthread_mutex_t wait_lock;
+    pthread_cond_t nonempty;
+} ConcurrentQueue;
+
+int cq_init(ConcurrentQueue *cq);
+void cq_destroy(ConcurrentQueue *cq);      /* frees any patients still queued */
+
+void cq_enqueue(ConcurrentQueue *cq, Patient *p);
+Patient* cq_try_dequeue(ConcurrentQueue *cq);          /* NULL if empty */
+Patient* cq_dequeue_wait(ConcurrentQueue *cq);         /* blocks; NULL once closed and empty */
+void cq_close(ConcurrentQueue *cq);                    /* wake all blocked consumers */
+
+int cq_size(ConcurrentQueue *cq);
+int cq_size_by_severity(ConcurrentQueue *cq, Severity sev);
+
+/* Move every patient between the single-threaded and concurrent queues.
+   Not safe while other threads are using cq. */
+void cq_load_from(ConcurrentQueue *cq, PriorityQueue *q);
+void cq_drain_into(ConcurrentQueue *cq, PriorityQueue *q);
+
+#endif
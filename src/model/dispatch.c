@@ -0,0 +1,223 @@
+#include "dispatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "history.h"
+#include "cdc.h"
+#include "../util/metrics.h"
+#include "../util/trace.h"
+
+/* Used until real service durations have been measured (seconds) */
+static const double DEFAULT_SVC_SEC[3] = { 3 * 60, 5 * 60, 10 * 60 };
+
+void dispatch_init(Dispatcher *d, int counters, const char *history_path) {
+    if (!d) return;
+    memset(d, 0, sizeof(*d));
+    if (counters < 1) counters = 1;
+    if (counters > DISPATCH_MAX_COUNTERS) counters = DISPATCH_MAX_COUNTERS;
+    d->n = counters;
+    d->history_path = history_path ? history_path : HISTORY_FILE;
+    time_t now = time(NULL);
+    for (int i = 0; i < counters; ++i) {
+        d->counters[i].id = i + 1;
+        d->counters[i].free_since = now;
+    }
+}
+
+int dispatch_counters_from_env(void) {
+    const char *env = getenv("HOSP_COUNTERS");
+    int n = env ? atoi(env) : 0;
+    if (n < 1 || n > DISPATCH_MAX_COUNTERS) n = DISPATCH_DEFAULT_COUNTERS;
+    return n;
+}
+
+int dispatch_set_counters(Dispatcher *d, int counters) {
+    if (!d || counters < 1 || counters > DISPATCH_MAX_COUNTERS) return 0;
+    for (int i = counters; i < d->n; ++i) if (d->counters[i].current) return 0;
+    time_t now = time(NULL);
+    for (int i = d->n; i < counters; ++i) {
+        memset(&d->counters[i], 0, sizeof(Counter));
+        d->counters[i].id = i + 1;
+        d->counters[i].free_since = now;
+    }
+    d->n = counters;
+    return 1;
+}
+
+static void record_duration(Dispatcher *d, int sev, double sec) {
+    if (sev < 0 || sev > 2 || sec < 0) return;
+    d->svc_sum[sev] += sec;
+    d->svc_cnt[sev]++;
+}
+
+void dispatch_load_history(Dispatcher *d) {
+    if (!d) return;
+    FILE *f = fopen(d->history_path, "r");
+    if (!f) return;
+    uint64_t t0 = metrics_begin(MET_HISTORY_SCAN);
+    TRACE_BEGIN(span);
+    char line[1024];
+    ServedRecord r;
+    while (fgets(line, sizeof(line), f)) {
+        /* counter 0 rows were served on the spot: their service_end is served_at */
+        if (!history_parse_line(line, &r) || r.service_end[0] == '\0' || r.counter_id == 0) continue;
+        time_t start = parse_iso_time(r.served_at), end = parse_iso_time(r.service_end);
+        if (start != (time_t)-1 && end != (time_t)-1 && end > start) {
+            record_duration(d, r.severity, (double)(end - start));
+        }
+    }
+    fclose(f);
+    metrics_end(MET_HISTORY_SCAN, t0);
+    TRACE_END(span, "history.service_times");
+}
+
+double dispatch_avg_service_sec(const Dispatcher *d, Severity sev) {
+    int s = (sev < NORMAL || sev > CRITICAL) ? NORMAL : (int)sev;
+    if (!d || d->svc_cnt[s] == 0) return DEFAULT_SVC_SEC[s];
+    double avg = d->svc_sum[s] / (double)d->svc_cnt[s];
+    return avg < 1.0 ? 1.0 : avg;
+}
+
+double dispatch_throughput_per_hour(const Dispatcher *d) {
+    if (!d) return 0.0;
+    /* service mix weighted by what has actually been served */
+    long total = d->svc_cnt[0] + d->svc_cnt[1] + d->svc_cnt[2];
+    double avg;
+    if (total == 0) {
+        avg = (DEFAULT_SVC_SEC[0] + DEFAULT_SVC_SEC[1] + DEFAULT_SVC_SEC[2]) / 3.0;
+    } else {
+        avg = (d->svc_sum[0] + d->svc_sum[1] + d->svc_sum[2]) / (double)total;
+        if (avg < 1.0) avg = 1.0;
+    }
+    return d->n * 3600.0 / avg;
+}
+
+Counter* dispatch_counter(Dispatcher *d, int counter_id) {
+    if (!d || counter_id < 1 || counter_id > d->n) return NULL;
+    return &d->counters[counter_id - 1];
+}
+
+int dispatch_busy_count(const Dispatcher *d) {
+    int busy = 0;
+    for (int i = 0; d && i < d->n; ++i) if (d->counters[i].current) busy++;
+    return busy;
+}
+
+Counter* dispatch_call_next(Dispatcher *d, PriorityQueue *q, const char *department, time_t now) {
+    if (!d || !q || pq_is_empty(q)) return NULL;
+
+    Counter *best = NULL;
+    for (int i = 0; i < d->n; ++i) {
+        Counter *c = &d->counters[i];
+        if (c->current) continue;
+        if (!best || c->free_since < best->free_since) best = c;
+    }
+    if (!best) return NULL;
+
+    TRACE_BEGIN(span);
+    best->current = pq_dequeue(q);
+    best->service_start = now;
+    snprintf(best->department, sizeof(best->department), "%s", department ? department : "");
+    if (d->observer) d->observer(d->observer_ctx, best, 1);
+    TRACE_END(span, "dispatch.call_next");
+    return best;
+}
+
+long dispatch_complete(Dispatcher *d, int counter_id, time_t now) {
+    Counter *c = dispatch_counter(d, counter_id);
+    if (!c || !c->current) return -1;
+
+    TRACE_BEGIN(span);
+    Patient *p = c->current;
+    long dur = (long)(now - c->service_start);
+    if (dur < 0) dur = 0;
+    long wait = p->arrival_ts != (time_t)-1 ? (long)(c->service_start - p->arrival_ts) : 0;
+
+    char start_iso[TIME_LEN], end_iso[TIME_LEN];
+    format_iso_time(c->service_start, start_iso, sizeof(start_iso));
+    format_iso_time(now, end_iso, sizeof(end_iso));
+    history_append_served(d->history_path, p, start_iso, wait, end_iso, c->id, c->department);
+    cdc_emit_served(d->cdc, p, c->id, wait, c->department);
+    if (d->observer) d->observer(d->observer_ctx, c, 0);
+
+    record_duration(d, (int)p->severity, (double)dur);
+    c->served++;
+    c->busy_sec += dur;
+    c->current = NULL;
+    c->free_since = now;
+    free_patient(p);
+    TRACE_END(span, "dispatch.complete");
+    return dur;
+}
+
+void dispatch_complete_all(Dispatcher *d, time_t now) {
+    for (int i = 0; d && i < d->n; ++i) {
+        if (d->counters[i].current) dispatch_complete(d, d->counters[i].id, now);
+    }
+}
+
+/* when each counter is expected to be free, in seconds from now */
+static void counters_free_at(const Dispatcher *d, time_t now, double *free_at) {
+    for (int i = 0; i < d->n; ++i) {
+        const Counter *c = &d->counters[i];
+        if (!c->current) { free_at[i] = 0.0; continue; }
+        double left = (double)(c->service_start - now) + dispatch_avg_service_sec(d, c->current->severity);
+        free_at[i] = left > 0.0 ? left : 0.0;
+    }
+}
+
+void dispatch_eta_ordered(const Dispatcher *d, const int *severity, int n, time_t now, long *eta_out) {
+    if (!eta_out || n <= 0) return;
+    if (!d || !severity || d->n == 0) {
+        for (int k = 0; k < n; ++k) eta_out[k] = -1;
+        return;
+    }
+    double free_at[DISPATCH_MAX_COUNTERS];
+    counters_free_at(d, now, free_at);
+    for (int k = 0; k < n; ++k) {
+        int slot = 0;
+        for (int i = 1; i < d->n; ++i) if (free_at[i] < free_at[slot]) slot = i;
+        eta_out[k] = (long)(free_at[slot] + 0.5);
+        free_at[slot] += dispatch_avg_service_sec(d, (Severity)severity[k]);
+    }
+}
+
+typedef struct SeverityList {
+    int *sev;
+    int n;
+} SeverityList;
+
+static int collect_severity(void *ctx, const Patient *p) {
+    SeverityList *l = ctx;
+    l->sev[l->n++] = (int)p->severity;
+    return 1;
+}
+
+long dispatch_eta_sec(const Dispatcher *d, PriorityQueue *q, const Patient *p, time_t now, int *counter_out) {
+    if (!d || !q || !p || d->n == 0) return -1;
+    int pos = pq_position(q, p);
+    if (pos <= 0) return -1;
+
+    double free_at[DISPATCH_MAX_COUNTERS];
+    counters_free_at(d, now, free_at);
+
+    SeverityList ahead = { NULL, 0 };
+    if (pos > 1) {
+        ahead.sev = malloc((size_t)(pos - 1) * sizeof(int));
+        if (!ahead.sev) return -1;
+        pq_service_walk(q, pos - 1, collect_severity, &ahead);
+    }
+
+    /* replay the queue: each patient ahead takes the earliest-free counter */
+    int slot = 0;
+    for (int k = 0; k < pos; ++k) {
+        slot = 0;
+        for (int i = 1; i < d->n; ++i) if (free_at[i] < free_at[slot]) slot = i;
+        if (k == pos - 1) break;
+        free_at[slot] += dispatch_avg_service_sec(d, k < ahead.n ? (Severity)ahead.sev[k] : p->severity);
+    }
+    free(ahead.sev);
+
+    if (counter_out) *counter_out = d->counters[slot].id;
+    return (long)(free_at[slot] + 0.5);
+}
@@ -0,0 +1,70 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <time.h>
+#include "patient.h"
+#include "queue.h"
+
+#define DISPATCH_MAX_COUNTERS 64
+#define DISPATCH_DEFAULT_COUNTERS 3
+
+/* A doctor counter. current is NULL while the counter is free. */
+typedef struct Counter {
+    int id;                   /* 1-based, as shown to patients */
+    Patient *current;
+    time_t service_start;
+    time_t free_since;
+    long served;
+    long busy_sec;
+    char department[32];      /* department the current patient came from */
+} Counter;
+
+/* Models N counters. The next patient goes to the counter that became
+   free first. Measured service durations (per severity) drive throughput
+   and ETA estimates. */
+struct CdcStream;
+
+/* Called with started = 1 right after a patient is assigned to c, and with
+   started = 0 when c finishes, before its patient is freed */
+typedef void (*DispatchObserver)(void *ctx, const Counter *c, int started);
+
+typedef struct Dispatcher {
+    Counter counters[DISPATCH_MAX_COUNTERS];
+    int n;
+    double svc_sum[3];
+    long svc_cnt[3];
+    const char *history_path;
+    struct CdcStream *cdc;    /* optional; gets a SERVED event per completion */
+    DispatchObserver observer;   /* optional */
+    void *observer_ctx;
+} Dispatcher;
+
+void dispatch_init(Dispatcher *d, int counters, const char *history_path);
+int dispatch_counters_from_env(void);                 /* HOSP_COUNTERS, default 3 */
+/* Grow or shrink to this many counters; 0 if out of range or a counter
+   that would go is still serving */
+int dispatch_set_counters(Dispatcher *d, int counters);
+void dispatch_load_history(Dispatcher *d);            /* seed durations from served.csv */
+
+/* Assign the next patient to the longest-idle free counter.
+   Returns the counter, or NULL if the queue is empty or every counter is busy. */
+Counter* dispatch_call_next(Dispatcher *d, PriorityQueue *q, const char *department, time_t now);
+
+/* Finish the service at counter_id: appends the served record (start, end,
+   counter), updates the duration stats and frees the patient.
+   Returns the service duration in seconds, or -1 if that counter was idle. */
+long dispatch_complete(Dispatcher *d, int counter_id, time_t now);
+void dispatch_complete_all(Dispatcher *d, time_t now);
+
+Counter* dispatch_counter(Dispatcher *d, int counter_id);
+int dispatch_busy_count(const Dispatcher *d);
+double dispatch_avg_service_sec(const Dispatcher *d, Severity sev);
+double dispatch_throughput_per_hour(const Dispatcher *d);
+
+/* Expected seconds until p reaches a counter, and which counter (1-based) */
+long dispatch_eta_sec(const Dispatcher *d, PriorityQueue *q, const Patient *p, time_t now, int *counter_out);
+/* ETAs for the first n patients in service order, given their severities,
+   in one replay */
+void dispatch_eta_ordered(const Dispatcher *d, const int *severity, int n, time_t now, long *eta_out);
+
+#endif
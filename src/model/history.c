@@ -0,0 +1,219 @@
+#include "history.h"
+#include "../util/metrics.h"
+#include "../util/trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+int history_append_served(const char *path, const Patient *p, const char *served_at_iso, long wait_seconds,
+                          const char *service_end_iso, int counter_id, const char *department) {
+    if (!path || !p || !served_at_iso) return 0;
+
+    FILE *f = fopen(path, "a");
+    if (!f) return 0;
+
+    /* readers skip the first line, so a fresh file needs its header */
+    fseek(f, 0, SEEK_END);
+    if (ftell(f) == 0) fputs(HISTORY_HEADER, f);
+
+    fprintf(f, "%d,%lld,%s,%d,%d,%s,%s,%ld,%s,%s,%d,%s\n",
+            p->id,
+            p->phone_number,
+            p->name ? p->name : "",
+            p->age,
+            (int)p->severity,
+            p->arrival,
+            served_at_iso,
+            wait_seconds,
+            p->problem ? p->problem : "",
+            service_end_iso ? service_end_iso : "",
+            counter_id,
+            department ? department : "");
+    fclose(f);
+    return 1;
+}
+
+int history_append_noshow(const char *path, const Patient *p, const char *marked_at_iso, long wait_seconds,
+                          const char *department) {
+    if (!path || !p || !marked_at_iso) return 0;
+
+    FILE *f = fopen(path, "a");
+    if (!f) return 0;
+    fseek(f, 0, SEEK_END);
+    if (ftell(f) == 0) fputs(NOSHOW_HEADER, f);
+
+    fprintf(f, "%d,%lld,%s,%d,%d,%s,%s,%ld,%s,%s\n",
+            p->id,
+            p->phone_number,
+            p->name ? p->name : "",
+            p->age,
+            (int)p->severity,
+            p->arrival,
+            marked_at_iso,
+            wait_seconds,
+            p->problem ? p->problem : "",
+            department ? department : "");
+    fclose(f);
+    return 1;
+}
+
+static void copy_field(char *dst, size_t dstlen, const char *src, size_t len) {
+    if (len >= dstlen) len = dstlen - 1;
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+/* "YYYY-MM-DD HH:MM:SS", checked by hand: this runs on every row */
+static int is_timestamp_or_empty(const char *s, size_t len) {
+    static const char layout[] = "0000-00-00 00:00:00";
+    if (len == 0) return 1;
+    if (len < 19) return 0;
+    for (int i = 0; i < 19; ++i) {
+        if (layout[i] == '0' ? (s[i] < '0' || s[i] > '9') : s[i] != layout[i]) return 0;
+    }
+    return 1;
+}
+
+int history_split_line(const char *line, HistoryView *v) {
+    if (!line || !v) return 0;
+
+    /* field boundaries; the problem text may itself contain commas on old rows */
+    enum { MAX_FIELDS = 64 };
+    const char *start[MAX_FIELDS];
+    size_t len[MAX_FIELDS];
+    int nf = 0;
+    const char *cur = line;
+    size_t linelen = strcspn(line, "\r\n");
+    const char *end = line + linelen;
+    while (nf < MAX_FIELDS) {
+        const char *comma = memchr(cur, ',', (size_t)(end - cur));
+        start[nf] = cur;
+        len[nf] = comma ? (size_t)(comma - cur) : (size_t)(end - cur);
+        nf++;
+        if (!comma) break;
+        cur = comma + 1;
+    }
+    if (nf < 9) return 0;
+    for (int c = 0; c < HC_PROBLEM; ++c) {
+        v->col[c] = start[c];
+        v->len[c] = len[c];
+    }
+
+    /* trailing service_end,counter[,department] columns are present on newer rows */
+    int last_problem = nf - 1;
+    for (int c = HC_SERVICE_END; c < HISTORY_COLS; ++c) {
+        v->col[c] = end;
+        v->len[c] = 0;
+    }
+    char num[32];
+    char *endp;
+    for (int extra = 3; extra >= 2; --extra) {
+        int ts = nf - extra, ctr = nf - extra + 1;
+        if (nf < 9 + extra || !is_timestamp_or_empty(start[ts], len[ts])) continue;
+        copy_field(num, sizeof(num), start[ctr], len[ctr]);
+        strtol(num, &endp, 10);
+        if (endp == num || *endp != '\0') continue;
+        v->col[HC_SERVICE_END] = start[ts];
+        v->len[HC_SERVICE_END] = len[ts];
+        v->col[HC_COUNTER] = start[ctr];
+        v->len[HC_COUNTER] = len[ctr];
+        if (extra == 3) {
+            v->col[HC_DEPARTMENT] = start[nf - 1];
+            v->len[HC_DEPARTMENT] = len[nf - 1];
+        }
+        last_problem = nf - extra - 1;
+        break;
+    }
+    v->col[HC_PROBLEM] = start[8];
+    v->len[HC_PROBLEM] = (size_t)(start[last_problem] + len[last_problem] - start[8]);
+    return 1;
+}
+
+int history_parse_line(const char *line, ServedRecord *r) {
+    HistoryView v;
+    if (!r || !history_split_line(line, &v)) return 0;
+
+    char num[32];
+    char *endp;
+    copy_field(num, sizeof(num), v.col[HC_ID], v.len[HC_ID]);
+    r->id = (int)strtol(num, &endp, 10);
+    if (endp == num) return 0;
+    copy_field(num, sizeof(num), v.col[HC_PHONE], v.len[HC_PHONE]);
+    r->phone = strtoll(num, NULL, 10);
+    copy_field(r->name, sizeof(r->name), v.col[HC_NAME], v.len[HC_NAME]);
+    copy_field(num, sizeof(num), v.col[HC_AGE], v.len[HC_AGE]);
+    r->age = atoi(num);
+    copy_field(num, sizeof(num), v.col[HC_SEVERITY], v.len[HC_SEVERITY]);
+    r->severity = (int)strtol(num, &endp, 10);
+    if (endp == num || r->severity < 0 || r->severity > 2) return 0;
+    copy_field(r->arrival, sizeof(r->arrival), v.col[HC_ARRIVAL], v.len[HC_ARRIVAL]);
+    copy_field(r->served_at, sizeof(r->served_at), v.col[HC_SERVED_AT], v.len[HC_SERVED_AT]);
+    copy_field(num, sizeof(num), v.col[HC_WAIT], v.len[HC_WAIT]);
+    r->wait_sec = strtol(num, &endp, 10);
+    if (endp == num) return 0;
+
+    copy_field(r->problem, sizeof(r->problem), v.col[HC_PROBLEM], v.len[HC_PROBLEM]);
+    copy_field(r->service_end, sizeof(r->service_end), v.col[HC_SERVICE_END], v.len[HC_SERVICE_END]);
+    copy_field(num, sizeof(num), v.col[HC_COUNTER], v.len[HC_COUNTER]);
+    r->counter_id = (int)strtol(num, NULL, 10);
+    copy_field(r->department, sizeof(r->department), v.col[HC_DEPARTMENT], v.len[HC_DEPARTMENT]);
+    return 1;
+}
+
+int history_seek_tail(FILE *f, long n) {
+    if (!f || fseek(f, 0, SEEK_END) != 0) return 0;
+    long size = ftell(f);
+    if (size < 0) return 0;
+
+    /* the first line is the header: never start before its end */
+    char line[1024];
+    rewind(f);
+    long body = fgets(line, sizeof(line), f) ? ftell(f) : 0;
+    if (n <= 0) return fseek(f, size, SEEK_SET) == 0;
+
+    /* count newlines back from the end; the final one ends the last line */
+    char block[8192];
+    long pos = size, found = 0, start = body;
+    int skip_last = 1;
+    while (pos > body && start == body) {
+        long chunk = pos - body < (long)sizeof(block) ? pos - body : (long)sizeof(block);
+        pos -= chunk;
+        if (fseek(f, pos, SEEK_SET) != 0 || fread(block, 1, (size_t)chunk, f) != (size_t)chunk) return 0;
+        for (long i = chunk - 1; i >= 0; --i) {
+            if (block[i] != '\n') continue;
+            if (skip_last && pos + i == size - 1) { skip_last = 0; continue; }
+            if (++found == n) { start = pos + i + 1; break; }
+        }
+    }
+    return fseek(f, start, SEEK_SET) == 0;
+}
+
+int history_next_id(const char *queue_path, const char *served_path) {
+    uint64_t t0 = metrics_begin(MET_HISTORY_SCAN);
+    TRACE_BEGIN(span);
+    int maxid = 0;
+    const char *files[] = {queue_path, served_path};
+    char line[1024];
+
+    for (int i = 0; i < 2; ++i) {
+        if (!files[i]) continue;
+        FILE *f = fopen(files[i], "r");
+        if (!f) continue;
+
+        if (fgets(line, sizeof(line), f) == NULL) {
+            fclose(f);
+            continue;
+        }
+
+        while (fgets(line, sizeof(line), f)) {
+            int id = 0;
+            if (sscanf(line, "%d,", &id) == 1 && id > maxid) {
+                maxid = id;
+            }
+        }
+        fclose(f);
+    }
+    metrics_end(MET_HISTORY_SCAN, t0);
+    TRACE_END(span, "history.next_id");
+    return maxid + 1;
+}
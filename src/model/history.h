@@ -0,0 +1,66 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdio.h>
+#include "patient.h"
+
+#define HISTORY_FILE "data/served.csv"
+#define HISTORY_HEADER "id,phone,name,age,severity,arrival,served_at,wait_sec,problem,service_end,counter,department\n"
+#define HISTORY_DEPT_LEN 32
+
+#define NOSHOW_FILE "data/noshow.csv"
+#define NOSHOW_HEADER "id,phone,name,age,severity,arrival,marked_at,wait_sec,problem,department\n"
+
+/* One row of served.csv. served_at is when the patient was called to a
+   counter; service_end/counter_id are empty/0 on rows written before
+   counters were tracked, and department is empty on rows written before
+   department queues. */
+typedef struct ServedRecord {
+    int id;
+    long long phone;
+    char name[NAME_LEN];
+    int age;
+    int severity;
+    char arrival[TIME_LEN];
+    char served_at[TIME_LEN];
+    long wait_sec;
+    char problem[PROB_LEN];
+    char service_end[TIME_LEN];
+    int counter_id;
+    char department[HISTORY_DEPT_LEN];
+} ServedRecord;
+
+/* Append one served record; writes the header first if the file is new. Returns 1 on success. */
+int history_append_served(const char *path, const Patient *p, const char *served_at_iso, long wait_seconds,
+                          const char *service_end_iso, int counter_id, const char *department);
+
+/* Append a patient who left before being called to noshow.csv. Returns 1 on success. */
+int history_append_noshow(const char *path, const Patient *p, const char *marked_at_iso, long wait_seconds,
+                          const char *department);
+
+/* Parse one served.csv data line. Returns 1 if it holds a valid record. */
+int history_parse_line(const char *line, ServedRecord *r);
+
+/* The columns of one served.csv line as pointers into it, without copying
+   or converting anything, for scans that only need a few of them. Missing
+   trailing columns have length 0. Returns 0 if the line has fewer than the
+   nine columns every row has; numbers are not checked. */
+enum { HC_ID, HC_PHONE, HC_NAME, HC_AGE, HC_SEVERITY, HC_ARRIVAL, HC_SERVED_AT, HC_WAIT,
+       HC_PROBLEM, HC_SERVICE_END, HC_COUNTER, HC_DEPARTMENT, HISTORY_COLS };
+
+typedef struct HistoryView {
+    const char *col[HISTORY_COLS];
+    size_t len[HISTORY_COLS];
+} HistoryView;
+
+int history_split_line(const char *line, HistoryView *v);
+
+/* Position f at the start of its last n lines (the header never counts)
+   by reading backwards from the end, so "tail N" costs O(N) however long
+   the file is. Returns 1, or 0 if f cannot seek. */
+int history_seek_tail(FILE *f, long n);
+
+/* Next free patient ID: one past the highest ID in the queue and history files */
+int history_next_id(const char *queue_path, const char *served_path);
+
+#endif
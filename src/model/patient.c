@@ -1,16 +1,14 @@
 #include "patient.h"
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
 
 Patient* create_patient(int id, long long phone_number, const char *name, int age, const char *problem, Severity sev, const char *arrival) {
-    printf("DEBUG:create_patient ENTER id=%d phone=%lld name='%s' age=%d sev=%d arrival='%s'\n",
+    PQ_TRACE("DEBUG:create_patient ENTER id=%d phone=%lld name='%s' age=%d sev=%d arrival='%s'\n",
            id, phone_number, name?name:"(null)", age, (int)sev, arrival?arrival:"(null)");
-    fflush(stdout);
 
     Patient *p = malloc(sizeof(Patient));
     if (!p) {
-        printf("DEBUG:create_patient malloc FAILED\n"); fflush(stdout); return NULL;
+        PQ_TRACE("DEBUG:create_patient malloc FAILED\n"); return NULL;
     }
     p->id = id;
     p->phone_number = phone_number; // store full 64-bit number
@@ -22,14 +20,23 @@ Patient* create_patient(int id, long long phone_number, const char *name, int ag
         p->arrival[TIME_LEN-1] = '\0';
     } else p->arrival[0] = '\0';
     p->problem = strdup(problem ? problem : "");
+    p->flags = 0;
     p->next = NULL;
+    p->prev = NULL;
+    p->arrival_ts = parse_iso_time(p->arrival);
+    p->sort_key = 0;
+    p->seq = 0;
+    p->heap_idx = -1;
+    p->snap_slot = -1;
+    for (int i = 0; i < PATIENT_TIMERS; ++i) p->timers[i] = NULL;
 
-    printf("DEBUG:create_patient EXIT p=%p name=%s phone=%lld\n", (void*)p, p->name?p->name:"(null)", p->phone_number);
-    fflush(stdout);
+    PQ_TRACE("DEBUG:create_patient EXIT p=%p name=%s phone=%lld\n", (void*)p, p->name?p->name:"(null)", p->phone_number);
     return p;
 }
 
 void free_patient(Patient* p) {
     if (!p) return;
+    free(p->name);
+    free(p->problem);
     free(p);
 }
\ No newline at end of file
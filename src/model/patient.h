@@ -1,10 +1,27 @@
 #ifndef PATIENT_H
 #define PATIENT_H
 
+#include <stdint.h>
+#include <time.h>
 #include "../util/time_util.h"
 
 #define NAME_LEN 128
 #define PROB_LEN 256
+#define PATIENT_TIMERS 3      /* one slot per AlertKind, see alerts.h */
+
+/* Patient.flags */
+#define PATIENT_PREGNANT 0x1u
+#define PATIENT_FLAG_MASK PATIENT_PREGNANT
+
+/* Build with -DPQ_DEBUG to trace patient/queue operations on stdout */
+#ifdef PQ_DEBUG
+#include <stdio.h>
+#define PQ_TRACE(...) do { printf(__VA_ARGS__); fflush(stdout); } while (0)
+#else
+#define PQ_TRACE(...) do { } while (0)
+#endif
+
+struct Timer;
 
 typedef enum { NORMAL = 0, SERIOUS = 1, CRITICAL = 2 } Severity;
 
@@ -16,7 +33,19 @@ typedef struct Patient {
     Severity severity;
     char arrival[TIME_LEN];
     char *problem;
+    unsigned flags;           // PATIENT_* triage flags
     struct Patient *next;
+
+    /* Queue bookkeeping, owned by PriorityQueue */
+    struct Patient *prev;
+    time_t arrival_ts;        // parsed arrival, (time_t)-1 if unknown
+    uint64_t sort_key;        // lower is served first
+    uint64_t seq;             // enqueue order, breaks key ties
+    int heap_idx;             // position in the queue heap, -1 if not queued
+    int snap_slot;            // record slot in the queue's SnapStore, -1 if none
+
+    /* Pending alert timers, owned by PatientAlerts; NULL when not armed */
+    struct Timer *timers[PATIENT_TIMERS];
 } Patient;
 
 Patient* create_patient(int id, long long phone_number, const char *name, int age, const char *problem, Severity sev, const char *arrival);
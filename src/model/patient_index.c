@@ -0,0 +1,953 @@
+#include "patient_index.h"
+#include "history.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void pidx_init(PatientIndex *ix) {
+    if (!ix) return;
+    memset(ix, 0, sizeof(*ix));
+    pthread_mutex_init(&ix->lock, NULL);
+}
+
+void pidx_free(PatientIndex *ix) {
+    if (!ix) return;
+    for (uint32_t i = 0; i < ix->gram_slots; ++i) free(ix->grams[i].docs);
+    free(ix->grams);
+    free(ix->by_id);
+    free(ix->entries);
+    free(ix->names);
+    for (uint32_t i = 0; i < ix->nwords; ++i) free(ix->words[i].docs.docs);
+    free(ix->words);
+    free(ix->word_slots);
+    free(ix->keys);
+    free(ix->key_slots);
+    free(ix->text);
+    free(ix->scratch);
+    for (uint32_t i = 0; i < ix->phone_slots; ++i) free(ix->phones[i].docs.docs);
+    free(ix->phones);
+    pthread_mutex_destroy(&ix->lock);
+    memset(ix, 0, sizeof(*ix));
+}
+
+const char* pidx_status_name(PidxStatus status) {
+    switch (status) {
+        case PIDX_WAITING: return "WAITING";
+        case PIDX_SERVED: return "SERVED";
+        case PIDX_LEFT: return "LEFT";
+    }
+    return "?";
+}
+
+static uint32_t hash_u32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+/* ---------- id map ---------- */
+
+static PidxEntry* find_id(PatientIndex *ix, int id) {
+    if (!ix->id_slots) return NULL;
+    uint32_t mask = ix->id_slots - 1;
+    for (uint32_t i = hash_u32((uint32_t)id) & mask;; i = (i + 1) & mask) {
+        uint32_t v = ix->by_id[i];
+        if (!v) return NULL;
+        if (ix->entries[v - 1].id == id) return &ix->entries[v - 1];
+    }
+}
+
+static void put_id(uint32_t *slots, uint32_t nslots, int id, uint32_t value) {
+    uint32_t mask = nslots - 1;
+    uint32_t i = hash_u32((uint32_t)id) & mask;
+    while (slots[i]) i = (i + 1) & mask;
+    slots[i] = value;
+}
+
+static int grow_ids(PatientIndex *ix) {
+    if (ix->id_slots && (ix->count + 1) * 2 <= ix->id_slots) return 1;
+    uint32_t n = ix->id_slots ? ix->id_slots * 2 : 1024;
+    uint32_t *slots = calloc(n, sizeof(uint32_t));
+    if (!slots) return 0;
+    for (uint32_t e = 0; e < ix->count; ++e) put_id(slots, n, ix->entries[e].id, e + 1);
+    free(ix->by_id);
+    ix->by_id = slots;
+    ix->id_slots = n;
+    return 1;
+}
+
+/* ---------- trigram postings ---------- */
+
+static uint32_t gram_key(const char *s) {
+    return (((uint32_t)(unsigned char)s[0] << 16) | ((uint32_t)(unsigned char)s[1] << 8) |
+            (uint32_t)(unsigned char)s[2]) + 1;
+}
+
+static PidxPosting* find_gram(PatientIndex *ix, uint32_t key) {
+    if (!ix->gram_slots) return NULL;
+    uint32_t mask = ix->gram_slots - 1;
+    for (uint32_t i = hash_u32(key) & mask;; i = (i + 1) & mask) {
+        if (ix->grams[i].key == key) return &ix->grams[i];
+        if (!ix->grams[i].key) return NULL;
+    }
+}
+
+static int grow_grams(PatientIndex *ix) {
+    if (ix->gram_slots && (ix->gram_used + 1) * 2 <= ix->gram_slots) return 1;
+    uint32_t n = ix->gram_slots ? ix->gram_slots * 2 : 4096;
+    PidxPosting *slots = calloc(n, sizeof(PidxPosting));
+    if (!slots) return 0;
+    for (uint32_t i = 0; i < ix->gram_slots; ++i) {
+        if (!ix->grams[i].key) continue;
+        uint32_t j = hash_u32(ix->grams[i].key) & (n - 1);
+        while (slots[j].key) j = (j + 1) & (n - 1);
+        slots[j] = ix->grams[i];
+    }
+    free(ix->grams);
+    ix->grams = slots;
+    ix->gram_slots = n;
+    return 1;
+}
+
+/* Entries are only ever appended, so a doc already on the list is its last */
+static int docs_append(uint32_t **docs, uint32_t *len, uint32_t *cap, uint32_t doc) {
+    if (*len && (*docs)[*len - 1] == doc) return 1;
+    if (*len == *cap) {
+        uint32_t ncap = *cap ? *cap * 2 : 4;
+        uint32_t *d = realloc(*docs, ncap * sizeof(uint32_t));
+        if (!d) return 0;
+        *docs = d;
+        *cap = ncap;
+    }
+    (*docs)[(*len)++] = doc;
+    return 1;
+}
+
+static int add_posting(PatientIndex *ix, uint32_t key, uint32_t doc) {
+    PidxPosting *pl = find_gram(ix, key);
+    if (!pl) {
+        if (!grow_grams(ix)) return 0;
+        uint32_t mask = ix->gram_slots - 1;
+        uint32_t i = hash_u32(key) & mask;
+        while (ix->grams[i].key) i = (i + 1) & mask;
+        pl = &ix->grams[i];
+        pl->key = key;
+        ix->gram_used++;
+    }
+    return docs_append(&pl->docs, &pl->len, &pl->cap, doc);
+}
+
+/* ---------- words, phonetic keys and the BK-tree ---------- */
+
+static uint32_t hash_str(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+static int text_add(PatientIndex *ix, const char *s, size_t len, uint32_t *off) {
+    if (ix->text_len + len + 1 > ix->text_cap) {
+        size_t cap = ix->text_cap ? ix->text_cap * 2 : 16 * 1024;
+        while (ix->text_len + len + 1 > cap) cap *= 2;
+        char *text = realloc(ix->text, cap);
+        if (!text) return 0;
+        ix->text = text;
+        ix->text_cap = cap;
+    }
+    *off = (uint32_t)ix->text_len;
+    memcpy(ix->text + ix->text_len, s, len);
+    ix->text[ix->text_len + len] = '\0';
+    ix->text_len += len + 1;
+    return 1;
+}
+
+/* Lookup in an open-addressing table of index + 1 over strings in ix->text */
+static uint32_t* find_text_slot(const PatientIndex *ix, uint32_t *slots, uint32_t nslots,
+                                const char *s, size_t len, int is_key) {
+    uint32_t mask = nslots - 1;
+    for (uint32_t i = hash_str(s, len) & mask;; i = (i + 1) & mask) {
+        uint32_t v = slots[i];
+        if (!v) return &slots[i];
+        uint32_t off = is_key ? ix->keys[v - 1].text_off : ix->words[v - 1].text_off;
+        uint8_t l = is_key ? ix->keys[v - 1].len : ix->words[v - 1].len;
+        if (l == len && memcmp(ix->text + off, s, len) == 0) return &slots[i];
+    }
+}
+
+static int grow_text_slots(PatientIndex *ix, int is_key) {
+    uint32_t used = is_key ? ix->nkeys : ix->nwords;
+    uint32_t *nslots = is_key ? &ix->key_slot_count : &ix->word_slot_count;
+    uint32_t **slots = is_key ? &ix->key_slots : &ix->word_slots;
+    if (*nslots && (used + 1) * 2 <= *nslots) return 1;
+    uint32_t n = *nslots ? *nslots * 2 : 1024;
+    uint32_t *fresh = calloc(n, sizeof(uint32_t));
+    if (!fresh) return 0;
+    for (uint32_t i = 0; i < used; ++i) {
+        uint32_t off = is_key ? ix->keys[i].text_off : ix->words[i].text_off;
+        uint8_t len = is_key ? ix->keys[i].len : ix->words[i].len;
+        *find_text_slot(ix, fresh, n, ix->text + off, len, is_key) = i + 1;
+    }
+    free(*slots);
+    *slots = fresh;
+    *nslots = n;
+    return 1;
+}
+
+static int is_vowel(char c) {
+    return c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u';
+}
+
+size_t pidx_phonetic_key(const char *w, size_t len, char *out, size_t outlen) {
+    size_t n = 0;
+    if (!out || outlen == 0) return 0;
+    for (size_t i = 0; i < len; ++i) {
+        char c = (char)tolower((unsigned char)w[i]);
+        char next = i + 1 < len ? (char)tolower((unsigned char)w[i + 1]) : '\0';
+        char k[2];
+        int nk = 1;
+        if (c < 'a' || c > 'z') continue;      /* apostrophes, digits, UTF-8 */
+        switch (c) {
+            case 'e': k[0] = next == 'e' ? 'i' : 'e'; if (next == 'e') ++i; break;
+            case 'o':
+                if (next == 'o') { k[0] = 'u'; ++i; }
+                else { k[0] = 'o'; if (next == 'u' || next == 'w') ++i; }
+                break;
+            case 'a': k[0] = (next == 'u' || next == 'w') ? 'o' : 'a'; if (k[0] == 'o') ++i; break;
+            case 'y': k[0] = is_vowel(next) ? 'y' : 'i'; break;
+            case 'w': k[0] = 'v'; break;
+            case 'z': k[0] = 'j'; break;
+            case 'q': k[0] = 'k'; break;
+            case 'x': k[0] = 'k'; k[1] = 's'; nk = 2; break;
+            case 'c': k[0] = next == 'h' ? 'c' : 'k'; break;
+            case 'p': k[0] = next == 'h' ? 'f' : 'p'; break;
+            default: k[0] = c; break;
+        }
+        /* aspirates: bh, dh, kh, sh, th, chh ... sound like the bare consonant */
+        if (!is_vowel(k[0]) && c != 'h' && c != 'y')
+            while (i + 1 < len && tolower((unsigned char)w[i + 1]) == 'h') ++i;
+        for (int j = 0; j < nk; ++j) {
+            if (n > 0 && out[n - 1] == k[j]) continue;   /* dd, tt, aa, ii */
+            if (n + 1 < outlen) out[n++] = k[j];
+        }
+    }
+    /* Krishna / Krishn, Rama / Ram */
+    if (n > 2 && out[n - 1] == 'a' && !is_vowel(out[n - 2])) --n;
+    out[n] = '\0';
+    return n;
+}
+
+/* Levenshtein distance of two short strings (both <= PIDX_WORD_MAX) */
+static int edit_distance(const char *a, int la, const char *b, int lb) {
+    int row[PIDX_WORD_MAX + 1];
+    for (int j = 0; j <= lb; ++j) row[j] = j;
+    for (int i = 1; i <= la; ++i) {
+        int diag = row[0];
+        row[0] = i;
+        for (int j = 1; j <= lb; ++j) {
+            int up = row[j];
+            int best = diag + (a[i - 1] != b[j - 1]);
+            if (up + 1 < best) best = up + 1;
+            if (row[j - 1] + 1 < best) best = row[j - 1] + 1;
+            row[j] = best;
+            diag = up;
+        }
+    }
+    return row[lb];
+}
+
+static const char* key_text(const PatientIndex *ix, uint32_t k) {
+    return ix->text + ix->keys[k].text_off;
+}
+
+static void bk_insert(PatientIndex *ix, uint32_t k) {
+    if (k == 0) return;                        /* the root */
+    uint32_t node = 0;
+    for (;;) {
+        int d = edit_distance(key_text(ix, node), ix->keys[node].len, key_text(ix, k), ix->keys[k].len);
+        uint32_t c = ix->keys[node].child;
+        while (c && ix->keys[c - 1].dist != d) c = ix->keys[c - 1].sibling;
+        if (!c) {
+            ix->keys[k].dist = (uint8_t)d;
+            ix->keys[k].sibling = ix->keys[node].child;
+            ix->keys[node].child = k + 1;
+            return;
+        }
+        node = c - 1;
+    }
+}
+
+/* Key index for the given key text, added to the BK-tree if new */
+static int key_for(PatientIndex *ix, const char *key, size_t len, uint32_t *out) {
+    if (!grow_text_slots(ix, 1)) return 0;
+    uint32_t *slot = find_text_slot(ix, ix->key_slots, ix->key_slot_count, key, len, 1);
+    if (*slot) { *out = *slot - 1; return 1; }
+    if (ix->nkeys == ix->keys_cap) {
+        uint32_t cap = ix->keys_cap ? ix->keys_cap * 2 : 1024;
+        PidxKey *keys = realloc(ix->keys, cap * sizeof(PidxKey));
+        if (!keys) return 0;
+        ix->keys = keys;
+        ix->keys_cap = cap;
+    }
+    PidxKey *k = &ix->keys[ix->nkeys];
+    memset(k, 0, sizeof(*k));
+    if (!text_add(ix, key, len, &k->text_off)) return 0;
+    k->len = (uint8_t)len;
+    *slot = ++ix->nkeys;
+    bk_insert(ix, ix->nkeys - 1);
+    *out = ix->nkeys - 1;
+    return 1;
+}
+
+static int add_word(PatientIndex *ix, const char *w, size_t len, uint32_t doc) {
+    if (len > PIDX_WORD_MAX) len = PIDX_WORD_MAX;
+    if (!grow_text_slots(ix, 0)) return 0;
+    uint32_t *slot = find_text_slot(ix, ix->word_slots, ix->word_slot_count, w, len, 0);
+    if (!*slot) {
+        char key[PIDX_WORD_MAX + 2];
+        size_t klen = pidx_phonetic_key(w, len, key, sizeof(key));
+        uint32_t k;
+        if (!key_for(ix, key, klen, &k)) return 0;
+        if (ix->nwords == ix->words_cap) {
+            uint32_t cap = ix->words_cap ? ix->words_cap * 2 : 1024;
+            PidxWord *words = realloc(ix->words, cap * sizeof(PidxWord));
+            if (!words) return 0;
+            ix->words = words;
+            ix->words_cap = cap;
+        }
+        PidxWord *nw = &ix->words[ix->nwords];
+        memset(nw, 0, sizeof(*nw));
+        if (!text_add(ix, w, len, &nw->text_off)) return 0;
+        nw->len = (uint8_t)len;
+        nw->key = k;
+        nw->next_same_key = ix->keys[k].first_word;
+        ix->keys[k].first_word = ix->nwords + 1;
+        *slot = ++ix->nwords;
+    }
+    PidxWord *word = &ix->words[*slot - 1];
+    return docs_append(&word->docs.docs, &word->docs.len, &word->docs.cap, doc);
+}
+
+/* Name words: runs of letters, digits, apostrophes and non-ASCII bytes */
+static int is_word_byte(unsigned char c) {
+    return isalnum(c) || c == '\'' || c >= 0x80;
+}
+
+/* Next word of s at or after *pos; returns its length, 0 at the end */
+static size_t next_word(const char *s, size_t *pos, const char **start) {
+    size_t i = *pos;
+    while (s[i] && !is_word_byte((unsigned char)s[i])) ++i;
+    size_t b = i;
+    while (s[i] && is_word_byte((unsigned char)s[i])) ++i;
+    *start = s + b;
+    *pos = i;
+    return i - b;
+}
+
+/* ---------- phone numbers ---------- */
+
+static uint32_t hash_phone(long long phone) {
+    uint64_t x = (uint64_t)phone;
+    return hash_u32((uint32_t)x ^ (uint32_t)(x >> 32));
+}
+
+static PidxPhone* find_phone(const PatientIndex *ix, long long phone) {
+    if (!ix->phone_slots) return NULL;
+    uint32_t mask = ix->phone_slots - 1;
+    for (uint32_t i = hash_phone(phone) & mask;; i = (i + 1) & mask) {
+        if (ix->phones[i].phone == phone) return &ix->phones[i];
+        if (!ix->phones[i].phone) return NULL;
+    }
+}
+
+static int grow_phones(PatientIndex *ix) {
+    if (ix->phone_slots && (ix->phones_used + 1) * 2 <= ix->phone_slots) return 1;
+    uint32_t n = ix->phone_slots ? ix->phone_slots * 2 : 1024;
+    PidxPhone *slots = calloc(n, sizeof(PidxPhone));
+    if (!slots) return 0;
+    for (uint32_t i = 0; i < ix->phone_slots; ++i) {
+        if (!ix->phones[i].phone) continue;
+        uint32_t j = hash_phone(ix->phones[i].phone) & (n - 1);
+        while (slots[j].phone) j = (j + 1) & (n - 1);
+        slots[j] = ix->phones[i];
+    }
+    free(ix->phones);
+    ix->phones = slots;
+    ix->phone_slots = n;
+    return 1;
+}
+
+/* Record e's phone number; a stale listing under an old number is skipped
+   by lookups, which check the entry's current number */
+static int set_phone(PatientIndex *ix, PidxEntry *e, long long phone) {
+    if (e->phone == phone) return 1;
+    e->phone = phone;
+    if (phone <= 0) return 1;
+    PidxPhone *ph = find_phone(ix, phone);
+    if (!ph) {
+        if (!grow_phones(ix)) return 0;
+        uint32_t mask = ix->phone_slots - 1;
+        uint32_t i = hash_phone(phone) & mask;
+        while (ix->phones[i].phone) i = (i + 1) & mask;
+        ph = &ix->phones[i];
+        ph->phone = phone;
+        ix->phones_used++;
+    }
+    return docs_append(&ph->docs.docs, &ph->docs.len, &ph->docs.cap, (uint32_t)(e - ix->entries));
+}
+
+/* ---------- entries ---------- */
+
+static const char* entry_name(const PatientIndex *ix, const PidxEntry *e) {
+    return ix->names + e->name_off;
+}
+
+static const char* entry_lower(const PatientIndex *ix, const PidxEntry *e) {
+    return ix->names + e->name_off + e->name_len + 1;
+}
+
+static int dept_slot(PatientIndex *ix, const char *department) {
+    if (!department || !department[0]) return 0xff;
+    for (int i = 0; i < ix->depts; ++i)
+        if (strcmp(ix->dept_names[i], department) == 0) return i;
+    if (ix->depts == PIDX_MAX_DEPTS) return 0xff;
+    snprintf(ix->dept_names[ix->depts], sizeof(ix->dept_names[0]), "%s", department);
+    return ix->depts++;
+}
+
+/* New entry with its name and trigrams, or the existing one for id */
+static PidxEntry* upsert(PatientIndex *ix, int id, const char *name) {
+    PidxEntry *e = find_id(ix, id);
+    if (e) return e;
+
+    if (ix->count == ix->cap) {
+        uint32_t cap = ix->cap ? ix->cap * 2 : 1024;
+        PidxEntry *entries = realloc(ix->entries, cap * sizeof(PidxEntry));
+        if (!entries) return NULL;
+        ix->entries = entries;
+        ix->cap = cap;
+    }
+    if (!name) name = "";
+    size_t len = strnlen(name, NAME_LEN - 1);
+    if (ix->names_len + 2 * (len + 1) > ix->names_cap) {
+        size_t cap = ix->names_cap ? ix->names_cap : 64 * 1024;
+        while (ix->names_len + 2 * (len + 1) > cap) cap *= 2;
+        char *names = realloc(ix->names, cap);
+        if (!names) return NULL;
+        ix->names = names;
+        ix->names_cap = cap;
+    }
+    if (!grow_ids(ix)) return NULL;
+
+    uint32_t doc = ix->count;
+    e = &ix->entries[doc];
+    memset(e, 0, sizeof(*e));
+    e->id = id;
+    e->arrival = (time_t)-1;
+    e->served_at = (time_t)-1;
+    e->dept = 0xff;
+    e->name_off = (uint32_t)ix->names_len;
+    e->name_len = (uint8_t)len;
+    char *orig = ix->names + ix->names_len;
+    memcpy(orig, name, len);
+    orig[len] = '\0';
+    char *lower = orig + len + 1;
+    for (size_t i = 0; i < len; ++i) lower[i] = (char)tolower((unsigned char)name[i]);
+    lower[len] = '\0';
+    ix->names_len += 2 * (len + 1);
+    ix->count++;
+    put_id(ix->by_id, ix->id_slots, id, doc + 1);
+
+    for (size_t i = 0; i + 3 <= len; ++i)
+        if (!add_posting(ix, gram_key(lower + i), doc)) return NULL;
+    const char *w;
+    size_t pos = 0, wlen;
+    while ((wlen = next_word(lower, &pos, &w)) > 0)
+        if (!add_word(ix, w, wlen, doc)) return NULL;
+    return e;
+}
+
+static void set_waiting(PatientIndex *ix, const Patient *p, const char *department) {
+    PidxEntry *e = upsert(ix, p->id, p->name);
+    if (!e) return;
+    e->status = PIDX_WAITING;
+    e->severity = (uint8_t)p->severity;
+    e->age = p->age;
+    set_phone(ix, e, p->phone_number);
+    e->arrival = p->arrival_ts;
+    e->served_at = (time_t)-1;
+    e->wait_sec = 0;
+    e->dept = (uint8_t)dept_slot(ix, department);
+}
+
+/* ---------- building and following the queues ---------- */
+
+/* parse_iso_time costs a mktime per call, most of a build's time on a long
+   history. Rows come roughly in time order, so remember the start of the
+   last few hours seen: DST only ever shifts on the hour, so hour start +
+   minutes + seconds is exact. served_at wanders back and forth across an
+   hour boundary as waits vary, hence more than one slot. */
+#define HOUR_CACHE_SLOTS 16
+
+typedef struct HourCache {
+    char hour[HOUR_CACHE_SLOTS][14];   /* "YYYY-MM-DD HH" */
+    time_t start[HOUR_CACHE_SLOTS];
+} HourCache;
+
+static time_t cached_time(HourCache *c, const char *iso) {
+    if (strlen(iso) < 19 || iso[13] != ':' || iso[16] != ':') return parse_iso_time(iso);
+    int slot = ((iso[8] - '0') * 10 + (iso[9] - '0') + (iso[11] - '0') * 10 + (iso[12] - '0')) & (HOUR_CACHE_SLOTS - 1);
+    if (memcmp(c->hour[slot], iso, 13) != 0) {
+        char top[TIME_LEN];
+        memcpy(top, iso, 13);
+        memcpy(top + 13, ":00:00", 7);
+        c->start[slot] = parse_iso_time(top);
+        memcpy(c->hour[slot], iso, 13);
+    }
+    if (c->start[slot] == (time_t)-1) return (time_t)-1;
+    int mm = (iso[14] - '0') * 10 + (iso[15] - '0');
+    int ss = (iso[17] - '0') * 10 + (iso[18] - '0');
+    return c->start[slot] + mm * 60 + ss;
+}
+
+int pidx_build_history(PatientIndex *ix, const char *served_path) {
+    if (!ix) return 0;
+    FILE *f = served_path ? fopen(served_path, "r") : NULL;
+    int ok = 1;
+    pthread_mutex_lock(&ix->lock);
+    if (f) {
+        char line[1024];
+        ServedRecord r;
+        HourCache arrived, called;
+        memset(&arrived, 0, sizeof(arrived));
+        memset(&called, 0, sizeof(called));
+        if (fgets(line, sizeof(line), f)) {
+            while (fgets(line, sizeof(line), f)) {
+                if (!history_parse_line(line, &r)) continue;
+                PidxEntry *e = upsert(ix, r.id, r.name);
+                if (!e) { ok = 0; break; }
+                e->status = PIDX_SERVED;
+                e->severity = (uint8_t)r.severity;
+                e->age = r.age;
+                if (!set_phone(ix, e, r.phone)) ok = 0;
+                e->arrival = cached_time(&arrived, r.arrival);
+                e->served_at = cached_time(&called, r.served_at);
+                e->wait_sec = r.wait_sec;
+                e->dept = (uint8_t)dept_slot(ix, r.department);
+            }
+        }
+        fclose(f);
+    }
+    ix->built = 1;
+    pthread_mutex_unlock(&ix->lock);
+    return ok;
+}
+
+static void add_waiting(void *ctx, const Patient *p) {
+    PidxTap *tap = ctx;
+    set_waiting(tap->ix, p, tap->department);
+}
+
+int pidx_add_queue(PidxTap *tap, PriorityQueue *q) {
+    if (!tap || !tap->ix || !q) return 0;
+    pthread_mutex_lock(&tap->ix->lock);
+    int ok = pq_arrival_walk(q, add_waiting, tap);
+    tap->live = 1;
+    pthread_mutex_unlock(&tap->ix->lock);
+    return ok;
+}
+
+static void pidx_queue_observer(void *ctx, PqEvent ev, const Patient *p, Severity old_severity) {
+    (void)old_severity;
+    PidxTap *tap = ctx;
+    if (!tap->live || !p) return;
+    PatientIndex *ix = tap->ix;
+    pthread_mutex_lock(&ix->lock);
+    switch (ev) {
+        case PQ_EV_ENQUEUE:
+            set_waiting(ix, p, tap->department);
+            break;
+        case PQ_EV_DEQUEUE: {
+            PidxEntry *e = upsert(ix, p->id, p->name);
+            if (!e) break;
+            time_t now = time(NULL);
+            e->status = PIDX_SERVED;
+            e->severity = (uint8_t)p->severity;
+            e->served_at = now;
+            e->wait_sec = p->arrival_ts != (time_t)-1 ? (long)(now - p->arrival_ts) : 0;
+            break;
+        }
+        case PQ_EV_RETRIAGE: {
+            PidxEntry *e = find_id(ix, p->id);
+            if (e) e->severity = (uint8_t)p->severity;
+            break;
+        }
+        case PQ_EV_REMOVE: {
+            /* a transfer is REMOVE then ENQUEUE, which sets it waiting again */
+            PidxEntry *e = find_id(ix, p->id);
+            if (e) e->status = PIDX_LEFT;
+            break;
+        }
+        case PQ_EV_SPILL:
+        case PQ_EV_REFILL:
+            break;                  /* still waiting, just elsewhere */
+    }
+    pthread_mutex_unlock(&ix->lock);
+}
+
+void pidx_tap_queue(PidxTap *tap, PatientIndex *ix, const char *department, PriorityQueue *q) {
+    if (!tap || !q) return;
+    tap->ix = ix;
+    tap->live = 0;
+    snprintf(tap->department, sizeof(tap->department), "%s", department ? department : "");
+    if (ix) pq_add_observer(q, pidx_queue_observer, tap);
+}
+
+void pidx_untap_queue(PidxTap *tap, PriorityQueue *q) {
+    if (tap && tap->ix) pq_remove_observer(q, pidx_queue_observer, tap);
+}
+
+/* ---------- search ---------- */
+
+/* Best place the (lowercased) query occurs in a lowercased name, or -1 */
+static int match_rank(const char *lower, const char *query, size_t qlen) {
+    int best = -1;
+    for (const char *hit = strstr(lower, query); hit; hit = strstr(hit + 1, query)) {
+        int rank;
+        if (hit == lower) rank = hit[qlen] == '\0' ? 0 : 1;
+        else rank = isalnum((unsigned char)hit[-1]) ? 3 : 2;
+        if (best < 0 || rank < best) best = rank;
+        if (best <= 2) break;       /* only the first occurrence can be at 0 */
+    }
+    return best;
+}
+
+typedef struct Ranked {
+    uint32_t doc;
+    int rank;
+    int status;
+    int id;
+    time_t when;              /* served_at if served, else arrival */
+} Ranked;
+
+/* < 0 if a belongs before b in the results */
+static int cmp_ranked(const Ranked *a, const Ranked *b) {
+    if (a->rank != b->rank) return a->rank - b->rank;
+    if (a->status != b->status) return a->status - b->status;
+    if (a->when != b->when) return a->when > b->when ? -1 : 1;
+    return b->id - a->id;
+}
+
+/* Keep the max best candidates in top[], sorted */
+static void offer(const PatientIndex *ix, Ranked *top, int *n, int max, uint32_t doc, int rank) {
+    if (max <= 0) return;
+    const PidxEntry *e = &ix->entries[doc];
+    Ranked r = { doc, rank, e->status, e->id, e->status == PIDX_SERVED ? e->served_at : e->arrival };
+    if (*n == max && cmp_ranked(&r, &top[max - 1]) >= 0) return;
+    int i = *n < max ? (*n)++ : max - 1;
+    while (i > 0 && cmp_ranked(&r, &top[i - 1]) < 0) { top[i] = top[i - 1]; --i; }
+    top[i] = r;
+}
+
+/* Last position in docs[0..from] holding a value <= want, or -1 (galloping
+   down, since candidates are visited newest first) */
+static long seek_doc(const uint32_t *docs, long from, uint32_t want) {
+    long step = 1, lo = from, hi = from;
+    while (lo >= 0 && docs[lo] > want) { hi = lo - 1; lo -= step; step *= 2; }
+    if (lo < 0) lo = 0;
+    long found = -1;
+    while (lo <= hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (docs[mid] <= want) { found = mid; lo = mid + 1; } else hi = mid - 1;
+    }
+    return found;
+}
+
+static int cmp_posting_len(const void *a, const void *b) {
+    const PidxPosting *pa = *(const PidxPosting * const *)a, *pb = *(const PidxPosting * const *)b;
+    return (pa->len > pb->len) - (pa->len < pb->len);
+}
+
+static void fill_hit(const PatientIndex *ix, const Ranked *r, PidxHit *out) {
+    const PidxEntry *e = &ix->entries[r->doc];
+    out->id = e->id;
+    out->status = (PidxStatus)e->status;
+    out->severity = e->severity;
+    out->age = e->age;
+    out->phone = e->phone;
+    out->arrival = e->arrival;
+    out->served_at = e->served_at;
+    out->wait_sec = e->wait_sec;
+    out->rank = r->rank;
+    snprintf(out->name, sizeof(out->name), "%s", entry_name(ix, e));
+    snprintf(out->department, sizeof(out->department), "%s", e->dept < ix->depts ? ix->dept_names[e->dept] : "");
+}
+
+int pidx_search_name(PatientIndex *ix, const char *query, PidxHit *out, int max) {
+    if (!ix || !query) return 0;
+    char q[NAME_LEN];
+    size_t qlen = 0;
+    for (; query[qlen] && qlen + 1 < sizeof(q); ++qlen) q[qlen] = (char)tolower((unsigned char)query[qlen]);
+    q[qlen] = '\0';
+    if (qlen == 0) return 0;
+    if (max < 0 || !out) max = 0;
+
+    Ranked *top = max ? malloc((size_t)max * sizeof(Ranked)) : NULL;
+    if (max && !top) return 0;
+    int ntop = 0, total = 0;
+
+    pthread_mutex_lock(&ix->lock);
+    if (qlen < 3) {
+        /* too short for a trigram: scan the names, still no file I/O */
+        for (uint32_t d = ix->count; d-- > 0;) {
+            int rank = match_rank(entry_lower(ix, &ix->entries[d]), q, qlen);
+            if (rank < 0) continue;
+            total++;
+            offer(ix, top, &ntop, max, d, rank);
+        }
+    } else {
+        size_t ngrams = qlen - 2;
+        PidxPosting **lists = malloc(ngrams * sizeof(PidxPosting*));
+        size_t nl = 0;
+        int missing = !lists;
+        for (size_t i = 0; !missing && i < ngrams; ++i) {
+            PidxPosting *pl = find_gram(ix, gram_key(q + i));
+            if (!pl) { missing = 1; break; }
+            int dup = 0;
+            for (size_t j = 0; j < nl; ++j) if (lists[j] == pl) { dup = 1; break; }
+            if (!dup) lists[nl++] = pl;
+        }
+        if (!missing) {
+            qsort(lists, nl, sizeof(PidxPosting*), cmp_posting_len);
+            /* newest first: most later candidates then lose to the top
+               list in one comparison */
+            long *pos = malloc(nl * sizeof(long));
+            for (size_t j = 0; pos && j < nl; ++j) pos[j] = (long)lists[j]->len - 1;
+            const PidxPosting *base = lists[0];
+            for (long k = (long)base->len - 1; pos && k >= 0; --k) {
+                uint32_t doc = base->docs[k];
+                int in_all = 1, exhausted = 0;
+                for (size_t j = 1; j < nl && in_all; ++j) {
+                    pos[j] = seek_doc(lists[j]->docs, pos[j], doc);
+                    if (pos[j] < 0) exhausted = 1;
+                    in_all = !exhausted && lists[j]->docs[pos[j]] == doc;
+                }
+                if (exhausted) break;
+                if (!in_all) continue;
+                /* every trigram is present; the query itself may still not be */
+                int rank = match_rank(entry_lower(ix, &ix->entries[doc]), q, qlen);
+                if (rank < 0) continue;
+                total++;
+                offer(ix, top, &ntop, max, doc, rank);
+            }
+            free(pos);
+        }
+        free(lists);
+    }
+    for (int i = 0; i < ntop; ++i) fill_hit(ix, &top[i], &out[i]);
+    pthread_mutex_unlock(&ix->lock);
+
+    free(top);
+    return total;
+}
+
+/* ---------- lookups by phone ---------- */
+
+int pidx_lookup_phone(PatientIndex *ix, long long phone, PidxHit *out, int max) {
+    if (!ix || phone <= 0) return 0;
+    if (max < 0 || !out) max = 0;
+    int total = 0;
+    pthread_mutex_lock(&ix->lock);
+    const PidxPhone *ph = find_phone(ix, phone);
+    /* entries are appended as patients arrive, so the list is oldest first */
+    for (uint32_t k = ph ? ph->docs.len : 0; k-- > 0;) {
+        Ranked r = { ph->docs.docs[k], 0, 0, 0, 0 };
+        if (ix->entries[r.doc].phone != phone) continue;
+        if (total < max) fill_hit(ix, &r, &out[total]);
+        total++;
+    }
+    pthread_mutex_unlock(&ix->lock);
+    return total;
+}
+
+int pidx_find_duplicate(PatientIndex *ix, long long phone, time_t now, long window_sec, PidxHit *out) {
+    if (!ix || phone <= 0) return 0;
+    int found = 0;
+    pthread_mutex_lock(&ix->lock);
+    const PidxPhone *ph = find_phone(ix, phone);
+    for (uint32_t k = ph ? ph->docs.len : 0; k-- > 0 && !found;) {
+        Ranked r = { ph->docs.docs[k], 0, 0, 0, 0 };
+        const PidxEntry *e = &ix->entries[r.doc];
+        if (e->phone != phone) continue;
+        int recent = window_sec > 0 && e->arrival != (time_t)-1 && now - e->arrival <= window_sec;
+        if (e->status == PIDX_WAITING || recent) {
+            if (out) fill_hit(ix, &r, out);
+            found = 1;
+        }
+    }
+    pthread_mutex_unlock(&ix->lock);
+    return found;
+}
+
+long pidx_dup_window_from_env(void) {
+    const char *env = getenv("HOSP_DUP_WINDOW_MIN");
+    long min = env ? atol(env) : PIDX_DEFAULT_DUP_WINDOW_MIN;
+    if (min < 0) min = PIDX_DEFAULT_DUP_WINDOW_MIN;
+    return min * 60;
+}
+
+/* ---------- fuzzy search ---------- */
+
+#define FUZZY_MAX_WORDS 8
+
+typedef struct WordMatch {
+    uint32_t word;
+    uint8_t score;
+} WordMatch;
+
+static int cmp_word_match(const void *a, const void *b) {
+    const WordMatch *wa = a, *wb = b;
+    return (int)wa->score - (int)wb->score;
+}
+
+/* Keys within budget edits of key: score each of their words by 2 per key
+   edit, plus 1 if the spelling differs from the query word */
+static void bk_search(const PatientIndex *ix, uint32_t node, const char *key, int klen, int budget,
+                      const char *word, size_t wlen, uint8_t *score) {
+    int d = edit_distance(key, klen, key_text(ix, node), ix->keys[node].len);
+    if (d <= budget) {
+        for (uint32_t w = ix->keys[node].first_word; w; w = ix->words[w - 1].next_same_key) {
+            const PidxWord *pw = &ix->words[w - 1];
+            int s = 2 * d + !(pw->len == wlen && memcmp(ix->text + pw->text_off, word, wlen) == 0);
+            if (s < score[w - 1]) score[w - 1] = (uint8_t)s;
+        }
+    }
+    for (uint32_t c = ix->keys[node].child; c; c = ix->keys[c - 1].sibling) {
+        int cd = ix->keys[c - 1].dist;
+        if (cd >= d - budget && cd <= d + budget) bk_search(ix, c - 1, key, klen, budget, word, wlen, score);
+    }
+}
+
+/* Words matching one query word, best first; returns how many (malloc'd) */
+static int match_word(const PatientIndex *ix, const char *word, size_t wlen, int as_prefix, WordMatch **out) {
+    *out = NULL;
+    if (wlen > PIDX_WORD_MAX) wlen = PIDX_WORD_MAX;
+    uint8_t *score = malloc(ix->nwords ? ix->nwords : 1);
+    if (!score) return 0;
+    memset(score, 0xff, ix->nwords);
+
+    char key[PIDX_WORD_MAX + 2];
+    size_t klen = pidx_phonetic_key(word, wlen, key, sizeof(key));
+    if (klen > 0 && ix->nkeys > 0) {
+        int budget = klen <= 2 ? 0 : (klen <= 6 ? 1 : 2);
+        bk_search(ix, 0, key, (int)klen, budget, word, wlen, score);
+    } else if (ix->word_slot_count) {
+        uint32_t *slot = find_text_slot(ix, ix->word_slots, ix->word_slot_count, word, wlen, 0);
+        if (*slot) score[*slot - 1] = 0;
+    }
+    /* still being typed: completions of the word or of its sound */
+    if (as_prefix && wlen >= 2) {
+        for (uint32_t w = 0; w < ix->nwords; ++w) {
+            const PidxWord *pw = &ix->words[w];
+            const PidxKey *pk = &ix->keys[pw->key];
+            if (score[w] <= 1) continue;
+            if ((pw->len > wlen && memcmp(ix->text + pw->text_off, word, wlen) == 0) ||
+                (klen >= 2 && pk->len > klen && memcmp(ix->text + pk->text_off, key, klen) == 0))
+                score[w] = 1;
+        }
+    }
+
+    int n = 0;
+    for (uint32_t w = 0; w < ix->nwords; ++w) n += score[w] != 0xff;
+    WordMatch *m = n ? malloc((size_t)n * sizeof(WordMatch)) : NULL;
+    if (n && !m) { free(score); return 0; }
+    n = 0;
+    for (uint32_t w = 0; w < ix->nwords; ++w)
+        if (score[w] != 0xff) { m[n].word = w; m[n].score = score[w]; ++n; }
+    free(score);
+    qsort(m, (size_t)n, sizeof(WordMatch), cmp_word_match);
+    *out = m;
+    return n;
+}
+
+int pidx_search_fuzzy(PatientIndex *ix, const char *query, PidxHit *out, int max) {
+    if (!ix || !query) return 0;
+    if (max < 0 || !out) max = 0;
+    char q[NAME_LEN];
+    size_t qlen = 0;
+    for (; query[qlen] && qlen + 1 < sizeof(q); ++qlen) q[qlen] = (char)tolower((unsigned char)query[qlen]);
+    q[qlen] = '\0';
+
+    const char *words[FUZZY_MAX_WORDS];
+    size_t lens[FUZZY_MAX_WORDS];
+    int nq = 0;
+    size_t pos = 0, wlen;
+    const char *w;
+    while (nq < FUZZY_MAX_WORDS && (wlen = next_word(q, &pos, &w)) > 0) {
+        words[nq] = w;
+        lens[nq++] = wlen;
+    }
+    if (nq == 0) return 0;
+    int typing = qlen > 0 && is_word_byte((unsigned char)q[qlen - 1]);
+
+    Ranked *top = max ? malloc((size_t)max * sizeof(Ranked)) : NULL;
+    if (max && !top) return 0;
+    int ntop = 0, total = 0;
+
+    pthread_mutex_lock(&ix->lock);
+    if (ix->scratch_cap < ix->count) {
+        uint8_t *scratch = realloc(ix->scratch, 2 * (size_t)ix->cap);
+        if (!scratch) { pthread_mutex_unlock(&ix->lock); free(top); return 0; }
+        memset(scratch, 0, 2 * (size_t)ix->cap);
+        ix->scratch = scratch;
+        ix->scratch_cap = ix->cap;
+    }
+    /* hits[doc]: query words matched so far; dist[doc]: their total score.
+       Both are zero outside a search. */
+    uint8_t *hits = ix->scratch, *dist = ix->scratch + ix->scratch_cap;
+
+    WordMatch *first = NULL;
+    int nfirst = 0;
+    for (int j = 0; j < nq; ++j) {
+        WordMatch *m;
+        int n = match_word(ix, words[j], lens[j], typing && j == nq - 1, &m);
+        /* best word first, so a doc's first visit this round is its best */
+        for (int i = 0; i < n; ++i) {
+            const PidxDocs *d = &ix->words[m[i].word].docs;
+            for (uint32_t k = 0; k < d->len; ++k) {
+                uint32_t doc = d->docs[k];
+                if (hits[doc] != j) continue;
+                hits[doc] = (uint8_t)(j + 1);
+                dist[doc] = (uint8_t)(dist[doc] + m[i].score);
+            }
+        }
+        if (j == 0) { first = m; nfirst = n; }
+        else free(m);
+    }
+
+    /* every candidate is on one of the first word's lists */
+    for (int i = 0; i < nfirst; ++i) {
+        const PidxDocs *d = &ix->words[first[i].word].docs;
+        for (uint32_t k = d->len; k-- > 0;) {
+            uint32_t doc = d->docs[k];
+            if (hits[doc] == nq) {
+                total++;
+                offer(ix, top, &ntop, max, doc, dist[doc]);
+                hits[doc] = 0xff;               /* counted */
+            }
+        }
+    }
+    for (int i = 0; i < nfirst; ++i) {
+        const PidxDocs *d = &ix->words[first[i].word].docs;
+        for (uint32_t k = 0; k < d->len; ++k) hits[d->docs[k]] = dist[d->docs[k]] = 0;
+    }
+    free(first);
+
+    for (int i = 0; i < ntop; ++i) fill_hit(ix, &top[i], &out[i]);
+    pthread_mutex_unlock(&ix->lock);
+    free(top);
+    return total;
+}
@@ -0,0 +1,207 @@
+#ifndef PATIENT_INDEX_H
+#define PATIENT_INDEX_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "patient.h"
+#include "queue.h"
+
+/* In-memory index of every patient the desk knows: the waiting queues and
+   served.csv, for lookups that would otherwise rescan the CSV.
+
+   Each patient is one entry (by ID) holding the fields a search result
+   shows and a status. Names are indexed by trigram: every three-byte
+   window of the lowercased name maps to the ascending list of entries
+   containing it, so a substring query of three or more characters only
+   verifies the entries on the intersection of its trigrams' lists.
+
+   For typo-tolerant search each distinct name word also gets a posting
+   list, and a sound-alike key (see pidx_phonetic_key) that folds the usual
+   spelling variants of transliterated Indian names. A BK-tree over the
+   distinct keys finds the keys within a few edits of a query word, so a
+   misspelt word only costs a walk of a small tree plus the postings of the
+   words it finds.
+
+   Visits are also indexed by normalized phone number (parse_indian_phone),
+   so a returning patient's earlier visits, and a second registration of
+   someone already waiting, are found without a scan.
+
+   The index is built on first use (one pass over served.csv, then a walk of
+   each queue) and then kept current by a queue observer per department, so
+   registering, serving, transfers and removals never rescan anything.
+   Observers of different departments run under different locks, so the
+   index has its own mutex, always taken after a department lock. */
+
+typedef enum { PIDX_WAITING = 0, PIDX_SERVED = 1, PIDX_LEFT = 2 } PidxStatus;
+
+#define PIDX_MAX_DEPTS 32
+
+typedef struct PidxEntry {
+    int id;
+    int age;
+    long long phone;
+    time_t arrival;           /* -1 if unknown */
+    time_t served_at;         /* -1 unless served */
+    long wait_sec;
+    uint32_t name_off;        /* into PatientIndex.names */
+    uint8_t name_len;         /* the lowercased copy starts name_len + 1 later */
+    uint8_t status;           /* PidxStatus */
+    uint8_t severity;
+    uint8_t dept;             /* into PatientIndex.dept_names */
+} PidxEntry;
+
+typedef struct PidxPosting {
+    uint32_t key;             /* trigram + 1; 0 marks a free slot */
+    uint32_t len;
+    uint32_t cap;
+    uint32_t *docs;           /* entry indexes, ascending */
+} PidxPosting;
+
+/* Entry indexes, ascending */
+typedef struct PidxDocs {
+    uint32_t len;
+    uint32_t cap;
+    uint32_t *docs;
+} PidxDocs;
+
+/* A distinct lowercased name word */
+typedef struct PidxWord {
+    uint32_t text_off;        /* into PatientIndex.text */
+    uint32_t key;             /* into PatientIndex.keys */
+    uint32_t next_same_key;   /* word + 1, 0 ends the chain */
+    uint8_t len;
+    PidxDocs docs;
+} PidxWord;
+
+/* A distinct phonetic key: one BK-tree node */
+typedef struct PidxKey {
+    uint32_t text_off;
+    uint32_t first_word;      /* word + 1 */
+    uint32_t child;           /* key + 1: first child, then siblings */
+    uint32_t sibling;
+    uint8_t len;
+    uint8_t dist;             /* edit distance to the parent node */
+} PidxKey;
+
+/* Visits sharing one phone number */
+typedef struct PidxPhone {
+    long long phone;          /* 0 marks a free slot */
+    PidxDocs docs;
+} PidxPhone;
+
+#define PIDX_WORD_MAX 31      /* longer words are indexed by their first 31 bytes */
+
+typedef struct PatientIndex {
+    pthread_mutex_t lock;
+    int built;
+    PidxEntry *entries;
+    uint32_t count;
+    uint32_t cap;
+    char *names;              /* lowercased copies follow each original */
+    size_t names_len;
+    size_t names_cap;
+    uint32_t *by_id;          /* open addressing: id -> entry + 1 */
+    uint32_t id_slots;        /* power of two */
+    PidxPosting *grams;       /* open addressing by trigram */
+    uint32_t gram_slots;      /* power of two */
+    uint32_t gram_used;
+    char dept_names[PIDX_MAX_DEPTS][32];
+    int depts;
+
+    /* fuzzy search */
+    PidxWord *words;
+    uint32_t nwords;
+    uint32_t words_cap;
+    uint32_t *word_slots;     /* open addressing: word text -> word + 1 */
+    uint32_t word_slot_count;
+    PidxKey *keys;            /* keys[0] is the BK-tree root */
+    uint32_t nkeys;
+    uint32_t keys_cap;
+    uint32_t *key_slots;      /* key text -> key + 1 */
+    uint32_t key_slot_count;
+    char *text;               /* word and key strings, NUL-terminated */
+    size_t text_len;
+    size_t text_cap;
+    uint8_t *scratch;         /* per-entry query state, 2 bytes per entry */
+    uint32_t scratch_cap;
+
+    PidxPhone *phones;        /* open addressing by phone number */
+    uint32_t phone_slots;     /* power of two */
+    uint32_t phones_used;
+} PatientIndex;
+
+/* Per-queue observer context: which index, which department */
+typedef struct PidxTap {
+    PatientIndex *ix;
+    char department[32];
+    int live;                 /* set once pidx_add_queue has indexed the queue */
+} PidxTap;
+
+typedef struct PidxHit {
+    int id;
+    PidxStatus status;
+    int severity;
+    int age;
+    long long phone;
+    time_t arrival;
+    time_t served_at;
+    long wait_sec;
+    int rank;                 /* name search: 0 exact, 1 prefix, 2 word start, 3 inside
+                                 a word; fuzzy search: distance, 0 = every word exact */
+    char name[NAME_LEN];
+    char department[32];
+} PidxHit;
+
+void pidx_init(PatientIndex *ix);
+void pidx_free(PatientIndex *ix);
+
+/* Observe q for ix. Events are ignored until pidx_add_queue, so tapping
+   at startup costs nothing if nobody ever searches. */
+void pidx_tap_queue(PidxTap *tap, PatientIndex *ix, const char *department, PriorityQueue *q);
+void pidx_untap_queue(PidxTap *tap, PriorityQueue *q);
+
+/* Index served.csv (a missing file is an empty history) and mark the index
+   built. Returns 0 if memory ran out part way. */
+int pidx_build_history(PatientIndex *ix, const char *served_path);
+/* Index the patients waiting in the tapped queue and start following it.
+   Call with the queue's lock held. */
+int pidx_add_queue(PidxTap *tap, PriorityQueue *q);
+
+/* Case-insensitive substring search over every indexed name. Fills up to
+   max best hits (rank, then waiting before served, then newest first) and
+   returns the total number of matches. */
+int pidx_search_name(PatientIndex *ix, const char *query, PidxHit *out, int max);
+
+/* Typo-tolerant search: every word of the query must match a word of the
+   name, exactly, as a sound-alike spelling, or within 1 (keys of 3-6
+   letters) or 2 (longer) edits of its sound-alike key. The last word may
+   also be the start of a name word, so results follow the query as it is
+   typed. Ranked by total distance, then as pidx_search_name; returns the
+   total number of matches. */
+int pidx_search_fuzzy(PatientIndex *ix, const char *query, PidxHit *out, int max);
+
+/* Visits registered with this phone number, newest first: fills up to max
+   and returns how many there are */
+int pidx_lookup_phone(PatientIndex *ix, long long phone, PidxHit *out, int max);
+
+/* The newest visit with this phone number that is still waiting or arrived
+   within window_sec of now: likely the same patient registered twice.
+   Returns 1 and fills *out if there is one. */
+int pidx_find_duplicate(PatientIndex *ix, long long phone, time_t now, long window_sec, PidxHit *out);
+
+#define PIDX_DEFAULT_DUP_WINDOW_MIN 60
+
+/* HOSP_DUP_WINDOW_MIN (default 60, 0 = only warn about patients still
+   waiting), in seconds */
+long pidx_dup_window_from_env(void);
+
+/* Sound-alike key of one lowercased word: aspirates and doubled letters
+   fold (bh/b, dd/d), as do the vowel spellings (ee/i, oo/u, ou/o, ai/e),
+   w/v, z/j, ph/f, x/ks, c/k and a final 'a'. Writes at most outlen - 1
+   bytes plus a NUL; returns the key length. */
+size_t pidx_phonetic_key(const char *word, size_t len, char *out, size_t outlen);
+
+const char* pidx_status_name(PidxStatus status);
+
+#endif /* PATIENT_INDEX_H */
@@ -0,0 +1,801 @@
+#include "query.h"
+#include "../util/phone_util.h"
+#include "../util/time_util.h"
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+static const char *SEV_NAMES[3] = { "NORMAL", "SERIOUS", "CRITICAL" };
+
+static const struct { const char *name; QueryField field; } FIELD_NAMES[] = {
+    { "id", QF_ID }, { "phone", QF_PHONE }, { "name", QF_NAME }, { "age", QF_AGE },
+    { "severity", QF_SEVERITY }, { "sev", QF_SEVERITY }, { "date", QF_ARRIVAL },
+    { "arrival", QF_ARRIVAL }, { "served", QF_SERVED_AT }, { "wait", QF_WAIT },
+    { "problem", QF_PROBLEM }, { "counter", QF_COUNTER }, { "dept", QF_DEPT },
+    { "department", QF_DEPT }, { "status", QF_STATUS },
+};
+
+static const struct { const char *name; QueryGroupBy by; } GROUP_NAMES[] = {
+    { "severity", QG_SEVERITY }, { "sev", QG_SEVERITY }, { "dept", QG_DEPT },
+    { "department", QG_DEPT }, { "day", QG_DAY }, { "date", QG_DAY }, { "hour", QG_HOUR },
+    { "age", QG_AGE }, { "status", QG_STATUS },
+};
+
+const char* query_field_name(QueryField f) {
+    switch (f) {
+        case QF_ID: return "ID";
+        case QF_PHONE: return "Phone";
+        case QF_NAME: return "Name";
+        case QF_AGE: return "Age";
+        case QF_SEVERITY: return "Severity";
+        case QF_ARRIVAL: return "Arrival";
+        case QF_SERVED_AT: return "Served";
+        case QF_WAIT: return "Wait(min)";
+        case QF_PROBLEM: return "Problem";
+        case QF_COUNTER: return "Counter";
+        case QF_DEPT: return "Dept";
+        case QF_STATUS: return "Status";
+        case QF_COUNT: break;
+    }
+    return "?";
+}
+
+/* ---------- compiling ---------- */
+
+static int fail(char *err, size_t errlen, const char *fmt, const char *what) {
+    if (err && errlen) snprintf(err, errlen, fmt, what);
+    return 0;
+}
+
+/* Next whitespace-separated term into tok; "double quotes" keep spaces.
+   Returns the rest of the text, or NULL when there are no more terms. */
+static const char* next_token(const char *s, char *tok, size_t toklen) {
+    while (*s && isspace((unsigned char)*s)) s++;
+    if (!*s) return NULL;
+    size_t n = 0;
+    int quoted = 0;
+    for (; *s && (quoted || !isspace((unsigned char)*s)); ++s) {
+        if (*s == '"') { quoted = !quoted; continue; }
+        if (n + 1 < toklen) tok[n++] = *s;
+    }
+    tok[n] = '\0';
+    return s;
+}
+
+static int lookup_field(const char *name, size_t len, QueryField *out) {
+    for (size_t i = 0; i < sizeof(FIELD_NAMES) / sizeof(FIELD_NAMES[0]); ++i) {
+        if (strlen(FIELD_NAMES[i].name) == len && strncasecmp(FIELD_NAMES[i].name, name, len) == 0) {
+            *out = FIELD_NAMES[i].field;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void narrow(QueryRange *r, long long lo, long long hi) {
+    if (!r->on) { r->on = 1; r->lo = LLONG_MIN; r->hi = LLONG_MAX; }
+    if (lo > r->lo) r->lo = lo;
+    if (hi < r->hi) r->hi = hi;
+}
+
+/* Integer, or for wait minutes unless suffixed s/m/h; result in seconds for wait */
+static int parse_number(QueryField f, const char *s, long long *out) {
+    char *end;
+    if (f == QF_WAIT) {
+        double v = strtod(s, &end);
+        if (end == s) return 0;
+        double scale = 60.0;
+        if (*end == 's' || *end == 'S') { scale = 1.0; end++; }
+        else if (*end == 'm' || *end == 'M') end++;
+        else if (*end == 'h' || *end == 'H') { scale = 3600.0; end++; }
+        if (*end) return 0;
+        *out = (long long)(v * scale);
+        return 1;
+    }
+    if (f == QF_PHONE) return parse_indian_phone(s, out);
+    *out = strtoll(s, &end, 10);
+    return end != s && *end == '\0';
+}
+
+static int parse_severity(const char *s, int *out) {
+    for (int i = 0; i < 3; ++i) {
+        if (strcasecmp(s, SEV_NAMES[i]) == 0) { *out = i; return 1; }
+    }
+    if (s[0] >= '0' && s[0] <= '2' && s[1] == '\0') { *out = s[0] - '0'; return 1; }
+    return 0;
+}
+
+/* today, yesterday, -Nd, -Nh or YYYY-MM-DD[ HH[:MM[:SS]]] ('T' may stand
+   for the space) as a prefix of the stored "YYYY-MM-DD HH:MM:SS" */
+static int parse_time(const char *s, time_t now, QueryTimeBound *b) {
+    time_t t = (time_t)-1;
+    const char *fmt = "%Y-%m-%d";
+    if (strcasecmp(s, "today") == 0) t = now;
+    else if (strcasecmp(s, "yesterday") == 0) t = now - 86400;
+    else if (s[0] == '-' && isdigit((unsigned char)s[1])) {
+        char *end;
+        long n = strtol(s + 1, &end, 10);
+        if (strcasecmp(end, "d") == 0) t = now - (time_t)n * 86400;
+        else if (strcasecmp(end, "h") == 0) { t = now - (time_t)n * 3600; fmt = "%Y-%m-%d %H"; }
+        else return 0;
+    }
+    if (t != (time_t)-1) {
+        struct tm tm;
+#if defined(_WIN32)
+        localtime_s(&tm, &t);
+#else
+        localtime_r(&t, &tm);
+#endif
+        b->len = strftime(b->text, sizeof(b->text), fmt, &tm);
+        return b->len > 0;
+    }
+
+    static const char pattern[] = "dddd-dd-dd dd:dd:dd";
+    size_t len = strlen(s);
+    if (len != 10 && len != 13 && len != 16 && len != 19) return 0;
+    for (size_t i = 0; i < len; ++i) {
+        char c = s[i];
+        if (i == 10 && (c == 'T' || c == 't')) c = ' ';
+        if (pattern[i] == 'd' ? !isdigit((unsigned char)c) : c != pattern[i]) return 0;
+        b->text[i] = c;
+    }
+    b->text[len] = '\0';
+    b->len = len;
+    return 1;
+}
+
+/* Compare a stored timestamp with a bound over the bound's length */
+static int prefix_cmp(const char *s, size_t len, const QueryTimeBound *b) {
+    size_t n = len < b->len ? len : b->len;
+    int c = memcmp(s, b->text, n);
+    if (c || len >= b->len) return c;
+    return -1;
+}
+
+/* Keep the later of two lower bounds, the earlier of two upper ones */
+static void set_bound(QueryTimeBound *dst, const QueryTimeBound *b, int strict, int upper) {
+    if (dst->len) {
+        int c = prefix_cmp(b->text, b->len, dst);
+        if (upper ? c > 0 : c < 0) return;
+    }
+    *dst = *b;
+    dst->strict = strict;
+}
+
+static int compile_term(Query *q, const char *tok, time_t now, char *err, size_t errlen) {
+    size_t flen = strcspn(tok, "=!<>~");
+    const char *op = tok + flen;
+    QueryField f;
+    if (!*op) return fail(err, errlen, "expected field=value, got '%s'", tok);
+    if (!lookup_field(tok, flen, &f)) return fail(err, errlen, "unknown field in '%s'", tok);
+
+    char opname[3] = {0};
+    size_t oplen = (op[1] == '=' || (op[0] == '!' && op[1] == '~')) ? 2 : 1;
+    memcpy(opname, op, oplen);
+    const char *value = op + oplen;
+    if (!*value) return fail(err, errlen, "missing value in '%s'", tok);
+    int eq = strcmp(opname, "=") == 0, ne = strcmp(opname, "!=") == 0;
+    int lt = strcmp(opname, "<") == 0, le = strcmp(opname, "<=") == 0;
+    int gt = strcmp(opname, ">") == 0, ge = strcmp(opname, ">=") == 0;
+    int has = strcmp(opname, "~") == 0, hasnt = strcmp(opname, "!~") == 0;
+    if (!(eq || ne || lt || le || gt || ge || has || hasnt)) return fail(err, errlen, "unknown operator in '%s'", tok);
+
+    char lo[64] = "", hi[64] = "";
+    const char *dots = strstr(value, "..");
+    if (dots && eq) {
+        snprintf(lo, sizeof(lo), "%.*s", (int)(dots - value), value);
+        snprintf(hi, sizeof(hi), "%s", dots + 2);
+    } else {
+        snprintf(lo, sizeof(lo), "%s", value);
+        snprintf(hi, sizeof(hi), "%s", value);
+    }
+
+    switch (f) {
+        case QF_NAME: case QF_PROBLEM: case QF_DEPT: {
+            if (!(has || hasnt || eq || ne)) return fail(err, errlen, "use ~, !~, = or != in '%s'", tok);
+            if (q->ntext == QUERY_MAX_TEXT) return fail(err, errlen, "too many text terms at '%s'", tok);
+            QueryText *t = &q->text[q->ntext++];
+            t->field = f;
+            t->negate = ne || hasnt;
+            t->exact = eq || ne;
+            t->len = strlen(value) < sizeof(t->needle) ? strlen(value) : sizeof(t->needle) - 1;
+            for (size_t i = 0; i < t->len; ++i) t->needle[i] = (char)tolower((unsigned char)value[i]);
+            t->needle[t->len] = '\0';
+            if (f != QF_NAME) q->full_parse = 1;
+            return 1;
+        }
+        case QF_SEVERITY: {
+            unsigned bits = 0;
+            if (eq || ne) {
+                char list[64];
+                snprintf(list, sizeof(list), "%s", value);
+                for (char *s = strtok(list, ","); s; s = strtok(NULL, ",")) {
+                    int sev;
+                    if (!parse_severity(s, &sev)) return fail(err, errlen, "unknown severity '%s'", s);
+                    bits |= 1u << sev;
+                }
+                if (ne) bits = ~bits & 7u;
+            } else if (lt || le || gt || ge) {
+                int sev;
+                if (!parse_severity(value, &sev)) return fail(err, errlen, "unknown severity '%s'", value);
+                for (int i = 0; i < 3; ++i) {
+                    if ((lt && i < sev) || (le && i <= sev) || (gt && i > sev) || (ge && i >= sev)) bits |= 1u << i;
+                }
+            } else {
+                return fail(err, errlen, "severity takes = != < <= > >=, not '%s'", tok);
+            }
+            q->severities &= bits;
+            return 1;
+        }
+        case QF_STATUS: {
+            int src;
+            if (strcasecmp(value, "waiting") == 0) src = QUERY_SRC_WAITING;
+            else if (strcasecmp(value, "served") == 0) src = QUERY_SRC_SERVED;
+            else return fail(err, errlen, "status is waiting or served, not '%s'", value);
+            if (!eq && !ne) return fail(err, errlen, "status takes = or !=, not '%s'", tok);
+            q->sources &= ne ? ~src : src;
+            return 1;
+        }
+        case QF_ARRIVAL: case QF_SERVED_AT: {
+            QueryTimeBound *blo = f == QF_ARRIVAL ? &q->arrival_lo : &q->served_lo;
+            QueryTimeBound *bhi = f == QF_ARRIVAL ? &q->arrival_hi : &q->served_hi;
+            QueryTimeBound b;
+            if (has || hasnt || ne) return fail(err, errlen, "dates take = < <= > >= or a..b, not '%s'", tok);
+            if ((eq || gt || ge) && lo[0]) {
+                if (!parse_time(lo, now, &b)) return fail(err, errlen, "bad date '%s' (YYYY-MM-DD[THH:MM], today, -7d)", lo);
+                set_bound(blo, &b, gt, 0);
+            }
+            if ((eq || lt || le) && hi[0]) {
+                if (!parse_time(hi, now, &b)) return fail(err, errlen, "bad date '%s' (YYYY-MM-DD[THH:MM], today, -7d)", hi);
+                set_bound(bhi, &b, lt, 1);
+            }
+            return 1;
+        }
+        default: {
+            QueryRange *r = f == QF_ID ? &q->id : f == QF_PHONE ? &q->phone : f == QF_AGE ? &q->age
+                          : f == QF_WAIT ? &q->wait : &q->counter;
+            long long a = LLONG_MIN, z = LLONG_MAX;
+            if (has || hasnt || ne) return fail(err, errlen, "numbers take = < <= > >= or a..b, not '%s'", tok);
+            if (f == QF_PHONE && !eq) return fail(err, errlen, "phone takes =, not '%s'", tok);
+            if ((eq || gt || ge) && lo[0] && !parse_number(f, lo, &a)) return fail(err, errlen, "bad number '%s'", lo);
+            if ((eq || lt || le) && hi[0] && !parse_number(f, hi, &z)) return fail(err, errlen, "bad number '%s'", hi);
+            if (gt) a++;
+            if (lt) z--;
+            narrow(r, a, z);
+            if (f == QF_COUNTER) q->full_parse = 1;
+            return 1;
+        }
+    }
+}
+
+static int compile_show(Query *q, const char *list, char *err, size_t errlen) {
+    q->nshow = 0;
+    while (*list) {
+        size_t len = strcspn(list, ",");
+        QueryField f;
+        if (len == 1 && list[0] == '*') {
+            for (int i = 0; i < QF_COUNT; ++i) q->show[i] = (QueryField)i;
+            q->nshow = QF_COUNT;
+        } else if (len) {
+            if (!lookup_field(list, len, &f)) return fail(err, errlen, "unknown column in '%s'", list);
+            if (q->nshow < QF_COUNT) q->show[q->nshow++] = f;
+        }
+        list += len;
+        if (*list == ',') list++;
+    }
+    return 1;
+}
+
+int query_compile(const char *text, Query *q, time_t now, char *err, size_t errlen) {
+    if (!text || !q) return fail(err, errlen, "%s", "empty query");
+    memset(q, 0, sizeof(*q));
+    q->sources = QUERY_SRC_WAITING | QUERY_SRC_SERVED;
+    q->severities = 7;
+    q->group_by = QG_NONE;
+    q->limit = QUERY_DEFAULT_LIMIT;
+
+    char tok[128], arg[128];
+    const char *s = text, *rest;
+    while ((s = next_token(s, tok, sizeof(tok))) != NULL) {
+        if (strcasecmp(tok, "where") == 0 || strcasecmp(tok, "and") == 0) continue;
+        if (strcasecmp(tok, "from") == 0 || strcasecmp(tok, "show") == 0 || strcasecmp(tok, "limit") == 0) {
+            if ((s = next_token(s, arg, sizeof(arg))) == NULL) return fail(err, errlen, "'%s' needs a value", tok);
+            if (strcasecmp(tok, "from") == 0) {
+                if (strcasecmp(arg, "waiting") == 0) q->sources = QUERY_SRC_WAITING;
+                else if (strcasecmp(arg, "served") == 0) q->sources = QUERY_SRC_SERVED;
+                else if (strcasecmp(arg, "all") == 0) q->sources = QUERY_SRC_WAITING | QUERY_SRC_SERVED;
+                else return fail(err, errlen, "from waiting, served or all, not '%s'", arg);
+            } else if (strcasecmp(tok, "show") == 0) {
+                if (!compile_show(q, arg, err, errlen)) return 0;
+            } else {
+                char *end;
+                long n = strtol(arg, &end, 10);
+                if (end == arg || *end || n < 0 || n > QUERY_MAX_LIMIT) return fail(err, errlen, "bad limit '%s'", arg);
+                q->limit = (int)n;
+            }
+            continue;
+        }
+        if (strcasecmp(tok, "count") == 0) {
+            q->count_only = 1;
+            if ((rest = next_token(s, arg, sizeof(arg))) != NULL && strcasecmp(arg, "by") == 0) {
+                if ((s = next_token(rest, arg, sizeof(arg))) == NULL) return fail(err, errlen, "%s", "'count by' needs a column");
+                size_t i, n = sizeof(GROUP_NAMES) / sizeof(GROUP_NAMES[0]);
+                for (i = 0; i < n && strcasecmp(arg, GROUP_NAMES[i].name) != 0; ++i) {}
+                if (i == n) return fail(err, errlen, "cannot count by '%s' (severity, dept, day, hour, age, status)", arg);
+                q->group_by = GROUP_NAMES[i].by;
+            }
+            continue;
+        }
+        if (!compile_term(q, tok, now, err, errlen)) return 0;
+    }
+
+    if (q->nshow == 0) {
+        static const QueryField defaults[] = { QF_ID, QF_NAME, QF_AGE, QF_SEVERITY, QF_ARRIVAL, QF_WAIT, QF_DEPT };
+        q->nshow = (int)(sizeof(defaults) / sizeof(defaults[0]));
+        memcpy(q->show, defaults, sizeof(defaults));
+    }
+    return 1;
+}
+
+/* ---------- testing rows ---------- */
+
+static int contains_ci(const char *s, size_t len, const char *needle, size_t nlen) {
+    if (nlen == 0) return 1;
+    for (size_t i = 0; i + nlen <= len; ++i) {
+        if (tolower((unsigned char)s[i]) == needle[0] && strncasecmp(s + i + 1, needle + 1, nlen - 1) == 0) return 1;
+    }
+    return 0;
+}
+
+static int text_ok(const QueryText *t, const char *s, size_t len) {
+    int hit = t->exact ? len == t->len && strncasecmp(s, t->needle, len) == 0
+                       : contains_ci(s, len, t->needle, t->len);
+    return hit != t->negate;
+}
+
+static int time_ok(const char *s, size_t len, const QueryTimeBound *lo, const QueryTimeBound *hi) {
+    if (lo->len) {
+        if (!len) return 0;
+        int c = prefix_cmp(s, len, lo);
+        if (c < 0 || (c == 0 && lo->strict)) return 0;
+    }
+    if (hi->len) {
+        if (!len) return 0;
+        int c = prefix_cmp(s, len, hi);
+        if (c > 0 || (c == 0 && hi->strict)) return 0;
+    }
+    return 1;
+}
+
+static int range_ok(const QueryRange *r, long long v) {
+    return !r->on || (v >= r->lo && v <= r->hi);
+}
+
+static int texts_ok(const Query *q, QueryField f, const char *s) {
+    for (int i = 0; i < q->ntext; ++i) {
+        if (q->text[i].field == f && !text_ok(&q->text[i], s, strlen(s))) return 0;
+    }
+    return 1;
+}
+
+/* Every test, against a whole record (waiting patients, and the problem /
+   department / counter tests of served rows) */
+static int record_ok(const Query *q, const ServedRecord *rec) {
+    return (q->severities & (1u << rec->severity))
+        && time_ok(rec->arrival, strlen(rec->arrival), &q->arrival_lo, &q->arrival_hi)
+        && time_ok(rec->served_at, strlen(rec->served_at), &q->served_lo, &q->served_hi)
+        && range_ok(&q->age, rec->age) && range_ok(&q->wait, rec->wait_sec)
+        && range_ok(&q->id, rec->id) && range_ok(&q->phone, rec->phone)
+        && range_ok(&q->counter, rec->counter_id)
+        && texts_ok(q, QF_NAME, rec->name) && texts_ok(q, QF_PROBLEM, rec->problem)
+        && texts_ok(q, QF_DEPT, rec->department);
+}
+
+/* The leading columns of a served.csv row: id, phone, name, age, severity,
+   arrival, served_at, wait_sec; the problem and trailing columns are left
+   to history_parse_line */
+enum { RAW_ID, RAW_PHONE, RAW_NAME, RAW_AGE, RAW_SEV, RAW_ARRIVAL, RAW_SERVED, RAW_WAIT, RAW_FIELDS };
+
+typedef struct RawRow {
+    const char *f[RAW_FIELDS];
+    size_t len[RAW_FIELDS];
+    const char *tail;         /* problem and the trailing columns */
+    size_t tail_len;
+} RawRow;
+
+/* 0 unless the row has the nine columns every served.csv row has */
+static int split_raw(const char *line, size_t linelen, RawRow *rr) {
+    const char *cur = line, *end = line + linelen;
+    for (int i = 0; i < RAW_FIELDS; ++i) {
+        const char *comma = memchr(cur, ',', (size_t)(end - cur));
+        if (!comma) return 0;
+        rr->f[i] = cur;
+        rr->len[i] = (size_t)(comma - cur);
+        cur = comma + 1;
+    }
+    rr->tail = cur;
+    rr->tail_len = (size_t)(end - cur);
+    return 1;
+}
+
+static int raw_int(const char *s, size_t len, long long *out) {
+    size_t i = 0;
+    int neg = 0;
+    if (len && s[0] == '-') { neg = 1; i = 1; }
+    if (i == len) return 0;
+    long long v = 0;
+    for (; i < len; ++i) {
+        if (s[i] < '0' || s[i] > '9') return 0;
+        v = v * 10 + (s[i] - '0');
+    }
+    *out = neg ? -v : v;
+    return 1;
+}
+
+static int raw_range_ok(const QueryRange *r, const char *s, size_t len) {
+    long long v;
+    return !r->on || (raw_int(s, len, &v) && v >= r->lo && v <= r->hi);
+}
+
+/* The tests that need one leading column each, cheapest first */
+static int raw_ok(const Query *q, const RawRow *rr) {
+    if (rr->len[RAW_SEV] != 1 || rr->f[RAW_SEV][0] < '0' || rr->f[RAW_SEV][0] > '2') return 0;
+    if (!(q->severities & (1u << (rr->f[RAW_SEV][0] - '0')))) return 0;
+    if (!time_ok(rr->f[RAW_ARRIVAL], rr->len[RAW_ARRIVAL], &q->arrival_lo, &q->arrival_hi)) return 0;
+    if (!time_ok(rr->f[RAW_SERVED], rr->len[RAW_SERVED], &q->served_lo, &q->served_hi)) return 0;
+    if (!raw_range_ok(&q->age, rr->f[RAW_AGE], rr->len[RAW_AGE])) return 0;
+    if (!raw_range_ok(&q->wait, rr->f[RAW_WAIT], rr->len[RAW_WAIT])) return 0;
+    if (!raw_range_ok(&q->id, rr->f[RAW_ID], rr->len[RAW_ID])) return 0;
+    if (!raw_range_ok(&q->phone, rr->f[RAW_PHONE], rr->len[RAW_PHONE])) return 0;
+    for (int i = 0; i < q->ntext; ++i) {
+        const QueryText *t = &q->text[i];
+        if (t->field == QF_NAME && !text_ok(t, rr->f[RAW_NAME], rr->len[RAW_NAME])) return 0;
+        /* problem and department text lies in the tail, so a row whose tail
+           lacks the needle is out before it is parsed */
+        if (t->field != QF_NAME && !t->negate && !contains_ci(rr->tail, rr->tail_len, t->needle, t->len)) return 0;
+    }
+    return 1;
+}
+
+/* ---------- results ---------- */
+
+void query_result_init(QueryResult *r, const Query *q) {
+    if (!r) return;
+    memset(r, 0, sizeof(*r));
+    r->rows_cap = q && !q->count_only ? q->limit : 0;
+}
+
+void query_result_free(QueryResult *r) {
+    if (!r) return;
+    free(r->rows);
+    memset(r, 0, sizeof(*r));
+}
+
+/* Rows grow by doubling from 64 up to the limit */
+static int rows_allocated(int n, int max) {
+    if (n == 0) return 0;
+    int a = 64;
+    while (a < n) a *= 2;
+    return a < max ? a : max;
+}
+
+static int keep_row(QueryResult *r, const ServedRecord *rec) {
+    if (r->nrows == rows_allocated(r->nrows, r->rows_cap)) {
+        int n = rows_allocated(r->nrows + 1, r->rows_cap);
+        ServedRecord *rows = realloc(r->rows, (size_t)n * sizeof(ServedRecord));
+        if (!rows) return 0;
+        r->rows = rows;
+    }
+    r->rows[r->nrows++] = *rec;
+    return 1;
+}
+
+/* Groups are kept sorted: severity most urgent first, age by decade, the
+   rest by key */
+static int group_cmp(QueryGroupBy by, const char *a, const char *b) {
+    if (by == QG_SEVERITY) {
+        int sa = 0, sb = 0;
+        parse_severity(a, &sa);
+        parse_severity(b, &sb);
+        return sb - sa;
+    }
+    if (by == QG_AGE) return atoi(a) - atoi(b);
+    return strcmp(a, b);
+}
+
+static void add_group(const Query *q, QueryResult *r, int sev, int age, const char *arrival, size_t alen,
+                      const char *dept, size_t dlen, int served, long wait) {
+    char key[32];
+    switch (q->group_by) {
+        case QG_SEVERITY: snprintf(key, sizeof(key), "%s", SEV_NAMES[sev]); break;
+        case QG_DEPT:
+            if (dlen) snprintf(key, sizeof(key), "%.*s", (int)dlen, dept);
+            else snprintf(key, sizeof(key), "(none)");
+            break;
+        case QG_DAY:
+            if (alen >= 10) snprintf(key, sizeof(key), "%.10s", arrival);
+            else snprintf(key, sizeof(key), "(unknown)");
+            break;
+        case QG_HOUR:
+            if (alen >= 13) snprintf(key, sizeof(key), "%.2s:00", arrival + 11);
+            else snprintf(key, sizeof(key), "(unknown)");
+            break;
+        case QG_AGE: snprintf(key, sizeof(key), "%d-%d", age / 10 * 10, age / 10 * 10 + 9); break;
+        case QG_STATUS: snprintf(key, sizeof(key), "%s", served ? "served" : "waiting"); break;
+        default: return;
+    }
+
+    int n = r->ngroups > QUERY_MAX_GROUPS ? QUERY_MAX_GROUPS : r->ngroups;
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (group_cmp(q->group_by, r->groups[mid].key, key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    QueryGroup *g;
+    if (lo < n && strcmp(r->groups[lo].key, key) == 0) {
+        g = &r->groups[lo];
+    } else if (n < QUERY_MAX_GROUPS) {
+        memmove(&r->groups[lo + 1], &r->groups[lo], (size_t)(n - lo) * sizeof(QueryGroup));
+        g = &r->groups[lo];
+        memset(g, 0, sizeof(*g));
+        snprintf(g->key, sizeof(g->key), "%s", key);
+        r->ngroups++;
+    } else {
+        g = &r->groups[QUERY_MAX_GROUPS];
+        if (r->ngroups == QUERY_MAX_GROUPS) {
+            memset(g, 0, sizeof(*g));
+            snprintf(g->key, sizeof(g->key), "(other)");
+            r->ngroups++;
+        }
+    }
+    g->count++;
+    g->wait_sum += (double)wait;
+}
+
+static int take_record(const Query *q, QueryResult *r, const ServedRecord *rec) {
+    r->matched++;
+    add_group(q, r, rec->severity, rec->age, rec->arrival, strlen(rec->arrival), rec->department,
+              strlen(rec->department), rec->served_at[0] != '\0', rec->wait_sec);
+    return r->nrows < r->rows_cap ? keep_row(r, rec) : 1;
+}
+
+/* ---------- waiting queues ---------- */
+
+typedef struct QueueScan {
+    const Query *q;
+    const char *department;
+    time_t now;
+    QueryResult *r;
+} QueueScan;
+
+static void scan_patient(void *ctx, const Patient *p) {
+    QueueScan *s = ctx;
+    ServedRecord rec;
+    rec.id = p->id;
+    rec.phone = p->phone_number;
+    snprintf(rec.name, sizeof(rec.name), "%s", p->name ? p->name : "");
+    rec.age = p->age;
+    rec.severity = (int)p->severity;
+    snprintf(rec.arrival, sizeof(rec.arrival), "%s", p->arrival);
+    rec.served_at[0] = '\0';
+    time_t arrived = p->arrival_ts != (time_t)-1 ? p->arrival_ts : parse_iso_time(p->arrival);
+    rec.wait_sec = arrived != (time_t)-1 ? (long)(s->now - arrived) : 0;
+    snprintf(rec.problem, sizeof(rec.problem), "%s", p->problem ? p->problem : "");
+    rec.service_end[0] = '\0';
+    rec.counter_id = 0;
+    snprintf(rec.department, sizeof(rec.department), "%s", s->department);
+
+    s->r->scanned++;
+    if (record_ok(s->q, &rec)) take_record(s->q, s->r, &rec);
+}
+
+void query_scan_queue(const Query *q, PriorityQueue *pq, const char *department, time_t now, QueryResult *r) {
+    if (!q || !pq || !r || !(q->sources & QUERY_SRC_WAITING)) return;
+    if (!department) department = "";
+    /* a served_at term or a department test decides for the whole queue */
+    if (q->served_lo.len || q->served_hi.len || !texts_ok(q, QF_DEPT, department)) return;
+    QueueScan s = { q, department, now, r };
+    pq_arrival_walk(pq, scan_patient, &s);
+}
+
+/* ---------- served.csv ---------- */
+
+void query_index_init(QueryIndex *ix) {
+    if (!ix) return;
+    memset(ix, 0, sizeof(*ix));
+    pthread_mutex_init(&ix->lock, NULL);
+}
+
+void query_index_free(QueryIndex *ix) {
+    if (!ix) return;
+    free(ix->blocks);
+    pthread_mutex_destroy(&ix->lock);
+    memset(ix, 0, sizeof(*ix));
+}
+
+/* Whether a block's time span can hold a row inside the query's bounds */
+static int span_meets(const char *min, const char *max, const QueryTimeBound *lo, const QueryTimeBound *hi) {
+    static const QueryTimeBound none;
+    return time_ok(min, strlen(min), &none, hi) && time_ok(max, strlen(max), lo, &none);
+}
+
+static int block_meets(const Query *q, const QueryBlock *b) {
+    return span_meets(b->arrival_min, b->arrival_max, &q->arrival_lo, &q->arrival_hi)
+        && span_meets(b->served_min, b->served_max, &q->served_lo, &q->served_hi);
+}
+
+static void widen_span(char *min, char *max, const char *s, size_t len) {
+    if (len == 0 || len >= TIME_LEN) return;
+    if (!min[0] || strncmp(s, min, len) < 0 || (strncmp(s, min, len) == 0 && strlen(min) > len)) {
+        memcpy(min, s, len);
+        min[len] = '\0';
+    }
+    if (!max[0] || strncmp(s, max, len) > 0 || (strncmp(s, max, len) == 0 && strlen(max) < len)) {
+        memcpy(max, s, len);
+        max[len] = '\0';
+    }
+}
+
+/* Next line of f into line, the tail of an overlong one skipped. Returns
+   its length in the file, 0 at the end; *partial is set for a last line
+   without its newline, i.e. a row still being written. */
+static size_t read_row(FILE *f, char *line, size_t size, int *partial) {
+    *partial = 0;
+    if (!fgets(line, (int)size, f)) return 0;
+    size_t len = strlen(line);
+    if (len && line[len - 1] == '\n') return len;
+    int c;
+    while ((c = fgetc(f)) != EOF && c != '\n') len++;
+    if (c == EOF) *partial = 1;
+    else len++;
+    return len;
+}
+
+/* Test one served.csv line. Fills rr and returns 1 if the line is a row
+   at all (matched or not), so the caller can index its times. */
+static int test_line(const Query *q, const char *line, QueryResult *r, RawRow *rr, int *ok) {
+    size_t len = strcspn(line, "\r\n");
+    if (!split_raw(line, len, rr)) return 0;
+    r->scanned++;
+    if (!raw_ok(q, rr)) return 1;
+
+    /* the whole row only when a later test, the group or the display needs it */
+    if (q->full_parse || q->group_by == QG_DEPT || r->nrows < r->rows_cap) {
+        ServedRecord rec;
+        if (!history_parse_line(line, &rec) || !record_ok(q, &rec)) return 1;
+        if (!take_record(q, r, &rec)) *ok = 0;
+        return 1;
+    }
+    long long id, wait, age = 0;
+    if (!raw_int(rr->f[RAW_ID], rr->len[RAW_ID], &id) || !raw_int(rr->f[RAW_WAIT], rr->len[RAW_WAIT], &wait)) return 1;
+    raw_int(rr->f[RAW_AGE], rr->len[RAW_AGE], &age);
+    r->matched++;
+    add_group(q, r, rr->f[RAW_SEV][0] - '0', (int)age, rr->f[RAW_ARRIVAL], rr->len[RAW_ARRIVAL], "", 0, 1, (long)wait);
+    return 1;
+}
+
+int query_scan_history(const Query *q, QueryIndex *ix, const char *path, QueryResult *r) {
+    if (!q || !path || !r || !(q->sources & QUERY_SRC_SERVED)) return 1;
+    FILE *f = fopen(path, "rb");
+    if (!f) return 1;
+    setvbuf(f, NULL, _IOFBF, 1 << 16);
+
+    char line[1024];
+    if (!fgets(line, sizeof(line), f)) { fclose(f); return 1; }
+    long body = ftell(f), end = body;
+
+    /* work from a copy of the index, so other desks are not held up */
+    QueryBlock *blocks = NULL;
+    int nblocks = 0;
+    unsigned long long inode = 0;
+    if (ix) {
+        struct stat st;
+        long size = 0;
+        if (fstat(fileno(f), &st) == 0) {
+            inode = (unsigned long long)st.st_ino;
+            size = (long)st.st_size;
+        }
+        pthread_mutex_lock(&ix->lock);
+        if (ix->inode != inode || size < ix->indexed_end) {
+            ix->nblocks = 0;
+            ix->indexed_end = 0;
+            ix->inode = inode;
+        }
+        if (ix->nblocks && (blocks = malloc((size_t)ix->nblocks * sizeof(QueryBlock))) != NULL) {
+            memcpy(blocks, ix->blocks, (size_t)ix->nblocks * sizeof(QueryBlock));
+            nblocks = ix->nblocks;
+            end = ix->indexed_end;
+        }
+        pthread_mutex_unlock(&ix->lock);
+    }
+    long start = end;   /* where this scan's new blocks continue the index */
+
+    int ok = 1;
+    RawRow rr;
+    for (int i = 0; i < nblocks; ++i) {
+        if (!block_meets(q, &blocks[i])) { r->skipped += QUERY_BLOCK_ROWS; continue; }
+        if (fseek(f, blocks[i].offset, SEEK_SET) != 0) break;
+        int partial;
+        for (int n = 0; n < QUERY_BLOCK_ROWS && read_row(f, line, sizeof(line), &partial); ++n) {
+            test_line(q, line, r, &rr, &ok);
+        }
+    }
+    free(blocks);
+
+    /* rows past the index: test them all, and index each complete block */
+    QueryBlock *fresh = NULL, cur;
+    int nfresh = 0, cap = 0, rows = 0, indexing = ix != NULL;
+    long pos = end;
+    if (fseek(f, end, SEEK_SET) != 0) { fclose(f); return ok; }
+    size_t len;
+    int partial;
+    while ((len = read_row(f, line, sizeof(line), &partial)) != 0) {
+        /* a row still being written is tested but ends the index */
+        if (partial) { test_line(q, line, r, &rr, &ok); break; }
+        if (rows == 0) {
+            memset(&cur, 0, sizeof(cur));
+            cur.offset = pos;
+        }
+        pos += (long)len;
+        if (test_line(q, line, r, &rr, &ok)) {
+            widen_span(cur.arrival_min, cur.arrival_max, rr.f[RAW_ARRIVAL], rr.len[RAW_ARRIVAL]);
+            widen_span(cur.served_min, cur.served_max, rr.f[RAW_SERVED], rr.len[RAW_SERVED]);
+        }
+        if (++rows < QUERY_BLOCK_ROWS || !indexing) continue;
+        rows = 0;
+        if (nfresh == cap) {
+            int n = cap ? cap * 2 : 64;
+            QueryBlock *grown = realloc(fresh, (size_t)n * sizeof(QueryBlock));
+            if (!grown) { indexing = 0; continue; }
+            fresh = grown;
+            cap = n;
+        }
+        fresh[nfresh++] = cur;
+        end = pos;
+    }
+    fclose(f);
+
+    if (ix && nfresh) {
+        pthread_mutex_lock(&ix->lock);
+        /* another scan may have indexed the same rows meanwhile */
+        if (ix->inode == inode && (ix->nblocks ? ix->indexed_end : body) == start) {
+            if (ix->nblocks + nfresh > ix->cap) {
+                int n = ix->cap ? ix->cap : 64;
+                while (n < ix->nblocks + nfresh) n *= 2;
+                QueryBlock *grown = realloc(ix->blocks, (size_t)n * sizeof(QueryBlock));
+                if (grown) { ix->blocks = grown; ix->cap = n; }
+            }
+            if (ix->nblocks + nfresh <= ix->cap) {
+                memcpy(ix->blocks + ix->nblocks, fresh, (size_t)nfresh * sizeof(QueryBlock));
+                ix->nblocks += nfresh;
+                ix->indexed_end = end;
+            }
+        }
+        pthread_mutex_unlock(&ix->lock);
+    }
+    free(fresh);
+    return ok;
+}
+
+void query_put_field(StrBuf *out, const ServedRecord *row, QueryField f) {
+    if (!out || !row) return;
+    switch (f) {
+        case QF_ID: sb_printf(out, "%d", row->id); break;
+        case QF_PHONE: if (row->phone) sb_printf(out, "%lld", row->phone); break;
+        case QF_NAME: sb_puts(out, row->name); break;
+        case QF_AGE: sb_printf(out, "%d", row->age); break;
+        case QF_SEVERITY: sb_puts(out, SEV_NAMES[row->severity]); break;
+        case QF_ARRIVAL: sb_puts(out, row->arrival); break;
+        case QF_SERVED_AT: sb_puts(out, row->served_at[0] ? row->served_at : "-"); break;
+        case QF_WAIT: sb_printf(out, "%.1f", (double)row->wait_sec / 60.0); break;
+        case QF_PROBLEM: sb_puts(out, row->problem); break;
+        case QF_COUNTER: if (row->counter_id) sb_printf(out, "%d", row->counter_id); break;
+        case QF_DEPT: sb_puts(out, row->department); break;
+        case QF_STATUS: sb_puts(out, row->served_at[0] ? "served" : "waiting"); break;
+        case QF_COUNT: break;
+    }
+}
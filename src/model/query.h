@@ -0,0 +1,156 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include "patient.h"
+#include "queue.h"
+#include "history.h"
+#include "../util/strbuf.h"
+
+/* Ad-hoc filter queries over the waiting queues and served.csv, e.g.
+
+     severity=critical age>60 wait>30 date>=-7d
+     name~kumar problem~fever from served show id,name,wait limit 50
+     date=2026-10-01..2026-10-07 count by dept
+
+   A query is whitespace-separated terms:
+     field op value   op is = != < <= > >= or ~ (contains, case-insensitive);
+                      = also takes a lo..hi range (either end may be empty)
+       id, phone, age, counter       integers
+       wait                          minutes, or with a s/m/h suffix
+       severity                      normal/serious/critical or 0-2, = and != take a list
+       date, arrival                 arrival time: YYYY-MM-DD[ HH[:MM]], today,
+                                     yesterday, -Nd or -Nh (N days / hours
+                                     ago); a date covers the whole day
+       served                        served_at, likewise
+       name, problem, dept           ~ and !~ (contains), = and != (whole value)
+       status                        waiting or served
+     from waiting|served|all         default all
+     show f1,f2,...                  columns (default id,name,age,severity,arrival,wait,dept)
+     count [by severity|dept|day|hour|age|status]
+     limit N                         rows kept for display (default 20)
+
+   query_compile turns this into a pipeline: terms on the same field merge
+   into one range, and the tests run cheapest first (severity, timestamps
+   compared as text, then numbers, then substrings), each reading only its
+   own CSV field of a served.csv row. The full row is parsed only when a
+   test needs the problem or department text, or a match is kept for
+   display. A date term skips whole blocks of served.csv through a
+   QueryIndex, and a dept term skips whole queues. */
+
+typedef enum {
+    QF_ID, QF_PHONE, QF_NAME, QF_AGE, QF_SEVERITY, QF_ARRIVAL, QF_SERVED_AT,
+    QF_WAIT, QF_PROBLEM, QF_COUNTER, QF_DEPT, QF_STATUS, QF_COUNT
+} QueryField;
+
+typedef enum { QG_NONE, QG_SEVERITY, QG_DEPT, QG_DAY, QG_HOUR, QG_AGE, QG_STATUS } QueryGroupBy;
+
+#define QUERY_SRC_WAITING 1
+#define QUERY_SRC_SERVED  2
+
+#define QUERY_MAX_TEXT 4      /* substring tests per query */
+#define QUERY_MAX_GROUPS 64   /* further groups are counted as "(other)" */
+#define QUERY_DEFAULT_LIMIT 20
+#define QUERY_MAX_LIMIT 10000
+
+typedef struct QueryRange {
+    int on;
+    long long lo, hi;         /* inclusive */
+} QueryRange;
+
+/* Timestamp bound compared with the first len bytes of a
+   "YYYY-MM-DD HH:MM:SS" field, so "2026-10-07" covers the whole day */
+typedef struct QueryTimeBound {
+    char text[TIME_LEN];
+    size_t len;               /* 0 = unbounded */
+    int strict;               /* < or > rather than <= or >= */
+} QueryTimeBound;
+
+typedef struct QueryText {
+    QueryField field;         /* QF_NAME, QF_PROBLEM or QF_DEPT */
+    int negate;
+    int exact;                /* dept=: whole value, not a substring */
+    char needle[64];          /* lowercased */
+    size_t len;
+} QueryText;
+
+typedef struct Query {
+    int sources;              /* QUERY_SRC_* */
+    unsigned severities;      /* bit per Severity; 7 = any */
+    QueryRange id, phone, age, wait, counter;
+    QueryTimeBound arrival_lo, arrival_hi, served_lo, served_hi;
+    QueryText text[QUERY_MAX_TEXT];
+    int ntext;
+    int full_parse;           /* a test reads problem or department */
+
+    QueryField show[QF_COUNT];
+    int nshow;
+    int count_only;
+    QueryGroupBy group_by;
+    int limit;
+} Query;
+
+/* Returns 1, or 0 with a message in err */
+int query_compile(const char *text, Query *q, time_t now, char *err, size_t errlen);
+
+typedef struct QueryGroup {
+    char key[32];
+    long count;
+    double wait_sum;
+} QueryGroup;
+
+typedef struct QueryResult {
+    long matched;
+    long scanned;             /* rows tested */
+    long skipped;             /* served.csv rows skipped by the date index */
+    ServedRecord *rows;       /* first limit matches; served_at is empty for waiting patients */
+    int nrows;
+    int rows_cap;
+    QueryGroup groups[QUERY_MAX_GROUPS + 1];
+    int ngroups;              /* the last may be "(other)" */
+} QueryResult;
+
+void query_result_init(QueryResult *r, const Query *q);
+void query_result_free(QueryResult *r);
+
+/* Date index of served.csv: for each block of QUERY_BLOCK_ROWS complete
+   rows, its byte offset and the lowest and highest arrival and served_at.
+   Blocks are added as scans read past the indexed end, so the first query
+   pays one ordinary scan and later ones only read blocks whose time span
+   meets their date terms, plus the rows appended since. A file that shrank
+   or was replaced is indexed afresh. Shared by every desk of a server, so
+   it has its own mutex. */
+#define QUERY_BLOCK_ROWS 1024
+
+typedef struct QueryBlock {
+    long offset;
+    char arrival_min[TIME_LEN], arrival_max[TIME_LEN];
+    char served_min[TIME_LEN], served_max[TIME_LEN];
+} QueryBlock;
+
+typedef struct QueryIndex {
+    pthread_mutex_t lock;
+    QueryBlock *blocks;
+    int nblocks;
+    int cap;
+    long indexed_end;         /* offset after the last indexed block */
+    unsigned long long inode; /* of the indexed file */
+} QueryIndex;
+
+void query_index_init(QueryIndex *ix);
+void query_index_free(QueryIndex *ix);
+
+/* Test the waiting patients of q (caller holds its lock); wait counts to now */
+void query_scan_queue(const Query *q, PriorityQueue *pq, const char *department, time_t now, QueryResult *r);
+
+/* Test the rows of a served.csv (a missing file has none). ix may be NULL:
+   every row is read. Returns 0 if memory ran out. */
+int query_scan_history(const Query *q, QueryIndex *ix, const char *path, QueryResult *r);
+
+/* Column title and value of one kept row */
+const char* query_field_name(QueryField f);
+void query_put_field(StrBuf *out, const ServedRecord *row, QueryField f);
+
+#endif /* QUERY_H */
@@ -1,88 +1,697 @@
 #include "queue.h"
+#include "snapshot.h"
+#include "spill.h"
+#include "../util/metrics.h"
+#include "../util/trace.h"
+#include <ctype.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 
+#define PQ_DEFAULT_SLA_CRITICAL (10 * 60)
+#define PQ_DEFAULT_SLA_SERIOUS  (30 * 60)
+#define PQ_DEFAULT_SLA_NORMAL   (120 * 60)
+
+void pq_policy_default(PqPolicy *policy) {
+    if (!policy) return;
+    policy->mode = PQ_MODE_STRICT;
+    policy->max_wait_sec[CRITICAL] = PQ_DEFAULT_SLA_CRITICAL;
+    policy->max_wait_sec[SERIOUS] = PQ_DEFAULT_SLA_SERIOUS;
+    policy->max_wait_sec[NORMAL] = PQ_DEFAULT_SLA_NORMAL;
+    policy->factors = 0;
+    policy->child_age = PQ_DEFAULT_CHILD_AGE;
+    policy->elder_age = PQ_DEFAULT_ELDER_AGE;
+}
+
+static unsigned parse_factors(const char *spec) {
+    unsigned factors = 0;
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    for (char *tok = strtok(buf, ", "); tok; tok = strtok(NULL, ", ")) {
+        if (strcmp(tok, "triage") == 0) factors |= PQ_FACTOR_AGE | PQ_FACTOR_PREGNANCY;
+        else if (strcmp(tok, "age") == 0) factors |= PQ_FACTOR_AGE;
+        else if (strcmp(tok, "pregnancy") == 0) factors |= PQ_FACTOR_PREGNANCY;
+        /* "severity" (the default) adds nothing */
+    }
+    return factors;
+}
+
+void pq_policy_from_env(PqPolicy *policy) {
+    if (!policy) return;
+    pq_policy_default(policy);
+
+    const char *mode = getenv("HOSP_SCHED");
+    if (mode && strcmp(mode, "aging") == 0) policy->mode = PQ_MODE_AGING;
+
+    const char *sla = getenv("HOSP_SLA_MIN");
+    int c, s, n;
+    if (sla && sscanf(sla, "%d,%d,%d", &c, &s, &n) == 3 && c >= 0 && s >= 0 && n >= 0) {
+        policy->max_wait_sec[CRITICAL] = c * 60;
+        policy->max_wait_sec[SERIOUS] = s * 60;
+        policy->max_wait_sec[NORMAL] = n * 60;
+    }
+
+    const char *prio = getenv("HOSP_PRIORITY");
+    if (prio) policy->factors = parse_factors(prio);
+
+    const char *ages = getenv("HOSP_VULN_AGE");
+    int child, elder;
+    if (ages && sscanf(ages, "%d,%d", &child, &elder) == 2 && child >= 0 && elder >= child) {
+        policy->child_age = child;
+        policy->elder_age = elder;
+    }
+}
+
+const char* pq_policy_describe(const PqPolicy *policy, char *buf, size_t buflen) {
+    if (!buf || buflen == 0) return "";
+    if (!policy) { buf[0] = '\0'; return buf; }
+    char factors[64] = "";
+    if (policy->factors & PQ_FACTOR_AGE)
+        snprintf(factors, sizeof(factors), " + age <%d/>%d", policy->child_age, policy->elder_age);
+    if (policy->factors & PQ_FACTOR_PREGNANCY)
+        snprintf(factors + strlen(factors), sizeof(factors) - strlen(factors), " + pregnancy");
+    snprintf(buf, buflen, "%s, severity%s", policy->mode == PQ_MODE_AGING ? "aging" : "strict", factors);
+    return buf;
+}
+
 /* Ensure queue is initialized */
 void pq_init(PriorityQueue *q) {
     if (!q) return;
     q->head = NULL;
     q->tail = NULL;
     q->count = 0;
+    q->heap = NULL;
+    q->heap_cap = 0;
+    q->next_seq = 0;
+    q->key_base = 0;
+    pq_policy_default(&q->policy);
+    q->snap = NULL;
+    q->spill = NULL;
+    q->observers = 0;
 }
 
-/* Enqueue patient into priority queue (higher severity first).
-   Added debug prints and safety checks to diagnose crash. */
-void pq_enqueue(PriorityQueue *q, Patient *p) {
-    printf("DEBUG(pq_enqueue): q=%p p=%p\n", (void*)q, (void*)p);
-    fflush(stdout);
+int pq_add_observer(PriorityQueue *q, PqObserver fn, void *ctx) {
+    if (!q || !fn || q->observers == PQ_MAX_OBSERVERS) return 0;
+    q->observer[q->observers] = fn;
+    q->observer_ctx[q->observers] = ctx;
+    q->observers++;
+    return 1;
+}
 
-    if (!q) { printf("DEBUG: pq_enqueue - q is NULL\n"); fflush(stdout); return; }
-    if (!p) { printf("DEBUG: pq_enqueue - p is NULL\n"); fflush(stdout); return; }
+void pq_remove_observer(PriorityQueue *q, PqObserver fn, void *ctx) {
+    if (!q) return;
+    for (int i = 0; i < q->observers; ++i) {
+        if (q->observer[i] != fn || q->observer_ctx[i] != ctx) continue;
+        for (int j = i + 1; j < q->observers; ++j) {
+            q->observer[j - 1] = q->observer[j];
+            q->observer_ctx[j - 1] = q->observer_ctx[j];
+        }
+        q->observers--;
+        return;
+    }
+}
+
+#define PQ_NOTIFY(q, ev, p, old) \
+    do { \
+        for (int o_ = 0; o_ < (q)->observers; ++o_) (q)->observer[o_]((q)->observer_ctx[o_], (ev), (p), (old)); \
+    } while (0)
+
+/* ---------- ordering keys ---------- */
+
+static int sev_index(Severity sev) {
+    if (sev < NORMAL) return NORMAL;
+    if (sev > CRITICAL) return CRITICAL;
+    return (int)sev;
+}
+
+time_t pq_sla_deadline(const PriorityQueue *q, const Patient *p) {
+    if (!q || !p) return (time_t)-1;
+    time_t arrived = p->arrival_ts != (time_t)-1 ? p->arrival_ts : time(NULL);
+    return arrived + (q->policy.max_wait_sec[sev_index(p->severity)] >> pq_vulnerability(&q->policy, p));
+}
+
+int pq_vulnerability(const PqPolicy *policy, const Patient *p) {
+    if (!policy || !p) return 0;
+    int v = 0;
+    if ((policy->factors & PQ_FACTOR_AGE) && (p->age < policy->child_age || p->age > policy->elder_age)) v++;
+    if ((policy->factors & PQ_FACTOR_PREGNANCY) && (p->flags & PATIENT_PREGNANT)) v++;
+    return v;
+}
+
+#define AGING_SPAN (1LL << PQ_AGING_DEADLINE_BITS)
+#define AGING_SEQ_MASK ((1ULL << PQ_AGING_SEQ_BITS) - 1)
+
+static uint64_t compute_key(const PriorityQueue *q, const Patient *p) {
+    uint64_t vuln = (uint64_t)pq_vulnerability(&q->policy, p);
+    if (q->policy.mode == PQ_MODE_AGING) {
+        /* static deadline: aging without ever rescanning the queue */
+        long long off = (long long)pq_sla_deadline(q, p) - (long long)q->key_base;
+        if (off < 0) off = 0;
+        if (off >= AGING_SPAN) off = AGING_SPAN - 1;
+        return ((uint64_t)off << PQ_AGING_SEQ_BITS) | (p->seq & AGING_SEQ_MASK);
+    }
+    uint64_t sev_rank = (uint64_t)(CRITICAL - sev_index(p->severity));
+    return (sev_rank << 62) | ((2 - vuln) << PQ_KEY_SEQ_BITS) | (p->seq & ((1ULL << PQ_KEY_SEQ_BITS) - 1));
+}
+
+static inline int heap_less(const Patient *a, const Patient *b) {
+    return a->sort_key < b->sort_key;
+}
+
+/* ---------- heap ---------- */
+
+static void heap_set(PriorityQueue *q, int i, Patient *p) {
+    q->heap[i] = p;
+    p->heap_idx = i;
+}
+
+static void sift_up(PriorityQueue *q, int i) {
+    Patient *p = q->heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!heap_less(p, q->heap[parent])) break;
+        heap_set(q, i, q->heap[parent]);
+        i = parent;
+    }
+    heap_set(q, i, p);
+}
+
+static void sift_down(PriorityQueue *q, int i) {
+    Patient *p = q->heap[i];
+    int n = q->count;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= n) break;
+        if (child + 1 < n && heap_less(q->heap[child + 1], q->heap[child])) child++;
+        if (!heap_less(q->heap[child], p)) break;
+        heap_set(q, i, q->heap[child]);
+        i = child;
+    }
+    heap_set(q, i, p);
+}
 
-    /* defensive: ensure p->next is NULL before insert */
+static int heap_reserve(PriorityQueue *q, int need) {
+    if (need <= q->heap_cap) return 1;
+    int ncap = q->heap_cap ? q->heap_cap * 2 : 64;
+    while (ncap < need) ncap *= 2;
+    Patient **nh = realloc(q->heap, (size_t)ncap * sizeof(Patient*));
+    if (!nh) return 0;
+    q->heap = nh;
+    q->heap_cap = ncap;
+    return 1;
+}
+
+/* Remove heap slot i and restore the heap property */
+static void heap_remove_at(PriorityQueue *q, int i) {
+    int last = q->count - 1;
+    Patient *removed = q->heap[i];
+    removed->heap_idx = -1;
+    q->count--;
+    if (i == last) return;
+    heap_set(q, i, q->heap[last]);
+    if (i > 0 && heap_less(q->heap[i], q->heap[(i - 1) / 2])) sift_up(q, i);
+    else sift_down(q, i);
+}
+
+/* ---------- arrival list ---------- */
+
+static void list_append(PriorityQueue *q, Patient *p) {
     p->next = NULL;
+    p->prev = q->tail;
+    if (q->tail) q->tail->next = p;
+    else q->head = p;
+    q->tail = p;
+}
 
-    /* empty queue */
-    if (q->head == NULL) {
-        q->head = q->tail = p;
-        q->count = 1;
-        printf("DEBUG: inserted as head, count=%d\n", q->count);
-        fflush(stdout);
-        return;
+static void list_unlink(PriorityQueue *q, Patient *p) {
+    if (p->prev) p->prev->next = p->next;
+    else q->head = p->next;
+    if (p->next) p->next->prev = p->prev;
+    else q->tail = p->prev;
+    p->next = p->prev = NULL;
+}
+
+/* ---------- snapshot mirror ---------- */
+
+/* Drop the dead records once they outnumber the live ones; pages still held
+   by snapshots stay valid until those are released */
+static void snap_left(PriorityQueue *q, Patient *p) {
+    if (!q->snap) return;
+    snap_store_drop(q->snap, p);
+    if (q->snap->used >= 4 * SNAP_PAGE_SLOTS && q->snap->dead > q->snap->used / 2) {
+        uint64_t version = q->snap->version;
+        snap_store_free(q->snap);
+        q->snap = calloc(1, sizeof(SnapStore));
+        if (!q->snap) return;
+        for (Patient *cur = q->head; cur; cur = cur->next) snap_store_put(q->snap, cur);
+        q->snap->version = version + 1;
     }
+}
 
-    /* If new patient has higher severity than head, insert at front */
-    if (p->severity > q->head->severity) {
-        p->next = q->head;
-        q->head = p;
-        q->count++;
-        printf("DEBUG: inserted at front, count=%d\n", q->count);
-        fflush(stdout);
+/* ---------- disk overflow ---------- */
+
+/* Keys within a class grow with arrival (seq in STRICT, deadline in AGING),
+   which is what lets a class's tail sit in an append-only run sorted both
+   by key and by seq */
+static int spill_class(const PriorityQueue *q, const Patient *p) {
+    return sev_index(p->severity) * 3 + pq_vulnerability(&q->policy, p);
+}
+
+static int aging_fit(PriorityQueue *q, const Patient *p);
+
+/* Insert a refilled patient, keeping the seq it was spilled with */
+static void refill_class(PriorityQueue *q, int cls) {
+    SpillStore *st = q->spill;
+    Patient *batch[SPILL_REFILL_BATCH];
+    TRACE_BEGIN(span);
+    int n = spill_read_batch(st, cls, batch, SPILL_REFILL_BATCH);
+    TRACE_END(span, "spill.read_batch");
+    if (n == 0 || !heap_reserve(q, q->count + n)) {
+        for (int i = 0; i < n; ++i) free_patient(batch[i]);
         return;
     }
+    for (int i = 0; i < n; ++i) {
+        Patient *p = batch[i];
+        aging_fit(q, p);
+        p->sort_key = compute_key(q, p);
+        list_append(q, p);
+        heap_set(q, q->count, p);
+        q->count++;
+        sift_up(q, p->heap_idx);
+        if (q->snap) snap_store_put(q->snap, p);
+        st->mem_by_class[cls]++;
+        PQ_NOTIFY(q, PQ_EV_REFILL, p, p->severity);
+    }
+}
 
-    /* Find insertion point: keep list sorted by severity desc, FIFO within same severity */
-    Patient *cur = q->head;
-    while (cur->next != NULL && cur->next->severity >= p->severity) {
-        cur = cur->next;
+/* Bookkeeping once p left memory (dequeue, removal, re-triage to another
+   class): the class's head must stay in memory while it has a spilled tail */
+static void spill_left(PriorityQueue *q, Patient *p, int cls) {
+    SpillStore *st = q->spill;
+    if (st->pending == p) st->pending = NULL;
+    if (--st->mem_by_class[cls] == 0 && st->run[cls].count > 0) refill_class(q, cls);
+}
+
+/* The newest arrival is spilled on the next enqueue, so a patient called
+   right after registering never touches the disk. It goes to its class's
+   run if that already has a tail (the run must stay in arrival order), or
+   if memory is over the cap; either way only when its class keeps another
+   patient in memory. */
+static void spill_pending(PriorityQueue *q) {
+    SpillStore *st = q->spill;
+    Patient *p = st->pending;
+    st->pending = NULL;
+    if (!p || p->heap_idx < 0) return;
+    int cls = spill_class(q, p);
+    SpillRun *r = &st->run[cls];
+    if (st->mem_by_class[cls] < 2) return;
+    if (r->count == 0 && q->count <= st->mem_cap) return;
+    /* an AGING key need not grow with arrival (transfers, reloads keep the
+       original arrival time); such a patient stays in memory */
+    if (r->count > 0 && p->sort_key < r->tail_key) return;
+    if (!spill_append(st, cls, p)) return;
+    r->tail_key = p->sort_key;
+    heap_remove_at(q, p->heap_idx);
+    list_unlink(q, p);
+    snap_left(q, p);
+    st->mem_by_class[cls]--;
+    PQ_NOTIFY(q, PQ_EV_SPILL, p, p->severity);
+    free_patient(p);
+}
+
+/* Sort key of the oldest spilled patient of cls, cached until the head moves */
+static int spill_head_key(PriorityQueue *q, int cls, uint64_t *key) {
+    SpillRun *r = &q->spill->run[cls];
+    if (r->count == 0) return 0;
+    if (!r->head_key_valid) {
+        Patient *p = spill_peek(q->spill, cls);
+        if (!p) return 0;
+        r->head_key = compute_key(q, p);
+        r->head_key_valid = 1;
+        free_patient(p);
     }
+    *key = r->head_key;
+    return 1;
+}
+
+int pq_spill_enable(PriorityQueue *q, int mem_cap, const char *dir) {
+    if (!q || q->spill) return 0;
+    q->spill = spill_store_new(dir, mem_cap);
+    if (!q->spill) return 0;
+    for (int i = 0; i < q->count; ++i) q->spill->mem_by_class[spill_class(q, q->heap[i])]++;
+    return 1;
+}
+
+int pq_spill_from_env(PriorityQueue *q) {
+    const char *cap = getenv("HOSP_QUEUE_MEM_CAP");
+    if (!cap || atoi(cap) <= 0) return 0;
+    const char *dir = getenv("HOSP_QUEUE_SPILL_DIR");
+    return pq_spill_enable(q, atoi(cap), dir && *dir ? dir : "data/spill");
+}
+
+int pq_spilled(const PriorityQueue *q) {
+    return (q && q->spill) ? (int)q->spill->spilled : 0;
+}
 
-    /* Insert after cur */
-    p->next = cur->next;
-    cur->next = p;
-    if (p->next == NULL) q->tail = p;
+void pq_count_by_severity(PriorityQueue *q, int out[3]) {
+    out[NORMAL] = out[SERIOUS] = out[CRITICAL] = 0;
+    if (!q) return;
+    for (Patient *cur = q->head; cur; cur = cur->next) out[sev_index(cur->severity)]++;
+    if (q->spill) {
+        for (int i = 0; i < 3; ++i) out[i] += (int)q->spill->spilled_by_severity[i];
+    }
+}
+
+/* ---------- queue operations ---------- */
+
+/* Enqueue patient; O(log n). Build with -DPQ_DEBUG for the insertion trace. */
+void pq_enqueue(PriorityQueue *q, Patient *p) {
+    PQ_TRACE("DEBUG(pq_enqueue): q=%p p=%p\n", (void*)q, (void*)p);
+
+    if (!q) { PQ_TRACE("DEBUG: pq_enqueue - q is NULL\n"); return; }
+    if (!p) { PQ_TRACE("DEBUG: pq_enqueue - p is NULL\n"); return; }
+    uint64_t t0 = metrics_begin(MET_ENQUEUE);
+    if (q->spill) spill_pending(q);
+    if (!heap_reserve(q, q->count + 1)) { PQ_TRACE("DEBUG: pq_enqueue - heap alloc failed\n"); return; }
+
+    p->seq = q->next_seq++;
+    aging_fit(q, p);
+    p->sort_key = compute_key(q, p);
+    list_append(q, p);
+
+    heap_set(q, q->count, p);
     q->count++;
+    sift_up(q, p->heap_idx);
+    if (q->snap) snap_store_put(q->snap, p);
+    if (q->spill) {
+        q->spill->mem_by_class[spill_class(q, p)]++;
+        q->spill->pending = p;
+    }
+    PQ_NOTIFY(q, PQ_EV_ENQUEUE, p, p->severity);
+    metrics_end(MET_ENQUEUE, t0);
 
-    printf("DEBUG: inserted after %p, new tail=%p, count=%d\n", (void*)cur, (void*)q->tail, q->count);
-    fflush(stdout);
+    PQ_TRACE("DEBUG: inserted at heap slot %d, count=%d\n", p->heap_idx, q->count);
+}
+
+/* Service order with a spill store: the smallest of the heap top and every
+   class's spilled head. Runs are sorted by key, so their heads are all that
+   can beat the heap; they usually don't, since each class's oldest patients
+   stay in memory, but a re-triage or a late arrival can break that. The
+   heads' keys are cached, so this is a few compares per call. */
+static Patient* spill_top(PriorityQueue *q) {
+    for (;;) {
+        int best = -1;
+        uint64_t best_key = q->count > 0 ? q->heap[0]->sort_key : UINT64_MAX;
+        for (int c = 0; c < SPILL_CLASSES; ++c) {
+            uint64_t key;
+            if (spill_head_key(q, c, &key) && key < best_key) { best = c; best_key = key; }
+        }
+        if (best < 0) return q->count > 0 ? q->heap[0] : NULL;
+        int before = q->count;
+        refill_class(q, best);
+        if (q->count == before) return q->count > 0 ? q->heap[0] : NULL;
+    }
 }
 
 Patient* pq_dequeue(PriorityQueue* q) {
-    if (!q || q->head == NULL) return NULL;
-    Patient* p = q->head;
-    q->head = p->next;
-    if (q->head == NULL) q->tail = NULL;
-    p->next = NULL;
-    q->count--;
+    if (!q || (q->count == 0 && pq_spilled(q) == 0)) return NULL;
+    uint64_t t0 = metrics_begin(MET_DEQUEUE);
+    Patient* p = q->spill ? spill_top(q) : q->heap[0];
+    if (!p) return NULL;
+    heap_remove_at(q, p->heap_idx);
+    list_unlink(q, p);
+    snap_left(q, p);
+    if (q->spill) spill_left(q, p, spill_class(q, p));
+    PQ_NOTIFY(q, PQ_EV_DEQUEUE, p, p->severity);
+    metrics_end(MET_DEQUEUE, t0);
     return p;
 }
 
 Patient* pq_peek(PriorityQueue* q) {
     if (!q) return NULL;
-    return q->head;
+    if (q->spill) return spill_top(q);
+    if (q->count == 0) return NULL;
+    return q->heap[0];
+}
+
+static int take_out(PriorityQueue *q, Patient *p, PqEvent ev) {
+    if (!q || !p || p->heap_idx < 0 || p->heap_idx >= q->count || q->heap[p->heap_idx] != p) return 0;
+    heap_remove_at(q, p->heap_idx);
+    list_unlink(q, p);
+    snap_left(q, p);
+    if (q->spill) spill_left(q, p, spill_class(q, p));
+    PQ_NOTIFY(q, ev, p, p->severity);
+    return 1;
+}
+
+int pq_remove(PriorityQueue *q, Patient *p) {
+    return take_out(q, p, PQ_EV_REMOVE);
+}
+
+int pq_dequeue_patient(PriorityQueue *q, Patient *p) {
+    return take_out(q, p, PQ_EV_DEQUEUE);
+}
+
+/* Re-triage: change severity and reposition in O(log n). Queue order within
+   the new severity keeps the original arrival sequence. */
+int pq_update_severity(PriorityQueue *q, Patient *p, Severity sev) {
+    if (!q || !p || p->heap_idx < 0 || p->heap_idx >= q->count || q->heap[p->heap_idx] != p) return 0;
+    if (sev < NORMAL || sev > CRITICAL) return 0;
+    uint64_t old_key = p->sort_key;
+    Severity old_sev = p->severity;
+    int old_cls = q->spill ? spill_class(q, p) : 0;
+    p->severity = sev;
+    if (!aging_fit(q, p)) {
+        p->sort_key = compute_key(q, p);
+        if (p->sort_key < old_key) sift_up(q, p->heap_idx);
+        else if (p->sort_key > old_key) sift_down(q, p->heap_idx);
+    }
+    if (q->snap) snap_store_update(q->snap, p);
+    if (old_sev != sev) PQ_NOTIFY(q, PQ_EV_RETRIAGE, p, old_sev);
+    if (q->spill && spill_class(q, p) != old_cls) {
+        q->spill->mem_by_class[spill_class(q, p)]++;
+        spill_left(q, p, old_cls);
+    }
+    return 1;
+}
+
+/* Recompute every in-memory key and rebuild the heap */
+static void rekey_all(PriorityQueue *q) {
+    for (int i = 0; i < q->count; ++i) {
+        q->heap[i]->sort_key = compute_key(q, q->heap[i]);
+        if (q->snap) snap_store_update(q->snap, q->heap[i]);
+    }
+    for (int i = q->count / 2 - 1; i >= 0; --i) sift_down(q, i);
+    if (q->spill) {
+        for (int c = 0; c < SPILL_CLASSES; ++c) q->spill->run[c].head_key_valid = 0;
+    }
+}
+
+/* Make sure p's AGING deadline fits the key's deadline field, moving
+   key_base forward (and re-keying) when it does not. Returns 1 if the
+   queue was re-keyed, p included. */
+static int aging_fit(PriorityQueue *q, const Patient *p) {
+    if (q->policy.mode != PQ_MODE_AGING) return 0;
+    time_t deadline = pq_sla_deadline(q, p);
+    if (q->key_base == 0) {
+        q->key_base = deadline - AGING_SPAN / 2;
+        return 0;
+    }
+    if ((long long)deadline - (long long)q->key_base < AGING_SPAN) return 0;
+    uint64_t shift = (uint64_t)(deadline - AGING_SPAN / 2 - q->key_base);
+    q->key_base += (time_t)shift;
+    if (q->spill) {
+        /* a run's keys all drop by the same amount, clamped at zero, so they stay sorted */
+        for (int c = 0; c < SPILL_CLASSES; ++c) {
+            SpillRun *r = &q->spill->run[c];
+            uint64_t off = r->tail_key >> PQ_AGING_SEQ_BITS;
+            off = off > shift ? off - shift : 0;
+            r->tail_key = (off << PQ_AGING_SEQ_BITS) | (r->tail_key & AGING_SEQ_MASK);
+        }
+    }
+    rekey_all(q);
+    return 1;
+}
+
+void pq_set_policy(PriorityQueue *q, const PqPolicy *policy) {
+    if (!q || !policy) return;
+    q->policy = *policy;
+    q->key_base = 0;
+    for (Patient *cur = q->head; cur; cur = cur->next) aging_fit(q, cur);
+    rekey_all(q);
+    if (q->spill) {
+        /* runs were sorted under the old policy; set it before spilling starts */
+        for (int c = 0; c < SPILL_CLASSES; ++c) {
+            q->spill->mem_by_class[c] = 0;
+            q->spill->run[c].head_key_valid = 0;
+        }
+        for (int i = 0; i < q->count; ++i) q->spill->mem_by_class[spill_class(q, q->heap[i])]++;
+    }
+}
+
+static int cmp_service_order(const void *a, const void *b) {
+    const Patient *pa = *(Patient* const*)a, *pb = *(Patient* const*)b;
+    if (heap_less(pa, pb)) return -1;
+    if (heap_less(pb, pa)) return 1;
+    return 0;
+}
+
+int pq_ordered(PriorityQueue *q, Patient **out, int max) {
+    if (!q || !out || max <= 0 || q->count == 0) return 0;
+    Patient **tmp = malloc((size_t)q->count * sizeof(Patient*));
+    if (!tmp) return 0;
+    memcpy(tmp, q->heap, (size_t)q->count * sizeof(Patient*));
+    qsort(tmp, (size_t)q->count, sizeof(Patient*), cmp_service_order);
+    int n = q->count < max ? q->count : max;
+    memcpy(out, tmp, (size_t)n * sizeof(Patient*));
+    free(tmp);
+    return n;
+}
+
+int pq_service_walk(PriorityQueue *q, int max, int (*fn)(void *ctx, const Patient *p), void *ctx) {
+    if (!q || !fn || max <= 0) return 0;
+    Patient **mem = NULL;
+    if (q->count > 0) {
+        mem = malloc((size_t)q->count * sizeof(Patient*));
+        if (!mem) return -1;
+        memcpy(mem, q->heap, (size_t)q->count * sizeof(Patient*));
+        qsort(mem, (size_t)q->count, sizeof(Patient*), cmp_service_order);
+    }
+    /* each run is already in key order: merge their heads with memory */
+    SpillMerge m;
+    uint64_t key[SPILL_CLASSES];
+    int spilled = pq_spilled(q) > 0;
+    if (spilled) {
+        if (!spill_merge_open(&m, q->spill, NULL, NULL)) { free(mem); return -1; }
+        for (int c = 0; c < SPILL_CLASSES; ++c) if (m.cur[c].valid) key[c] = compute_key(q, &m.cur[c].view);
+    }
+    int i = 0, n = 0, go = 1;
+    while (go && n < max) {
+        int best = -1;
+        uint64_t best_key = i < q->count ? mem[i]->sort_key : UINT64_MAX;
+        for (int c = 0; spilled && c < SPILL_CLASSES; ++c) {
+            if (m.cur[c].valid && key[c] < best_key) { best = c; best_key = key[c]; }
+        }
+        if (best < 0 && i >= q->count) break;
+        n++;
+        if (best < 0) {
+            go = fn(ctx, mem[i++]);
+            continue;
+        }
+        go = fn(ctx, &m.cur[best].view);
+        spill_merge_advance(&m, best);
+        if (m.cur[best].valid) key[best] = compute_key(q, &m.cur[best].view);
+    }
+    if (spilled) spill_merge_close(&m);
+    free(mem);
+    return n;
+}
+
+typedef struct PositionWalk {
+    const Patient *target;
+    int seen;
+    int found;
+} PositionWalk;
+
+static int position_visit(void *ctx, const Patient *p) {
+    PositionWalk *w = ctx;
+    w->seen++;
+    if (p->id != w->target->id || p->seq != w->target->seq) return 1;
+    w->found = 1;
+    return 0;
+}
+
+int pq_position(PriorityQueue *q, const Patient *p) {
+    if (!q || !p) return 0;
+    if (p->heap_idx < 0) {
+        /* a copy of a spilled patient (pq_view_by_id): count its way there */
+        if (pq_spilled(q) == 0) return 0;
+        PositionWalk w = { p, 0, 0 };
+        pq_service_walk(q, INT_MAX, position_visit, &w);
+        return w.found ? w.seen : 0;
+    }
+    int ahead = 0;
+    for (int i = 0; i < q->count; ++i) {
+        if (heap_less(q->heap[i], p)) ahead++;
+    }
+    /* STRICT keys rank classes outright, so every spilled patient of a
+       higher class is ahead; in AGING mode this stays a lower bound */
+    if (q->spill && q->policy.mode == PQ_MODE_STRICT) {
+        for (int c = spill_class(q, p) + 1; c < SPILL_CLASSES; ++c) ahead += (int)q->spill->run[c].count;
+    }
+    return ahead + 1;
 }
 
 /* Get queue size */
 int pq_size(PriorityQueue *q) {
     if (!q) return 0;
-    return q->count;
+    return q->count + pq_spilled(q);
 }
 
 /* Check if queue is empty */
 int pq_is_empty(PriorityQueue *q) {
     if (!q) return 1;
-    return q->count == 0;
+    return pq_size(q) == 0;
+}
+
+static int match_id(const Patient *p, const void *arg) {
+    return p->id == *(const int*)arg;
+}
+
+/* Case-insensitive substring, as the patient index matches names */
+static int name_contains(const char *name, const char *text) {
+    size_t len = strlen(name), tlen = strlen(text);
+    if (tlen == 0) return 1;
+    for (size_t i = 0; i + tlen <= len; ++i) {
+        if (tolower((unsigned char)name[i]) == tolower((unsigned char)text[0]) &&
+            strncasecmp(name + i + 1, text + 1, tlen - 1) == 0) return 1;
+    }
+    return 0;
+}
+
+static int match_name(const Patient *p, const void *arg) {
+    return p->name && name_contains(p->name, (const char*)arg);
+}
+
+/* A spilled patient match accepts, read back into memory with every patient
+   ahead of it in its class's run (they stay there until served, so memory
+   can exceed mem_cap for a while). NULL if none is spilled. */
+static Patient* spill_search(PriorityQueue *q, int id, int (*match)(const Patient*, const void*), const void *arg) {
+    uint64_t seq;
+    int cls = q->spill ? spill_find(q->spill, id, match, arg, &seq, NULL) : -1;
+    if (cls < 0) return NULL;
+    SpillRun *r = &q->spill->run[cls];
+    while (r->count > 0) {
+        int before = q->count;
+        refill_class(q, cls);
+        if (q->count == before) break;
+        /* the batch was appended to the list */
+        Patient *cur = q->tail;
+        for (int i = before; i < q->count && cur; ++i, cur = cur->prev) {
+            if (cur->seq == seq) return cur;
+        }
+    }
+    return NULL;
+}
+
+int pq_view_by_id(PriorityQueue *q, int id, void (*fn)(void *ctx, const Patient *p), void *ctx) {
+    if (!q) return 0;
+    for (Patient *cur = q->head; cur; cur = cur->next) {
+        if (cur->id != id) continue;
+        if (fn) fn(ctx, cur);
+        return 1;
+    }
+    if (id < 0 || !q->spill) return 0;
+    Patient *copy = NULL;
+    int cls = spill_find(q->spill, id, match_id, &id, NULL, fn ? &copy : NULL);
+    if (cls < 0) return 0;
+    if (copy) {
+        fn(ctx, copy);
+        free_patient(copy);
+    }
+    return 1;
 }
 
 /* Search patient by ID */
@@ -95,20 +704,20 @@ Patient* pq_search_by_id(PriorityQueue *q, int id) {
         }
         cur = cur->next;
     }
-    return NULL;
+    return id >= 0 ? spill_search(q, id, match_id, &id) : NULL;
 }
 
-/* Search patient by name (partial match) */
+/* Search patient by name (partial match, any case) */
 Patient* pq_search_by_name(PriorityQueue *q, const char *name) {
     if (!q || !name) return NULL;
     Patient* cur = q->head;
     while (cur) {
-        if (cur->name && strstr(cur->name, name)) {
+        if (match_name(cur, name)) {
             return cur;
         }
         cur = cur->next;
     }
-    return NULL;
+    return spill_search(q, -1, match_name, name);
 }
 
 void pq_free_all(PriorityQueue* q) {
@@ -116,54 +725,141 @@ void pq_free_all(PriorityQueue* q) {
     Patient* cur = q->head;
     while (cur) {
         Patient* nx = cur->next;
-        free(cur);
+        free_patient(cur);
         cur = nx;
     }
+    free(q->heap);
+    q->heap = NULL;
+    q->heap_cap = 0;
+    snap_store_free(q->snap);
+    q->snap = NULL;
+    spill_store_unref(q->spill);
+    q->spill = NULL;
     q->head = q->tail = NULL;
     q->count = 0;
 }
+static void save_row(FILE *f, const Patient *cur) {
+    fprintf(f, "%d,%lld,%s,%d,%d,%s,%s,%u\n",
+        cur->id,
+        cur->phone_number,
+        cur->name,
+        cur->age,
+        (int)cur->severity,
+        cur->arrival,
+        cur->problem,
+        cur->flags);
+}
+
+static int cmp_seq(const void *a, const void *b) {
+    const Patient *pa = *(Patient* const*)a, *pb = *(Patient* const*)b;
+    return (pa->seq > pb->seq) - (pa->seq < pb->seq);
+}
+
+/* Spilled patients merged back in by arrival, so a reload (or a standby)
+   rebuilds the same order within every severity */
+int pq_arrival_walk(PriorityQueue *q, void (*fn)(void *ctx, const Patient *p), void *ctx) {
+    if (!q || !fn) return 0;
+    if (!q->spill) {
+        for (Patient *cur = q->head; cur; cur = cur->next) fn(ctx, cur);
+        return 1;
+    }
+    Patient **mem = malloc((size_t)(q->count ? q->count : 1) * sizeof(Patient*));
+    if (!mem) return 0;
+    int n = 0;
+    for (Patient *cur = q->head; cur; cur = cur->next) mem[n++] = cur;
+    qsort(mem, (size_t)n, sizeof(Patient*), cmp_seq);
+    SpillMerge m;
+    if (!spill_merge_open(&m, q->spill, NULL, NULL)) { free(mem); return 0; }
+    int i = 0;
+    const Patient *sp;
+    while ((sp = spill_merge_peek(&m)) != NULL || i < n) {
+        if (i < n && (!sp || mem[i]->seq < sp->seq)) fn(ctx, mem[i++]);
+        else { fn(ctx, sp); spill_merge_next(&m); }
+    }
+    spill_merge_close(&m);
+    free(mem);
+    return 1;
+}
+
+typedef struct NameWalk {
+    const char *text;
+    void (*fn)(void *ctx, const Patient *p);
+    void *ctx;
+    int matches;
+} NameWalk;
+
+static void name_visit(void *ctx, const Patient *p) {
+    NameWalk *w = ctx;
+    if (!match_name(p, w->text)) return;
+    w->matches++;
+    w->fn(w->ctx, p);
+}
+
+int pq_name_walk(PriorityQueue *q, const char *text, void (*fn)(void *ctx, const Patient *p), void *ctx) {
+    if (!q || !text || !fn) return -1;
+    NameWalk w = { text, fn, ctx, 0 };
+    return pq_arrival_walk(q, name_visit, &w) ? w.matches : -1;
+}
+
+static void save_visit(void *ctx, const Patient *p) {
+    save_row(ctx, p);
+}
 
 int pq_save_csv(PriorityQueue* q, const char* filepath) {
     if (!q || !filepath) return 0;
+    uint64_t t0 = metrics_begin(MET_SAVE);
+    TRACE_BEGIN(span);
+    int ok = 0;
     FILE* f = fopen(filepath, "w");
-    if (!f) return 0;
-    fprintf(f, "id,phone,name,age,severity,arrival,problem\n");
-    Patient* cur = q->head;
-    while (cur) {
-        fprintf(f, "%d,%lld,%s,%d,%d,%s,%s\n",
-            cur->id,
-            cur->phone_number,
-            cur->name,
-            cur->age,
-            (int)cur->severity,
-            cur->arrival,
-            cur->problem);
-        cur = cur->next;
+    if (f) {
+        fprintf(f, "id,phone,name,age,severity,arrival,problem,flags\n");
+        ok = pq_arrival_walk(q, save_visit, f);
+        /* a full disk shows up as a stream error or on the final flush */
+        if (ferror(f)) ok = 0;
+        if (fclose(f) != 0) ok = 0;
     }
-    fclose(f);
-    return 1;
+    metrics_end(MET_SAVE, t0);
+    TRACE_END_ARG(span, "queue.save_csv", filepath);
+    return ok;
 }
 
 int pq_load_csv(PriorityQueue* q, const char* filepath, int* nextId) {
     if (!q || !filepath) return 0;
     FILE* f = fopen(filepath, "r");
     if (!f) return 0;
+    TRACE_BEGIN(span);
     char line[512];
-    // skip header
+    // skip header; files written before triage flags have no flags column
     if (!fgets(line, sizeof(line), f)) { fclose(f); return 0; }
+    int has_flags = strstr(line, ",flags") != NULL;
     while (fgets(line, sizeof(line), f)) {
+        unsigned flags = 0;
+        if (has_flags) {
+            /* problem may contain commas, so flags are split off the end */
+            line[strcspn(line, "\r\n")] = '\0';
+            char *comma = strrchr(line, ',');
+            if (comma) {
+                flags = (unsigned)strtoul(comma + 1, NULL, 10);
+                *comma = '\0';
+            }
+        }
         int id, age, sev;
         long long phone;
         char name[128], problem[256], arrival[64];
         /* format: id,phone,name,age,sev,problem,arrival */
         int r = sscanf(line, "%d,%lld,%127[^,],%d,%d,%63[^,],%255[^\n]",
    &id, &phone, name, &age, &sev, arrival, problem);
-        if (r >= 7) {
+        if (r == 6) problem[0] = '\0';   /* empty problem column */
+        if (r >= 6) {
             Patient* p = create_patient(id, phone, name, age, problem, (Severity)sev, arrival);
-            if (p) pq_enqueue(q, p);
-            if (nextId) *nextId = id + 1;
+            if (p) {
+                p->flags = flags;
+                pq_enqueue(q, p);
+            }
+            if (nextId && id >= *nextId) *nextId = id + 1;
         }
     }
     fclose(f);
+    TRACE_END_ARG(span, "queue.load_csv", filepath);
     return 1;
 }
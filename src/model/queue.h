@@ -3,26 +3,155 @@
 
 #include "patient.h"
 
+/* Scheduling modes:
+   PQ_MODE_STRICT  higher severity first, FIFO within a severity (default)
+   PQ_MODE_AGING   earliest SLA deadline first, where deadline = arrival +
+                   max_wait_sec[severity]. A patient's effective priority
+                   rises as they wait, so a NORMAL patient is eventually
+                   served ahead of newer SERIOUS/CRITICAL arrivals. */
+typedef enum { PQ_MODE_STRICT = 0, PQ_MODE_AGING = 1 } PqMode;
+
+/* Triage factors folded into the key on top of severity. Each one a patient
+   matches adds a vulnerability point (0..2):
+   PQ_FACTOR_AGE        younger than child_age or older than elder_age
+   PQ_FACTOR_PREGNANCY  PATIENT_PREGNANT set */
+#define PQ_FACTOR_AGE       0x1u
+#define PQ_FACTOR_PREGNANCY 0x2u
+
+#define PQ_DEFAULT_CHILD_AGE 5
+#define PQ_DEFAULT_ELDER_AGE 75
+
+typedef struct PqPolicy {
+    PqMode mode;
+    int max_wait_sec[3];      /* per-severity SLA, indexed by Severity */
+    unsigned factors;         /* PQ_FACTOR_* */
+    int child_age;
+    int elder_age;
+} PqPolicy;
+
+/* Every patient gets one packed 64-bit sort key when enqueued (or
+   re-triaged); lower is served first and keys never tie, so the heap
+   compares a single integer.
+     STRICT  [63:62] 2 - severity | [61:60] 2 - vulnerability | [59:0] arrival seq
+     AGING   [63:40] SLA deadline, SLA halved per vulnerability point, in seconds
+             after key_base | [39:0] arrival seq
+   key_base sits half the deadline field's span (about 97 days) before the
+   first deadline keyed. A later deadline past the span moves it forward and
+   re-keys the queue; deadlines left before it are long overdue and keep
+   their arrival order. */
+#define PQ_KEY_SEQ_BITS        60
+#define PQ_AGING_SEQ_BITS      40
+#define PQ_AGING_DEADLINE_BITS 24
+
+struct SnapStore;
+struct SpillStore;
+
+/* Mutation notifications, e.g. for change-data capture (cdc.h) and
+   replication (net/replica.h). Observers run inline under whatever lock
+   guards the queue, so they must not block. old_severity is only
+   meaningful for PQ_EV_RETRIAGE. PQ_EV_SPILL / PQ_EV_REFILL move a waiting
+   patient to disk and back (see spill.h): the Patient of a SPILL is freed
+   right after the call and the REFILL one is a new allocation, so observers
+   holding Patient pointers must drop and re-take them. */
+typedef enum { PQ_EV_ENQUEUE, PQ_EV_DEQUEUE, PQ_EV_RETRIAGE, PQ_EV_REMOVE,
+               PQ_EV_SPILL, PQ_EV_REFILL } PqEvent;
+typedef void (*PqObserver)(void *ctx, PqEvent ev, const Patient *p, Severity old_severity);
+#define PQ_MAX_OBSERVERS 4
+
+/* Patients are kept twice:
+   - head/tail: doubly linked list in arrival order (iteration, persistence)
+   - heap:      binary min-heap on (sort_key, seq) deciding who is served next.
+                Each patient knows its heap_idx, so removal and re-triage are O(log n).
+   With a spill store, count, list and heap only hold the in-memory part;
+   pq_size, pq_save_csv and snapshots include the spilled tail as well. */
 typedef struct PriorityQueue {
     Patient* head;
     Patient* tail;
     int count;
+    Patient** heap;
+    int heap_cap;
+    uint64_t next_seq;
+    time_t key_base;          /* AGING deadlines are keyed from here; 0 until the first */
+    PqPolicy policy;
+    struct SnapStore *snap;   /* NULL until the first pq_snapshot, see snapshot.h */
+    struct SpillStore *spill; /* NULL unless pq_spill_enable, see spill.h */
+    PqObserver observer[PQ_MAX_OBSERVERS];
+    void *observer_ctx[PQ_MAX_OBSERVERS];
+    int observers;
 } PriorityQueue;
 
 /* Queue operations */
 void pq_init(PriorityQueue *q);
 void pq_enqueue(PriorityQueue *q, Patient *p);
 Patient* pq_dequeue(PriorityQueue *q);
+/* Reads a spilled head back into memory to return it; pq_service_walk
+   with max 1 looks at it without doing so */
 Patient* pq_peek(PriorityQueue *q);
 int pq_save_csv(PriorityQueue *q, const char *filename);
 int pq_load_csv(PriorityQueue *q, const char *filename, int *nextId);
 void pq_free_all(PriorityQueue *q);
 void clear_queue_with_confirmation(PriorityQueue *q);
+/* 0 if PQ_MAX_OBSERVERS are already registered */
+int pq_add_observer(PriorityQueue *q, PqObserver fn, void *ctx);
+void pq_remove_observer(PriorityQueue *q, PqObserver fn, void *ctx);
 
 /* NEW HELPER FUNCTIONS */
 int pq_size(PriorityQueue *q);
 int pq_is_empty(PriorityQueue *q);
+/* A spilled match is read back into memory, along with the patients ahead
+   of it in its run, so the returned pointer stays valid like any other and
+   can be re-triaged or removed. Lookups that only read use pq_view_by_id,
+   pq_name_walk or pq_service_walk, which leave the queue as it is. */
 Patient* pq_search_by_id(PriorityQueue *q, int id);
+/* Pass the waiting patient with this id to fn (a copy if spilled; fn may
+   be NULL to test only); 0 if none */
+int pq_view_by_id(PriorityQueue *q, int id, void (*fn)(void *ctx, const Patient *p), void *ctx);
+/* First patient whose name contains name, in any case; a spilled match is
+   read back as pq_search_by_id does */
 Patient* pq_search_by_name(PriorityQueue *q, const char *name);
 
+/* Scheduling policy */
+void pq_policy_default(PqPolicy *policy);
+/* HOSP_SCHED=strict|aging, HOSP_SLA_MIN=crit,serious,normal,
+   HOSP_PRIORITY=severity|triage|age,pregnancy, HOSP_VULN_AGE=child,elder */
+void pq_policy_from_env(PqPolicy *policy);
+const char* pq_policy_describe(const PqPolicy *policy, char *buf, size_t buflen);
+int pq_vulnerability(const PqPolicy *policy, const Patient *p);
+void pq_set_policy(PriorityQueue *q, const PqPolicy *policy);
+time_t pq_sla_deadline(const PriorityQueue *q, const Patient *p);
+
+/* Re-triage / removal, O(log n) once the patient is known */
+int pq_update_severity(PriorityQueue *q, Patient *p, Severity sev);
+int pq_remove(PriorityQueue *q, Patient *p);
+/* As pq_remove, but p is served out of turn: observers see PQ_EV_DEQUEUE */
+int pq_dequeue_patient(PriorityQueue *q, Patient *p);
+
+/* Disk overflow: keep about mem_cap patients in memory and spill the rest
+   of each severity's tail to run files in dir. Call after pq_set_policy.
+   Returns 0 if the run files cannot be created. */
+int pq_spill_enable(PriorityQueue *q, int mem_cap, const char *dir);
+/* HOSP_QUEUE_MEM_CAP=N (unset or 0 = off), HOSP_QUEUE_SPILL_DIR (default data/spill) */
+int pq_spill_from_env(PriorityQueue *q);
+int pq_spilled(const PriorityQueue *q);
+/* Waiting patients per severity, spilled ones included */
+void pq_count_by_severity(PriorityQueue *q, int out[3]);
+/* Every waiting patient, spilled ones included, in arrival order (the
+   pq_save_csv order); spilled patients are only valid during the call */
+int pq_arrival_walk(PriorityQueue *q, void (*fn)(void *ctx, const Patient *p), void *ctx);
+/* pq_arrival_walk over the patients whose name contains text in any case,
+   the match pq_search_by_name uses. Returns how many, -1 on failure. */
+int pq_name_walk(PriorityQueue *q, const char *text, void (*fn)(void *ctx, const Patient *p), void *ctx);
+
+/* Fill out[] with up to max in-memory patients in service order; returns
+   how many. Spilled patients are not listed, and the order is only exact up
+   to the first of them, so listings use pq_service_walk instead. */
+int pq_ordered(PriorityQueue *q, Patient **out, int max);
+/* Up to max waiting patients in service order, spilled ones included and
+   left on disk (valid only during the call). fn returns 0 to stop. Returns
+   how many were visited, -1 if the runs could not be read. */
+int pq_service_walk(PriorityQueue *q, int max, int (*fn)(void *ctx, const Patient *p), void *ctx);
+/* 1-based service position of p, 0 if not queued. p may be the copy of a
+   spilled patient pq_view_by_id passes, found by walking the queue. */
+int pq_position(PriorityQueue *q, const Patient *p);
+
 #endif
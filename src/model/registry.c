@@ -0,0 +1,234 @@
+#include "registry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+void registry_init(QueueRegistry *r) {
+    if (!r) return;
+    r->n = 0;
+    pthread_rwlock_init(&r->table_lock, NULL);
+}
+
+void registry_destroy(QueueRegistry *r) {
+    if (!r) return;
+    for (int i = 0; i < r->n; ++i) {
+        pq_free_all(&r->depts[i]->q);
+        pthread_mutex_destroy(&r->depts[i]->lock);
+        free(r->depts[i]);
+    }
+    r->n = 0;
+    pthread_rwlock_destroy(&r->table_lock);
+}
+
+/* Department names end up in file names, so keep them to [a-z0-9_-] */
+static int normalize_name(const char *in, char *out, size_t outlen) {
+    size_t j = 0;
+    for (size_t i = 0; in[i] && j + 1 < outlen; ++i) {
+        unsigned char c = (unsigned char)in[i];
+        if (isspace(c)) continue;
+        c = (unsigned char)tolower(c);
+        if (!isalnum(c) && c != '_' && c != '-') return 0;
+        out[j++] = (char)c;
+    }
+    out[j] = '\0';
+    return j > 0;
+}
+
+Department* registry_find(QueueRegistry *r, const char *name) {
+    if (!r || !name) return NULL;
+    char norm[DEPT_NAME_LEN];
+    if (!normalize_name(name, norm, sizeof(norm))) return NULL;
+
+    Department *found = NULL;
+    pthread_rwlock_rdlock(&r->table_lock);
+    for (int i = 0; i < r->n; ++i) {
+        if (strcmp(r->depts[i]->name, norm) == 0) { found = r->depts[i]; break; }
+    }
+    pthread_rwlock_unlock(&r->table_lock);
+    return found;
+}
+
+static Department* dept_new(const char *name) {
+    Department *d = calloc(1, sizeof(Department));
+    if (!d) return NULL;
+    if (!normalize_name(name, d->name, sizeof(d->name))) { free(d); return NULL; }
+    pthread_mutex_init(&d->lock, NULL);
+    return d;
+}
+
+/* 0 when the registry is full; the caller still owns d then */
+static int dept_insert(QueueRegistry *r, Department *d) {
+    pthread_rwlock_wrlock(&r->table_lock);
+    int ok = r->n < REGISTRY_MAX_DEPTS;
+    if (ok) {
+        d->is_default = (r->n == 0);
+        r->depts[r->n++] = d;
+    }
+    pthread_rwlock_unlock(&r->table_lock);
+    return ok;
+}
+
+static void dept_free(Department *d) {
+    pthread_mutex_destroy(&d->lock);
+    free(d);
+}
+
+Department* registry_add(QueueRegistry *r, const char *name, const PqPolicy *policy) {
+    if (!r || !name) return NULL;
+    Department *existing = registry_find(r, name);
+    if (existing) return existing;
+
+    Department *d = dept_new(name);
+    if (!d) return NULL;
+    pq_init(&d->q);
+    if (policy) pq_set_policy(&d->q, policy);
+    pq_spill_from_env(&d->q);
+    if (dept_insert(r, d)) return d;
+    pq_free_all(&d->q);
+    dept_free(d);
+    return NULL;
+}
+
+Department* registry_adopt(QueueRegistry *r, const char *name, PriorityQueue *q) {
+    if (!r || !name || !q || q->observers || q->snap || registry_find(r, name)) return NULL;
+    Department *d = dept_new(name);
+    if (!d) return NULL;
+    /* the patients and heap point at each other, never back at the queue */
+    d->q = *q;
+    if (!dept_insert(r, d)) {
+        dept_free(d);
+        return NULL;
+    }
+    PqPolicy policy = q->policy;
+    pq_init(q);
+    pq_set_policy(q, &policy);
+    return d;
+}
+
+int registry_add_from_env(QueueRegistry *r, const PqPolicy *policy) {
+    const char *env = getenv("HOSP_DEPARTMENTS");
+    if (env && env[0]) {
+        char buf[512];
+        snprintf(buf, sizeof(buf), "%s", env);
+        for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+            registry_add(r, tok, policy);
+        }
+    }
+    if (registry_count(r) == 0) registry_add(r, REGISTRY_DEFAULT_DEPT, policy);
+    return registry_count(r);
+}
+
+Department* registry_get(QueueRegistry *r, int index) {
+    if (!r) return NULL;
+    Department *d = NULL;
+    pthread_rwlock_rdlock(&r->table_lock);
+    if (index >= 0 && index < r->n) d = r->depts[index];
+    pthread_rwlock_unlock(&r->table_lock);
+    return d;
+}
+
+int registry_count(QueueRegistry *r) {
+    if (!r) return 0;
+    pthread_rwlock_rdlock(&r->table_lock);
+    int n = r->n;
+    pthread_rwlock_unlock(&r->table_lock);
+    return n;
+}
+
+void dept_lock(Department *d) { if (d) pthread_mutex_lock(&d->lock); }
+void dept_unlock(Department *d) { if (d) pthread_mutex_unlock(&d->lock); }
+
+int registry_transfer(QueueRegistry *r, Department *from, Department *to, int patient_id) {
+    (void)r;
+    if (!from || !to) return 0;
+    if (from == to) {
+        pthread_mutex_lock(&from->lock);
+        int waiting = pq_view_by_id(&from->q, patient_id, NULL, NULL);
+        pthread_mutex_unlock(&from->lock);
+        return waiting;
+    }
+
+    /* address order gives every pair of departments one global lock order */
+    Department *first = from < to ? from : to;
+    Department *second = from < to ? to : from;
+    pthread_mutex_lock(&first->lock);
+    pthread_mutex_lock(&second->lock);
+
+    int ok = 0;
+    Patient *p = pq_search_by_id(&from->q, patient_id);
+    if (p && pq_remove(&from->q, p)) {
+        pq_enqueue(&to->q, p);
+        ok = 1;
+    }
+
+    pthread_mutex_unlock(&second->lock);
+    pthread_mutex_unlock(&first->lock);
+    return ok;
+}
+
+static void stats_add_dept(Department *d, time_t now, RegistryStats *out) {
+    pthread_mutex_lock(&d->lock);
+    int by_sev[3];
+    pq_count_by_severity(&d->q, by_sev);
+    for (int s = 0; s < 3; ++s) {
+        out->by_severity[s] += by_sev[s];
+        out->waiting += by_sev[s];
+    }
+    /* a class's oldest patients are never spilled, so memory holds the longest waits */
+    for (Patient *cur = d->q.head; cur; cur = cur->next) {
+        int s = (cur->severity >= NORMAL && cur->severity <= CRITICAL) ? (int)cur->severity : NORMAL;
+        if (cur->arrival_ts != (time_t)-1) {
+            long w = (long)(now - cur->arrival_ts);
+            if (w > out->oldest_wait_sec[s]) out->oldest_wait_sec[s] = w;
+        }
+    }
+    out->registered += d->registered;
+    out->served += d->served;
+    pthread_mutex_unlock(&d->lock);
+}
+
+void registry_stats(QueueRegistry *r, Department *dept, time_t now, RegistryStats *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    for (int s = 0; s < 3; ++s) out->oldest_wait_sec[s] = -1;
+    if (dept) { stats_add_dept(dept, now, out); return; }
+
+    /* one department lock at a time: a consistent view per department,
+       without stopping the others */
+    int n = registry_count(r);
+    for (int i = 0; i < n; ++i) stats_add_dept(registry_get(r, i), now, out);
+}
+
+void registry_queue_path(const Department *d, char *buf, size_t buflen) {
+    if (!d || d->is_default) snprintf(buf, buflen, "data/queue.csv");
+    else snprintf(buf, buflen, "data/queue_%s.csv", d->name);
+}
+
+int registry_load_all(QueueRegistry *r, int *nextId) {
+    int n = registry_count(r), ok = 1;
+    for (int i = 0; i < n; ++i) {
+        Department *d = registry_get(r, i);
+        char path[128];
+        int id = nextId ? *nextId : 0;
+        registry_queue_path(d, path, sizeof(path));
+        dept_lock(d);
+        pq_load_csv(&d->q, path, &id);
+        dept_unlock(d);
+        if (nextId && id > *nextId) *nextId = id;
+    }
+    return ok;
+}
+
+int registry_save_all(QueueRegistry *r) {
+    int n = registry_count(r), ok = 1;
+    for (int i = 0; i < n; ++i) {
+        Department *d = registry_get(r, i);
+        char path[128];
+        registry_queue_path(d, path, sizeof(path));
+        dept_lock(d);
+        if (!pq_save_csv(&d->q, path)) ok = 0;
+        dept_unlock(d);
+    }
+    return ok;
+}
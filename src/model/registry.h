@@ -0,0 +1,67 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <pthread.h>
+#include <time.h>
+#include "queue.h"
+
+#define REGISTRY_MAX_DEPTS 32
+#define DEPT_NAME_LEN 32
+#define REGISTRY_DEFAULT_DEPT "general"
+
+/* One department line (emergency, OPD, ...) with its own queue and lock.
+   Threads working on different departments never contend. */
+typedef struct Department {
+    char name[DEPT_NAME_LEN];
+    PriorityQueue q;
+    pthread_mutex_t lock;
+    long registered;
+    long served;
+    int is_default;            /* first department; owns the legacy queue file */
+} Department;
+
+typedef struct QueueRegistry {
+    Department *depts[REGISTRY_MAX_DEPTS];
+    int n;
+    pthread_rwlock_t table_lock;   /* guards depts[]/n, not the queues */
+} QueueRegistry;
+
+/* Waiting-queue aggregate for one department or all of them */
+typedef struct RegistryStats {
+    int waiting;
+    int by_severity[3];
+    long oldest_wait_sec[3];   /* -1 when no patient of that severity waits */
+    long registered;
+    long served;
+} RegistryStats;
+
+void registry_init(QueueRegistry *r);
+void registry_destroy(QueueRegistry *r);               /* frees all queued patients */
+
+/* Adds departments from HOSP_DEPARTMENTS="emergency,opd,..." (default: general) */
+int registry_add_from_env(QueueRegistry *r, const PqPolicy *policy);
+Department* registry_add(QueueRegistry *r, const char *name, const PqPolicy *policy);
+/* Adds a department that takes over q's patients, policy and spill store,
+   leaving q empty. q must have no observers or snapshots yet. */
+Department* registry_adopt(QueueRegistry *r, const char *name, PriorityQueue *q);
+Department* registry_find(QueueRegistry *r, const char *name);
+Department* registry_get(QueueRegistry *r, int index);
+int registry_count(QueueRegistry *r);
+
+void dept_lock(Department *d);
+void dept_unlock(Department *d);
+
+/* Move a waiting patient between departments atomically (both locks held,
+   taken in a fixed order). The Patient object is relinked, not copied.
+   Returns 1 on success, 0 if the patient is not waiting in from. */
+int registry_transfer(QueueRegistry *r, Department *from, Department *to, int patient_id);
+
+/* dept == NULL aggregates across every department */
+void registry_stats(QueueRegistry *r, Department *dept, time_t now, RegistryStats *out);
+
+/* data/queue.csv for the default (first) department, data/queue_<name>.csv otherwise */
+void registry_queue_path(const Department *d, char *buf, size_t buflen);
+int registry_load_all(QueueRegistry *r, int *nextId);
+int registry_save_all(QueueRegistry *r);
+
+#endif
@@ -0,0 +1,259 @@
+#include "snapshot.h"
+#include "../util/metrics.h"
+#include "../util/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static SnapPage* page_new(void) {
+    SnapPage *pg = malloc(sizeof(SnapPage));
+    if (!pg) return NULL;
+    atomic_init(&pg->refs, 1);
+    memset(pg->rec, 0, sizeof(pg->rec));
+    return pg;
+}
+
+static void page_unref(SnapPage *pg) {
+    if (pg && atomic_fetch_sub_explicit(&pg->refs, 1, memory_order_acq_rel) == 1) free(pg);
+}
+
+/* Writable record for slot: copies the page first if a snapshot shares it */
+static PatientRecord* slot_for_write(SnapStore *st, int slot) {
+    int pi = slot / SNAP_PAGE_SLOTS;
+    SnapPage *pg = st->pages[pi];
+    if (atomic_load_explicit(&pg->refs, memory_order_acquire) > 1) {
+        SnapPage *copy = malloc(sizeof(SnapPage));
+        if (!copy) return NULL;
+        memcpy(copy->rec, pg->rec, sizeof(pg->rec));
+        atomic_init(&copy->refs, 1);
+        st->pages[pi] = copy;
+        page_unref(pg);
+    }
+    return &st->pages[pi]->rec[slot % SNAP_PAGE_SLOTS];
+}
+
+static void fill_record(PatientRecord *r, const Patient *p) {
+    r->id = p->id;
+    r->phone_number = p->phone_number;
+    r->age = p->age;
+    r->severity = p->severity;
+    r->flags = p->flags;
+    r->arrival_ts = p->arrival_ts;
+    r->sort_key = p->sort_key;
+    r->seq = p->seq;
+    snprintf(r->arrival, sizeof(r->arrival), "%s", p->arrival);
+    snprintf(r->name, sizeof(r->name), "%s", p->name ? p->name : "");
+    snprintf(r->problem, sizeof(r->problem), "%s", p->problem ? p->problem : "");
+    r->live = 1;
+}
+
+void snap_store_put(SnapStore *st, Patient *p) {
+    if (!st || !p) return;
+    int slot = st->used;
+    if (slot % SNAP_PAGE_SLOTS == 0) {
+        if (st->npages == st->page_cap) {
+            int ncap = st->page_cap ? st->page_cap * 2 : 16;
+            SnapPage **np = realloc(st->pages, (size_t)ncap * sizeof(SnapPage*));
+            if (!np) return;
+            st->pages = np;
+            st->page_cap = ncap;
+        }
+        SnapPage *pg = page_new();
+        if (!pg) return;
+        st->pages[st->npages++] = pg;
+    }
+    PatientRecord *r = slot_for_write(st, slot);
+    if (!r) return;
+    fill_record(r, p);
+    if (r->severity >= NORMAL && r->severity <= CRITICAL) st->by_severity[r->severity]++;
+    p->snap_slot = slot;
+    st->used++;
+    st->version++;
+}
+
+void snap_store_update(SnapStore *st, Patient *p) {
+    if (!st || !p || p->snap_slot < 0 || p->snap_slot >= st->used) return;
+    PatientRecord *r = slot_for_write(st, p->snap_slot);
+    if (!r) return;
+    if (r->severity >= NORMAL && r->severity <= CRITICAL) st->by_severity[r->severity]--;
+    if (p->severity >= NORMAL && p->severity <= CRITICAL) st->by_severity[p->severity]++;
+    r->severity = p->severity;
+    r->flags = p->flags;
+    r->sort_key = p->sort_key;
+    st->version++;
+}
+
+void snap_store_drop(SnapStore *st, Patient *p) {
+    if (!st || !p || p->snap_slot < 0 || p->snap_slot >= st->used) return;
+    PatientRecord *r = slot_for_write(st, p->snap_slot);
+    if (r) {
+        r->live = 0;
+        if (r->severity >= NORMAL && r->severity <= CRITICAL) st->by_severity[r->severity]--;
+    }
+    p->snap_slot = -1;
+    st->dead++;
+    st->version++;
+}
+
+void snap_store_free(SnapStore *st) {
+    if (!st) return;
+    for (int i = 0; i < st->npages; ++i) page_unref(st->pages[i]);
+    free(st->pages);
+    free(st);
+}
+
+/* ---------- snapshots ---------- */
+
+QueueSnapshot* pq_snapshot(PriorityQueue *q) {
+    if (!q) return NULL;
+    if (!q->snap) {
+        /* first snapshot of this queue: start mirroring it */
+        q->snap = calloc(1, sizeof(SnapStore));
+        if (!q->snap) return NULL;
+        for (Patient *p = q->head; p; p = p->next) snap_store_put(q->snap, p);
+    }
+    SnapStore *st = q->snap;
+
+    QueueSnapshot *s = calloc(1, sizeof(QueueSnapshot));
+    if (!s) return NULL;
+    s->pages = malloc((size_t)(st->npages ? st->npages : 1) * sizeof(SnapPage*));
+    if (!s->pages) { free(s); return NULL; }
+    for (int i = 0; i < st->npages; ++i) {
+        s->pages[i] = st->pages[i];
+        atomic_fetch_add_explicit(&st->pages[i]->refs, 1, memory_order_relaxed);
+    }
+    s->npages = st->npages;
+    s->slots = st->used;
+    s->count = q->count;
+    s->version = st->version;
+    s->mode = q->policy.mode;
+    s->taken_at = time(NULL);
+    for (int i = 0; i < 3; ++i) s->by_severity[i] = st->by_severity[i];
+    if (q->spill) {
+        /* the runs only ever grow at the tail while pinned, and every record
+           is written through, so [head, tail) stays readable from any thread */
+        spill_store_ref(q->spill);
+        s->spill = q->spill;
+        for (int c = 0; c < SPILL_CLASSES; ++c) {
+            s->spill_from[c] = q->spill->run[c].head;
+            s->spill_to[c] = q->spill->run[c].tail;
+        }
+        s->spilled = (int)q->spill->spilled;
+        s->count += s->spilled;
+        for (int i = 0; i < 3; ++i) s->by_severity[i] += (int)q->spill->spilled_by_severity[i];
+    }
+    return s;
+}
+
+void qsnap_release(QueueSnapshot *s) {
+    if (!s) return;
+    for (int i = 0; i < s->npages; ++i) page_unref(s->pages[i]);
+    free(s->pages);
+    spill_store_unref(s->spill);
+    free(s);
+}
+
+int qsnap_size(const QueueSnapshot *s) {
+    return s ? s->count : 0;
+}
+
+const PatientRecord* qsnap_next(const QueueSnapshot *s, int *cursor) {
+    if (!s || !cursor) return NULL;
+    while (*cursor < s->slots) {
+        int slot = (*cursor)++;
+        const PatientRecord *r = &s->pages[slot / SNAP_PAGE_SLOTS]->rec[slot % SNAP_PAGE_SLOTS];
+        if (r->live) return r;
+    }
+    return NULL;
+}
+
+static int cmp_record_key(const void *a, const void *b) {
+    const PatientRecord *ra = *(const PatientRecord* const*)a, *rb = *(const PatientRecord* const*)b;
+    return (ra->sort_key > rb->sort_key) - (ra->sort_key < rb->sort_key);
+}
+
+int qsnap_ordered(const QueueSnapshot *s, const PatientRecord **out, int max) {
+    int in_memory = s ? s->count - s->spilled : 0;
+    if (!s || !out || max <= 0 || in_memory == 0) return 0;
+    const PatientRecord **tmp = malloc((size_t)in_memory * sizeof(PatientRecord*));
+    if (!tmp) return 0;
+    int n = 0, cursor = 0;
+    const PatientRecord *r;
+    while (n < in_memory && (r = qsnap_next(s, &cursor)) != NULL) tmp[n++] = r;
+    qsort(tmp, (size_t)n, sizeof(PatientRecord*), cmp_record_key);
+    if (n > max) n = max;
+    memcpy(out, tmp, (size_t)n * sizeof(PatientRecord*));
+    free(tmp);
+    return n;
+}
+
+static void save_record(FILE *f, const PatientRecord *r) {
+    fprintf(f, "%d,%lld,%s,%d,%d,%s,%s,%u\n",
+            r->id, r->phone_number, r->name, r->age, (int)r->severity, r->arrival, r->problem, r->flags);
+}
+
+static void save_spilled(FILE *f, const Patient *p) {
+    fprintf(f, "%d,%lld,%s,%d,%d,%s,%s,%u\n",
+            p->id, p->phone_number, p->name, p->age, (int)p->severity, p->arrival, p->problem, p->flags);
+}
+
+static int cmp_record_seq(const void *a, const void *b) {
+    const PatientRecord *ra = *(const PatientRecord* const*)a, *rb = *(const PatientRecord* const*)b;
+    return (ra->seq > rb->seq) - (ra->seq < rb->seq);
+}
+
+/* In-memory records sorted by arrival and merged with the pinned runs */
+static int save_with_spill(const QueueSnapshot *s, FILE *f) {
+    int in_memory = s->count - s->spilled;
+    const PatientRecord **mem = malloc((size_t)(in_memory > 0 ? in_memory : 1) * sizeof(PatientRecord*));
+    if (!mem) return 0;
+    int n = 0, cursor = 0;
+    const PatientRecord *r;
+    while (n < in_memory && (r = qsnap_next(s, &cursor)) != NULL) mem[n++] = r;
+    qsort(mem, (size_t)n, sizeof(PatientRecord*), cmp_record_seq);
+    SpillMerge m;
+    if (!spill_merge_open(&m, s->spill, s->spill_from, s->spill_to)) { free(mem); return 0; }
+    int i = 0;
+    const Patient *sp;
+    while ((sp = spill_merge_peek(&m)) != NULL || i < n) {
+        if (i < n && (!sp || mem[i]->seq < sp->seq)) save_record(f, mem[i++]);
+        else { save_spilled(f, sp); spill_merge_next(&m); }
+    }
+    spill_merge_close(&m);
+    free(mem);
+    return 1;
+}
+
+int qsnap_save_csv(const QueueSnapshot *s, const char *filepath) {
+    if (!s || !filepath) return 0;
+    /* write aside and rename, so a reader never sees a half-written file */
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", filepath);
+    uint64_t t0 = metrics_begin(MET_SAVE);
+    TRACE_BEGIN(span);
+    int ok = 0;
+    FILE *f = fopen(tmp, "w");
+    if (f) {
+        fprintf(f, "id,phone,name,age,severity,arrival,problem,flags\n");
+        ok = 1;
+        if (s->spill) {
+            ok = save_with_spill(s, f);
+        } else {
+            int cursor = 0;
+            const PatientRecord *r;
+            while ((r = qsnap_next(s, &cursor)) != NULL) save_record(f, r);
+        }
+        if (ferror(f)) ok = 0;
+        if (fclose(f) != 0) ok = 0;
+        if (!ok) remove(tmp);
+    }
+    if (ok) {
+#if defined(_WIN32)
+        remove(filepath);   /* rename does not replace on Windows */
+#endif
+        ok = rename(tmp, filepath) == 0;
+    }
+    metrics_end(MET_SAVE, t0);
+    TRACE_END_ARG(span, "snapshot.save_csv", filepath);
+    return ok;
+}
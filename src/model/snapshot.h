@@ -0,0 +1,91 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "patient.h"
+#include "queue.h"
+#include "spill.h"
+
+/* Copy-on-write queue snapshots.
+
+   Once the first snapshot of a queue is requested, the queue mirrors every
+   waiting patient into a PatientRecord kept in arrival order on fixed-size
+   pages. A snapshot is just a reference to the current pages, so taking one
+   costs O(n / SNAP_PAGE_SLOTS) and needs the queue lock only for that long.
+   Pages shared with a live snapshot are never written: the queue copies a
+   page the first time it changes one (structural sharing), so readers on
+   other threads iterate a consistent view while desks keep mutating.
+   Patients spilled to disk (spill.h) are not mirrored; the snapshot pins
+   the run files and remembers each run's extent instead, so counts and
+   qsnap_save_csv cover them while iteration sees the in-memory part. */
+
+#define SNAP_PAGE_SLOTS 32
+
+typedef struct PatientRecord {
+    int id;
+    long long phone_number;
+    int age;
+    Severity severity;
+    unsigned flags;
+    time_t arrival_ts;
+    uint64_t sort_key;        /* as in the queue when the snapshot was taken */
+    uint64_t seq;
+    char arrival[TIME_LEN];
+    char name[NAME_LEN];
+    char problem[PROB_LEN];
+    int live;                 /* 0 once the patient left the queue */
+} PatientRecord;
+
+typedef struct SnapPage {
+    atomic_int refs;
+    PatientRecord rec[SNAP_PAGE_SLOTS];
+} SnapPage;
+
+/* Owned by the PriorityQueue; only touched with the queue lock held */
+typedef struct SnapStore {
+    SnapPage **pages;
+    int npages;
+    int page_cap;
+    int used;                 /* slots handed out, live or dead */
+    int dead;
+    int by_severity[3];       /* live records */
+    uint64_t version;         /* bumped on every mutation */
+} SnapStore;
+
+typedef struct QueueSnapshot {
+    SnapPage **pages;
+    int npages;
+    int slots;
+    int count;                /* live patients */
+    int spilled;              /* of which on disk */
+    int by_severity[3];
+    uint64_t version;
+    PqMode mode;
+    time_t taken_at;
+    SpillStore *spill;        /* referenced, NULL if the queue does not spill */
+    uint64_t spill_from[SPILL_CLASSES];
+    uint64_t spill_to[SPILL_CLASSES];
+} QueueSnapshot;
+
+/* Take a snapshot; hold the queue's lock across this call if it is shared.
+   Release with qsnap_release from any thread. NULL on allocation failure. */
+QueueSnapshot* pq_snapshot(PriorityQueue *q);
+void qsnap_release(QueueSnapshot *s);
+
+/* Waiting patients, spilled ones included */
+int qsnap_size(const QueueSnapshot *s);
+/* Arrival-order iteration: start with *cursor = 0; NULL at the end */
+const PatientRecord* qsnap_next(const QueueSnapshot *s, int *cursor);
+/* Fill out[] with up to max records in service order; returns how many */
+int qsnap_ordered(const QueueSnapshot *s, const PatientRecord **out, int max);
+/* Same format as pq_save_csv, written from the snapshot without the queue lock */
+int qsnap_save_csv(const QueueSnapshot *s, const char *filepath);
+
+/* Queue-side hooks, called by queue.c when q->snap is set */
+void snap_store_put(SnapStore *st, Patient *p);
+void snap_store_update(SnapStore *st, Patient *p);
+void snap_store_drop(SnapStore *st, Patient *p);
+void snap_store_free(SnapStore *st);
+
+#endif /* SNAPSHOT_H */
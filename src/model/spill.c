@@ -0,0 +1,359 @@
+#include "spill.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+
+SpillStore* spill_store_new(const char *dir, int mem_cap) {
+    (void)dir; (void)mem_cap;
+    return NULL;
+}
+void spill_store_ref(SpillStore *st) { (void)st; }
+void spill_store_unref(SpillStore *st) { (void)st; }
+int spill_append(SpillStore *st, int cls, const Patient *p) { (void)st; (void)cls; (void)p; return 0; }
+int spill_read_batch(SpillStore *st, int cls, Patient **out, int max) {
+    (void)st; (void)cls; (void)out; (void)max;
+    return 0;
+}
+Patient* spill_peek(SpillStore *st, int cls) { (void)st; (void)cls; return NULL; }
+int spill_find(SpillStore *st, int id, int (*match)(const Patient *p, const void *arg), const void *arg,
+               uint64_t *seq, Patient **copy) {
+    (void)st; (void)id; (void)match; (void)arg; (void)seq;
+    if (copy) *copy = NULL;
+    return -1;
+}
+int spill_merge_open(SpillMerge *m, SpillStore *st, const uint64_t *from, const uint64_t *to) {
+    (void)st; (void)from; (void)to;
+    if (m) memset(m, 0, sizeof(*m));
+    return m != NULL;
+}
+const Patient* spill_merge_peek(SpillMerge *m) { (void)m; return NULL; }
+void spill_merge_next(SpillMerge *m) { (void)m; }
+void spill_merge_advance(SpillMerge *m, int cls) { (void)m; (void)cls; }
+void spill_merge_close(SpillMerge *m) { (void)m; }
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define SPILL_READ_BUF (64 * 1024)
+
+/* On-disk record: header, then name, problem and arrival, unterminated */
+typedef struct SpillHeader {
+    uint32_t len;             /* whole record */
+    int32_t id;
+    int32_t age;
+    int32_t severity;
+    uint32_t flags;
+    uint16_t name_len;
+    uint16_t problem_len;
+    int64_t phone;
+    int64_t arrival_ts;
+    uint64_t seq;
+    uint16_t arrival_len;
+    uint16_t pad[3];
+} SpillHeader;
+
+static int run_open(SpillRun *r, const char *dir) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/run-XXXXXX", dir);
+    r->wfd = mkstemp(path);
+    if (r->wfd < 0) return 0;
+    r->rfd = open(path, O_RDONLY);
+    unlink(path);             /* lives exactly as long as the descriptors */
+    if (r->rfd < 0 || fcntl(r->wfd, F_SETFL, O_APPEND) < 0) {
+        close(r->wfd);
+        if (r->rfd >= 0) close(r->rfd);
+        return 0;
+    }
+    return 1;
+}
+
+SpillStore* spill_store_new(const char *dir, int mem_cap) {
+    if (!dir || mem_cap <= 0) return NULL;
+    mkdir(dir, 0700);
+    SpillStore *st = calloc(1, sizeof(SpillStore));
+    if (!st) return NULL;
+    atomic_init(&st->refs, 1);
+    st->mem_cap = mem_cap;
+    for (int c = 0; c < SPILL_CLASSES; ++c) {
+        if (run_open(&st->run[c], dir)) continue;
+        fprintf(stderr, "Cannot create spill run in %s: %s\n", dir, strerror(errno));
+        for (int k = 0; k < c; ++k) { close(st->run[k].wfd); close(st->run[k].rfd); }
+        free(st);
+        return NULL;
+    }
+    return st;
+}
+
+void spill_store_ref(SpillStore *st) {
+    if (st) atomic_fetch_add_explicit(&st->refs, 1, memory_order_relaxed);
+}
+
+void spill_store_unref(SpillStore *st) {
+    if (!st || atomic_fetch_sub_explicit(&st->refs, 1, memory_order_acq_rel) != 1) return;
+    for (int c = 0; c < SPILL_CLASSES; ++c) {
+        close(st->run[c].wfd);
+        close(st->run[c].rfd);
+    }
+    free(st);
+}
+
+static uint16_t field_len(const char *s, size_t max) {
+    return s ? (uint16_t)strnlen(s, max - 1) : 0;
+}
+
+int spill_append(SpillStore *st, int cls, const Patient *p) {
+    if (!st || !p || cls < 0 || cls >= SPILL_CLASSES) return 0;
+    SpillRun *r = &st->run[cls];
+    if (r->failed) return 0;
+    SpillHeader h;
+    memset(&h, 0, sizeof(h));
+    h.id = p->id;
+    h.age = p->age;
+    h.severity = (int32_t)p->severity;
+    h.flags = p->flags;
+    h.name_len = field_len(p->name, NAME_LEN);
+    h.problem_len = field_len(p->problem, PROB_LEN);
+    h.arrival_len = field_len(p->arrival, TIME_LEN);
+    h.phone = p->phone_number;
+    h.arrival_ts = (int64_t)p->arrival_ts;
+    h.seq = p->seq;
+    h.len = (uint32_t)(sizeof(h) + h.name_len + h.problem_len + h.arrival_len);
+
+    char rec[sizeof(SpillHeader) + NAME_LEN + PROB_LEN + TIME_LEN];
+    char *s = rec;
+    memcpy(s, &h, sizeof(h));
+    s += sizeof(h);
+    memcpy(s, p->name, h.name_len);
+    s += h.name_len;
+    memcpy(s, p->problem, h.problem_len);
+    s += h.problem_len;
+    memcpy(s, p->arrival, h.arrival_len);
+
+    /* written through, so a full disk shows up here while the caller still
+       holds the patient, not at some later flush after it was freed */
+    ssize_t w;
+    do w = write(r->wfd, rec, h.len); while (w < 0 && errno == EINTR);
+    if (w != (ssize_t)h.len) {
+        fprintf(stderr, "Spill run write failed (%s): class %d stays in memory\n",
+                w < 0 ? strerror(errno) : "short write", cls);
+        /* cut off any partial record, so the run still ends at tail */
+        if (ftruncate(r->wfd, (off_t)r->tail) != 0) { /* appends are closed anyway */ }
+        r->failed = 1;
+        return 0;
+    }
+    if (r->count == 0) {
+        r->head_key_valid = 0;
+        r->min_id = r->max_id = p->id;
+    }
+    if (p->id < r->min_id) r->min_id = p->id;
+    if (p->id > r->max_id) r->max_id = p->id;
+    r->tail += h.len;
+    r->count++;
+    st->spilled++;
+    if (p->severity >= NORMAL && p->severity <= CRITICAL) st->spilled_by_severity[p->severity]++;
+    return 1;
+}
+
+/* Decode one record at buf; fills p's fields in place (strings point into
+   buf, so p is only a view). Returns the record length, 0 if incomplete. */
+static uint32_t decode(const char *buf, size_t avail, Patient *p, char *name, char *problem) {
+    SpillHeader h;
+    if (avail < sizeof(h)) return 0;
+    memcpy(&h, buf, sizeof(h));
+    if (h.len > avail || h.len < sizeof(h)) return 0;
+    if (h.name_len >= NAME_LEN || h.problem_len >= PROB_LEN || h.arrival_len >= TIME_LEN) return 0;
+    const char *s = buf + sizeof(h);
+    memcpy(name, s, h.name_len);
+    name[h.name_len] = '\0';
+    s += h.name_len;
+    memcpy(problem, s, h.problem_len);
+    problem[h.problem_len] = '\0';
+    s += h.problem_len;
+    memset(p, 0, sizeof(*p));
+    memcpy(p->arrival, s, h.arrival_len);
+    p->arrival[h.arrival_len] = '\0';
+    p->id = h.id;
+    p->phone_number = h.phone;
+    p->name = name;
+    p->age = h.age;
+    p->severity = (Severity)h.severity;
+    p->problem = problem;
+    p->flags = h.flags;
+    p->arrival_ts = (time_t)h.arrival_ts;
+    p->seq = h.seq;
+    p->heap_idx = -1;
+    p->snap_slot = -1;
+    return h.len;
+}
+
+static Patient* materialize(const Patient *view) {
+    /* no arrival string here: it is copied as is, skipping the mktime per refill */
+    Patient *p = create_patient(view->id, view->phone_number, view->name, view->age,
+                                view->problem, view->severity, NULL);
+    if (!p) return NULL;
+    memcpy(p->arrival, view->arrival, TIME_LEN);
+    p->flags = view->flags;
+    p->arrival_ts = view->arrival_ts;
+    p->seq = view->seq;
+    return p;
+}
+
+/* ---------- merged reading ---------- */
+
+static void cursor_advance(SpillCursor *c) {
+    c->valid = 0;
+    for (;;) {
+        uint32_t len = decode(c->buf + c->off, c->len - c->off, &c->view, c->name, c->problem);
+        if (len > 0) {
+            c->off += len;
+            c->valid = 1;
+            return;
+        }
+        /* refill the buffer from the first undecoded byte */
+        c->pos += c->off;
+        c->off = c->len = 0;
+        if (c->pos >= c->end) return;
+        size_t want = c->end - c->pos < SPILL_READ_BUF ? (size_t)(c->end - c->pos) : SPILL_READ_BUF;
+        ssize_t got = pread(c->fd, c->buf, want, (off_t)c->pos);
+        if (got <= 0) return;
+        c->len = (size_t)got;
+        if (decode(c->buf, c->len, &c->view, c->name, c->problem) == 0) return;  /* corrupt */
+    }
+}
+
+int spill_merge_open(SpillMerge *m, SpillStore *st, const uint64_t *from, const uint64_t *to) {
+    if (!m) return 0;
+    memset(m, 0, sizeof(*m));
+    if (!st) return 1;
+    for (int c = 0; c < SPILL_CLASSES; ++c) {
+        SpillCursor *cur = &m->cur[c];
+        cur->fd = st->run[c].rfd;
+        cur->pos = from ? from[c] : st->run[c].head;
+        cur->end = to ? to[c] : st->run[c].tail;
+        if (cur->pos >= cur->end) continue;
+        cur->buf = malloc(SPILL_READ_BUF);
+        if (!cur->buf) { spill_merge_close(m); return 0; }
+        cursor_advance(cur);
+    }
+    return 1;
+}
+
+const Patient* spill_merge_peek(SpillMerge *m) {
+    const Patient *best = NULL;
+    for (int c = 0; c < SPILL_CLASSES; ++c) {
+        if (m->cur[c].valid && (!best || m->cur[c].view.seq < best->seq)) best = &m->cur[c].view;
+    }
+    return best;
+}
+
+void spill_merge_next(SpillMerge *m) {
+    const Patient *best = spill_merge_peek(m);
+    for (int c = 0; c < SPILL_CLASSES; ++c) {
+        if (&m->cur[c].view == best) { cursor_advance(&m->cur[c]); return; }
+    }
+}
+
+void spill_merge_advance(SpillMerge *m, int cls) {
+    if (m && cls >= 0 && cls < SPILL_CLASSES && m->cur[cls].valid) cursor_advance(&m->cur[cls]);
+}
+
+void spill_merge_close(SpillMerge *m) {
+    if (!m) return;
+    for (int c = 0; c < SPILL_CLASSES; ++c) {
+        free(m->cur[c].buf);
+        m->cur[c].buf = NULL;
+        m->cur[c].valid = 0;
+    }
+}
+
+int spill_read_batch(SpillStore *st, int cls, Patient **out, int max) {
+    if (!st || !out || max <= 0 || cls < 0 || cls >= SPILL_CLASSES) return 0;
+    SpillRun *r = &st->run[cls];
+    if (r->count == 0) return 0;
+    char *buf = malloc(SPILL_READ_BUF);
+    if (!buf) return 0;
+    char name[NAME_LEN], problem[PROB_LEN];
+    Patient view;
+    int n = 0;
+    while (n < max && r->head < r->tail) {
+        size_t want = r->tail - r->head < SPILL_READ_BUF ? (size_t)(r->tail - r->head) : SPILL_READ_BUF;
+        ssize_t got = pread(r->rfd, buf, want, (off_t)r->head);
+        if (got <= 0) break;
+        size_t off = 0;
+        uint32_t len;
+        while (n < max && (len = decode(buf + off, (size_t)got - off, &view, name, problem)) > 0) {
+            Patient *p = materialize(&view);
+            if (!p) break;
+            out[n++] = p;
+            off += len;
+            r->count--;
+            st->spilled--;
+            if (p->severity >= NORMAL && p->severity <= CRITICAL) st->spilled_by_severity[p->severity]--;
+        }
+        if (off == 0) break;
+        r->head += off;
+    }
+    free(buf);
+    r->head_key_valid = 0;
+    if (r->count == 0 && atomic_load_explicit(&st->refs, memory_order_acquire) == 1) {
+        /* drained and no snapshot reads it: reclaim the disk space */
+        if (ftruncate(r->wfd, 0) == 0) r->head = r->tail = 0;
+    }
+    return n;
+}
+
+Patient* spill_peek(SpillStore *st, int cls) {
+    if (!st || cls < 0 || cls >= SPILL_CLASSES) return NULL;
+    SpillRun *r = &st->run[cls];
+    if (r->count == 0) return NULL;
+    char buf[sizeof(SpillHeader) + NAME_LEN + PROB_LEN + TIME_LEN];
+    size_t want = r->tail - r->head < sizeof(buf) ? (size_t)(r->tail - r->head) : sizeof(buf);
+    ssize_t got = pread(r->rfd, buf, want, (off_t)r->head);
+    if (got <= 0) return NULL;
+    char name[NAME_LEN], problem[PROB_LEN];
+    Patient view;
+    if (decode(buf, (size_t)got, &view, name, problem) == 0) return NULL;
+    return materialize(&view);
+}
+
+int spill_find(SpillStore *st, int id, int (*match)(const Patient *p, const void *arg), const void *arg,
+               uint64_t *seq, Patient **copy) {
+    if (copy) *copy = NULL;
+    if (!st || !match) return -1;
+    int found = -1;
+    uint64_t best = UINT64_MAX;
+    SpillCursor cur;
+    memset(&cur, 0, sizeof(cur));
+    for (int c = 0; c < SPILL_CLASSES; ++c) {
+        SpillRun *r = &st->run[c];
+        if (r->count == 0 || (id >= 0 && (id < r->min_id || id > r->max_id))) continue;
+        if (!cur.buf && !(cur.buf = malloc(SPILL_READ_BUF))) break;
+        cur.fd = r->rfd;
+        cur.pos = r->head;
+        cur.end = r->tail;
+        cur.len = cur.off = 0;
+        /* a run is in arrival order: its first match is its oldest */
+        for (cursor_advance(&cur); cur.valid; cursor_advance(&cur)) {
+            if (!match(&cur.view, arg)) continue;
+            if (cur.view.seq < best) {
+                best = cur.view.seq;
+                found = c;
+                if (copy) {
+                    free_patient(*copy);
+                    *copy = materialize(&cur.view);
+                }
+            }
+            break;
+        }
+    }
+    free(cur.buf);
+    if (found >= 0 && seq) *seq = best;
+    return found;
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "patient.h"
+
+/* Disk-backed overflow for very long queues (mass-casualty surges,
+   vaccination drives).
+
+   Patients are grouped into classes (severity x vulnerability). Within a
+   class the sort key only grows with arrival, so the class's tail is
+   already sorted and can live in an append-only run file. The queue keeps
+   the head of every class in memory and moves its newest arrivals to the
+   class run once it holds more than mem_cap patients; when a class's last
+   in-memory patient leaves, the next batch is read back. Enqueue is one
+   write(2) per spilled patient, checked before the patient is freed;
+   dequeue is an amortized batch read, and memory stays near mem_cap
+   however long the backlog grows. A class whose run cannot be written
+   (disk full, I/O error) keeps its new arrivals in memory from then on.
+
+   The run files are unlinked as soon as they are open, so they never
+   outlive the process; persistence still goes through queue.csv, which
+   includes spilled patients. Queue-side logic lives in queue.c; this file
+   only stores and reads records. */
+
+#define SPILL_CLASSES 9                /* 3 severities x 3 vulnerability levels */
+#define SPILL_REFILL_BATCH 1024
+
+typedef struct SpillRun {
+    int wfd;                  /* O_APPEND writer, one write per record */
+    int rfd;                  /* reader; pread-only, so snapshot threads may share it */
+    uint64_t head;            /* byte offset of the oldest spilled record */
+    uint64_t tail;            /* bytes written */
+    long count;
+    int failed;               /* a write failed: nothing more is appended */
+    uint64_t head_key;        /* sort key of the record at head, see queue.c */
+    int head_key_valid;
+    uint64_t tail_key;        /* sort key of the last record appended */
+    int32_t min_id, max_id;   /* ids appended since the run was last empty */
+} SpillRun;
+
+typedef struct SpillStore {
+    atomic_int refs;          /* the queue, plus every snapshot covering it */
+    SpillRun run[SPILL_CLASSES];
+    int mem_cap;
+    int mem_by_class[SPILL_CLASSES];   /* queued in memory */
+    long spilled;
+    long spilled_by_severity[3];
+    Patient *pending;         /* newest arrival, spilled (or not) on the next enqueue/dequeue */
+} SpillStore;
+
+/* Sequential reader over one run's [pos, end) */
+typedef struct SpillCursor {
+    int fd;
+    uint64_t pos;             /* file offset of buf[0] */
+    uint64_t end;
+    char *buf;
+    size_t len;
+    size_t off;
+    Patient view;             /* current record; strings point into name/problem */
+    char name[NAME_LEN];
+    char problem[PROB_LEN];
+    int valid;
+} SpillCursor;
+
+/* All runs merged back into arrival (seq) order, e.g. to write queue.csv */
+typedef struct SpillMerge {
+    SpillCursor cur[SPILL_CLASSES];
+} SpillMerge;
+
+/* NULL when the run files cannot be created (or on Windows) */
+SpillStore* spill_store_new(const char *dir, int mem_cap);
+void spill_store_ref(SpillStore *st);
+void spill_store_unref(SpillStore *st);
+
+/* 0 if the record could not be written (the run is then closed to appends) */
+int spill_append(SpillStore *st, int cls, const Patient *p);
+/* Reads up to max patients from the head of cls into out (seq restored);
+   returns how many */
+int spill_read_batch(SpillStore *st, int cls, Patient **out, int max);
+/* The patient at the head of cls without consuming it; caller frees */
+Patient* spill_peek(SpillStore *st, int cls);
+/* The first arrival among spilled patients match accepts: returns its class
+   and sets *seq, or -1 if none. With id >= 0 only the runs whose id range
+   holds id are read, so a miss is usually free. With copy, *copy is set to
+   a copy of the match (caller frees), leaving the run as it was. */
+int spill_find(SpillStore *st, int id, int (*match)(const Patient *p, const void *arg), const void *arg,
+               uint64_t *seq, Patient **copy);
+
+/* Merge the runs' [from[c], to[c]) ranges (offsets as in SpillRun; NULL for
+   the current extents). Safe from another thread while the owner appends,
+   as long as it holds a ref. */
+int spill_merge_open(SpillMerge *m, SpillStore *st, const uint64_t *from, const uint64_t *to);
+/* Oldest remaining spilled patient, NULL at the end; valid until spill_merge_next */
+const Patient* spill_merge_peek(SpillMerge *m);
+void spill_merge_next(SpillMerge *m);
+/* Step class cls's cursor only, for merges in another order than arrival:
+   each class is read through cur[cls].view while cur[cls].valid */
+void spill_merge_advance(SpillMerge *m, int cls);
+void spill_merge_close(SpillMerge *m);
+
+#endif /* SPILL_H */
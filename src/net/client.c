@@ -0,0 +1,195 @@
+#include "client.h"
+#include <stdio.h>
+
+#if defined(_WIN32)
+
+int client_run(const char *connect_spec) {
+    (void)connect_spec;
+    fprintf(stderr, "Client mode is not available on Windows\n");
+    return 1;
+}
+
+#else
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "net.h"
+#include "protocol.h"
+#include "../view/view.h"
+#include "../util/strbuf.h"
+
+typedef struct Session {
+    FILE *rx;
+    FILE *tx;
+} Session;
+
+/* Send one request and read the single-line reply into buf. Returns 0 on a lost connection. */
+static int session_call(Session *s, const char *request, char *buf, size_t buflen) {
+    if (fprintf(s->tx, "%s\n", request) < 0 || fflush(s->tx) != 0) return 0;
+    if (!fgets(buf, (int)buflen, s->rx)) return 0;
+    buf[strcspn(buf, "\r\n")] = '\0';
+    return 1;
+}
+
+/* Show the patient in an "OK|<patient>..." reply using the regular view */
+static void show_patient_reply(char *reply) {
+    char *f[PROTO_MAX_FIELDS];
+    int n = proto_split(reply, f, PROTO_MAX_FIELDS);
+    Patient *p = proto_parse_patient(f + 1, n - 1);
+    view_show_patient(p);
+    if (p && n >= 1 + PROTO_PATIENT_FIELDS + 2) {
+        printf("Served At: %s\nWait Time: %.2f min\n", f[8], atol(f[9]) / 60.0);
+    }
+    free_patient(p);
+}
+
+static void show_reply(char *reply, const char *empty_msg) {
+    if (strncmp(reply, "OK|", 3) == 0) show_patient_reply(reply);
+    else if (strcmp(reply, "EMPTY") == 0 || strcmp(reply, "NOTFOUND") == 0) printf("%s\n", empty_msg);
+    else printf("❌ %s\n", reply);
+}
+
+/* "OK|matches|<patient>|..." from SEARCH|NAME: every listed patient */
+static void show_name_reply(char *reply) {
+    if (strncmp(reply, "OK|", 3) != 0) { show_reply(reply, "Patient not found"); return; }
+    char *f[2 + PROTO_SEARCH_SHOWN * PROTO_PATIENT_FIELDS];
+    int n = proto_split(reply, f, (int)(sizeof(f) / sizeof(f[0])));
+    int shown = 0;
+    for (int i = 2; i + PROTO_PATIENT_FIELDS <= n; i += PROTO_PATIENT_FIELDS, ++shown) {
+        Patient *p = proto_parse_patient(f + i, n - i);
+        view_show_patient(p);
+        free_patient(p);
+    }
+    int total = n >= 2 ? atoi(f[1]) : 0;
+    if (total > shown) printf("... and %d more; narrow the search\n", total - shown);
+}
+
+static int session_open(Session *s, const char *connect_spec) {
+    int fd = net_connect(connect_spec);
+    if (fd < 0) return 0;
+    s->rx = fdopen(fd, "r");
+    s->tx = fdopen(dup(fd), "w");
+    if (!s->rx || !s->tx) {
+        if (s->rx) fclose(s->rx); else close(fd);
+        if (s->tx) fclose(s->tx);
+        return 0;
+    }
+    return 1;
+}
+
+/* A hot standby takes over the same address within a second or two */
+static int session_reconnect(Session *s, const char *connect_spec) {
+    fclose(s->tx);
+    fclose(s->rx);
+    for (int i = 0; i < 30; ++i) {
+        if (session_open(s, connect_spec)) return 1;
+        usleep(100 * 1000);
+    }
+    return 0;
+}
+
+int client_run(const char *connect_spec) {
+    Session s;
+    if (!session_open(&s, connect_spec)) {
+        fprintf(stderr, "Could not connect to %s\n", connect_spec);
+        return 1;
+    }
+
+    char reply[PROTO_MAX_LINE];
+    StrBuf req;
+    sb_init(&req);
+    int rc = 0;
+
+    for (;;) {
+        printf("\n=== Desk client (%s) ===\n", connect_spec);
+        printf("  1. Register Patient\n");
+        printf("  2. Call Next Patient\n");
+        printf("  3. Peek Next Patient\n");
+        printf("  4. Search Patient\n");
+        printf("  5. View Statistics\n");
+        printf("  6. Exit\n\n");
+
+        int ch;
+        if (!read_int("Enter choice: ", &ch)) break;
+        sb_reset(&req);
+
+        if (ch == 1) {
+            char name[NAME_LEN], problem[PROB_LEN], phone[64];
+            int age = 0, sev = 0;
+            printf("Enter name: ");
+            if (!read_line(name, sizeof(name))) break;
+            if (!read_int("Enter age: ", &age)) break;
+            printf("Enter problem/notes: ");
+            if (!read_line(problem, sizeof(problem))) break;
+            if (!read_int("Severity (0=Normal,1=Serious,2=Critical): ", &sev)) break;
+            printf("Enter patient's phone number (accepts +91 / 0 / plain): ");
+            if (!read_line(phone, sizeof(phone))) break;
+            proto_sanitize(name);
+            proto_sanitize(problem);
+            proto_sanitize(phone);
+            sb_printf(&req, "REGISTER|%s|%d|%d|%s|%s", name, age, sev, phone, problem);
+        } else if (ch == 2) {
+            sb_puts(&req, "SERVE");
+        } else if (ch == 3) {
+            sb_puts(&req, "PEEK");
+        } else if (ch == 4) {
+            int by = 0;
+            char key[64];
+            if (!read_int("Search by (1) ID or (2) name? ", &by)) continue;
+            printf("Enter %s: ", by == 1 ? "ID" : "name or part of name");
+            if (!read_line(key, sizeof(key))) continue;
+            proto_sanitize(key);
+            sb_printf(&req, "SEARCH|%s|%s", by == 1 ? "ID" : "NAME", key);
+        } else if (ch == 5) {
+            sb_puts(&req, "STATS");
+        } else if (ch == 6) {
+            session_call(&s, "QUIT", reply, sizeof(reply));
+            break;
+        } else {
+            printf("❌ Invalid option\n");
+            continue;
+        }
+
+        if (!session_call(&s, req.data, reply, sizeof(reply))) {
+            if (!session_reconnect(&s, connect_spec)) {
+                printf("❌ Connection to server lost\n");
+                rc = 1;
+                s.rx = s.tx = NULL;
+                break;
+            }
+            /* the request may or may not have been applied before the failover */
+            printf("⚠️  Reconnected to %s; check the queue before repeating the last request\n", connect_spec);
+            continue;
+        }
+
+        if (ch == 1) {
+            if (strncmp(reply, "OK|", 3) == 0) printf("\n✅ Patient registered\n");
+            show_reply(reply, "");
+        } else if (ch == 2) {
+            if (strncmp(reply, "OK|", 3) == 0) printf("\n📞 CALLING NEXT PATIENT:\n");
+            show_reply(reply, "❌ No patients to serve");
+        } else if (ch == 3) {
+            show_reply(reply, "Queue is empty");
+        } else if (ch == 4) {
+            if (strncmp(req.data, "SEARCH|NAME|", 12) == 0) show_name_reply(reply);
+            else show_reply(reply, "Patient not found");
+        } else if (ch == 5) {
+            char *f[PROTO_MAX_FIELDS];
+            int n = proto_split(reply, f, PROTO_MAX_FIELDS);
+            if (n >= 7 && strcmp(f[0], "OK") == 0) {
+                view_show_stats_counts(atoi(f[5]), atoi(f[6]), atoi(f[1]));
+                printf("Critical: %s  Serious: %s  Normal: %s\n", f[2], f[3], f[4]);
+            } else {
+                printf("❌ %s\n", reply);
+            }
+        }
+    }
+
+    sb_free(&req);
+    if (s.tx) fclose(s.tx);
+    if (s.rx) fclose(s.rx);
+    return rc;
+}
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef NET_CLIENT_H
+#define NET_CLIENT_H
+
+/* Interactive desk client for a running queue server (see server.h) */
+int client_run(const char *connect_spec);
+
+#endif /* NET_CLIENT_H */
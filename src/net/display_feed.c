@@ -0,0 +1,137 @@
+#include "display_feed.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+void display_feed_name(const char *department, int is_default, char *buf, size_t buflen) {
+    if (is_default || !department || !department[0]) snprintf(buf, buflen, "%s", DISPLAY_SHM_PREFIX);
+    else snprintf(buf, buflen, "%s_%s", DISPLAY_SHM_PREFIX, department);
+}
+
+void display_mask_name(const char *name, char *out, size_t outlen) {
+    if (!out || outlen == 0) return;
+    out[0] = '\0';
+    if (!name) return;
+    while (isspace((unsigned char)*name)) name++;
+
+    size_t first = strcspn(name, " \t");
+    const char *last = strrchr(name, ' ');
+    char initial = 0;
+    if (last && last[1] && last > name) initial = (char)toupper((unsigned char)last[1]);
+
+    int keep = first < 3 ? (int)first : 3;
+    if (initial) snprintf(out, outlen, "%.*s*** %c.", keep, name, initial);
+    else snprintf(out, outlen, "%.*s***", keep, name);
+}
+
+int display_enabled_from_env(void) {
+    const char *env = getenv("HOSP_DISPLAY");
+    return env && (strcmp(env, "1") == 0 || strcmp(env, "on") == 0);
+}
+
+#if defined(_WIN32)
+
+int display_publisher_open(DisplayPublisher *pub, const char *shm_name) {
+    (void)shm_name;
+    if (pub) pub->feed = NULL;
+    fprintf(stderr, "Display feed needs POSIX shared memory\n");
+    return 0;
+}
+void display_publisher_close(DisplayPublisher *pub, int unlink_segment) { (void)pub; (void)unlink_segment; }
+void display_publish(DisplayPublisher *pub, const DisplayPayload *payload) { (void)pub; (void)payload; }
+const DisplayFeed* display_attach(const char *shm_name) { (void)shm_name; return NULL; }
+void display_detach(const DisplayFeed *feed) { (void)feed; }
+int display_read(const DisplayFeed *feed, DisplayPayload *out) { (void)feed; (void)out; return 0; }
+
+#else
+
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int display_publisher_open(DisplayPublisher *pub, const char *shm_name) {
+    if (!pub || !shm_name) return 0;
+    pub->feed = NULL;
+    snprintf(pub->shm_name, sizeof(pub->shm_name), "%s", shm_name);
+
+    int fd = shm_open(shm_name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) { perror("shm_open"); return 0; }
+    if (ftruncate(fd, sizeof(DisplayFeed)) != 0) { perror("ftruncate"); close(fd); return 0; }
+    void *mem = mmap(NULL, sizeof(DisplayFeed), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) { perror("mmap"); return 0; }
+
+    DisplayFeed *feed = mem;
+    /* a restarted owner keeps counting from the old sequence, so readers
+       mid-copy still notice the change */
+    uint64_t seq = atomic_load_explicit(&feed->seq, memory_order_relaxed);
+    if (seq & 1) seq++;
+    atomic_store_explicit(&feed->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memset(&feed->data, 0, sizeof(feed->data));
+    feed->magic = DISPLAY_MAGIC;
+    feed->version = DISPLAY_VERSION;
+    atomic_store_explicit(&feed->seq, seq + 2, memory_order_release);
+
+    pub->feed = feed;
+    return 1;
+}
+
+void display_publisher_close(DisplayPublisher *pub, int unlink_segment) {
+    if (!pub || !pub->feed) return;
+    munmap(pub->feed, sizeof(DisplayFeed));
+    pub->feed = NULL;
+    if (unlink_segment) shm_unlink(pub->shm_name);
+}
+
+void display_publish(DisplayPublisher *pub, const DisplayPayload *payload) {
+    if (!pub || !pub->feed || !payload) return;
+    DisplayFeed *feed = pub->feed;
+    /* single writer: seq is only ever advanced here */
+    uint64_t seq = atomic_load_explicit(&feed->seq, memory_order_relaxed);
+    atomic_store_explicit(&feed->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&feed->data, payload, sizeof(*payload));
+    atomic_store_explicit(&feed->seq, seq + 2, memory_order_release);
+}
+
+const DisplayFeed* display_attach(const char *shm_name) {
+    if (!shm_name) return NULL;
+    int fd = shm_open(shm_name, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(DisplayFeed)) { close(fd); return NULL; }
+    void *mem = mmap(NULL, sizeof(DisplayFeed), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return mem == MAP_FAILED ? NULL : mem;
+}
+
+void display_detach(const DisplayFeed *feed) {
+    if (feed) munmap((void*)feed, sizeof(DisplayFeed));
+}
+
+int display_read(const DisplayFeed *feed, DisplayPayload *out) {
+    if (!feed || !out) return 0;
+    /* a publisher that died mid-update leaves seq odd for good */
+    int tries = 0;
+    for (;;) {
+        if (++tries > DISPLAY_READ_TRIES) return 0;
+        uint64_t s1 = atomic_load_explicit(&((DisplayFeed*)feed)->seq, memory_order_acquire);
+        if (s1 & 1) { sched_yield(); continue; }   /* writer mid-update */
+        if (feed->magic != DISPLAY_MAGIC || feed->version != DISPLAY_VERSION) return 0;
+        memcpy(out, &feed->data, sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t s2 = atomic_load_explicit(&((DisplayFeed*)feed)->seq, memory_order_relaxed);
+        if (s1 == s2) break;
+    }
+    if (out->rows < 0) out->rows = 0;
+    if (out->rows > DISPLAY_MAX_ROWS) out->rows = DISPLAY_MAX_ROWS;
+    out->department[DISPLAY_DEPT_LEN - 1] = '\0';
+    for (int i = 0; i < out->rows; ++i) out->row[i].name[DISPLAY_NAME_LEN - 1] = '\0';
+    return 1;
+}
+
+#endif
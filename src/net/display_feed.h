@@ -0,0 +1,80 @@
+#ifndef NET_DISPLAY_FEED_H
+#define NET_DISPLAY_FEED_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+/* Waiting-room display feed.
+
+   The queue owner publishes the next DISPLAY_MAX_ROWS patients of a queue
+   into a POSIX shared memory segment with a fixed layout. Updates are
+   guarded by a seqlock: the writer makes seq odd, rewrites the payload and
+   makes seq even again; readers copy the payload and retry if seq was odd
+   or moved meanwhile. Readers never write to the segment, so any number of
+   display processes can poll it without syscalls or contention.
+
+   Segment names: /hqueue_display for the default department,
+   /hqueue_display_<department> for the others. */
+
+#define DISPLAY_SHM_PREFIX "/hqueue_display"
+#define DISPLAY_MAGIC 0x46445148u      /* "HQDF" */
+#define DISPLAY_VERSION 1
+#define DISPLAY_MAX_ROWS 32
+#define DISPLAY_NAME_LEN 24
+#define DISPLAY_DEPT_LEN 32
+#define DISPLAY_READ_TRIES 1000
+
+typedef struct DisplayRow {
+    int32_t id;
+    int32_t position;         /* 1 = next to be called */
+    int32_t severity;         /* Severity */
+    int32_t eta_sec;          /* -1 if unknown */
+    char name[DISPLAY_NAME_LEN];   /* masked, e.g. "Ram*** K." */
+} DisplayRow;
+
+typedef struct DisplayPayload {
+    int64_t published_at;     /* wall-clock seconds */
+    int32_t waiting;          /* whole queue, not just the rows shown */
+    int32_t rows;
+    int32_t counters_busy;
+    int32_t counters_total;
+    char department[DISPLAY_DEPT_LEN];
+    DisplayRow row[DISPLAY_MAX_ROWS];
+} DisplayPayload;
+
+typedef struct DisplayFeed {
+    uint32_t magic;
+    uint32_t version;
+    _Atomic uint64_t seq;     /* odd while the writer is mid-update */
+    DisplayPayload data;
+} DisplayFeed;
+
+/* ---------- publisher (queue owner) ---------- */
+
+typedef struct DisplayPublisher {
+    DisplayFeed *feed;        /* NULL when not open */
+    char shm_name[64];
+} DisplayPublisher;
+
+/* department NULL/"" or is_default selects the plain segment name */
+void display_feed_name(const char *department, int is_default, char *buf, size_t buflen);
+int display_publisher_open(DisplayPublisher *pub, const char *shm_name);
+void display_publisher_close(DisplayPublisher *pub, int unlink_segment);
+void display_publish(DisplayPublisher *pub, const DisplayPayload *payload);
+
+/* "Ramesh Kumar" -> "Ram*** K." so the board shows nothing identifying */
+void display_mask_name(const char *name, char *out, size_t outlen);
+
+/* HOSP_DISPLAY=1 turns publishing on */
+int display_enabled_from_env(void);
+
+/* ---------- reader (display process) ---------- */
+
+const DisplayFeed* display_attach(const char *shm_name);
+void display_detach(const DisplayFeed *feed);
+/* Consistent copy of the payload; 0 if the segment is not a display feed
+   or is still mid-update after DISPLAY_READ_TRIES attempts (stale) */
+int display_read(const DisplayFeed *feed, DisplayPayload *out);
+
+#endif /* NET_DISPLAY_FEED_H */
@@ -0,0 +1,105 @@
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+
+int net_listen(const char *spec) { (void)spec; return -1; }
+int net_connect(const char *spec) { (void)spec; return -1; }
+int net_set_nonblocking(int fd) { (void)fd; return 0; }
+
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+int net_set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return 0;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static int fill_unix_addr(const char *path, struct sockaddr_un *sun) {
+    if (strlen(path) >= sizeof(sun->sun_path)) return 0;
+    memset(sun, 0, sizeof(*sun));
+    sun->sun_family = AF_UNIX;
+    strcpy(sun->sun_path, path);
+    return 1;
+}
+
+/* Split "host:port" (host optional). Defaults host to 127.0.0.1. */
+static int split_host_port(const char *hp, char *host, size_t hostlen, char *port, size_t portlen) {
+    const char *colon = strrchr(hp, ':');
+    if (!colon) {
+        snprintf(host, hostlen, "127.0.0.1");
+        snprintf(port, portlen, "%s", hp);
+    } else {
+        size_t hl = (size_t)(colon - hp);
+        if (hl == 0) snprintf(host, hostlen, "127.0.0.1");
+        else snprintf(host, hostlen, "%.*s", (int)hl, hp);
+        snprintf(port, portlen, "%s", colon + 1);
+    }
+    return port[0] != '\0';
+}
+
+static int tcp_open(const char *hp, int listening) {
+    char host[256], port[32];
+    if (!split_host_port(hp, host, sizeof(host), port, sizeof(port))) return -1;
+
+    struct addrinfo hints, *res = NULL, *ai;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (listening) hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+
+    int fd = -1;
+    for (ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        int one = 1;
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 128) == 0) break;
+        } else {
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+static int unix_open(const char *path, int listening) {
+    struct sockaddr_un sun;
+    if (!fill_unix_addr(path, &sun)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (listening) {
+        unlink(path); /* stale socket from a previous run */
+        if (bind(fd, (struct sockaddr*)&sun, sizeof(sun)) == 0 && listen(fd, 128) == 0) return fd;
+    } else {
+        if (connect(fd, (struct sockaddr*)&sun, sizeof(sun)) == 0) return fd;
+    }
+    close(fd);
+    return -1;
+}
+
+static int net_open(const char *spec, int listening) {
+    if (!spec || !spec[0]) return -1;
+    if (strncmp(spec, "unix:", 5) == 0) return unix_open(spec + 5, listening);
+    if (strncmp(spec, "tcp:", 4) == 0) return tcp_open(spec + 4, listening);
+    return tcp_open(spec, listening);
+}
+
+int net_listen(const char *spec) { return net_open(spec, 1); }
+int net_connect(const char *spec) { return net_open(spec, 0); }
+
+#endif
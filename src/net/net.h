@@ -0,0 +1,13 @@
+#ifndef NET_NET_H
+#define NET_NET_H
+
+/* Address specs:
+     tcp:HOST:PORT   e.g. tcp:127.0.0.1:7070
+     unix:PATH       e.g. unix:/tmp/hqueue.sock
+     HOST:PORT or PORT are treated as tcp */
+
+int net_listen(const char *spec);
+int net_connect(const char *spec);
+int net_set_nonblocking(int fd);
+
+#endif /* NET_NET_H */
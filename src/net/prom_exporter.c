@@ -0,0 +1,413 @@
+#include "prom_exporter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/metrics.h"
+#include "../util/trace.h"
+
+static const char *severity_label[3] = { "normal", "serious", "critical" };
+
+static int64_t wall_ms(void) {
+#if defined(_WIN32)
+    return (int64_t)time(NULL) * 1000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+static int sev_index(Severity s) {
+    return (s >= NORMAL && s <= CRITICAL) ? (int)s : NORMAL;
+}
+
+/* ---------- queue side ---------- */
+
+/* A change to the persisted queue: counted, and the dirty clock started */
+static void mark_change(PromQueue *pq) {
+    atomic_fetch_add_explicit(&pq->changes, 1, memory_order_relaxed);
+    int64_t zero = 0;
+    if (atomic_load_explicit(&pq->dirty_since_ms, memory_order_relaxed) == 0)
+        atomic_compare_exchange_strong(&pq->dirty_since_ms, &zero, wall_ms());
+}
+
+static void count_serve(PromQueue *pq) {
+    atomic_fetch_add_explicit(&pq->served, 1, memory_order_relaxed);
+    uint64_t sec = (uint64_t)time(NULL);
+    _Atomic uint64_t *slot = &pq->minute[sec % 60];
+    /* one writer per queue, so load-then-store cannot lose a count */
+    uint64_t v = atomic_load_explicit(slot, memory_order_relaxed);
+    if (v >> 20 == sec) atomic_store_explicit(slot, v + 1, memory_order_relaxed);
+    else atomic_store_explicit(slot, sec << 20 | 1, memory_order_relaxed);
+}
+
+static void on_queue_event(void *ctx, PqEvent ev, const Patient *p, Severity old_severity) {
+    PromQueue *pq = ctx;
+    int s = sev_index(p->severity);
+    switch (ev) {
+        case PQ_EV_ENQUEUE:
+            atomic_fetch_add_explicit(&pq->waiting[s], 1, memory_order_relaxed);
+            break;
+        case PQ_EV_DEQUEUE:
+            atomic_fetch_sub_explicit(&pq->waiting[s], 1, memory_order_relaxed);
+            count_serve(pq);
+            break;
+        case PQ_EV_RETRIAGE:
+            atomic_fetch_sub_explicit(&pq->waiting[sev_index(old_severity)], 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&pq->waiting[s], 1, memory_order_relaxed);
+            break;
+        case PQ_EV_REMOVE:
+            atomic_fetch_sub_explicit(&pq->waiting[s], 1, memory_order_relaxed);
+            break;
+        default:
+            return;           /* spill/refill: still waiting, nothing to save */
+    }
+    mark_change(pq);
+}
+
+PromQueue* prom_track_queue(PromExporter *e, const char *department, PriorityQueue *q) {
+    if (!e || !q) return NULL;
+    int n = atomic_load(&e->queues);
+    if (n >= PROM_MAX_QUEUES) return NULL;
+    PromQueue *pq = calloc(1, sizeof(PromQueue));
+    if (!pq) return NULL;
+    snprintf(pq->department, sizeof(pq->department), "%s", department ? department : "");
+    int by_sev[3];
+    pq_count_by_severity(q, by_sev);
+    for (int s = 0; s < 3; ++s) atomic_store(&pq->waiting[s], by_sev[s]);
+    if (!pq_add_observer(q, on_queue_event, pq)) {
+        fprintf(stderr, "metrics: no observer slot left for queue %s\n", pq->department);
+        free(pq);
+        return NULL;
+    }
+    prom_refresh(pq, q);
+    e->queue[n] = pq;
+    atomic_store(&e->queues, n + 1);      /* publishes the slot to the exporter thread */
+    return pq;
+}
+
+void prom_untrack_queue(PromQueue *pq, PriorityQueue *q) {
+    if (pq && q) pq_remove_observer(q, on_queue_event, pq);
+}
+
+void prom_refresh(PromQueue *pq, PriorityQueue *q) {
+    if (!pq || !q) return;
+    PromOldest o;
+    memset(&o, 0, sizeof(o));
+    int want = 0, found = 0;
+    for (int s = 0; s < 3; ++s) if (atomic_load_explicit(&pq->waiting[s], memory_order_relaxed) > 0) want |= 1 << s;
+    /* arrival order: the first patient seen per severity is its oldest, so
+       the walk stops as soon as every waiting severity has been seen */
+    for (Patient *cur = q->head; cur && found != want; cur = cur->next) {
+        int s = sev_index(cur->severity);
+        if (found & (1 << s)) continue;
+        found |= 1 << s;
+        if (cur->arrival_ts != (time_t)-1) o.arrival[s] = (int64_t)cur->arrival_ts;
+    }
+
+    uint64_t seq = atomic_load_explicit(&pq->oldest_seq, memory_order_relaxed);
+    atomic_store_explicit(&pq->oldest_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&pq->oldest, &o, sizeof(o));
+    atomic_store_explicit(&pq->oldest_seq, seq + 2, memory_order_release);
+}
+
+static void read_oldest(PromQueue *pq, PromOldest *out) {
+    for (;;) {
+        uint64_t s1 = atomic_load_explicit(&pq->oldest_seq, memory_order_acquire);
+        if (s1 & 1) continue;
+        memcpy(out, &pq->oldest, sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&pq->oldest_seq, memory_order_relaxed) == s1) return;
+    }
+}
+
+void prom_save_begin(PromQueue *pq) {
+    if (!pq) return;
+    pq->saving_changes = atomic_load(&pq->changes);
+    atomic_store(&pq->saving_since_ms, atomic_exchange(&pq->dirty_since_ms, 0));
+}
+
+void prom_save_end(PromQueue *pq, int ok) {
+    if (!pq) return;
+    int64_t since = atomic_exchange(&pq->saving_since_ms, 0);
+    if (ok) {
+        atomic_store(&pq->saved_changes, pq->saving_changes);
+        atomic_store(&pq->last_save_ms, wall_ms());
+        return;
+    }
+    /* the changes are still unsaved: put their clock back */
+    int64_t cur = atomic_load(&pq->dirty_since_ms);
+    while (since && (cur == 0 || since < cur) &&
+           !atomic_compare_exchange_weak(&pq->dirty_since_ms, &cur, since)) { }
+}
+
+/* ---------- rendering ---------- */
+
+static void put_label(StrBuf *out, const char *v) {
+    for (; *v; ++v) {
+        if (*v == '\\' || *v == '"') { sb_append(out, "\\", 1); sb_append(out, v, 1); }
+        else if (*v == '\n') sb_puts(out, "\\n");
+        else sb_append(out, v, 1);
+    }
+}
+
+static void put_head(StrBuf *out, const char *name, const char *type, const char *help) {
+    sb_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void put_dept(StrBuf *out, const char *name, const PromQueue *pq) {
+    sb_printf(out, "%s{department=\"", name);
+    put_label(out, pq->department);
+    sb_puts(out, "\"");
+}
+
+/* log2 buckets below about 1 us are folded into the first one, and the
+   ones past about a minute into +Inf */
+#define PROM_FIRST_BUCKET 10
+#define PROM_LAST_BUCKET 36
+
+static void render_latency(StrBuf *out) {
+    put_head(out, "hqueue_operations_total", "counter", "Calls per operation");
+    for (int id = 0; id < MET_COUNT; ++id) {
+        MetricSummary m;
+        metrics_read((MetricId)id, &m);
+        sb_printf(out, "hqueue_operations_total{op=\"%s\"} %llu\n", metrics_name((MetricId)id),
+                  (unsigned long long)m.count);
+    }
+    put_head(out, "hqueue_operation_duration_seconds", "histogram",
+             "Latency of timed calls (enqueue and dequeue are sampled)");
+    for (int id = 0; id < MET_COUNT; ++id) {
+        MetricSummary m;
+        uint64_t sum;
+        metrics_read((MetricId)id, &m);
+        sum = atomic_load_explicit(&g_metrics[id].sum_ns, memory_order_relaxed);
+        const char *op = metrics_name((MetricId)id);
+        uint64_t cum = 0;
+        for (int b = 0; b < METRICS_BUCKETS; ++b) {
+            cum += m.bucket[b];
+            if (b < PROM_FIRST_BUCKET || b > PROM_LAST_BUCKET) continue;
+            sb_printf(out, "hqueue_operation_duration_seconds_bucket{op=\"%s\",le=\"%.9g\"} %llu\n",
+                      op, (double)metrics_bucket_le(b) / 1e9, (unsigned long long)cum);
+        }
+        sb_printf(out, "hqueue_operation_duration_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n",
+                  op, (unsigned long long)m.timed);
+        sb_printf(out, "hqueue_operation_duration_seconds_sum{op=\"%s\"} %.9f\n", op, (double)sum / 1e9);
+        sb_printf(out, "hqueue_operation_duration_seconds_count{op=\"%s\"} %llu\n", op,
+                  (unsigned long long)m.timed);
+    }
+}
+
+static void render_process(StrBuf *out) {
+    ProcessStats ps;
+    DiskStats disk;
+    metrics_process(&ps);
+    metrics_disk("data", &disk);
+    put_head(out, "process_cpu_seconds_total", "counter", "User and system CPU time");
+    sb_printf(out, "process_cpu_seconds_total %.3f\n", ps.cpu_user_sec + ps.cpu_sys_sec);
+    if (ps.ok) {
+        put_head(out, "process_resident_memory_bytes", "gauge", "Resident set size");
+        sb_printf(out, "process_resident_memory_bytes %lld\n", (long long)ps.rss_kb * 1024);
+        put_head(out, "process_threads", "gauge", "Threads in the process");
+        sb_printf(out, "process_threads %d\n", ps.threads);
+    }
+    put_head(out, "hqueue_uptime_seconds", "gauge", "Seconds since the process started");
+    sb_printf(out, "hqueue_uptime_seconds %.0f\n", ps.uptime_sec);
+    if (disk.ok) {
+        put_head(out, "hqueue_data_disk_free_bytes", "gauge", "Free space under data/");
+        sb_printf(out, "hqueue_data_disk_free_bytes %llu\n", (unsigned long long)disk.free_bytes);
+    }
+}
+
+int prom_render(PromExporter *e, StrBuf *out) {
+    int n = e ? atomic_load(&e->queues) : 0;
+    int64_t now_ms = wall_ms();
+    uint64_t now_sec = (uint64_t)(now_ms / 1000);
+
+    put_head(out, "hqueue_waiting", "gauge", "Patients waiting, spilled ones included");
+    for (int i = 0; i < n; ++i)
+        for (int s = 2; s >= 0; --s) {
+            put_dept(out, "hqueue_waiting", e->queue[i]);
+            sb_printf(out, ",severity=\"%s\"} %lld\n", severity_label[s],
+                      (long long)atomic_load_explicit(&e->queue[i]->waiting[s], memory_order_relaxed));
+        }
+
+    put_head(out, "hqueue_oldest_wait_seconds", "gauge", "Wait of the oldest waiting patient, 0 if none");
+    for (int i = 0; i < n; ++i) {
+        PromOldest o;
+        read_oldest(e->queue[i], &o);
+        for (int s = 2; s >= 0; --s) {
+            int64_t w = o.arrival[s] ? (int64_t)now_sec - o.arrival[s] : 0;
+            put_dept(out, "hqueue_oldest_wait_seconds", e->queue[i]);
+            sb_printf(out, ",severity=\"%s\"} %lld\n", severity_label[s], (long long)(w > 0 ? w : 0));
+        }
+    }
+
+    put_head(out, "hqueue_served_total", "counter", "Patients called from the queue");
+    for (int i = 0; i < n; ++i) {
+        put_dept(out, "hqueue_served_total", e->queue[i]);
+        sb_printf(out, "} %llu\n", (unsigned long long)atomic_load_explicit(&e->queue[i]->served, memory_order_relaxed));
+    }
+
+    put_head(out, "hqueue_serves_per_minute", "gauge", "Patients called in the last 60 seconds");
+    for (int i = 0; i < n; ++i) {
+        uint64_t total = 0;
+        for (int k = 0; k < 60; ++k) {
+            uint64_t v = atomic_load_explicit(&e->queue[i]->minute[k], memory_order_relaxed);
+            if (now_sec - (v >> 20) < 60) total += v & ((1u << 20) - 1);
+        }
+        put_dept(out, "hqueue_serves_per_minute", e->queue[i]);
+        sb_printf(out, "} %llu\n", (unsigned long long)total);
+    }
+
+    put_head(out, "hqueue_persist_lag_seconds", "gauge",
+             "Age of the oldest queue change not yet in a completed save");
+    for (int i = 0; i < n; ++i) {
+        PromQueue *pq = e->queue[i];
+        int64_t a = atomic_load(&pq->saving_since_ms), b = atomic_load(&pq->dirty_since_ms);
+        int64_t oldest = a && (!b || a < b) ? a : b;
+        put_dept(out, "hqueue_persist_lag_seconds", pq);
+        sb_printf(out, "} %.3f\n", oldest && now_ms > oldest ? (double)(now_ms - oldest) / 1000.0 : 0.0);
+    }
+    put_head(out, "hqueue_persist_unsaved_changes", "gauge", "Queue changes not yet in a completed save");
+    for (int i = 0; i < n; ++i) {
+        PromQueue *pq = e->queue[i];
+        put_dept(out, "hqueue_persist_unsaved_changes", pq);
+        sb_printf(out, "} %llu\n", (unsigned long long)(atomic_load(&pq->changes) - atomic_load(&pq->saved_changes)));
+    }
+    put_head(out, "hqueue_last_save_timestamp_seconds", "gauge", "Wall time of the last completed save, 0 if none");
+    for (int i = 0; i < n; ++i) {
+        put_dept(out, "hqueue_last_save_timestamp_seconds", e->queue[i]);
+        sb_printf(out, "} %lld\n", (long long)(atomic_load(&e->queue[i]->last_save_ms) / 1000));
+    }
+
+    render_latency(out);
+    render_process(out);
+    return out->data != NULL;
+}
+
+/* ---------- HTTP listener ---------- */
+
+#if defined(_WIN32)
+
+PromExporter* prom_open(const char *listen_spec) {
+    (void)listen_spec;
+    fprintf(stderr, "Metrics endpoint needs POSIX sockets\n");
+    return NULL;
+}
+void prom_close(PromExporter *e) { (void)e; }
+
+#else
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "net.h"
+
+#define PROM_POLL_MS 250
+#define PROM_REQ_MAX 4096
+
+static void send_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return;
+        p += w;
+        n -= (size_t)w;
+    }
+}
+
+static void reply(int fd, const char *status, const char *type, const char *body, size_t len) {
+    char head[256];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                     status, type, len);
+    send_all(fd, head, (size_t)n);
+    send_all(fd, body, len);
+}
+
+/* One request per connection; scrapers reconnect every interval anyway */
+static void handle(PromExporter *e, int fd) {
+    struct timeval tv = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char req[PROM_REQ_MAX];
+    size_t len = 0;
+    while (len < sizeof(req) - 1) {
+        ssize_t r = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        len += (size_t)r;
+        req[len] = '\0';
+        if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n")) break;
+    }
+    req[len] = '\0';
+
+    if (strncmp(req, "GET /metrics ", 13) == 0 || strncmp(req, "GET / ", 6) == 0) {
+        StrBuf body;
+        sb_init(&body);
+        if (prom_render(e, &body))
+            reply(fd, "200 OK", "text/plain; version=0.0.4; charset=utf-8", body.data, body.len);
+        else
+            reply(fd, "500 Internal Server Error", "text/plain", "out of memory\n", 14);
+        sb_free(&body);
+    } else if (strncmp(req, "GET ", 4) == 0) {
+        reply(fd, "404 Not Found", "text/plain", "try /metrics\n", 13);
+    } else {
+        reply(fd, "405 Method Not Allowed", "text/plain", "GET only\n", 9);
+    }
+}
+
+static void* exporter_main(void *arg) {
+    PromExporter *e = arg;
+    trace_thread_name("metrics-http");
+    while (!atomic_load(&e->stop)) {
+        struct pollfd pfd = { e->fd, POLLIN, 0 };
+        if (poll(&pfd, 1, PROM_POLL_MS) <= 0) continue;
+        int fd = accept(e->fd, NULL, NULL);
+        if (fd < 0) continue;
+        TRACE_BEGIN(span);
+        handle(e, fd);
+        TRACE_END(span, "metrics.scrape");
+        close(fd);
+    }
+    return NULL;
+}
+
+PromExporter* prom_open(const char *listen_spec) {
+    if (!listen_spec || !listen_spec[0]) return NULL;
+    PromExporter *e = calloc(1, sizeof(PromExporter));
+    if (!e) return NULL;
+    snprintf(e->listen, sizeof(e->listen), "%s", listen_spec);
+    e->fd = net_listen(listen_spec);
+    if (e->fd < 0) {
+        fprintf(stderr, "Could not listen for metrics on %s\n", listen_spec);
+        free(e);
+        return NULL;
+    }
+    if (pthread_create(&e->thread, NULL, exporter_main, e) != 0) {
+        close(e->fd);
+        free(e);
+        return NULL;
+    }
+    return e;
+}
+
+void prom_close(PromExporter *e) {
+    if (!e) return;
+    atomic_store(&e->stop, 1);
+    pthread_join(e->thread, NULL);
+    close(e->fd);
+    if (strncmp(e->listen, "unix:", 5) == 0) unlink(e->listen + 5);
+    int n = atomic_load(&e->queues);
+    for (int i = 0; i < n; ++i) free(e->queue[i]);
+    free(e);
+}
+
+#endif
+
+PromExporter* prom_open_from_env(void) {
+    return prom_open(getenv("HOSP_METRICS_LISTEN"));
+}
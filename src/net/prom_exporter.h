@@ -0,0 +1,82 @@
+#ifndef NET_PROM_EXPORTER_H
+#define NET_PROM_EXPORTER_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "../model/queue.h"
+#include "../util/strbuf.h"
+
+/* Prometheus text-format endpoint (HOSP_METRICS_LISTEN=PORT or HOST:PORT,
+   localhost unless a host is given).
+
+   A background thread answers GET /metrics. It never touches a queue or its
+   lock: everything it renders is a counter or a snapshot the queue owner
+   keeps up to date lock-free.
+   - Depth per severity and serves are counted by a queue observer into
+     atomics, so they are exact at scrape time.
+   - Oldest arrival per severity is republished by the owner with
+     prom_refresh (server: every second; console: every menu pass) behind a
+     seqlock. The exporter subtracts it from the scrape time, so the wait
+     keeps growing between refreshes.
+   - Persistence lag is the age of the oldest queue change that is not yet
+     in a completed save; the save paths bracket writes with
+     prom_save_begin / prom_save_end.
+   - Operation latencies and process figures come from util/metrics.h. */
+
+#define PROM_MAX_QUEUES 32
+#define PROM_DEPT_LEN 32
+
+typedef struct PromOldest {
+    int64_t arrival[3];           /* wall seconds, 0 if none waits */
+} PromOldest;
+
+/* Per-queue state; written by the queue owner, read by the exporter thread */
+typedef struct PromQueue {
+    char department[PROM_DEPT_LEN];
+    _Atomic int64_t waiting[3];
+    _Atomic uint64_t served;      /* dequeues */
+    _Atomic uint64_t minute[60];  /* serves per wall second: second << 20 | count */
+
+    _Atomic uint64_t oldest_seq;  /* seqlock, odd while the owner writes */
+    PromOldest oldest;
+
+    _Atomic uint64_t changes;
+    _Atomic uint64_t saved_changes;   /* changes covered by the last completed save */
+    _Atomic int64_t dirty_since_ms;   /* oldest change after the last save began, 0 if none */
+    _Atomic int64_t saving_since_ms;  /* dirty_since of the save in flight, 0 if none */
+    uint64_t saving_changes;          /* changes when the save in flight began */
+    _Atomic int64_t last_save_ms;     /* wall time of the last completed save */
+} PromQueue;
+
+typedef struct PromExporter {
+    int fd;
+    pthread_t thread;
+    atomic_int stop;
+    PromQueue *queue[PROM_MAX_QUEUES];
+    _Atomic int queues;
+    char listen[128];
+} PromExporter;
+
+/* Starts the listener from HOSP_METRICS_LISTEN; NULL when unset or on failure */
+PromExporter* prom_open_from_env(void);
+PromExporter* prom_open(const char *listen_spec);
+void prom_close(PromExporter *e);
+
+/* Observe q under the given department label (NULL-safe on e). Call from the
+   queue owner, with the queue's lock held if it has one. */
+PromQueue* prom_track_queue(PromExporter *e, const char *department, PriorityQueue *q);
+void prom_untrack_queue(PromQueue *pq, PriorityQueue *q);
+/* Republish the oldest arrival per severity; queue owner, under its lock */
+void prom_refresh(PromQueue *pq, PriorityQueue *q);
+
+/* Bracket one save of the queue. begin runs where the queue is read (under
+   its lock, or when the snapshot is taken); end may run on any thread. */
+void prom_save_begin(PromQueue *pq);
+void prom_save_end(PromQueue *pq, int ok);
+
+/* The exposition text, as served on /metrics; returns 0 on allocation failure */
+int prom_render(PromExporter *e, StrBuf *out);
+
+#endif /* NET_PROM_EXPORTER_H */
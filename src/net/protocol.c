@@ -0,0 +1,40 @@
+#include "protocol.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Split in place on '|'. Returns the number of fields. */
+int proto_split(char *line, char **fields, int max_fields) {
+    if (!line || !fields || max_fields <= 0) return 0;
+    line[strcspn(line, "\r\n")] = '\0';
+
+    int n = 0;
+    char *cur = line;
+    fields[n++] = cur;
+    while (n < max_fields && (cur = strchr(cur, '|')) != NULL) {
+        *cur++ = '\0';
+        fields[n++] = cur;
+    }
+    return n;
+}
+
+/* Separators would corrupt both the wire format and the CSV files */
+void proto_sanitize(char *s) {
+    if (!s) return;
+    for (; *s; ++s) {
+        if (*s == '|' || *s == ',' || *s == '\n' || *s == '\r') *s = ' ';
+    }
+}
+
+void proto_put_patient(StrBuf *out, const Patient *p) {
+    sb_printf(out, "%d|%lld|%s|%d|%d|%s|%s",
+              p->id, p->phone_number, p->name ? p->name : "", p->age,
+              (int)p->severity, p->arrival, p->problem ? p->problem : "");
+}
+
+Patient* proto_parse_patient(char **fields, int nfields) {
+    if (!fields || nfields < PROTO_PATIENT_FIELDS) return NULL;
+    int sev = atoi(fields[4]);
+    if (sev < NORMAL || sev > CRITICAL) sev = NORMAL;
+    return create_patient(atoi(fields[0]), strtoll(fields[1], NULL, 10), fields[2],
+                          atoi(fields[3]), fields[6], (Severity)sev, fields[5]);
+}
@@ -0,0 +1,54 @@
+#ifndef NET_PROTOCOL_H
+#define NET_PROTOCOL_H
+
+#include <stddef.h>
+#include "../model/patient.h"
+#include "../util/strbuf.h"
+
+/* Line protocol shared by the desk server and its clients.
+   One request per line, fields separated by '|':
+
+     REGISTER|name|age|severity|phone|problem  -> OK|<patient>
+     SERVE                                     -> OK|<patient>|served_at|wait_sec  or EMPTY
+     SERVE|id                                  -> OK|<patient>|served_at|wait_sec  or NOTFOUND
+     CALL                                      -> OK|counter|<patient>  or EMPTY / BUSY
+     DONE|counter                              -> OK|counter|service_sec
+     COUNTERS                                  -> OK|n|capacity_per_hour|id:patient:busy_sec|...
+     PEEK                                      -> OK|<patient>                     or EMPTY
+     SEARCH|ID|id                              -> OK|<patient>                     or NOTFOUND
+     SEARCH|NAME|text                          -> OK|matches|<patient>|...         or NOTFOUND
+     RETRIAGE|id|severity                      -> OK|<patient>|position            or NOTFOUND
+     REMOVE|id                                 -> OK|<patient>                     or NOTFOUND
+     STATS                                     -> OK|waiting|critical|serious|normal|registered|served
+     QUERY|terms                               -> OK|matches[|group=count...][|row...]
+     REPLICATION                               -> OK|role|lsn|standbys|behind|lag_ms
+     DEPT|name                                 -> OK|name|dept,dept,...           or NOTFOUND
+     PING                                      -> PONG
+     QUIT                                      -> BYE
+
+   REGISTER takes an optional trailing |flags (PATIENT_* bits, e.g. 1 = pregnant).
+   Names over NAME_LEN-1 and problems over PROB_LEN-1 bytes are refused.
+   <patient> is id|phone|name|age|severity|arrival|problem.
+   SEARCH|NAME matches text anywhere in the name, in any case, and lists up
+   to PROTO_SEARCH_SHOWN of the matching patients, oldest arrival first.
+   DEPT is server-only and applies to the rest of the connection: later
+   requests work on that department's queue (the first one until then).
+   Plain DEPT names the current department and lists them all.
+   QUERY takes the query language of model/query.h over the waiting queue
+   and served.csv; a row is its shown columns joined by ','. Rows stop
+   where the next would take the reply past PROTO_MAX_LINE, so fewer rows
+   than min(matches, limit) means the reply was cut: narrow the query or
+   show fewer columns.
+   Failures reply ERR|reason. */
+
+#define PROTO_MAX_LINE 4096
+#define PROTO_MAX_FIELDS 16
+#define PROTO_PATIENT_FIELDS 7
+#define PROTO_SEARCH_SHOWN 8    /* full patients still fit PROTO_MAX_LINE */
+
+int proto_split(char *line, char **fields, int max_fields);
+void proto_sanitize(char *s);
+void proto_put_patient(StrBuf *out, const Patient *p);
+Patient* proto_parse_patient(char **fields, int nfields);
+
+#endif /* NET_PROTOCOL_H */
@@ -0,0 +1,375 @@
+#include "replica.h"
+#include <stdio.h>
+
+#if !defined(__linux__)
+
+void repl_status(const ReplPrimary *r, StrBuf *out) {
+    (void)r;
+    sb_puts(out, "OK|standalone|0|0|0|0\n");
+}
+
+int standby_run(const char *primary_spec, const char *listen_spec) {
+    (void)primary_spec; (void)listen_spec;
+    fprintf(stderr, "Standby mode needs the Linux server and is not available here\n");
+    return 1;
+}
+
+#else
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "net.h"
+#include "protocol.h"
+#include "server.h"
+#include "../model/history.h"
+
+int64_t repl_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ---------- primary ---------- */
+
+static void put_enqueue(StrBuf *out, uint64_t lsn, const Patient *p) {
+    sb_printf(out, "E|%llu|", (unsigned long long)lsn);
+    proto_put_patient(out, p);
+    sb_printf(out, "|%u\n", p->flags);
+}
+
+typedef struct ResyncCtx {
+    StrBuf *out;
+    uint64_t lsn;
+} ResyncCtx;
+
+static void resync_patient(void *ctx, const Patient *p) {
+    ResyncCtx *rc = ctx;
+    put_enqueue(rc->out, rc->lsn, p);
+}
+
+/* Start the next record: bumps the lsn and remembers when it was produced */
+static uint64_t next_lsn(ReplPrimary *r) {
+    r->lsn++;
+    r->lsn_ms[r->lsn & (REPL_LAG_WINDOW - 1)] = repl_now_ms();
+    return r->lsn;
+}
+
+static int has_standbys(const ReplPrimary *r) {
+    for (int i = 0; i < REPL_MAX_STANDBYS; ++i) if (r->peers[i].active) return 1;
+    return 0;
+}
+
+static void on_queue_event(void *ctx, PqEvent ev, const Patient *p, Severity old_severity) {
+    (void)old_severity;
+    ReplPrimary *r = ctx;
+    if (!has_standbys(r)) return;   /* a new standby gets a full resync anyway */
+    if (ev == PQ_EV_SPILL || ev == PQ_EV_REFILL) return;   /* storage only; the standby keeps all in memory */
+    uint64_t lsn = next_lsn(r);
+    switch (ev) {
+        case PQ_EV_ENQUEUE:  put_enqueue(&r->pending, lsn, p); break;
+        case PQ_EV_DEQUEUE:  sb_printf(&r->pending, "D|%llu|%d\n", (unsigned long long)lsn, p->id); break;
+        case PQ_EV_REMOVE:   sb_printf(&r->pending, "X|%llu|%d\n", (unsigned long long)lsn, p->id); break;
+        case PQ_EV_RETRIAGE: sb_printf(&r->pending, "T|%llu|%d|%d\n", (unsigned long long)lsn, p->id, (int)p->severity); break;
+        default: break;
+    }
+}
+
+static void on_counter_event(void *ctx, const Counter *c, int started) {
+    ReplPrimary *r = ctx;
+    if (!has_standbys(r)) return;
+    uint64_t lsn = next_lsn(r);
+    if (started)
+        sb_printf(&r->pending, "S|%llu|%d|%d|%lld\n", (unsigned long long)lsn, c->id,
+                  c->current ? c->current->id : 0, (long long)c->service_start);
+    else
+        sb_printf(&r->pending, "C|%llu|%d\n", (unsigned long long)lsn, c->id);
+}
+
+void repl_primary_init(ReplPrimary *r, PriorityQueue *q, Dispatcher *d, const int *next_id) {
+    memset(r, 0, sizeof(*r));
+    r->q = q;
+    r->disp = d;
+    r->next_id = next_id;
+    sb_init(&r->pending);
+    pq_add_observer(q, on_queue_event, r);
+    d->observer = on_counter_event;
+    d->observer_ctx = r;
+}
+
+void repl_primary_free(ReplPrimary *r) {
+    if (!r) return;
+    pq_remove_observer(r->q, on_queue_event, r);
+    if (r->disp && r->disp->observer == on_counter_event) r->disp->observer = NULL;
+    sb_free(&r->pending);
+}
+
+int repl_attach(ReplPrimary *r, StrBuf *out) {
+    int peer = -1;
+    for (int i = 0; i < REPL_MAX_STANDBYS && peer < 0; ++i) if (!r->peers[i].active) peer = i;
+    if (peer < 0) return -1;
+
+    /* everything up to now travels as state, so this standby starts at lsn */
+    unsigned long long lsn = (unsigned long long)r->lsn;
+    sb_printf(out, "R|%llu|%d|%d\n", lsn, r->next_id ? *r->next_id : 1, r->disp->n);
+    ResyncCtx rc = { out, r->lsn };
+    pq_arrival_walk(r->q, resync_patient, &rc);   /* spilled patients too, in arrival order */
+    for (int i = 0; i < r->disp->n; ++i) {
+        const Counter *c = &r->disp->counters[i];
+        if (!c->current) continue;
+        put_enqueue(out, r->lsn, c->current);
+        sb_printf(out, "D|%llu|%d\n", lsn, c->current->id);
+        sb_printf(out, "S|%llu|%d|%d|%lld\n", lsn, c->id, c->current->id, (long long)c->service_start);
+    }
+    r->peers[peer].active = 1;
+    r->peers[peer].acked = r->lsn;
+    r->peers[peer].acked_at_ms = repl_now_ms();
+    return peer;
+}
+
+void repl_detach(ReplPrimary *r, int peer) {
+    if (peer >= 0 && peer < REPL_MAX_STANDBYS) r->peers[peer].active = 0;
+}
+
+void repl_on_line(ReplPrimary *r, int peer, const char *line) {
+    if (peer < 0 || peer >= REPL_MAX_STANDBYS || strncmp(line, "A|", 2) != 0) return;
+    uint64_t lsn = strtoull(line + 2, NULL, 10);
+    ReplPeer *p = &r->peers[peer];
+    if (lsn > p->acked && lsn <= r->lsn) {
+        p->acked = lsn;
+        p->acked_at_ms = repl_now_ms();
+    }
+}
+
+void repl_heartbeat(ReplPrimary *r, int64_t now_ms) {
+    if (!has_standbys(r) || now_ms - r->last_heartbeat_ms < REPL_HEARTBEAT_MS) return;
+    r->last_heartbeat_ms = now_ms;
+    sb_printf(&r->pending, "H|%llu|%lld\n", (unsigned long long)r->lsn, (long long)now_ms);
+}
+
+void repl_lag(const ReplPrimary *r, int64_t now_ms, ReplLag *out) {
+    memset(out, 0, sizeof(*out));
+    if (!r) return;
+    out->lsn = r->lsn;
+    uint64_t slowest = r->lsn;
+    for (int i = 0; i < REPL_MAX_STANDBYS; ++i) {
+        if (!r->peers[i].active) continue;
+        out->standbys++;
+        if (r->peers[i].acked < slowest) slowest = r->peers[i].acked;
+    }
+    out->behind = r->lsn - slowest;
+    if (out->behind == 0) return;
+    /* beyond the window the oldest remembered record bounds the age from below */
+    uint64_t first = out->behind < REPL_LAG_WINDOW ? slowest + 1 : r->lsn - REPL_LAG_WINDOW + 1;
+    out->lag_ms = now_ms - r->lsn_ms[first & (REPL_LAG_WINDOW - 1)];
+    if (out->lag_ms < 0) out->lag_ms = 0;
+}
+
+void repl_status(const ReplPrimary *r, StrBuf *out) {
+    ReplLag lag;
+    repl_lag(r, repl_now_ms(), &lag);
+    sb_printf(out, "OK|%s|%llu|%d|%llu|%lld\n", r ? "primary" : "standalone",
+              (unsigned long long)lag.lsn, lag.standbys, (unsigned long long)lag.behind, (long long)lag.lag_ms);
+}
+
+/* ---------- standby ---------- */
+
+typedef struct ReplMirror {
+    PriorityQueue q;
+    Dispatcher disp;
+    int next_id;
+    int synced;
+    uint64_t applied;
+    Patient *limbo;           /* dequeued, waiting to see whether an S claims it */
+} ReplMirror;
+
+static Patient* mirror_find(ReplMirror *m, int id) {
+    Patient *p = pq_peek(&m->q);   /* dequeues nearly always take the head */
+    return (p && p->id == id) ? p : pq_search_by_id(&m->q, id);
+}
+
+static void mirror_clear(ReplMirror *m) {
+    free_patient(m->limbo);
+    m->limbo = NULL;
+    Patient *p;
+    while ((p = pq_dequeue(&m->q)) != NULL) free_patient(p);
+    for (int i = 0; i < m->disp.n; ++i) {
+        free_patient(m->disp.counters[i].current);
+        m->disp.counters[i].current = NULL;
+    }
+}
+
+/* Returns 0 on a record this standby cannot apply */
+static int mirror_apply(ReplMirror *m, char *line) {
+    char *f[PROTO_MAX_FIELDS];
+    int n = proto_split(line, f, PROTO_MAX_FIELDS);
+    if (n < 2 || f[0][0] == '\0' || f[0][1] != '\0') return 0;
+    char kind = f[0][0];
+    if (kind != 'S' && m->limbo) {
+        /* served on the spot: history was written by the primary */
+        free_patient(m->limbo);
+        m->limbo = NULL;
+    }
+
+    if (kind == 'R') {
+        if (n < 3) return 0;
+        mirror_clear(m);
+        /* S and C name the primary's counters, whatever HOSP_COUNTERS says here */
+        if (n > 3 && !dispatch_set_counters(&m->disp, atoi(f[3]))) {
+            fprintf(stderr, "standby: cannot mirror %s counters (at most %d)\n", f[3], DISPATCH_MAX_COUNTERS);
+            return 0;
+        }
+        m->next_id = atoi(f[2]);
+        m->synced = 1;
+    } else if (kind == 'E') {
+        Patient *p = proto_parse_patient(f + 2, n - 2);
+        if (!p) return 0;
+        if (n > 2 + PROTO_PATIENT_FIELDS) p->flags = (unsigned)strtoul(f[2 + PROTO_PATIENT_FIELDS], NULL, 10);
+        pq_enqueue(&m->q, p);
+        if (p->id >= m->next_id) m->next_id = p->id + 1;
+    } else if (kind == 'D' || kind == 'X' || kind == 'T') {
+        if (n < 3) return 0;
+        Patient *p = mirror_find(m, atoi(f[2]));
+        if (!p) return 0;
+        if (kind == 'T') {
+            if (n < 4 || !pq_update_severity(&m->q, p, (Severity)atoi(f[3]))) return 0;
+        } else {
+            pq_remove(&m->q, p);
+            if (kind == 'D') m->limbo = p;
+            else free_patient(p);
+        }
+    } else if (kind == 'S') {
+        if (n < 5) return 0;
+        Counter *c = dispatch_counter(&m->disp, atoi(f[2]));
+        if (!c || !m->limbo || m->limbo->id != atoi(f[3])) return 0;
+        free_patient(c->current);
+        c->current = m->limbo;
+        c->service_start = (time_t)strtoll(f[4], NULL, 10);
+        m->limbo = NULL;
+    } else if (kind == 'C') {
+        if (n < 3) return 0;
+        Counter *c = dispatch_counter(&m->disp, atoi(f[2]));
+        if (!c) return 0;
+        free_patient(c->current);
+        c->current = NULL;
+        c->served++;
+        c->free_since = time(NULL);
+    } else if (kind != 'H') {
+        return 0;
+    }
+    m->applied = strtoull(f[1], NULL, 10);
+    return 1;
+}
+
+static int send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t w = send(fd, buf, len, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return 0;
+        buf += w;
+        len -= (size_t)w;
+    }
+    return 1;
+}
+
+/* Apply records until the primary goes away. Returns 1 if it was lost
+   after a full sync (time to take over), 0 on a protocol error. */
+static int follow_primary(ReplMirror *m, int fd, int timeout_ms) {
+    StrBuf in;
+    sb_init(&in);
+    int lost = 1;
+    for (;;) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int rc = poll(&pfd, 1, timeout_ms);
+        if (rc < 0 && errno == EINTR) continue;
+        if (rc == 0) {
+            fprintf(stderr, "standby: no word from the primary for %d ms\n", timeout_ms);
+            break;
+        }
+        char buf[16384];
+        ssize_t r = recv(fd, buf, sizeof(buf), 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        sb_append(&in, buf, (size_t)r);
+
+        size_t start = 0;
+        char *nl;
+        while ((nl = memchr(in.data + start, '\n', in.len - start)) != NULL) {
+            *nl = '\0';
+            if (!mirror_apply(m, in.data + start)) {
+                fprintf(stderr, "standby: cannot apply record at lsn %llu\n", (unsigned long long)m->applied);
+                lost = 0;
+            }
+            start = (size_t)(nl - in.data) + 1;
+        }
+        sb_consume(&in, start);
+        if (!lost) break;
+
+        char ack[32];
+        int len = snprintf(ack, sizeof(ack), "A|%llu\n", (unsigned long long)m->applied);
+        if (!send_all(fd, ack, (size_t)len)) break;
+    }
+    sb_free(&in);
+    return lost;
+}
+
+int standby_run(const char *primary_spec, const char *listen_spec) {
+    const char *env = getenv("HOSP_REPLICA_TIMEOUT_MS");
+    int timeout_ms = env ? atoi(env) : REPL_TIMEOUT_MS;
+    if (timeout_ms <= 0) timeout_ms = REPL_TIMEOUT_MS;
+
+    ReplMirror m;
+    memset(&m, 0, sizeof(m));
+    pq_init(&m.q);
+    PqPolicy policy;
+    pq_policy_from_env(&policy);
+    pq_set_policy(&m.q, &policy);
+    dispatch_init(&m.disp, dispatch_counters_from_env(), HISTORY_FILE);
+    dispatch_load_history(&m.disp);
+
+    for (;;) {
+        int fd = net_connect(primary_spec);
+        if (fd < 0) {
+            /* nothing to take over until a first full sync */
+            usleep(200 * 1000);
+            continue;
+        }
+        printf("Standby following %s\n", primary_spec);
+        fflush(stdout);
+        int lost = follow_primary(&m, fd, timeout_ms);
+        close(fd);
+        if (lost && m.synced) break;
+        fprintf(stderr, "standby: resyncing from %s\n", primary_spec);
+        m.synced = 0;
+    }
+
+    free_patient(m.limbo);
+    m.limbo = NULL;
+    int next_id = history_next_id(NULL, HISTORY_FILE);
+    if (next_id < m.next_id) next_id = m.next_id;
+    printf("Primary lost at lsn %llu: taking over on %s with %d waiting\n",
+           (unsigned long long)m.applied, listen_spec, pq_size(&m.q));
+    fflush(stdout);
+    pq_spill_from_env(&m.q);   /* the mirror itself never spills */
+
+    /* the primary ran a single department: the first of HOSP_DEPARTMENTS */
+    const char *depts = getenv("HOSP_DEPARTMENTS");
+    if (!depts || !depts[0]) depts = REGISTRY_DEFAULT_DEPT;
+    char name[DEPT_NAME_LEN];
+    snprintf(name, sizeof(name), "%.*s", (int)strcspn(depts, ","), depts);
+    QueueRegistry reg;
+    registry_init(&reg);
+    if (!registry_adopt(&reg, name, &m.q)) {
+        fprintf(stderr, "standby: bad department name \"%s\"\n", name);
+        pq_free_all(&m.q);
+        registry_destroy(&reg);
+        return 1;
+    }
+    return server_serve(listen_spec, &reg, &m.disp, next_id);
+}
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef NET_REPLICA_H
+#define NET_REPLICA_H
+
+#include <stdint.h>
+#include "../model/queue.h"
+#include "../model/dispatch.h"
+#include "../util/strbuf.h"
+
+/* Hot-standby replication by log shipping.
+
+   The primary server (HOSP_REPLICA_LISTEN=unix:PATH) turns every queue and
+   counter change into one record line and, within the same event-loop step,
+   writes it to each connected standby before the desk's reply is flushed.
+   A change a desk has seen acknowledged is therefore already in the
+   standby's socket buffer, even if the primary dies right after.
+
+   Records (primary -> standby), one per line:
+     R|lsn|next_id|counters      full resync follows: clear queue, size and clear counters
+     E|lsn|<patient>|flags       enqueue, <patient> as in protocol.h
+     D|lsn|id                    dequeued (served on the spot, or see S)
+     X|lsn|id                    removed without service (no-show)
+     T|lsn|id|severity           re-triaged
+     S|lsn|counter|id|start      the patient just dequeued is at counter since start
+     C|lsn|counter               counter finished its patient
+     H|lsn|wall_ms               heartbeat
+   Standby -> primary: A|lsn once a batch is applied.
+
+   The standby (hospital_queue --standby PRIMARY LISTEN) keeps its own
+   PriorityQueue and Dispatcher in sync. When the primary's socket closes, or
+   it sends nothing for HOSP_REPLICA_TIMEOUT_MS (default REPL_TIMEOUT_MS),
+   the standby starts serving desks on LISTEN from memory, with no CSV
+   reload. The default is three missed heartbeats, so a hung primary is
+   replaced within a second; a primary whose loop stalls longer than that
+   (a huge QUERY, a swapping host) is taken over while still alive, so
+   raise the timeout on such hosts. The standby adopts the primary's
+   counter count from R. Run both with the same HOSP_SCHED/HOSP_PRIORITY
+   settings so ordering matches. */
+
+#define REPL_MAX_STANDBYS 4
+#define REPL_LAG_WINDOW 4096        /* power of two */
+#define REPL_HEARTBEAT_MS 250
+#define REPL_TIMEOUT_MS 750
+
+typedef struct ReplPeer {
+    int active;
+    uint64_t acked;
+    int64_t acked_at_ms;
+} ReplPeer;
+
+typedef struct ReplPrimary {
+    PriorityQueue *q;
+    Dispatcher *disp;
+    const int *next_id;
+    uint64_t lsn;
+    int64_t lsn_ms[REPL_LAG_WINDOW];   /* when each recent lsn was produced */
+    StrBuf pending;                    /* records not yet handed to the standbys */
+    ReplPeer peers[REPL_MAX_STANDBYS];
+    int64_t last_heartbeat_ms;
+} ReplPrimary;
+
+typedef struct ReplLag {
+    int standbys;
+    uint64_t lsn;
+    uint64_t behind;          /* records the slowest standby has not acked */
+    int64_t lag_ms;           /* age of the oldest unacked record */
+} ReplLag;
+
+/* Registers the queue and dispatcher observers */
+void repl_primary_init(ReplPrimary *r, PriorityQueue *q, Dispatcher *d, const int *next_id);
+void repl_primary_free(ReplPrimary *r);
+
+/* A standby connected: returns its peer slot (or -1 when full) and writes
+   the full resync into out */
+int repl_attach(ReplPrimary *r, StrBuf *out);
+void repl_detach(ReplPrimary *r, int peer);
+void repl_on_line(ReplPrimary *r, int peer, const char *line);
+/* Queues an H record if REPL_HEARTBEAT_MS passed since the last one */
+void repl_heartbeat(ReplPrimary *r, int64_t now_ms);
+
+void repl_lag(const ReplPrimary *r, int64_t now_ms, ReplLag *out);
+/* REPLICATION reply: OK|role|lsn|standbys|behind|lag_ms (r may be NULL) */
+void repl_status(const ReplPrimary *r, StrBuf *out);
+int64_t repl_now_ms(void);
+
+/* Follow primary_spec, then take over desks on listen_spec. Returns a
+   process exit code. */
+int standby_run(const char *primary_spec, const char *listen_spec);
+
+#endif /* NET_REPLICA_H */
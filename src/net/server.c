@@ -0,0 +1,569 @@
+#if defined(__linux__)
+#define _GNU_SOURCE /* accept4 */
+#endif
+#include "server.h"
+#include <stdio.h>
+
+#if !defined(__linux__)
+
+int server_run(const char *listen_spec) {
+    (void)listen_spec;
+    fprintf(stderr, "Server mode needs epoll and is only available on Linux\n");
+    return 1;
+}
+
+int server_serve(const char *listen_spec, QueueRegistry *reg, Dispatcher *disp, int next_id) {
+    (void)disp; (void)next_id;
+    registry_destroy(reg);
+    return server_run(listen_spec);
+}
+
+#else
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "net.h"
+#include "protocol.h"
+#include "../controller/commands.h"
+#include "../model/queue.h"
+#include "../model/registry.h"
+#include "../model/history.h"
+#include "../model/snapshot.h"
+#include "../model/cdc.h"
+#include "../view/view.h"
+#include "display_feed.h"
+#include "replica.h"
+#include "prom_exporter.h"
+#include "../util/file_util.h"
+#include "../util/strbuf.h"
+#include "../util/trace.h"
+
+#define QUEUE_FILE "data/queue.csv"   /* the default department's, see registry_queue_path */
+#define MAX_EVENTS 256
+#define AUTOSAVE_SEC 30
+
+typedef enum { CONN_DESK, CONN_LISTENER, CONN_REPL_LISTENER, CONN_STANDBY } ConnKind;
+
+typedef struct Conn {
+    int fd;
+    ConnKind kind;
+    int peer;        /* CONN_STANDBY: ReplPrimary peer slot */
+    int closing;     /* close once the reply has been flushed */
+    uint32_t events; /* epoll events currently registered */
+    int dead;        /* CONN_STANDBY: shipping failed; closed by reap_standbys */
+    int dept;        /* CONN_DESK: index of the department chosen with DEPT */
+    StrBuf in;
+    StrBuf out;
+} Conn;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+/* Autosave writes a queue snapshot on a helper thread, so a large queue
+   never stalls the event loop while desks keep registering and serving. */
+typedef struct SaveJob {
+    QueueSnapshot *snap;
+    PromQueue *prom;          /* persistence lag bookkeeping, may be NULL */
+    char path[128];
+    pthread_t tid;
+    int started;
+    atomic_int running;
+} SaveJob;
+
+static void* save_main(void *arg) {
+    SaveJob *job = arg;
+    trace_thread_name("autosave");
+    int ok = qsnap_save_csv(job->snap, job->path);
+    if (!ok) fprintf(stderr, "autosave to %s failed\n", job->path);
+    prom_save_end(job->prom, ok);
+    qsnap_release(job->snap);
+    job->snap = NULL;
+    atomic_store(&job->running, 0);
+    return NULL;
+}
+
+static void save_start(SaveJob *job, PriorityQueue *q) {
+    if (atomic_load(&job->running)) return;
+    if (job->started) pthread_join(job->tid, NULL);
+    job->started = 0;
+    job->snap = pq_snapshot(q);
+    if (!job->snap) return;
+    prom_save_begin(job->prom);
+    atomic_store(&job->running, 1);
+    if (pthread_create(&job->tid, NULL, save_main, job) != 0) {
+        atomic_store(&job->running, 0);
+        prom_save_end(job->prom, 0);
+        qsnap_release(job->snap);
+        job->snap = NULL;
+        return;
+    }
+    job->started = 1;
+}
+
+/* Alerts fire from alerts_tick on the loop thread, between requests. The
+   loop thread is the only one touching the queues, so no department lock
+   is taken here or around requests. */
+static void on_alert(PatientAlerts *a, Patient *p, AlertKind kind) {
+    QueueRegistry *reg = a->user;
+    for (int i = 0; i < registry_count(reg); ++i) {
+        Department *d = registry_get(reg, i);
+        if (pq_search_by_id(&d->q, p->id) != p) continue;
+        char msg[256];
+        alerts_apply(a, &d->q, p, kind, d->name, msg, sizeof(msg));
+        printf("[%s] %s\n", alert_kind_name(kind), msg);
+        fflush(stdout);
+        return;
+    }
+    alerts_forget(a, p);
+}
+
+/* One per department: its requests, change stream, metrics, board and autosave */
+typedef struct ServerDept {
+    Department *d;
+    CommandContext ctx;
+    CdcTap cdc_tap;
+    PromQueue *prom;
+    DisplayPublisher display;
+    SaveJob save;
+    int saved_ops;
+} ServerDept;
+
+/* Event-loop state shared by the connection handlers */
+typedef struct Server {
+    int ep;
+    ServerDept depts[REGISTRY_MAX_DEPTS];
+    int ndepts;
+    int next_id;              /* shared by every department's REGISTER */
+    ReplPrimary repl;
+    int repl_on;
+    Conn *standbys[REPL_MAX_STANDBYS];
+} Server;
+
+static Conn* conn_new(int fd, ConnKind kind) {
+    Conn *c = calloc(1, sizeof(Conn));
+    if (!c) return NULL;
+    c->fd = fd;
+    c->kind = kind;
+    c->peer = -1;
+    c->events = EPOLLIN;
+    sb_init(&c->in);
+    sb_init(&c->out);
+    return c;
+}
+
+static void conn_close(Server *srv, Conn *c) {
+    if (c->kind == CONN_STANDBY) {
+        repl_detach(&srv->repl, c->peer);
+        srv->standbys[c->peer] = NULL;
+        printf("Standby %d disconnected\n", c->peer);
+        fflush(stdout);
+    }
+    epoll_ctl(srv->ep, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    sb_free(&c->in);
+    sb_free(&c->out);
+    free(c);
+}
+
+/* A closing connection stops reading: at EOF EPOLLIN would fire on every wait */
+static void conn_update_interest(int ep, Conn *c) {
+    uint32_t want = (c->closing ? 0 : EPOLLIN) | (c->out.len > 0 ? EPOLLOUT : 0);
+    if (want == c->events) return;
+    struct epoll_event ev;
+    ev.events = want;
+    ev.data.ptr = c;
+    epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = want;
+}
+
+/* Returns 0 on a fatal socket error */
+static int conn_flush(Conn *c) {
+    while (c->out.len > 0) {
+        ssize_t w = send(c->fd, c->out.data, c->out.len, MSG_NOSIGNAL);
+        if (w > 0) { sb_consume(&c->out, (size_t)w); continue; }
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 1;
+        return 0;
+    }
+    return 1;
+}
+
+/* DEPT|name points this desk's later requests at another department;
+   plain DEPT names the current one and lists them all */
+static void select_department(Server *srv, Conn *c, char **f, int n) {
+    if (n >= 2) {
+        int found = -1;
+        for (int i = 0; i < srv->ndepts && found < 0; ++i) {
+            if (strcmp(srv->depts[i].d->name, f[1]) == 0) found = i;
+        }
+        if (found < 0) {
+            sb_puts(&c->out, "NOTFOUND\n");
+            return;
+        }
+        c->dept = found;
+    }
+    sb_printf(&c->out, "OK|%s|", srv->depts[c->dept].d->name);
+    for (int i = 0; i < srv->ndepts; ++i) sb_printf(&c->out, "%s%s", i ? "," : "", srv->depts[i].d->name);
+    sb_puts(&c->out, "\n");
+}
+
+static void conn_execute(Server *srv, Conn *c, char *line) {
+    if (strncmp(line, "DEPT", 4) == 0 && (line[4] == '\0' || line[4] == '|')) {
+        char *f[PROTO_MAX_FIELDS];
+        select_department(srv, c, f, proto_split(line, f, PROTO_MAX_FIELDS));
+        return;
+    }
+    CommandContext *ctx = &srv->depts[c->dept].ctx;
+    ctx->next_id = srv->next_id;
+    if (cmd_execute(ctx, line, &c->out) == CMD_QUIT) c->closing = 1;
+    srv->next_id = ctx->next_id;
+}
+
+/* Execute every complete line in the input buffer; a standby only sends acks */
+static void conn_process(Server *srv, Conn *c) {
+    size_t start = 0;
+    while (!c->closing && start < c->in.len) {
+        char *line = c->in.data + start;
+        char *nl = memchr(line, '\n', c->in.len - start);
+        if (!nl) break;
+        *nl = '\0';
+        start = (size_t)(nl - c->in.data) + 1;
+        if (c->kind == CONN_STANDBY) { repl_on_line(&srv->repl, c->peer, line); continue; }
+        TRACE_BEGIN(span);
+        conn_execute(srv, c, line);
+        TRACE_END_ARG(span, "server.request", line);   /* split in place: just the verb */
+    }
+    sb_consume(&c->in, start);
+    if (c->in.len > PROTO_MAX_LINE) {
+        sb_puts(&c->out, "ERR|line too long\n");
+        c->closing = 1;
+    }
+}
+
+/* Returns 0 when the peer is gone */
+static int conn_read(Server *srv, Conn *c) {
+    char buf[16384];
+    for (;;) {
+        ssize_t r = recv(c->fd, buf, sizeof(buf), 0);
+        if (r > 0) {
+            if (!sb_append(&c->in, buf, (size_t)r)) return 0;
+            conn_process(srv, c);
+            if (c->closing) return 1;
+            continue;
+        }
+        if (r == 0) {
+            /* a desk that half-closed still gets the replies it pipelined */
+            if (c->kind == CONN_STANDBY) return 0;
+            c->closing = 1;
+            return 1;
+        }
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+static void accept_all(Server *srv, Conn *listener) {
+    for (;;) {
+        int fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return; /* EAGAIN, or out of fds: retry on the next wakeup */
+        }
+        int standby = listener->kind == CONN_REPL_LISTENER;
+        Conn *c = conn_new(fd, standby ? CONN_STANDBY : CONN_DESK);
+        if (c && standby) {
+            c->peer = repl_attach(&srv->repl, &c->out);
+            if (c->peer < 0) {
+                fprintf(stderr, "Standby refused: %d already attached\n", REPL_MAX_STANDBYS);
+                sb_free(&c->out);
+                free(c);
+                c = NULL;
+            }
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        if (!c || epoll_ctl(srv->ep, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            if (c && standby) repl_detach(&srv->repl, c->peer);
+            close(fd);
+            if (c) { sb_free(&c->in); sb_free(&c->out); free(c); }
+            continue;
+        }
+        if (standby) {
+            srv->standbys[c->peer] = c;
+            printf("Standby %d attached at lsn %llu\n", c->peer, (unsigned long long)srv->repl.lsn);
+            fflush(stdout);
+            conn_flush(c);
+            conn_update_interest(srv->ep, c);
+        }
+    }
+}
+
+/* Hand the records produced so far to every standby. Called before desk
+   replies are flushed, so an acknowledged change has left this process.
+   A standby that cannot take them is only marked dead: the event being
+   handled, or a later one of the same batch, may still point at it. */
+static void ship_replication(Server *srv) {
+    if (!srv->repl_on || srv->repl.pending.len == 0) return;
+    for (int i = 0; i < REPL_MAX_STANDBYS; ++i) {
+        Conn *c = srv->standbys[i];
+        if (!c || c->dead) continue;
+        if (!sb_append(&c->out, srv->repl.pending.data, srv->repl.pending.len) || !conn_flush(c)) {
+            c->dead = 1;
+            continue;
+        }
+        conn_update_interest(srv->ep, c);
+    }
+    sb_reset(&srv->repl.pending);
+}
+
+/* Close the standbys ship_replication gave up on; only between event batches */
+static void reap_standbys(Server *srv) {
+    for (int i = 0; i < REPL_MAX_STANDBYS; ++i) {
+        if (srv->standbys[i] && srv->standbys[i]->dead) conn_close(srv, srv->standbys[i]);
+    }
+}
+
+static int add_listener(Server *srv, const char *spec, ConnKind kind, Conn **out) {
+    *out = NULL;
+    int fd = net_listen(spec);
+    if (fd < 0) {
+        fprintf(stderr, "Could not listen on %s\n", spec);
+        return 0;
+    }
+    net_set_nonblocking(fd);
+    Conn *c = conn_new(fd, kind);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+    if (!c || epoll_ctl(srv->ep, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        fprintf(stderr, "epoll setup failed\n");
+        close(fd);
+        free(c);
+        return 0;
+    }
+    *out = c;
+    return 1;
+}
+
+int server_run(const char *listen_spec) {
+    if (!ensure_data_dir("data")) {
+        fprintf(stderr, "Could not create or access data directory \"data\"\n");
+        return 1;
+    }
+
+    TRACE_BEGIN(startup);
+    PqPolicy policy;
+    pq_policy_from_env(&policy);
+    QueueRegistry reg;
+    registry_init(&reg);
+    registry_add_from_env(&reg, &policy);
+    int nextId = history_next_id(QUEUE_FILE, HISTORY_FILE);
+    registry_load_all(&reg, &nextId);
+
+    Dispatcher disp;
+    dispatch_init(&disp, dispatch_counters_from_env(), HISTORY_FILE);
+    dispatch_load_history(&disp);
+    TRACE_END(startup, "startup");
+
+    return server_serve(listen_spec, &reg, &disp, nextId);
+}
+
+int server_serve(const char *listen_spec, QueueRegistry *reg, Dispatcher *disp, int nextId) {
+    Server srv;
+    memset(&srv, 0, sizeof(srv));
+    srv.ndepts = registry_count(reg);
+    srv.next_id = nextId;
+    const char *repl_spec = getenv("HOSP_REPLICA_LISTEN");
+    if (repl_spec && repl_spec[0] && srv.ndepts > 1) {
+        fprintf(stderr, "Standbys mirror a single queue: run with one department (HOSP_DEPARTMENTS) "
+                        "or without HOSP_REPLICA_LISTEN\n");
+        registry_destroy(reg);
+        return 1;
+    }
+    srv.ep = epoll_create1(EPOLL_CLOEXEC);
+    if (srv.ep < 0) {
+        perror("epoll_create1");
+        registry_destroy(reg);
+        return 1;
+    }
+    Conn *listener = NULL, *repl_listener = NULL;
+    if (!add_listener(&srv, listen_spec, CONN_LISTENER, &listener) ||
+        (repl_spec && repl_spec[0] && !add_listener(&srv, repl_spec, CONN_REPL_LISTENER, &repl_listener))) {
+        if (listener) { close(listener->fd); free(listener); }
+        close(srv.ep);
+        registry_destroy(reg);
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    PatientAlerts alerts;
+    AlertConfig acfg;
+    alerts_config_from_env(&acfg, &registry_get(reg, 0)->q.policy);
+    alerts_init(&alerts, &acfg, on_alert, reg);
+
+    /* attached after loading, so the stream only carries new changes */
+    CdcStream *cdc = cdc_open_from_env();
+    disp->cdc = cdc;
+    PromExporter *prom = prom_open_from_env();
+    int display_on = display_enabled_from_env();
+
+    QueryIndex qindex;
+    query_index_init(&qindex);
+
+    int waiting = 0;
+    for (int i = 0; i < srv.ndepts; ++i) {
+        ServerDept *sd = &srv.depts[i];
+        Department *d = sd->d = registry_get(reg, i);
+        alerts_track_queue(&alerts, &d->q);
+        cdc_tap_queue(&sd->cdc_tap, cdc, d->name, &d->q);
+        sd->prom = prom_track_queue(prom, d->name, &d->q);
+
+        CommandContext *ctx = &sd->ctx;
+        cmd_context_init(ctx, &d->q, nextId);
+        ctx->disp = disp;
+        ctx->department = d->name;
+        ctx->alerts = &alerts;
+        ctx->cdc = cdc;
+        ctx->qindex = &qindex;
+
+        sd->save.prom = sd->prom;
+        registry_queue_path(d, sd->save.path, sizeof(sd->save.path));
+        char shm_name[64];
+        display_feed_name(d->name, d->is_default, shm_name, sizeof(shm_name));
+        if (display_on && display_publisher_open(&sd->display, shm_name))
+            printf("Publishing the %s waiting-room feed at %s\n", d->name, shm_name);
+        waiting += pq_size(&d->q);
+    }
+
+    if (repl_listener) {
+        CommandContext *ctx = &srv.depts[0].ctx;
+        /* a single department: its context always holds the latest next id */
+        repl_primary_init(&srv.repl, ctx->q, disp, &ctx->next_id);
+        srv.repl_on = 1;
+        ctx->repl = &srv.repl;
+    }
+
+    printf("Queue server listening on %s (%d waiting in %d department%s)\n",
+           listen_spec, waiting, srv.ndepts, srv.ndepts == 1 ? "" : "s");
+    if (cdc) printf("Streaming change events to %s\n", getenv("HOSP_CDC"));
+    if (repl_listener) printf("Accepting standbys on %s\n", repl_spec);
+    if (prom) printf("Serving Prometheus metrics on %s (GET /metrics)\n", getenv("HOSP_METRICS_LISTEN"));
+    fflush(stdout);
+
+    struct epoll_event events[MAX_EVENTS];
+    time_t last_refresh = 0;
+    time_t last_save = time(NULL);
+    /* standbys expect a heartbeat well inside their takeover timeout */
+    int wait_ms = srv.repl_on ? REPL_HEARTBEAT_MS : 1000;
+
+    while (!stop_requested) {
+        int n = epoll_wait(srv.ep, events, MAX_EVENTS, wait_ms);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            Conn *c = events[i].data.ptr;
+            if (c->kind == CONN_LISTENER || c->kind == CONN_REPL_LISTENER) { accept_all(&srv, c); continue; }
+            if (c->dead) continue;
+
+            int alive = 1;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) alive = conn_read(&srv, c);
+            ship_replication(&srv);
+            if (alive && !c->dead) alive = conn_flush(c);
+            if (!alive || c->dead || (c->closing && c->out.len == 0)) {
+                conn_close(&srv, c);
+                continue;
+            }
+            conn_update_interest(srv.ep, c);
+        }
+        reap_standbys(&srv);
+
+        /* epoll_wait wakes at least once a second, which is the wheel's tick */
+        alerts_tick(&alerts);
+        trace_poll();
+        if (srv.repl_on) repl_heartbeat(&srv.repl, repl_now_ms());
+        ship_replication(&srv);
+        reap_standbys(&srv);
+
+        /* boards and metrics once a second */
+        time_t now = time(NULL);
+        if (now != last_refresh) {
+            last_refresh = now;
+            for (int i = 0; i < srv.ndepts; ++i) {
+                ServerDept *sd = &srv.depts[i];
+                if (sd->display.feed) {
+                    DisplayPayload payload;
+                    view_fill_display(&payload, &sd->d->q, disp, sd->d->name, now);
+                    display_publish(&sd->display, &payload);
+                }
+                if (sd->prom) prom_refresh(sd->prom, &sd->d->q);
+            }
+        }
+
+        /* Persist periodically so a crash loses at most AUTOSAVE_SEC of queue changes */
+        if (now - last_save >= AUTOSAVE_SEC) {
+            last_save = now;
+            for (int i = 0; i < srv.ndepts; ++i) {
+                ServerDept *sd = &srv.depts[i];
+                int ops = sd->ctx.registered + sd->ctx.served + sd->ctx.changed;
+                if (ops == sd->saved_ops || atomic_load(&sd->save.running)) continue;
+                save_start(&sd->save, &sd->d->q);
+                sd->saved_ops = ops;
+            }
+        }
+    }
+
+    printf("\nShutting down... saving %d department queue(s)\n", srv.ndepts);
+    /* free the desk address first: a standby binds it as soon as we hang up */
+    close(listener->fd);
+    free(listener);
+    if (strncmp(listen_spec, "unix:", 5) == 0) unlink(listen_spec + 5);
+    dispatch_complete_all(disp, time(NULL));
+    if (srv.repl_on) {
+        ship_replication(&srv);
+        for (int i = 0; i < REPL_MAX_STANDBYS; ++i) if (srv.standbys[i]) conn_close(&srv, srv.standbys[i]);
+        repl_primary_free(&srv.repl);
+        close(repl_listener->fd);
+        free(repl_listener);
+    }
+    for (int i = 0; i < srv.ndepts; ++i) {
+        ServerDept *sd = &srv.depts[i];
+        cdc_untap_queue(&sd->cdc_tap, &sd->d->q);
+        if (sd->save.started) pthread_join(sd->save.tid, NULL);
+        display_publisher_close(&sd->display, 1);
+        prom_save_begin(sd->prom);
+        prom_save_end(sd->prom, pq_save_csv(&sd->d->q, sd->save.path));
+        prom_untrack_queue(sd->prom, &sd->d->q);
+    }
+    cdc_close(cdc);
+    prom_close(prom);
+    alerts_destroy(&alerts);
+    query_index_free(&qindex);
+    registry_destroy(reg);
+    close(srv.ep);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef NET_SERVER_H
+#define NET_SERVER_H
+
+#include "../model/registry.h"
+#include "../model/dispatch.h"
+
+/* Run the multi-desk queue server on listen_spec (see net.h) until SIGINT/SIGTERM.
+   The server owns the department queues of HOSP_DEPARTMENTS, loads/saves
+   their queue files and appends to data/served.csv exactly like the
+   interactive desk. A desk works on the first department until it sends
+   DEPT|name (net/protocol.h). Returns a process exit code. */
+int server_run(const char *listen_spec);
+
+/* Same, over departments and a dispatcher that are already populated (a
+   standby taking over). Destroys the registry before returning. */
+int server_serve(const char *listen_spec, QueueRegistry *reg, Dispatcher *disp, int next_id);
+
+#endif /* NET_SERVER_H */
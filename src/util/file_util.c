@@ -0,0 +1,24 @@
+#include "file_util.h"
+#include <errno.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+/* Ensure data directory exists */
+int ensure_data_dir(const char *dir) {
+#if defined(_WIN32)
+    if (_mkdir(dir) == 0) return 1;
+    return GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    struct stat st;
+    if (stat(dir, &st) == 0) return S_ISDIR(st.st_mode);
+    if (mkdir(dir, 0755) == 0) return 1;
+    if (errno == EEXIST) return 1;
+    return 0;
+#endif
+}
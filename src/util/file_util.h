@@ -0,0 +1,7 @@
+#ifndef FILE_UTIL_H
+#define FILE_UTIL_H
+
+/* Create dir if missing. Returns 1 if it exists afterwards. */
+int ensure_data_dir(const char *dir);
+
+#endif /* FILE_UTIL_H */
@@ -0,0 +1,137 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+
+MetricSeries g_metrics[MET_COUNT];
+
+static uint64_t start_ns;
+
+void metrics_init(void) {
+    start_ns = monotonic_ns();
+}
+
+const char* metrics_name(MetricId id) {
+    switch (id) {
+        case MET_ENQUEUE:      return "enqueue";
+        case MET_DEQUEUE:      return "dequeue";
+        case MET_SAVE:         return "save";
+        case MET_HISTORY_SCAN: return "history_scan";
+        case MET_PREDICT:      return "prediction";
+        case MET_LOGIN:        return "login";
+        default:               return "unknown";
+    }
+}
+
+static int bucket_of(uint64_t ns) {
+    int b = 0;
+    while (ns && b < METRICS_BUCKETS - 1) { ns >>= 1; b++; }
+    return b;
+}
+
+uint64_t metrics_bucket_le(int b) {
+    if (b <= 0) return 0;
+    if (b >= 64) return UINT64_MAX;
+    return (1ULL << b) - 1;
+}
+
+void metrics_observe(MetricId id, uint64_t ns) {
+    if ((unsigned)id >= MET_COUNT) return;
+    MetricSeries *m = &g_metrics[id];
+    atomic_fetch_add_explicit(&m->sum_ns, ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&m->bucket[bucket_of(ns)], 1, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&m->max_ns, memory_order_relaxed);
+    while (ns > max && !atomic_compare_exchange_weak_explicit(&m->max_ns, &max, ns,
+                                                              memory_order_relaxed, memory_order_relaxed)) { }
+}
+
+static uint64_t percentile(const MetricSummary *s, uint64_t total, double q) {
+    if (total == 0) return 0;
+    uint64_t rank = (uint64_t)((double)total * q + 0.5), seen = 0;
+    if (rank == 0) rank = 1;
+    for (int b = 0; b < METRICS_BUCKETS; ++b) {
+        seen += s->bucket[b];
+        if (seen >= rank) return metrics_bucket_le(b) < s->max_ns ? metrics_bucket_le(b) : s->max_ns;
+    }
+    return s->max_ns;
+}
+
+void metrics_read(MetricId id, MetricSummary *out) {
+    memset(out, 0, sizeof(*out));
+    if ((unsigned)id >= MET_COUNT) return;
+    MetricSeries *m = &g_metrics[id];
+    out->count = atomic_load_explicit(&m->count, memory_order_relaxed);
+    out->max_ns = atomic_load_explicit(&m->max_ns, memory_order_relaxed);
+    uint64_t sum = atomic_load_explicit(&m->sum_ns, memory_order_relaxed), total = 0;
+    for (int b = 0; b < METRICS_BUCKETS; ++b) {
+        out->bucket[b] = atomic_load_explicit(&m->bucket[b], memory_order_relaxed);
+        total += out->bucket[b];
+    }
+    /* timed calls are counted from the buckets, so they agree with the percentiles */
+    out->timed = total;
+    out->mean_ns = total ? sum / total : 0;
+    out->p50_ns = percentile(out, total, 0.50);
+    out->p99_ns = percentile(out, total, 0.99);
+}
+
+#if defined(_WIN32)
+
+void metrics_process(ProcessStats *out) {
+    memset(out, 0, sizeof(*out));
+    out->uptime_sec = (double)(monotonic_ns() - start_ns) / 1e9;
+}
+
+void metrics_disk(const char *path, DiskStats *out) {
+    (void)path;
+    memset(out, 0, sizeof(*out));
+}
+
+#else
+
+#include <sys/resource.h>
+#include <sys/statvfs.h>
+
+/* "Key:   123 kB" lines of /proc files */
+static long proc_field(const char *path, const char *key) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[256];
+    size_t klen = strlen(key);
+    long v = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, klen) == 0 && line[klen] == ':') {
+            sscanf(line + klen + 1, "%ld", &v);
+            break;
+        }
+    }
+    fclose(f);
+    return v;
+}
+
+void metrics_process(ProcessStats *out) {
+    memset(out, 0, sizeof(*out));
+    out->uptime_sec = (double)(monotonic_ns() - start_ns) / 1e9;
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        out->cpu_user_sec = (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1e6;
+        out->cpu_sys_sec = (double)ru.ru_stime.tv_sec + (double)ru.ru_stime.tv_usec / 1e6;
+        out->peak_rss_kb = ru.ru_maxrss;   /* kB on Linux */
+    }
+    out->rss_kb = proc_field("/proc/self/status", "VmRSS");
+    long hwm = proc_field("/proc/self/status", "VmHWM");
+    if (hwm >= 0) out->peak_rss_kb = hwm;
+    out->threads = (int)proc_field("/proc/self/status", "Threads");
+    out->mem_total_kb = proc_field("/proc/meminfo", "MemTotal");
+    out->mem_available_kb = proc_field("/proc/meminfo", "MemAvailable");
+    out->ok = out->rss_kb >= 0 && out->mem_total_kb > 0;
+}
+
+void metrics_disk(const char *path, DiskStats *out) {
+    memset(out, 0, sizeof(*out));
+    struct statvfs sv;
+    if (!path || statvfs(path, &sv) != 0) return;
+    out->total_bytes = (uint64_t)sv.f_blocks * sv.f_frsize;
+    out->free_bytes = (uint64_t)sv.f_bavail * sv.f_frsize;
+    out->ok = 1;
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "time_util.h"
+
+/* Always-on operation metrics: a call counter and a log2 latency histogram
+   per operation, in process-wide relaxed atomics, so any thread may record
+   and any thread may read without locks.
+
+   Hot operations (enqueue, dequeue) count every call but time only one in
+   METRICS_HOT_SAMPLE, which keeps the cost to one atomic add on most calls;
+   everything else is timed on every call. Recording:
+
+       uint64_t t0 = metrics_begin(MET_SAVE);
+       ...
+       metrics_end(MET_SAVE, t0);
+*/
+
+typedef enum {
+    MET_ENQUEUE,
+    MET_DEQUEUE,
+    MET_SAVE,                 /* queue.csv, live or from a snapshot */
+    MET_HISTORY_SCAN,         /* full reads of served.csv */
+    MET_PREDICT,              /* wait-time prediction, ML helper or heuristic */
+    MET_LOGIN,                /* password verification (key derivation) */
+    MET_COUNT
+} MetricId;
+
+#define METRICS_HOT_SAMPLE 64       /* power of two */
+#define METRICS_BUCKETS 48          /* bucket b holds [2^(b-1), 2^b) ns, b = 0 holds 0 */
+
+typedef struct MetricSeries {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum_ns;
+    _Atomic uint64_t max_ns;
+    _Atomic uint64_t bucket[METRICS_BUCKETS];
+} MetricSeries;
+
+extern MetricSeries g_metrics[MET_COUNT];
+
+/* Counts the call; returns a start time if this call is timed, else 0 */
+static inline uint64_t metrics_begin(MetricId id) {
+    uint64_t n = atomic_fetch_add_explicit(&g_metrics[id].count, 1, memory_order_relaxed);
+    uint64_t mask = id <= MET_DEQUEUE ? METRICS_HOT_SAMPLE - 1 : 0;
+    return (n & mask) ? 0 : monotonic_ns();
+}
+
+void metrics_observe(MetricId id, uint64_t ns);
+
+static inline void metrics_end(MetricId id, uint64_t t0) {
+    if (t0) metrics_observe(id, monotonic_ns() - t0);
+}
+
+/* Point-in-time view of one series; latencies in nanoseconds. Percentiles
+   are bucket upper bounds, so within a factor of two. */
+typedef struct MetricSummary {
+    uint64_t count;
+    uint64_t timed;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+    uint64_t bucket[METRICS_BUCKETS];
+} MetricSummary;
+
+void metrics_read(MetricId id, MetricSummary *out);
+const char* metrics_name(MetricId id);
+/* Upper bound of bucket b in nanoseconds */
+uint64_t metrics_bucket_le(int b);
+
+/* Process resources: /proc and getrusage on Linux; ok = 0 where unavailable */
+typedef struct ProcessStats {
+    int ok;
+    long rss_kb;
+    long peak_rss_kb;
+    long mem_total_kb;        /* whole machine */
+    long mem_available_kb;
+    double cpu_user_sec;
+    double cpu_sys_sec;
+    double uptime_sec;        /* since metrics_init */
+    int threads;
+} ProcessStats;
+
+typedef struct DiskStats {
+    int ok;
+    uint64_t total_bytes;
+    uint64_t free_bytes;      /* available to this user */
+} DiskStats;
+
+/* Marks process start for uptime; call once early in main */
+void metrics_init(void);
+void metrics_process(ProcessStats *out);
+void metrics_disk(const char *path, DiskStats *out);
+
+#endif /* METRICS_H */
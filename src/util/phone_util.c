@@ -0,0 +1,53 @@
+#include "phone_util.h"
+#include <string.h>
+
+/* Parse Indian phone number in multiple formats */
+int parse_indian_phone(const char *input, long long *out) {
+    if (!input || input[0] == '\0') return 0;
+
+    char digits[32];
+    int di = 0;
+
+    /* Step 1: Extract ONLY digits from input */
+    for (int i = 0; input[i] != '\0' && di < 31; i++) {
+        char c = input[i];
+        if (c >= '0' && c <= '9') {
+            digits[di++] = c;
+        }
+    }
+    digits[di] = '\0';
+
+    if (di == 0) return 0;
+
+    /* Step 2: Normalize length - handle different input formats */
+    if (di == 12 && digits[0] == '9' && digits[1] == '1') {
+        /* Format: 919876543210 -> 9876543210 */
+        char temp[32];
+        strcpy(temp, digits);
+        strcpy(digits, temp + 2);
+        di = 10;
+    } else if (di == 11 && digits[0] == '0') {
+        /* Format: 09876543210 -> 9876543210 */
+        char temp[32];
+        strcpy(temp, digits);
+        strcpy(digits, temp + 1);
+        di = 10;
+    }
+
+    /* Step 3: Must be exactly 10 digits */
+    if (di != 10) return 0;
+
+    /* Step 4: Must start with 6-9 (valid Indian mobile prefix) */
+    if (digits[0] < '6' || digits[0] > '9') return 0;
+
+    /* Step 5: Convert to long long safely */
+    long long val = 0;
+    for (int i = 0; i < 10; i++) {
+        val = val * 10 + (digits[i] - '0');
+    }
+
+    if (val <= 0) return 0;
+
+    if (out) *out = val;
+    return 1;
+}
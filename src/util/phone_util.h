@@ -0,0 +1,7 @@
+#ifndef PHONE_UTIL_H
+#define PHONE_UTIL_H
+
+/* Normalize +91 / 0 / plain 10-digit Indian mobile numbers. Returns 1 on success. */
+int parse_indian_phone(const char *input, long long *out);
+
+#endif /* PHONE_UTIL_H */
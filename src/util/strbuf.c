@@ -0,0 +1,83 @@
+#include "strbuf.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+void sb_init(StrBuf *sb) {
+    if (!sb) return;
+    sb->data = NULL;
+    sb->len = 0;
+    sb->cap = 0;
+}
+
+void sb_free(StrBuf *sb) {
+    if (!sb) return;
+    free(sb->data);
+    sb_init(sb);
+}
+
+/* Keep the allocation so the buffer can be reused without reallocating */
+void sb_reset(StrBuf *sb) {
+    if (!sb) return;
+    sb->len = 0;
+    if (sb->data) sb->data[0] = '\0';
+}
+
+int sb_reserve(StrBuf *sb, size_t extra) {
+    if (sb->len + extra + 1 <= sb->cap) return 1;
+    size_t ncap = sb->cap ? sb->cap : 256;
+    while (ncap < sb->len + extra + 1) ncap *= 2;
+    char *nd = realloc(sb->data, ncap);
+    if (!nd) return 0;
+    sb->data = nd;
+    sb->cap = ncap;
+    return 1;
+}
+
+int sb_append(StrBuf *sb, const char *s, size_t n) {
+    if (!sb || !s) return 0;
+    if (!sb_reserve(sb, n)) return 0;
+    memcpy(sb->data + sb->len, s, n);
+    sb->len += n;
+    sb->data[sb->len] = '\0';
+    return 1;
+}
+
+int sb_puts(StrBuf *sb, const char *s) {
+    if (!s) return 0;
+    return sb_append(sb, s, strlen(s));
+}
+
+int sb_printf(StrBuf *sb, const char *fmt, ...) {
+    if (!sb || !fmt) return 0;
+    va_list ap;
+    va_start(ap, fmt);
+    char tmp[512];
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    if ((size_t)n < sizeof(tmp)) return sb_append(sb, tmp, (size_t)n);
+
+    if (!sb_reserve(sb, (size_t)n)) return 0;
+    va_start(ap, fmt);
+    vsnprintf(sb->data + sb->len, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    sb->len += (size_t)n;
+    return 1;
+}
+
+/* Drop the first n bytes (e.g. after a partial socket write) */
+void sb_consume(StrBuf *sb, size_t n) {
+    if (!sb || !sb->data) return;
+    if (n >= sb->len) { sb_reset(sb); return; }
+    memmove(sb->data, sb->data + n, sb->len - n);
+    sb->len -= n;
+    sb->data[sb->len] = '\0';
+}
+
+void sb_truncate(StrBuf *sb, size_t len) {
+    if (!sb || !sb->data || len >= sb->len) return;
+    sb->len = len;
+    sb->data[len] = '\0';
+}
@@ -0,0 +1,27 @@
+#ifndef STRBUF_H
+#define STRBUF_H
+
+#include <stddef.h>
+
+/* Growable, reusable text buffer */
+typedef struct StrBuf {
+    char *data;
+    size_t len;
+    size_t cap;
+} StrBuf;
+
+void sb_init(StrBuf *sb);
+void sb_free(StrBuf *sb);
+void sb_reset(StrBuf *sb);
+int sb_reserve(StrBuf *sb, size_t extra);
+int sb_append(StrBuf *sb, const char *s, size_t n);
+int sb_puts(StrBuf *sb, const char *s);
+int sb_printf(StrBuf *sb, const char *fmt, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+void sb_consume(StrBuf *sb, size_t n);
+void sb_truncate(StrBuf *sb, size_t len);   /* drop everything past len */
+
+#endif /* STRBUF_H */
@@ -1,11 +1,16 @@
 #include "time_util.h"
 #include <time.h>
 #include <stdio.h>
+#if defined(_WIN32)
+#include <windows.h>
+#endif
 
 void get_now_iso(char *buf, size_t buflen) {
-    if (!buf || buflen == 0) return;
+    format_iso_time(time(NULL), buf, buflen);
+}
 
-    time_t t = time(NULL);
+void format_iso_time(time_t t, char *buf, size_t buflen) {
+    if (!buf || buflen == 0) return;
     if (t == (time_t)-1) { buf[0] = '\0'; return; }
 
     struct tm tm;
@@ -31,4 +36,45 @@ void get_now_iso(char *buf, size_t buflen) {
     if (strftime(buf, buflen, "%Y-%m-%d %H:%M:%S", &tm) == 0) {
         if (buflen > 0) buf[0] = '\0';
     }
-}
\ No newline at end of file
+}
+
+/* Parse ISO 8601 datetime string to time_t */
+time_t parse_iso_time(const char *iso) {
+    if (!iso) return (time_t)-1;
+    int Y = 0, M = 0, D = 0, h = 0, m = 0, s = 0;
+    if (sscanf(iso, "%d-%d-%d %d:%d:%d", &Y, &M, &D, &h, &m, &s) != 6) {
+        return (time_t)-1;
+    }
+    struct tm tm = {0};
+    tm.tm_year = Y - 1900;
+    tm.tm_mon = M - 1;
+    tm.tm_mday = D;
+    tm.tm_hour = h;
+    tm.tm_min = m;
+    tm.tm_sec = s;
+    tm.tm_isdst = -1;   /* let mktime apply DST the same way localtime did */
+    return mktime(&tm);
+}
+
+uint64_t monotonic_ms(void) {
+#if defined(_WIN32)
+    return (uint64_t)GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+#endif
+}
+
+uint64_t monotonic_ns(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
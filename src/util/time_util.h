@@ -2,10 +2,23 @@
 #define TIME_UTIL_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 
 /* Buffer size for "YYYY-MM-DD HH:MM:SS" (19) + NUL + margin */
 #define TIME_LEN 25
 
 void get_now_iso(char *buf, size_t buflen);
 
+/* Parse "YYYY-MM-DD HH:MM:SS" as local time; (time_t)-1 on failure */
+time_t parse_iso_time(const char *iso);
+
+/* Format t as local "YYYY-MM-DD HH:MM:SS" */
+void format_iso_time(time_t t, char *buf, size_t buflen);
+
+/* Milliseconds from an arbitrary start; never jumps with wall-clock changes */
+uint64_t monotonic_ms(void);
+/* Same clock in nanoseconds, for latency measurements */
+uint64_t monotonic_ns(void);
+
 #endif /* TIME_UTIL_H */
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "timer_wheel.h"
+#include <stdlib.h>
+#include <string.h>
+
+void tw_init(TimerWheel *tw, uint64_t now, void *owner) {
+    if (!tw) return;
+    memset(tw->slots, 0, sizeof(tw->slots));
+    tw->now = now;
+    tw->pending = 0;
+    tw->owner = owner;
+}
+
+static void slot_link(Timer **slot, Timer *t) {
+    t->prev = NULL;
+    t->next = *slot;
+    if (*slot) (*slot)->prev = t;
+    *slot = t;
+}
+
+static void slot_unlink(TimerWheel *tw, Timer *t) {
+    if (t->prev) {
+        t->prev->next = t->next;
+    } else {
+        /* head of its slot: find which one from the expiry */
+        for (int lvl = 0; lvl < TW_LEVELS; ++lvl) {
+            Timer **slot = &tw->slots[lvl][(t->expires >> (lvl * TW_BITS)) & TW_MASK];
+            if (*slot == t) { *slot = t->next; break; }
+        }
+    }
+    if (t->next) t->next->prev = t->prev;
+    t->next = t->prev = NULL;
+}
+
+/* Place t on the level whose span covers its remaining delay */
+static void wheel_place(TimerWheel *tw, Timer *t) {
+    uint64_t delta = t->expires > tw->now ? t->expires - tw->now : 0;
+    int lvl = 0;
+    while (lvl < TW_LEVELS - 1 && delta >= (1ULL << ((lvl + 1) * TW_BITS))) lvl++;
+    slot_link(&tw->slots[lvl][(t->expires >> (lvl * TW_BITS)) & TW_MASK], t);
+}
+
+void tw_destroy(TimerWheel *tw) {
+    if (!tw) return;
+    for (int lvl = 0; lvl < TW_LEVELS; ++lvl) {
+        for (int s = 0; s < TW_SLOTS; ++s) {
+            Timer *t = tw->slots[lvl][s];
+            while (t) {
+                Timer *next = t->next;
+                free(t);
+                t = next;
+            }
+            tw->slots[lvl][s] = NULL;
+        }
+    }
+    tw->pending = 0;
+}
+
+Timer* tw_add(TimerWheel *tw, uint64_t delay, void (*fn)(TimerWheel *, Timer *), void *arg, int tag) {
+    if (!tw || !fn) return NULL;
+    Timer *t = malloc(sizeof(Timer));
+    if (!t) return NULL;
+    if (delay < 1) delay = 1;
+    if (delay > TW_MAX_DELAY) delay = TW_MAX_DELAY;
+    t->expires = tw->now + delay;
+    t->fn = fn;
+    t->arg = arg;
+    t->tag = tag;
+    wheel_place(tw, t);
+    tw->pending++;
+    return t;
+}
+
+void tw_cancel(TimerWheel *tw, Timer *t) {
+    if (!tw || !t) return;
+    slot_unlink(tw, t);
+    tw->pending--;
+    free(t);
+}
+
+/* Re-place every timer of a coarse slot now that it is within reach */
+static void cascade(TimerWheel *tw, int lvl) {
+    Timer **slot = &tw->slots[lvl][(tw->now >> (lvl * TW_BITS)) & TW_MASK];
+    Timer *t = *slot;
+    *slot = NULL;
+    while (t) {
+        Timer *next = t->next;
+        wheel_place(tw, t);
+        t = next;
+    }
+}
+
+int tw_advance(TimerWheel *tw, uint64_t now) {
+    if (!tw) return 0;
+    int fired = 0;
+    while (tw->now < now) {
+        tw->now++;
+        /* crossing a level boundary pulls the next coarse slot down */
+        for (int lvl = 1; lvl < TW_LEVELS; ++lvl) {
+            if ((tw->now & ((1ULL << (lvl * TW_BITS)) - 1)) != 0) break;
+            cascade(tw, lvl);
+        }
+
+        Timer **slot = &tw->slots[0][tw->now & TW_MASK];
+        /* pop one at a time: a callback may cancel or add other timers */
+        while (*slot) {
+            Timer *t = *slot;
+            *slot = t->next;
+            if (t->next) t->next->prev = NULL;
+            t->next = t->prev = NULL;
+            tw->pending--;
+            t->fn(tw, t);
+            free(t);
+            fired++;
+        }
+    }
+    return fired;
+}
@@ -0,0 +1,46 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+/* Hierarchical timing wheel: TW_LEVELS wheels of TW_SLOTS slots, each level
+   TW_SLOTS times coarser than the one below. Insert and cancel are O(1);
+   a tick only touches the slot that comes due (plus an occasional cascade
+   from a coarser level), so idle timers cost nothing between ticks.
+   Ticks are abstract; callers drive tw_advance from a monotonic clock. */
+
+#define TW_BITS   6
+#define TW_SLOTS  (1 << TW_BITS)
+#define TW_MASK   (TW_SLOTS - 1)
+#define TW_LEVELS 4
+#define TW_MAX_DELAY ((1ULL << (TW_BITS * TW_LEVELS)) - 1)   /* longer delays are clamped */
+
+struct TimerWheel;
+
+typedef struct Timer {
+    struct Timer *next, *prev;
+    uint64_t expires;
+    void (*fn)(struct TimerWheel *tw, struct Timer *t);
+    void *arg;
+    int tag;
+} Timer;
+
+typedef struct TimerWheel {
+    Timer *slots[TW_LEVELS][TW_SLOTS];
+    uint64_t now;
+    int pending;
+    void *owner;              /* free for the user of the wheel */
+} TimerWheel;
+
+void tw_init(TimerWheel *tw, uint64_t now, void *owner);
+void tw_destroy(TimerWheel *tw);                      /* cancels everything without firing */
+
+/* Fire fn(tw, t) after delay ticks (at least 1). The Timer is freed after
+   fn returns, or by tw_cancel; NULL on allocation failure. */
+Timer* tw_add(TimerWheel *tw, uint64_t delay, void (*fn)(TimerWheel *, Timer *), void *arg, int tag);
+void tw_cancel(TimerWheel *tw, Timer *t);
+
+/* Run every timer due up to and including tick now; returns how many fired */
+int tw_advance(TimerWheel *tw, uint64_t now);
+
+#endif /* TIMER_WHEEL_H */
@@ -0,0 +1,198 @@
+#include "trace.h"
+
+#ifndef HQ_NO_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#define trace_getpid() _getpid()
+#else
+#include <unistd.h>
+#define trace_getpid() getpid()
+#endif
+
+typedef struct TraceSpan {
+    uint64_t start_ns;
+    uint64_t dur_ns;
+    const char *name;         /* string literal */
+    char detail[TRACE_DETAIL_LEN];
+} TraceSpan;
+
+/* One per recording thread; only that thread writes it. The dumper reads
+   slots below head and drops the ones that were overwritten meanwhile.
+   When a thread exits its ring is kept for the dump, and the next thread
+   with the same name (e.g. each autosave) records into it. */
+typedef struct TraceRing {
+    _Atomic uint64_t head;    /* spans recorded so far */
+    int tid;
+    int in_use;               /* under rings_lock */
+    char thread[32];
+    struct TraceRing *next;
+    TraceSpan span[TRACE_RING_SPANS];
+} TraceRing;
+
+atomic_int g_trace_on = 0;
+
+static char trace_path[256];
+static uint64_t origin_ns;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceRing *rings;
+static int next_tid = 1;
+static volatile sig_atomic_t dump_requested = 0;
+
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local TraceRing *tls_ring;
+static _Thread_local char tls_name[32];
+
+static void release_ring(void *arg) {
+    TraceRing *r = arg;
+    pthread_mutex_lock(&rings_lock);
+    r->in_use = 0;
+    pthread_mutex_unlock(&rings_lock);
+}
+
+static void make_ring_key(void) {
+    pthread_key_create(&ring_key, release_ring);
+}
+
+static TraceRing* ring_for_thread(void) {
+    if (tls_ring) return tls_ring;
+    pthread_once(&ring_key_once, make_ring_key);
+    pthread_mutex_lock(&rings_lock);
+    TraceRing *r = rings;
+    while (r && (r->in_use || !tls_name[0] || strcmp(r->thread, tls_name) != 0)) r = r->next;
+    if (!r && (r = calloc(1, sizeof(TraceRing))) != NULL) {
+        r->tid = next_tid++;
+        if (tls_name[0]) snprintf(r->thread, sizeof(r->thread), "%s", tls_name);
+        else snprintf(r->thread, sizeof(r->thread), "thread %d", r->tid);
+        r->next = rings;
+        rings = r;
+    }
+    if (r) r->in_use = 1;
+    pthread_mutex_unlock(&rings_lock);
+    if (!r) return NULL;
+    pthread_setspecific(ring_key, r);
+    tls_ring = r;
+    return r;
+}
+
+void trace_record(const char *name, const char *detail, uint64_t start_ns, uint64_t end_ns) {
+    TraceRing *r = ring_for_thread();
+    if (!r) return;
+    uint64_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    TraceSpan *s = &r->span[h & (TRACE_RING_SPANS - 1)];
+    s->start_ns = start_ns;
+    s->dur_ns = end_ns - start_ns;
+    s->name = name;
+    if (detail) snprintf(s->detail, sizeof(s->detail), "%s", detail);
+    else s->detail[0] = '\0';
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+}
+
+void trace_thread_name(const char *name) {
+    snprintf(tls_name, sizeof(tls_name), "%s", name ? name : "");
+    if (tls_ring) {
+        pthread_mutex_lock(&rings_lock);
+        snprintf(tls_ring->thread, sizeof(tls_ring->thread), "%s", tls_name);
+        pthread_mutex_unlock(&rings_lock);
+    }
+}
+
+static void put_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+int trace_dump(const char *path) {
+    if (!path) path = trace_path;
+    if (!path[0]) return 0;
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    int pid = (int)trace_getpid();
+    TraceSpan *copy = malloc(sizeof(TraceSpan) * TRACE_RING_SPANS);
+    uint64_t lost = 0;
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"hospital_queue\"}}", pid);
+    pthread_mutex_lock(&rings_lock);
+    for (TraceRing *r = rings; r && copy; r = r->next) {
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", pid, r->tid);
+        put_json_string(f, r->thread);
+        fprintf(f, "}}");
+
+        uint64_t h1 = atomic_load_explicit(&r->head, memory_order_acquire);
+        uint64_t from = h1 > TRACE_RING_SPANS ? h1 - TRACE_RING_SPANS : 0;
+        for (uint64_t i = from; i < h1; ++i) copy[i - from] = r->span[i & (TRACE_RING_SPANS - 1)];
+        uint64_t h2 = atomic_load_explicit(&r->head, memory_order_acquire);
+        /* slots at or below h2 - RING were reused while copying */
+        uint64_t valid = h2 >= TRACE_RING_SPANS ? h2 - TRACE_RING_SPANS + 1 : 0;
+        lost += from;
+        for (uint64_t i = from; i < h1; ++i) {
+            if (i < valid) { lost++; continue; }
+            const TraceSpan *s = &copy[i - from];
+            double ts = s->start_ns >= origin_ns ? (double)(s->start_ns - origin_ns) / 1000.0 : 0.0;
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    s->name, pid, r->tid, ts, (double)s->dur_ns / 1000.0);
+            if (s->detail[0]) {
+                fprintf(f, ",\"args\":{\"detail\":");
+                put_json_string(f, s->detail);
+                fputc('}', f);
+            }
+            fputc('}', f);
+        }
+    }
+    pthread_mutex_unlock(&rings_lock);
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"spans_overwritten\":%llu}}\n",
+            (unsigned long long)lost);
+    free(copy);
+    return fclose(f) == 0;
+}
+
+static void dump_at_exit(void) {
+    if (trace_dump(NULL)) fprintf(stderr, "Trace written to %s\n", trace_path);
+}
+
+#if !defined(_WIN32)
+static void on_sigusr2(int sig) {
+    (void)sig;
+    dump_requested = 1;
+}
+#endif
+
+void trace_poll(void) {
+    if (!dump_requested) return;
+    dump_requested = 0;
+    if (trace_dump(NULL)) fprintf(stderr, "Trace written to %s\n", trace_path);
+}
+
+int trace_init_from_env(void) {
+    const char *env = getenv("HOSP_TRACE");
+    if (!env || !env[0] || strcmp(env, "0") == 0) return 0;
+    snprintf(trace_path, sizeof(trace_path), "%s", strcmp(env, "1") == 0 ? "data/trace.json" : env);
+    origin_ns = monotonic_ns();
+    trace_thread_name("main");
+    atexit(dump_at_exit);
+#if !defined(_WIN32)
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigusr2;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR2, &sa, NULL);
+#endif
+    atomic_store(&g_trace_on, 1);
+    return 1;
+}
+
+#endif /* HQ_NO_TRACE */
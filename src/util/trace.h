@@ -0,0 +1,65 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "time_util.h"
+
+/* Span tracing in Chrome trace-event format (chrome://tracing, Perfetto).
+
+   HOSP_TRACE=data/trace.json turns recording on at startup. Each thread
+   records completed spans into its own ring of TRACE_RING_SPANS, so
+   recording takes no lock and the newest spans win when a ring wraps.
+   The rings are written to the file at exit and whenever the process gets
+   SIGUSR2 (picked up by the server loop or the next menu pass).
+
+       TRACE_BEGIN(t);
+       ...
+       TRACE_END(t, "queue.load_csv");          name must be a string literal
+       TRACE_END_ARG(t, "server.cmd", verb);    detail is copied, may be transient
+
+   Build with -DHQ_NO_TRACE (make NO_TRACE=1) to compile every span out. */
+
+#define TRACE_RING_SPANS 16384     /* per thread, power of two */
+#define TRACE_DETAIL_LEN 24
+
+#ifndef HQ_NO_TRACE
+
+extern atomic_int g_trace_on;
+
+void trace_record(const char *name, const char *detail, uint64_t start_ns, uint64_t end_ns);
+
+static inline uint64_t trace_begin(void) {
+    return atomic_load_explicit(&g_trace_on, memory_order_relaxed) ? monotonic_ns() : 0;
+}
+
+static inline void trace_end(uint64_t t0, const char *name, const char *detail) {
+    if (t0) trace_record(name, detail, t0, monotonic_ns());
+}
+
+#define TRACE_BEGIN(t) uint64_t t = trace_begin()
+#define TRACE_END(t, name) trace_end(t, name, NULL)
+#define TRACE_END_ARG(t, name, detail) trace_end(t, name, detail)
+
+/* HOSP_TRACE; also installs the exit and SIGUSR2 dumps. Returns 1 if on. */
+int trace_init_from_env(void);
+/* Label the calling thread in the trace viewer */
+void trace_thread_name(const char *name);
+/* Write every ring to path (NULL = the HOSP_TRACE file); 0 on failure */
+int trace_dump(const char *path);
+/* Dump if SIGUSR2 arrived since the last call; cheap, call from loops */
+void trace_poll(void);
+
+#else
+
+#define TRACE_BEGIN(t) do { } while (0)
+#define TRACE_END(t, name) do { } while (0)
+#define TRACE_END_ARG(t, name, detail) do { } while (0)
+static inline int trace_init_from_env(void) { return 0; }
+static inline void trace_thread_name(const char *name) { (void)name; }
+static inline int trace_dump(const char *path) { (void)path; return 0; }
+static inline void trace_poll(void) { }
+
+#endif /* HQ_NO_TRACE */
+
+#endif /* TRACE_H */
@@ -0,0 +1,65 @@
+#include "screen.h"
+#include <string.h>
+
+void screen_init(Screen *s) {
+    memset(s, 0, sizeof(*s));
+}
+
+static void move_to(StrBuf *out, int row, int col) {
+    sb_printf(out, "\x1b[%d;%dH", row + 1, col + 1);
+}
+
+void screen_update(Screen *s, const char *frame, StrBuf *out) {
+    if (!s->drawn) {
+        sb_puts(out, "\x1b[?25l\x1b[2J");   /* hide the cursor, clear once */
+        s->drawn = 1;
+    }
+
+    int row = 0;
+    const char *line = frame;
+    while (row < SCREEN_MAX_ROWS && line && *line) {
+        const char *nl = strchr(line, '\n');
+        int len = nl ? (int)(nl - line) : (int)strlen(line);
+        if (len > SCREEN_MAX_COLS) len = SCREEN_MAX_COLS;
+
+        /* changed span: new text plus blanks over what the old row had beyond it */
+        int old = row < s->rows ? s->width[row] : 0;
+        int span = len > old ? len : old;
+        int first = -1, last = -1;
+        for (int c = 0; c < span; ++c) {
+            char want = c < len ? line[c] : ' ';
+            char have = c < old ? s->cell[row][c] : ' ';
+            if (want != have) {
+                if (first < 0) first = c;
+                last = c;
+            }
+        }
+        if (first >= 0) {
+            move_to(out, row, first);
+            for (int c = first; c <= last; ++c) {
+                char want = c < len ? line[c] : ' ';
+                sb_append(out, &want, 1);
+                s->cell[row][c] = want;
+            }
+        }
+        s->width[row] = len;
+        ++row;
+        line = nl ? nl + 1 : NULL;
+    }
+
+    /* the frame got shorter: blank the rows it no longer covers */
+    for (int r = row; r < s->rows; ++r) {
+        if (s->width[r] == 0) continue;
+        move_to(out, r, 0);
+        sb_puts(out, "\x1b[K");
+        s->width[r] = 0;
+    }
+    s->rows = row;
+}
+
+void screen_finish(Screen *s, StrBuf *out) {
+    if (!s->drawn) return;
+    move_to(out, s->rows, 0);
+    sb_puts(out, "\x1b[?25h\n");
+    s->drawn = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include "../util/strbuf.h"
+
+/* Differential redraw for full-screen live views (ANSI terminals).
+
+   A frame is plain text, one screen row per '\n'-terminated line. Each
+   screen_update compares the new frame with the one on screen and appends
+   only cursor moves and the changed cells to out, so a dashboard that
+   refreshes every second rewrites a handful of digits instead of the whole
+   screen. Rows beyond SCREEN_MAX_ROWS x SCREEN_MAX_COLS are cut off; keep
+   frames single-byte (ASCII), since columns are counted in bytes. */
+
+#define SCREEN_MAX_ROWS 60
+#define SCREEN_MAX_COLS 160
+
+typedef struct Screen {
+    char cell[SCREEN_MAX_ROWS][SCREEN_MAX_COLS];
+    int width[SCREEN_MAX_ROWS];   /* used columns per row */
+    int rows;
+    int drawn;                    /* 0 until the first frame clears the screen */
+} Screen;
+
+void screen_init(Screen *s);
+void screen_update(Screen *s, const char *frame, StrBuf *out);
+/* Leave the cursor below the last row and show it again */
+void screen_finish(Screen *s, StrBuf *out);
+
+#endif /* SCREEN_H */
@@ -1,6 +1,38 @@
 #include "view.h"
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#if !defined(_WIN32)
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+static const char* sev_name(int sev) {
+    return sev == 2 ? "CRITICAL" : (sev == 1 ? "SERIOUS" : "NORMAL");
+}
+
+StrBuf* view_buffer(void) {
+    static StrBuf out;
+    return &out;
+}
+
+void view_flush(void) {
+    StrBuf *out = view_buffer();
+    if (out->len > 0) fwrite(out->data, 1, out->len, stdout);
+    fflush(stdout);
+    sb_reset(out);
+}
+
+/* Paging prompt between screenfuls; 0 when the user wants to stop */
+static int more_prompt(int shown, int total) {
+    char buf[8];
+    printf("-- %d of %d shown: Enter for more, q to stop -- ", shown, total);
+    if (!read_line(buf, sizeof(buf))) return 0;
+    return buf[0] != 'q' && buf[0] != 'Q';
+}
 
 void view_show_menu(void) {
     printf("\n\n\n=== Hospital Queue Management ===\n");
@@ -35,54 +67,401 @@ void view_show_patient(const Patient* p) {
     printf("Patient name: %s\n", p->name);
     printf("Patient Age: %d\n", p->age);
     printf("Severity: %s\n", sev_str);
+    if (p->flags & PATIENT_PREGNANT) printf("Pregnant: yes\n");
     printf("Arrival: %s\n", p->arrival);
     printf("Problem: %s\n\n", p->problem);
 }
 
 void view_show_list(PriorityQueue* q) {
-    if (!q || !q->head) {
+    QueueSnapshot *s = pq_snapshot(q);
+    view_show_snapshot(s);
+    qsnap_release(s);
+}
+
+int view_render_snapshot(StrBuf *out, const PatientRecord **order, int count, int first, int max) {
+    if (first == 0) {
+        sb_puts(out, "\n");
+        sb_printf(out, "%-4s | %-25s | %-5s | %-8s | %-19s | %-20s\n",
+                  "ID", "Name", "Age", "Severity", "Arrival", "Problem");
+        sb_puts(out, "----------------------------------------------------------------------------------------------------------\n");
+    }
+    int n = 0;
+    for (int i = first; i < count && n < max; ++i, ++n) {
+        const PatientRecord *cur = order[i];
+        sb_printf(out, "%-4d | %-25.25s | %-5d | %-8s | %-19s | %-20.20s\n",
+                  cur->id, cur->name, cur->age, sev_name(cur->severity), cur->arrival, cur->problem);
+    }
+    return n;
+}
+
+void view_show_snapshot(const QueueSnapshot* s) {
+    if (qsnap_size(s) == 0) {
         printf("Queue is empty\n");
         return;
     }
 
-    printf("\n");
-    printf("%-4s | %-25s | %-5s | %-8s | %-19s | %-20s\n",
-           "ID", "Name", "Age", "Severity", "Arrival", "Problem");
-    printf("----------------------------------------------------------------------------------------------------------\n");
-
-    Patient* cur = q->head;
-    while (cur) {
-        const char *sev_str = cur->severity == 2 ? "CRITICAL" : (cur->severity == 1 ? "SERIOUS" : "NORMAL");
-        printf("%-4d | %-25.25s | %-5d | %-8s | %-19s | %-20.20s\n",
-               cur->id, cur->name, cur->age, sev_str, cur->arrival, cur->problem);
-        cur = cur->next;
+    /* list in service order, which is what the desk calls next */
+    int count = qsnap_size(s);
+    const PatientRecord **order = malloc((size_t)count * sizeof(PatientRecord*));
+    if (!order) return;
+    count = qsnap_ordered(s, order, count);
+
+    StrBuf *out = view_buffer();
+    int shown = 0;
+    for (;;) {
+        shown += view_render_snapshot(out, order, count, shown, VIEW_PAGE_ROWS);
+        if (shown >= count) break;
+        view_flush();
+        if (!more_prompt(shown, count)) break;
+    }
+    free(order);
+
+    if (shown >= count && s->spilled > 0)
+        sb_printf(out, "... and %d more spilled to disk (served after those of their severity above)\n", s->spilled);
+    sb_printf(out, "\nTotal waiting: %d\n", qsnap_size(s));
+    view_flush();
+}
+
+void view_render_served_header(StrBuf *out) {
+    sb_puts(out, "\n");
+    sb_printf(out, "%-4s | %-12s | %-20s | %-3s | %-8s | %-19s | %-19s | %-9s | %-7s | %-3s | %-20s\n",
+              "ID", "Phone", "Name", "Age", "Severity", "Arrival", "Served At", "Wait(min)", "Svc(min)", "Ctr", "Problem");
+    sb_puts(out, "-----------------------------------------------------------------------------------------------------------------------------\n");
+}
+
+void view_render_served_row(StrBuf *out, const ServedRecord *r) {
+    double wait_min = (double)r->wait_sec / 60.0;
+    char svc[16] = "-";
+    time_t t_start = parse_iso_time(r->served_at), t_end = parse_iso_time(r->service_end);
+    if (r->counter_id > 0 && t_start != (time_t)-1 && t_end != (time_t)-1)
+        snprintf(svc, sizeof(svc), "%.2f", (double)(t_end - t_start) / 60.0);
+    sb_printf(out, "%-4d | %-12lld | %-20.20s | %-3d | %-8s | %-19s | %-19s | %-9.2f | %-8s | %-3d | %-20.20s\n",
+              r->id, r->phone, r->name, r->age, sev_name(r->severity), r->arrival, r->served_at, wait_min, svc,
+              r->counter_id, r->problem);
+}
+
+void view_render_search_header(StrBuf *out) {
+    sb_printf(out, "%-6s | %-22s | %-7s | %-10s | %-8s | %-19s | %-9s | %s\n",
+              "ID", "Name", "Status", "Dept", "Severity", "Arrived / Served", "Wait(min)", "Phone");
+    sb_puts(out, "------------------------------------------------------------------------------------------------------------\n");
+}
+
+void view_render_search_hits(StrBuf *out, const PidxHit *hits, int n, const char *default_dept, time_t now) {
+    for (int i = 0; i < n; ++i) {
+        const PidxHit *h = &hits[i];
+        char when[TIME_LEN] = "-";
+        time_t t = h->status == PIDX_SERVED ? h->served_at : h->arrival;
+        if (t != (time_t)-1) format_iso_time(t, when, sizeof(when));
+        long wait = h->wait_sec;
+        if (h->status == PIDX_WAITING) wait = h->arrival != (time_t)-1 ? (long)(now - h->arrival) : 0;
+        sb_printf(out, "%-6d | %-22.22s | %-7s | %-10.10s | %-8s | %-19s | %-9.2f | %lld\n",
+                  h->id, h->name, pidx_status_name(h->status), h->department[0] ? h->department : default_dept,
+                  sev_name(h->severity), when, (double)wait / 60.0, h->phone);
+    }
+}
+
+static int query_column_width(QueryField f) {
+    switch (f) {
+        case QF_ID: return 6;
+        case QF_PHONE: return 10;
+        case QF_NAME: return 22;
+        case QF_AGE: return 3;
+        case QF_SEVERITY: return 8;
+        case QF_ARRIVAL: case QF_SERVED_AT: return 19;
+        case QF_WAIT: return 9;
+        case QF_PROBLEM: return 20;
+        case QF_COUNTER: return 7;
+        case QF_DEPT: return 10;
+        case QF_STATUS: return 7;
+        case QF_COUNT: break;
     }
+    return 8;
+}
 
-    int count = 0;
-    cur = q->head;
-    while (cur) { count++; cur = cur->next; }
-    printf("\nTotal waiting: %d\n", count);
+void view_render_query_result(StrBuf *out, const Query *q, const QueryResult *r) {
+    if (q->group_by != QG_NONE) {
+        sb_printf(out, "%-12s | %9s | %s\n", "Group", "Count", "Avg wait(min)");
+        sb_puts(out, "-----------------------------------------\n");
+        for (int i = 0; i < r->ngroups; ++i) {
+            const QueryGroup *g = &r->groups[i];
+            sb_printf(out, "%-12s | %9ld | %.1f\n", g->key, g->count, g->count ? g->wait_sum / (double)g->count / 60.0 : 0.0);
+        }
+    } else if (!q->count_only && r->nrows > 0) {
+        StrBuf cell;
+        sb_init(&cell);
+        size_t width = 0;
+        for (int c = 0; c < q->nshow; ++c) {
+            int w = query_column_width(q->show[c]);
+            sb_printf(out, "%s%-*s", c ? " | " : "", w, query_field_name(q->show[c]));
+            width += (size_t)w + (c ? 3 : 0);
+        }
+        sb_puts(out, "\n");
+        for (size_t i = 0; i < width; ++i) sb_puts(out, "-");
+        sb_puts(out, "\n");
+        for (int i = 0; i < r->nrows; ++i) {
+            for (int c = 0; c < q->nshow; ++c) {
+                int w = query_column_width(q->show[c]);
+                sb_reset(&cell);
+                query_put_field(&cell, &r->rows[i], q->show[c]);
+                sb_printf(out, "%s%-*.*s", c ? " | " : "", w, w, cell.len ? cell.data : "");
+            }
+            sb_puts(out, "\n");
+        }
+        sb_free(&cell);
+    }
+    sb_printf(out, "\n%ld match%s", r->matched, r->matched == 1 ? "" : "es");
+    if (r->nrows < r->matched && !q->count_only) sb_printf(out, " (first %d shown; add limit N for more)", r->nrows);
+    sb_puts(out, "\n");
 }
 
 void view_show_stats(int totalAdded, int served, PriorityQueue* q) {
-    int waiting = 0;
-    Patient* cur = q->head;
-    while (cur) { waiting++; cur = cur->next; }
+    view_show_stats_counts(totalAdded, served, pq_size(q));
+}
 
+void view_show_stats_counts(int totalAdded, int served, int waiting) {
     printf("\n--- Stats ---\n");
     printf("Total registered: %d\n", totalAdded);
     printf("Total served: %d\n", served);
     printf("Currently waiting: %d\n", waiting);
 }
 
+void view_render_main_menu(StrBuf *out, const char *department) {
+    sb_puts(out, "\n╔════════════════════════════════════════════╗\n");
+    sb_puts(out, "║          MAIN MENU                         ║\n");
+    sb_puts(out, "╚════════════════════════════════════════════╝\n\n");
+    sb_puts(out, "  1.  ➕ Register Patient\n");
+    sb_puts(out, "  2.  📋 View Waiting List\n");
+    sb_puts(out, "  3.  📞 Call Next Patient\n");
+    sb_puts(out, "  4.  👀 Peek Next Patient\n");
+    sb_puts(out, "  5.  🔍 Search Patient\n");
+    sb_puts(out, "  6.  💾 Save Queue\n");
+    sb_puts(out, "  7.  📊 View Statistics\n");
+    sb_puts(out, "  8.  🗑️  Clear Queue\n");
+    sb_puts(out, "  9.  📜 View Served History\n");
+    sb_puts(out, "  10. ⏱️  Average Serving Times\n");
+    sb_puts(out, "  11. 📊 Queue Analytics (NEW)\n");
+    sb_puts(out, "  12. 🎯 Check Queue Position (NEW)\n");
+    sb_puts(out, "  13. 🤖 Predict Wait Time (NEW - ML)\n");
+    sb_puts(out, "  14. 📈 Peak Hours Analysis (NEW)\n");
+    sb_puts(out, "  15. 👨‍⚕️ Staff Performance (NEW)\n");
+    sb_puts(out, "  16. 🚨 Emergency Bypass (NEW)\n");
+    sb_puts(out, "  17. 📋 Visual Queue (NEW)\n");
+    sb_puts(out, "  18. 📑 Daily Report (NEW)\n");
+    sb_puts(out, "  19. 🛤️  Patient Journey (NEW)\n");
+    sb_puts(out, "  20. ✅ System Health Check (NEW)\n");
+    sb_puts(out, "  21. 🚪 Exit\n");
+    sb_puts(out, "  22. 🩺 Re-triage Patient (NEW)\n");
+    sb_puts(out, "  23. ✔️  Complete Service at Counter (NEW)\n");
+    sb_puts(out, "  24. 🏥 Counter Status (NEW)\n");
+    sb_printf(out, "  25. 🔀 Switch Department [%s] (NEW)\n", department);
+    sb_puts(out, "  26. ↪️  Transfer Patient to Department (NEW)\n");
+    sb_puts(out, "  27. 🏥 Department Statistics (NEW)\n");
+    sb_puts(out, "  28. 📺 Live Dashboard (NEW)\n");
+    sb_puts(out, "  29. 🧮 Query Patients (NEW)\n\n");
+}
+
+static int dash_row(void *ctx, const Patient *p) {
+    Dashboard *db = ctx;
+    DashboardRow *r = &db->row[db->rows++];
+    r->id = p->id;
+    snprintf(r->name, sizeof(r->name), "%s", p->name ? p->name : "");
+    r->severity = (int)p->severity;
+    time_t arr = p->arrival_ts;
+    r->waited_sec = arr != (time_t)-1 && db->now >= arr ? (long)(db->now - arr) : 0;
+    return 1;
+}
+
+void view_fill_dashboard(Dashboard *out, PriorityQueue *q, const Dispatcher *d, const char *department, time_t now) {
+    /* stats are filled by the caller (registry_stats takes the lock itself) */
+    out->now = now;
+    snprintf(out->department, sizeof(out->department), "%s", department ? department : "");
+    out->counters_busy = d ? dispatch_busy_count(d) : 0;
+    out->counters_total = d ? d->n : 0;
+    out->capacity_per_hour = d ? dispatch_throughput_per_hour(d) : 0.0;
+
+    /* spilled patients are read in place (pq_service_walk), not loaded */
+    out->rows = 0;
+    int n = pq_service_walk(q, DASH_ROWS, dash_row, out);
+    if (n < 0) out->rows = n = 0;
+    int sev[DASH_ROWS];
+    long eta[DASH_ROWS];
+    for (int i = 0; i < n; ++i) sev[i] = out->row[i].severity;
+    dispatch_eta_ordered(d, sev, n, now, eta);
+    for (int i = 0; i < n; ++i) out->row[i].eta_sec = eta[i];
+}
+
+static void put_minutes(StrBuf *out, long sec) {
+    if (sec < 0) sb_printf(out, "%6s", "-");
+    else sb_printf(out, "%4ld:%02ld", sec / 60, sec % 60);
+}
+
+void view_render_dashboard(StrBuf *frame, const Dashboard *db) {
+    char when[TIME_LEN];
+    format_iso_time(db->now, when, sizeof(when));
+    const RegistryStats *st = &db->stats;
+    sb_printf(frame, "HOSPITAL QUEUE - LIVE DASHBOARD %32s\n", when);
+    sb_printf(frame, "Department: %-20s  Counters busy: %d/%d  Capacity: %.1f/h\n",
+              db->department[0] ? db->department : "general", db->counters_busy, db->counters_total,
+              db->capacity_per_hour);
+    sb_puts(frame, "\n");
+    sb_printf(frame, "Waiting %6d   Critical %5d   Serious %5d   Normal %5d\n",
+              st->waiting, st->by_severity[CRITICAL], st->by_severity[SERIOUS], st->by_severity[NORMAL]);
+    sb_puts(frame, "Oldest wait     Critical ");
+    put_minutes(frame, st->oldest_wait_sec[CRITICAL]);
+    sb_puts(frame, "  Serious ");
+    put_minutes(frame, st->oldest_wait_sec[SERIOUS]);
+    sb_puts(frame, "  Normal ");
+    put_minutes(frame, st->oldest_wait_sec[NORMAL]);
+    sb_printf(frame, "\nRegistered %5ld   Served %5ld\n", st->registered, st->served);
+    sb_puts(frame, "\n");
+    sb_printf(frame, "%3s  %-6s %-30s %-8s %8s %8s\n", "#", "ID", "Name", "Severity", "Waited", "ETA");
+    sb_puts(frame, "------------------------------------------------------------------------\n");
+    for (int i = 0; i < DASH_ROWS; ++i) {
+        if (i >= db->rows) { sb_puts(frame, "\n"); continue; }
+        const DashboardRow *r = &db->row[i];
+        sb_printf(frame, "%3d  %-6d %-30.30s %-8s ", i + 1, r->id, r->name, sev_name(r->severity));
+        put_minutes(frame, r->waited_sec);
+        sb_puts(frame, " ");
+        put_minutes(frame, r->eta_sec);
+        sb_puts(frame, "\n");
+    }
+    if (st->waiting > db->rows) sb_printf(frame, "... %d more waiting\n", st->waiting - db->rows);
+    else sb_puts(frame, "\n");
+    /* fixed height, so a new alert only redraws its own lines */
+    sb_puts(frame, "\n");
+    for (int i = 0; i < DASH_ALERTS; ++i) sb_printf(frame, "%s\n", i < db->alerts ? db->alert[i] : "");
+    sb_puts(frame, "\nRefreshes every second. Press Enter to return to the menu.\n");
+}
+
+static int display_row(void *ctx, const Patient *p) {
+    DisplayPayload *out = ctx;
+    DisplayRow *r = &out->row[out->rows++];
+    r->id = p->id;
+    r->position = out->rows;
+    r->severity = (int32_t)p->severity;
+    display_mask_name(p->name, r->name, sizeof(r->name));
+    return 1;
+}
+
+void view_fill_display(DisplayPayload *out, PriorityQueue *q, const Dispatcher *d, const char *department, time_t now) {
+    memset(out, 0, sizeof(*out));
+    out->published_at = (int64_t)now;
+    out->waiting = pq_size(q);
+    out->counters_busy = d ? dispatch_busy_count(d) : 0;
+    out->counters_total = d ? d->n : 0;
+    snprintf(out->department, sizeof(out->department), "%s", department ? department : "");
+
+    int n = pq_service_walk(q, DISPLAY_MAX_ROWS, display_row, out);
+    if (n < 0) out->rows = n = 0;
+    int sev[DISPLAY_MAX_ROWS];
+    long eta[DISPLAY_MAX_ROWS];
+    for (int i = 0; i < n; ++i) sev[i] = out->row[i].severity;
+    dispatch_eta_ordered(d, sev, n, now, eta);
+    for (int i = 0; i < n; ++i) out->row[i].eta_sec = (int32_t)eta[i];
+}
+
 void clear_queue_with_confirmation(PriorityQueue* q) {
     printf("Are you sure? (y/n): ");
     char buf[8];
     if (fgets(buf, sizeof(buf), stdin)) {
         if (buf[0] == 'y' || buf[0] == 'Y') {
-            pq_free_all(q);
-            pq_init(q);
+            /* one at a time so a queue observer sees every removal */
+            Patient *p;
+            while ((p = pq_peek(q)) != NULL) {
+                pq_remove(q, p);
+                free_patient(p);
+            }
             printf("Queue cleared\n");
         }
     }
 }
+
+/* Read a line from stdin */
+int read_line(char *buf, size_t buflen) {
+    if (!fgets(buf, (int)buflen, stdin)) return 0;
+    buf[strcspn(buf, "\r\n")] = '\0';
+    return 1;
+}
+
+int read_line_timeout(char *buf, size_t buflen, int timeout_ms) {
+#if !defined(_WIN32)
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    int r = poll(&pfd, 1, timeout_ms);
+    if (r == 0) return 0;
+    if (r < 0) return 0;   /* interrupted: treat as a tick */
+#else
+    (void)timeout_ms;      /* no portable console poll: block */
+#endif
+    return read_line(buf, buflen) ? 1 : -1;
+}
+
+#if !defined(_WIN32)
+static struct termios saved_term;
+static int keys_on = 0;
+#endif
+
+int view_keys_begin(void) {
+#if !defined(_WIN32)
+    if (keys_on || !isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &saved_term) != 0) return keys_on;
+    struct termios raw = saved_term;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) != 0) return 0;
+    keys_on = 1;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void view_keys_end(void) {
+#if !defined(_WIN32)
+    if (!keys_on) return;
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved_term);
+    keys_on = 0;
+#endif
+}
+
+int read_key(void) {
+    int c = getchar();
+    return c == EOF ? -1 : c;
+}
+
+/* Read an integer from stdin with validation */
+int read_int(const char *prompt, int *out) {
+    return read_int_ticking(prompt, out, NULL, NULL);
+}
+
+int read_int_ticking(const char *prompt, int *out, void (*tick)(void *ctx), void *ctx) {
+    char buf[128];
+    char *endptr;
+    long val;
+
+    while (1) {
+        printf("%s", prompt);
+        if (tick) {
+            int r;
+            fflush(stdout);
+            while ((r = read_line_timeout(buf, sizeof(buf), 1000)) == 0) tick(ctx);
+            if (r < 0) return 0;
+        } else if (!read_line(buf, sizeof(buf))) return 0;
+
+        errno = 0;
+        val = strtol(buf, &endptr, 10);
+
+        if (endptr == buf || (*endptr != '\0')) {
+            printf("Invalid number, try again.\n");
+            continue;
+        }
+
+        if ((errno == ERANGE && (val == LONG_MAX || val == LONG_MIN)) ||
+            val < INT_MIN || val > INT_MAX) {
+            printf("Number out of range, try again.\n");
+            continue;
+        }
+
+        *out = (int)val;
+        return 1;
+    }
+}
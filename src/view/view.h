@@ -3,11 +3,89 @@
 
 #include "../model/patient.h"
 #include "../model/queue.h"
+#include "../model/snapshot.h"
+#include "../model/dispatch.h"
+#include "../model/history.h"
+#include "../model/registry.h"
+#include "../model/patient_index.h"
+#include "../model/query.h"
+#include "../net/display_feed.h"
+#include "../util/strbuf.h"
+#include <stddef.h>
+
+/* Console output is rendered into one reusable buffer and written with a
+   single fwrite per screenful, instead of a printf per row */
+#define VIEW_PAGE_ROWS 40     /* rows per page of the waiting list and history */
+
+StrBuf* view_buffer(void);
+void view_flush(void);
 
 void view_show_menu(void);
+void view_render_main_menu(StrBuf *out, const char *department);
 void view_show_patient(const Patient* p);
 void view_show_list(PriorityQueue* q);
+void view_show_snapshot(const QueueSnapshot* s);   /* safe off the queue's thread, pages */
+/* Rows [first, first + max) of the waiting list in service order; returns rows rendered */
+int view_render_snapshot(StrBuf *out, const PatientRecord **order, int count, int first, int max);
+void view_render_served_header(StrBuf *out);
+void view_render_served_row(StrBuf *out, const ServedRecord *r);
+/* Ranked name-search results (menu 5); history rows without a department
+   show default_dept */
+void view_render_search_header(StrBuf *out);
+void view_render_search_hits(StrBuf *out, const PidxHit *hits, int n, const char *default_dept, time_t now);
+/* Ad-hoc query results (menu 29): the group counts if the query has a
+   "count by", else the kept rows in the query's columns */
+void view_render_query_result(StrBuf *out, const Query *q, const QueryResult *r);
 void view_show_stats(int totalAdded, int served, PriorityQueue* q);
+void view_show_stats_counts(int totalAdded, int served, int waiting);
 void clear_queue_with_confirmation(PriorityQueue* q);
 
+/* Waiting-room board: next DISPLAY_MAX_ROWS patients with masked names and ETAs */
+void view_fill_display(DisplayPayload *out, PriorityQueue *q, const Dispatcher *d, const char *department, time_t now);
+
+/* Live dashboard: filled under the department lock, rendered outside it */
+#define DASH_ROWS 15
+#define DASH_ALERTS 3
+#define DASH_ALERT_LEN 80   /* one ASCII line of the frame */
+
+typedef struct DashboardRow {
+    int id;
+    char name[32];
+    int severity;
+    long waited_sec;
+    long eta_sec;
+} DashboardRow;
+
+typedef struct Dashboard {
+    time_t now;
+    char department[32];
+    RegistryStats stats;
+    int counters_busy;
+    int counters_total;
+    double capacity_per_hour;
+    int rows;
+    DashboardRow row[DASH_ROWS];
+    int alerts;               /* alerts fired while the dashboard is up, oldest first */
+    char alert[DASH_ALERTS][DASH_ALERT_LEN];
+} Dashboard;
+
+void view_fill_dashboard(Dashboard *out, PriorityQueue *q, const Dispatcher *d, const char *department, time_t now);
+/* ASCII frame for screen_update */
+void view_render_dashboard(StrBuf *frame, const Dashboard *db);
+
+/* Console input helpers */
+int read_line(char *buf, size_t buflen);
+int read_int(const char *prompt, int *out);
+/* read_int that calls tick(ctx) every second while the prompt waits */
+int read_int_ticking(const char *prompt, int *out, void (*tick)(void *ctx), void *ctx);
+/* 1 = line read, 0 = nothing typed within timeout_ms, -1 = end of input.
+   Polls the descriptor, so stdin must be unbuffered (see main_loop). */
+int read_line_timeout(char *buf, size_t buflen, int timeout_ms);
+/* Single keystrokes without echo, for views that react to every key.
+   Returns 0, changing nothing, when stdin is not a terminal. */
+int view_keys_begin(void);
+void view_keys_end(void);
+/* Next input byte, or -1 at end of input */
+int read_key(void);
+
 #endif